@@ -0,0 +1,33 @@
+#ifndef __CWIST_CORE_MEM_EPOCH_H__
+#define __CWIST_CORE_MEM_EPOCH_H__
+
+#include <ttak/mem/epoch.h>
+
+/**
+ * @brief Registers the calling thread with libttak's epoch reclamation.
+ * Cheap after the first call; the thread is deregistered when it exits.
+ */
+void cwist_epoch_register(void);
+
+/**
+ * @brief Enters an epoch, registering the thread first if needed. Pointers
+ * loaded until cwist_epoch_unpin stay valid even if a writer retires them.
+ */
+void cwist_epoch_pin(void);
+
+/** @brief Leaves the epoch entered by cwist_epoch_pin. */
+void cwist_epoch_unpin(void);
+
+/** @brief Runs `cleanup(ptr)` once no pinned thread can still see `ptr`. */
+void cwist_epoch_retire(void *ptr, void (*cleanup)(void *));
+
+/**
+ * @brief Like cwist_epoch_retire, but only queues `ptr`. Lets a writer retire
+ * a batch under its lock and call cwist_epoch_reclaim once after dropping it.
+ */
+void cwist_epoch_retire_deferred(void *ptr, void (*cleanup)(void *));
+
+/** @brief Runs the cleanups of retired pointers no pinned thread can still see. */
+void cwist_epoch_reclaim(void);
+
+#endif
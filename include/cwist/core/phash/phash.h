@@ -0,0 +1,39 @@
+#ifndef __CWIST_PHASH_H__
+#define __CWIST_PHASH_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Immutable minimal perfect hash over a fixed key set.
+ *
+ * Built once (hash-and-displace): keys are grouped into small buckets, and
+ * each bucket gets a displacement that sends all of its keys to distinct
+ * slots. A lookup is one hash, one displacement read, one slot read and one
+ * memcmp. Header, displacements, slots and key bytes share one allocation.
+ */
+typedef struct cwist_phash cwist_phash;
+
+/** @brief One input key. `tag` is part of the key (e.g. the HTTP method). */
+typedef struct cwist_phash_key {
+    const char *key;
+    size_t len;
+    uint32_t tag;
+    void *value;
+} cwist_phash_key;
+
+/**
+ * @brief Builds a table over `keys[0..count)`; key bytes are copied.
+ * @return NULL on allocation failure, duplicate (tag, key) pairs, or an empty set.
+ */
+cwist_phash *cwist_phash_build(const cwist_phash_key *keys, size_t count);
+
+/** @brief Value stored for (tag, key), or NULL if the pair was not in the build set. */
+void *cwist_phash_get(const cwist_phash *ph, uint32_t tag, const char *key, size_t len);
+
+/** @brief Number of keys in the table. */
+size_t cwist_phash_count(const cwist_phash *ph);
+
+void cwist_phash_destroy(cwist_phash *ph);
+
+#endif
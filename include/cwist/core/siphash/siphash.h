@@ -12,6 +12,16 @@
  * * Returns the 64-bit hash value.
  */
 uint64_t siphash24(const void *src, size_t len, const uint8_t key[16]);
+/**
+ * siphash24_128: SipHash-2-4 with a 128-bit output, written to out[0..1].
+ * For keys where a 64-bit collision would be a correctness problem.
+ */
+void siphash24_128(const void *src, size_t len, const uint8_t key[16], uint64_t out[2]);
+/**
+ * siphash13: SipHash-1-3, the reduced-round variant used for hash tables.
+ * Still keyed (flood resistant), at roughly half the cost for short inputs.
+ */
+uint64_t siphash13(const void *src, size_t len, const uint8_t key[16]);
 /**
  * @brief Generates a random SipHash seed.
  * @code
@@ -21,4 +31,11 @@ uint64_t siphash24(const void *src, size_t len, const uint8_t key[16]);
  * @endcode
  */
 void cwist_generate_hash_seed(uint8_t key[16]);
+/**
+ * @brief Copies the per-process SipHash seed.
+ *
+ * The seed is generated on first use and regenerated in forked children, so
+ * hot paths get flood-resistant keys without reading /dev/urandom each time.
+ */
+void cwist_process_hash_seed(uint8_t key[16]);
 #endif
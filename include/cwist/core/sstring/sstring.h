@@ -9,6 +9,7 @@
 typedef struct cwist_sstring {
   char   *data;  ///< Access directly only when raw handling is necessary.
   bool   is_fixed;
+  bool   is_view; ///< `data` borrows external storage; it is copied before the first write.
   size_t size;
   size_t (*get_size)(struct cwist_sstring *str);
   int    (*compare )(struct cwist_sstring *left, const struct cwist_sstring *right); ///< Should mimic `strcmp`, internally use `strncmp`.
@@ -31,6 +32,18 @@ typedef struct cwist_sstring {
 cwist_sstring *cwist_sstring_create(void);
 void cwist_sstring_destroy(cwist_sstring *str);
 
+/** @name Views */
+/** @{ */
+/**
+ * @brief Initialize `str` as a read-only view of `len` bytes at `data`.
+ * `data[len]` must be `'\0'` and outlive the view. Mutating calls copy the
+ * bytes into owned storage first, so views can be handed out as regular strings.
+ */
+cwist_error_t cwist_sstring_init_view(cwist_sstring *str, const char *data, size_t len);
+/** @brief Free owned storage of an embedded (non-`create`d) string and reset it to empty. */
+void cwist_sstring_release(cwist_sstring *str);
+/** @} */
+
 /** @name String manipulation API */
 /** @{ */
 cwist_error_t cwist_sstring_append_len(cwist_sstring *str, const char *data, size_t len);
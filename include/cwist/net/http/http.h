@@ -12,6 +12,7 @@
 #include <cwist/core/db/sql.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 struct cwist_app;
 
@@ -45,6 +46,14 @@ typedef enum cwist_http_status_t {
 #define CWIST_HTTP_MAX_BODY_SIZE   (10 * 1024 * 1024)
 #define CWIST_HTTP_READ_BUFFER_SIZE (16 * 1024)
 #define CWIST_HTTP_TIMEOUT_MS      5000
+#define CWIST_HTTP_DRAIN_TIMEOUT_MS 10000
+/** Requests and responses each thread keeps for reuse (header nodes: four times as many). */
+#define CWIST_HTTP_RECYCLE_CACHE   64
+/** Header slots and body bytes a recycled object may keep; larger buffers are freed. */
+#define CWIST_HTTP_RECYCLE_MAX_HEADERS 64
+#define CWIST_HTTP_RECYCLE_MAX_BODY    (64 * 1024)
+/** Bytes of request-scoped scratch memory embedded in each request; larger needs spill into chunks. */
+#define CWIST_HTTP_ARENA_SIZE      (4 * 1024)
 
 /** --- Structures --- */
 
@@ -53,13 +62,14 @@ typedef struct cwist_http_header_node {
     cwist_sstring *key;
     cwist_sstring *value;
     struct cwist_http_header_node *next;
+    bool is_view; ///< Parsed in place: node and strings live in the request's header block.
 } cwist_http_header_node;
 
 typedef struct cwist_http_request {
     cwist_http_method_t method;
     cwist_sstring *path;        ///< e.g., "/users/1"
     cwist_sstring *query;       ///< e.g., "active=true" (raw)
-    cwist_query_map *query_params; ///< Parsed query parameters.
+    cwist_query_map *query_params; ///< Query parameters, parsed from `query` on first access.
     cwist_query_map *path_params;  ///< Parsed path parameters (e.g. :id).
     cwist_sstring *version;     ///< e.g., "HTTP/1.1"
     cwist_http_header_node *headers;
@@ -75,6 +85,25 @@ typedef struct cwist_http_request {
 
 typedef void (*cwist_http_body_cleanup_fn)(const void *ptr, size_t len, void *ctx);
 
+/**
+ * @brief A managed pointer body as it leaves the send path.
+ * An observer that keeps the bytes copies this struct and clears `cleanup`
+ * in the original; the reference is then its to release.
+ */
+typedef struct cwist_http_body_pin {
+    const void *ptr;
+    size_t len;
+    cwist_http_body_cleanup_fn cleanup;
+    void *ctx;
+} cwist_http_body_pin;
+
+/**
+ * @brief Receives the exact bytes of a response: status line and headers in
+ * iov[0], the body (if any) in iov[1]. The iovecs are valid only during the
+ * call. `pin` is set when the body is a managed pointer body.
+ */
+typedef void (*cwist_http_sent_fn)(const struct iovec *iov, int iov_cnt, cwist_http_body_pin *pin, void *ctx);
+
 /**
  * @brief HTTP Response Object.
  * Supports standard string body or Zero-Copy pointer body.
@@ -104,6 +133,56 @@ cwist_http_request *cwist_http_request_create(void);
 void cwist_http_request_destroy(cwist_http_request *req);
 cwist_http_request *cwist_http_parse_request(const char *raw_request); 
 cwist_http_request *cwist_http_receive_request(int client_fd, char *read_buf, size_t buf_size, size_t *buf_len);
+/**
+ * @brief Deep-copies the method, path, query, version, headers and body.
+ * The copy is detached: no client_fd, app, db or parsed parameters. It may be
+ * destroyed on another thread.
+ */
+cwist_http_request *cwist_http_request_clone(const cwist_http_request *src);
+/** @} */
+
+/** @name Request Arena */
+/** @{ */
+/**
+ * @brief Allocates zeroed scratch memory that lives exactly as long as the request.
+ *
+ * Everything drawn from the arena is released in one step by
+ * cwist_http_request_destroy (i.e. after the response is sent); never pass it to cwist_free.
+ * The parser, query/path parameter maps and bundled middleware use it too.
+ */
+void *cwist_http_request_alloc(cwist_http_request *req, size_t size);
+/** @brief Copies up to `n` bytes of `src` into the request arena (NUL-terminated). */
+char *cwist_http_request_strndup(cwist_http_request *req, const char *src, size_t n);
+/** @brief Copies `src` into the request arena. */
+char *cwist_http_request_strdup(cwist_http_request *req, const char *src);
+/** @} */
+
+/** @name Request Framing */
+/** @{ */
+/**
+ * @brief Checks whether a buffer starts with a complete request (headers + Content-Length body).
+ * @param buf Buffered bytes from the connection.
+ * @param len Number of valid bytes in buf.
+ * @param frame_len Receives the size of the complete request when framed.
+ * @return 1 when framed, 0 when more bytes are needed, -1 when the request exceeds the size limits.
+ */
+int cwist_http_frame_request(const char *buf, size_t len, size_t *frame_len);
+/**
+ * @brief Parses a request previously framed by cwist_http_frame_request.
+ *
+ * The request points into buf, so buf must outlive it. buf[frame_len] must be
+ * writable: it holds the body's NUL terminator until cwist_http_request_destroy
+ * puts the original byte back.
+ *
+ * @param buf Writable buffer holding the frame.
+ * @param frame_len Size reported by cwist_http_frame_request.
+ */
+cwist_http_request *cwist_http_request_from_frame(char *buf, size_t frame_len);
+/**
+ * @brief cwist_http_frame_request for a buffer that grows between calls.
+ * @param scanned In/out progress of the header search; start at 0 and reset to 0 once the frame is consumed.
+ */
+int cwist_http_frame_request_resume(const char *buf, size_t len, size_t *scanned, size_t *frame_len);
 /** @} */
 
 /** @name Request Data Processing */
@@ -126,6 +205,18 @@ void cwist_http_response_set_body_ptr_managed(cwist_http_response *res, const vo
 
 cwist_sstring *cwist_http_stringify_response(cwist_http_response *res);
 cwist_error_t cwist_http_send_response(int client_fd, cwist_http_response *res);
+/**
+ * @brief Sends like cwist_http_send_response, then hands the bytes it sent to
+ * `sent` (only if the send succeeded), so caches learn without re-serializing.
+ */
+cwist_error_t cwist_http_send_response_capture(int client_fd, cwist_http_response *res, cwist_http_sent_fn sent, void *ctx);
+/** @brief Serializes without sending and hands the bytes to `sent`. Releases the pointer body like a send. */
+void cwist_http_capture_response(cwist_http_response *res, cwist_http_sent_fn sent, void *ctx);
+/**
+ * @brief Writes every byte of an iovec array, waiting for POLLOUT on non-blocking sockets.
+ * @note The iovec entries are advanced in place as bytes are written.
+ */
+cwist_error_t cwist_http_send_iov(int client_fd, struct iovec *iov, int iov_cnt);
 cwist_error_t cwist_http_response_send_file(cwist_http_response *res, const char *file_path, const char *content_type_hint, size_t *out_size);
 /** @} */
 
@@ -150,17 +241,70 @@ cwist_http_method_t cwist_http_string_to_method(const char *method_str);
 /** @{ */
 /** @brief Create an IPv4 socket and perform bind/listen. */
 int cwist_make_socket_ipv4(struct sockaddr_in *sockv4, const char *address, uint16_t port, uint16_t backlog);
+/** @brief Same as cwist_make_socket_ipv4, with SO_REUSEPORT so several sockets can share the port. */
+int cwist_make_socket_ipv4_reuseport(struct sockaddr_in *sockv4, const char *address, uint16_t port, uint16_t backlog);
 /** @brief Accept sockets and invoke a handler callback. */
 cwist_error_t cwist_accept_socket(int server_fd, struct sockaddr *sockv4, void (*handler_func)(int client_fd, void *ctx), void *ctx);
 /** @} */
 
+/**
+ * @brief Per-request callback used by the event-driven server loop.
+ * @param client_fd Connection the request arrived on.
+ * @param req Fully framed request (owned by the loop, destroyed after the call).
+ * @param ctx User context passed to cwist_http_server_loop.
+ * @return true to keep the connection open for further requests.
+ */
+typedef bool (*cwist_http_request_handler_fn)(int client_fd, cwist_http_request *req, void *ctx);
+
 typedef struct cwist_server_config {
-    bool use_forking;     ///< Process per request.
-    bool use_threading;   ///< Thread per request.
-    bool use_epoll;       ///< Use epoll for accepting.
+    bool use_forking;     ///< Prefork: worker_processes long-lived processes share the listener.
+    bool use_threading;   ///< Dispatch connections (or framed requests with use_epoll) to a fixed worker pool.
+    bool use_epoll;       ///< Event-driven reactor: non-blocking client sockets registered with epoll.
+    size_t worker_threads; ///< Pool size for use_threading (0 = online CPU count).
+    size_t queue_capacity; ///< Pending jobs before the producer blocks (0 = 64 per worker).
+    cwist_http_request_handler_fn on_request; ///< Required by the reactor; called once per framed request.
+    bool use_io_uring;    ///< Prefer the io_uring engine (Linux); falls back to the epoll reactor at runtime.
+    int listen_backlog;   ///< listen() backlog used by cwist_app_listen (0 = SOMAXCONN).
+    size_t listener_shards; ///< SO_REUSEPORT listening sockets, each with its own loop (0/1 = single listener).
+    bool pin_cpus;        ///< Pin each listener shard (and the workers it starts) to one CPU.
+    size_t worker_processes; ///< Prefork worker count for use_forking (0 = online CPU count).
+    void (*on_worker_start)(void *ctx); ///< Called in each prefork worker right after fork().
+    void (*on_worker_exit)(void *ctx); ///< Called in each prefork worker once its loop has drained, before it exits.
+    bool use_coroutines;  ///< Run each connection handler as a coroutine on worker_threads schedulers.
+    size_t coroutine_stack_size; ///< Stack per coroutine (0 = CWIST_CORO_DEFAULT_STACK_SIZE).
 } cwist_server_config;
 
+/** @name Send Backends */
+/** @{ */
+/**
+ * @brief Hook that takes over writes issued through cwist_http_send_iov.
+ * @return true if the bytes were accepted (queued or sent), false to use the default sendmsg path.
+ */
+typedef bool (*cwist_http_send_hook_fn)(int client_fd, const struct iovec *iov, int iov_cnt, void *ctx);
+
+/**
+ * @brief Installs a send hook for the calling thread (NULL removes it).
+ * Used by completion-based engines that batch response writes.
+ */
+void cwist_http_set_send_hook(cwist_http_send_hook_fn hook, void *ctx);
+/** @} */
+
 cwist_error_t cwist_http_server_loop(int server_fd, cwist_server_config *config, void (*handler)(int, void *), void *ctx);
+/**
+ * @brief Asks running server loops to stop accepting and exit once in-flight work finishes.
+ * cwist_http_server_loop installs a SIGTERM/SIGINT handler that calls this, whatever the model.
+ */
+void cwist_http_server_request_drain(void);
+/** @brief True once a drain was requested. */
+bool cwist_http_server_is_draining(void);
+/**
+ * @brief Runs one cwist_http_server_loop per listening socket, each on its own thread.
+ *
+ * Intended for SO_REUSEPORT sockets: the kernel spreads new connections across
+ * them. The worker budget (worker_threads, or the CPU count) is divided between
+ * the shards, and config->pin_cpus pins shard i to CPU i. Blocks until every loop returns.
+ */
+cwist_error_t cwist_http_server_loop_sharded(const int *server_fds, size_t count, cwist_server_config *config, void (*handler)(int, void *), void *ctx);
 int headers_have_content_length(cwist_http_header_node *headers);
 
 #endif
@@ -1,31 +1,82 @@
 #ifndef __CWIST_QUERY_H__
 #define __CWIST_QUERY_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
-typedef struct cwist_query_bucket {
-    char *key;
-    char *value;
-    struct cwist_query_bucket *next;
-} cwist_query_bucket;
+/** Slots embedded in every map (enough for 8 entries at the maximum load of 1/2). */
+#define CWIST_QUERY_INLINE_SLOTS 16
+/** Entries per storage block; the first block is embedded in the map. */
+#define CWIST_QUERY_BLOCK_ENTRIES 8
+/** Bytes of a key/value pair (both NUL-terminated) stored inside the entry itself. */
+#define CWIST_QUERY_INLINE_BYTES 37
 
+/**
+ * @brief One key/value pair, sized to a single cache line.
+ * Entries never move once inserted, so returned pointers stay valid until the
+ * value is overwritten or the map is cleared.
+ */
+typedef struct cwist_query_entry {
+    const char *key;      ///< Points into inline_data for short pairs.
+    const char *value;
+    uint32_t hash;
+    uint32_t value_len;
+    uint16_t key_len;
+    uint8_t flags;        ///< Which strings were heap allocated (maps without an arena).
+    char inline_data[CWIST_QUERY_INLINE_BYTES];
+} cwist_query_entry;
+
+typedef void *(*cwist_query_alloc_fn)(void *ctx, size_t size);
+
+/**
+ * @brief Flat open-addressing map with linear probing.
+ *
+ * Slots hold a 16-bit hash tag and an entry index, so a probe compares tags
+ * within one cache line before touching any entry. Entries are kept in
+ * insertion order. Do not copy a map by value; it points into itself.
+ */
 typedef struct cwist_query_map {
-    cwist_query_bucket **buckets;
-    size_t size;
+    uint32_t *slots;            ///< (tag << 16) | (index + 1); 0 marks an empty slot.
+    size_t slot_mask;
+    size_t count;
+    cwist_query_entry **blocks; ///< Insertion-ordered entries, CWIST_QUERY_BLOCK_ENTRIES per block.
+    size_t block_count;
+    size_t block_cap;
     uint8_t seed[16];
+    cwist_query_alloc_fn alloc; ///< Optional arena for growth and long pairs; dropped, not freed.
+    void *alloc_ctx;
+    const char *pending;        ///< Raw query parsed on first access (see cwist_query_map_parse_deferred).
+    size_t pending_len;
+    uint32_t inline_slots[CWIST_QUERY_INLINE_SLOTS];
+    cwist_query_entry *inline_blocks[1];
+    cwist_query_entry first_block[CWIST_QUERY_BLOCK_ENTRIES];
 } cwist_query_map;
 
 /** @name Lifecycle */
 /** @{ */
 cwist_query_map *cwist_query_map_create(void);
 void cwist_query_map_destroy(cwist_query_map *map);
+/** @brief Initializes a map embedded in another object; allocates nothing. */
+void cwist_query_map_init(cwist_query_map *map);
+/** @brief Frees what an embedded map owns, leaving it empty. */
+void cwist_query_map_release(cwist_query_map *map);
+/**
+ * @brief Draws growth and long pairs from `alloc` instead of the heap.
+ * The arena must outlive every entry, and is expected to be reset wholesale.
+ */
+void cwist_query_map_use_arena(cwist_query_map *map, cwist_query_alloc_fn alloc, void *ctx);
 /** @} */
 
 /** @name Parsing */
 /** @{ */
 /** @brief Parse raw query strings (e.g., "a=1&b=2") into the map. */
 void cwist_query_map_parse(cwist_query_map *map, const char *raw_query);
+/**
+ * @brief Records `raw_query` and parses it only when the map is first read or written.
+ * The string must stay valid until then (or until the map is cleared).
+ */
+void cwist_query_map_parse_deferred(cwist_query_map *map, const char *raw_query, size_t len);
 void cwist_query_map_clear(cwist_query_map *map);
 /** @} */
 
@@ -33,6 +84,12 @@ void cwist_query_map_clear(cwist_query_map *map);
 /** @{ */
 const char *cwist_query_map_get(cwist_query_map *map, const char *key);
 void cwist_query_map_set(cwist_query_map *map, const char *key, const char *value);
+/** @brief cwist_query_map_set for strings that are not NUL-terminated. */
+bool cwist_query_map_set_len(cwist_query_map *map, const char *key, size_t key_len, const char *value, size_t value_len);
+/** @brief Number of distinct keys. */
+size_t cwist_query_map_count(cwist_query_map *map);
+/** @brief Entry `index` in insertion order; returns false past the end. */
+bool cwist_query_map_at(cwist_query_map *map, size_t index, const char **key, const char **value);
 /** @} */
 
 #endif
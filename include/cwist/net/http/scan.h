@@ -0,0 +1,38 @@
+/**
+ * @file scan.h
+ * @brief Vectorized delimiter scanning for the HTTP framer and parser.
+ *
+ * The implementation is chosen once at runtime: AVX2 when the CPU has it,
+ * SSE2 on other x86-64 machines, and a portable scalar loop elsewhere.
+ * Setting the environment variable `CWIST_HTTP_SCAN` to `scalar`, `sse2` or
+ * `avx2` caps the choice (useful for benchmarks).
+ */
+
+#ifndef __CWIST_HTTP_SCAN_H__
+#define __CWIST_HTTP_SCAN_H__
+
+#include <stddef.h>
+
+/**
+ * @brief Finds the first byte equal to `a` or `b` (memchr when they are equal).
+ * @return Offset of the match in `p[0..len)`, or `len` if there is none.
+ */
+size_t cwist_http_scan2(const char *p, size_t len, char a, char b);
+
+/**
+ * @brief Resumable search for the CRLF CRLF that ends a header block.
+ *
+ * `scanned` (optional) carries progress between calls on a growing buffer:
+ * start it at 0, pass it back after appending bytes, and reset it once the
+ * frame is consumed. Bytes before `*scanned` are not examined again.
+ *
+ * @return Pointer to the terminator's first `\r`, or NULL if not present yet.
+ */
+const char *cwist_http_scan_header_end(const char *buf, size_t len, size_t *scanned);
+
+/**
+ * @brief Name of the selected implementation ("avx2", "sse2" or "scalar").
+ */
+const char *cwist_http_scan_impl(void);
+
+#endif
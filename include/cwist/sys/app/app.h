@@ -40,15 +40,31 @@ typedef void (*cwist_error_handler_func)(cwist_http_request *req, cwist_http_res
 typedef void (*cwist_middleware_func)(cwist_http_request *req, cwist_http_response *res, cwist_handler_func next);
 
 /**
- * @brief Linked list node for middleware chain.
+ * @brief Linked list node for middleware registrations.
  */
 typedef struct cwist_middleware_node {
     cwist_middleware_func func;
+    char *prefix;      ///< Normalized path prefix, or NULL for every route.
+    size_t prefix_len;
     struct cwist_middleware_node *next;
 } cwist_middleware_node;
 
+/**
+ * @brief The middleware one route or mount runs, flattened in order.
+ *
+ * Resolved when the route is registered (and again when middleware is
+ * added), so a request indexes an array instead of re-filtering the list.
+ * Identical chains are shared; all of them live until cwist_app_destroy.
+ */
+typedef struct cwist_middleware_chain {
+    struct cwist_middleware_chain *next; ///< App-owned list of distinct chains.
+    size_t count;
+    cwist_middleware_func funcs[];
+} cwist_middleware_chain;
+
 typedef struct cwist_route_table cwist_route_table;
 typedef struct cwist_static_dir cwist_static_dir;
+typedef struct cwist_static_index cwist_static_index;
 
 /**
  * @brief Main Application Context.
@@ -62,10 +78,14 @@ typedef struct cwist_app {
     char *cert_path;
     char *key_path;
     
-    cwist_middleware_node *middlewares; ///< Head of the middleware chain.
+    cwist_middleware_node *middlewares; ///< Middleware registrations, in order.
+    cwist_middleware_chain *mw_chains; ///< Distinct resolved chains, shared by routes and mounts.
 
     cwist_route_table *router; ///< Router definition.
     cwist_static_dir *static_dirs; ///< Static directory mappings.
+    cwist_static_index *static_index; ///< Frozen prefix lookup built by cwist_app_listen.
+    pthread_mutex_t route_lock; ///< Serializes route and mount writers; lookups never take it.
+    bool routes_live; ///< Set by cwist_app_listen; later changes are published copy-on-write.
     
     cwist_error_handler_func error_handler; ///< Error handling callback.
 
@@ -81,6 +101,19 @@ typedef struct cwist_app {
     
     /** @brief Big Dumb Reply context for auto-caching high-latency endpoints */
     cwist_bdr_t *bdr_ctx;
+    /** @brief Bounded queue and thread for background BDR jobs (stale refreshes, snapshots) */
+    struct cwist_bdr_jobs *bdr_jobs;
+    /** @brief Warm-start snapshot of the BDR cache (NULL = none) */
+    char *bdr_snapshot_path;
+    /** @brief Seconds between periodic snapshots (0 = only on destroy) */
+    time_t bdr_snapshot_interval;
+    /** @brief When the last snapshot was started (atomic) */
+    time_t bdr_snapshot_at;
+    /** @brief Prefork: each worker saves its snapshot on drain; the master, which never learns, does not */
+    bool bdr_snapshot_in_workers;
+
+    /** @brief Concurrency settings applied by cwist_app_listen (plain HTTP) */
+    cwist_server_config server_config;
 } cwist_app;
 
 /** --- Memory Management --- */
@@ -143,7 +176,15 @@ void cwist_app_set_max_memspace(cwist_app *app, size_t size);
 
 /** @name Middleware */
 /** @{ */
+/** @brief Runs `mw` for every route and static mount. */
 void cwist_app_use(cwist_app *app, cwist_middleware_func mw);
+
+/**
+ * @brief Runs `mw` only for routes and mounts registered at `prefix` or below
+ * it ("/api" covers "/api" and "/api/users/:id", not "/apis").
+ * @return err_i16 = -1 on invalid arguments or allocation failure.
+ */
+cwist_error_t cwist_app_use_prefix(cwist_app *app, const char *prefix, cwist_middleware_func mw);
 /** @} */
 
 /** @name Error Handling Configuration */
@@ -160,6 +201,31 @@ void cwist_app_set_error_handler(cwist_app *app, cwist_error_handler_func handle
  */
 void cwist_app_configure_bdr(cwist_app *app, size_t max_bytes, time_t max_entry_age_sec, uint64_t revalidate_hits);
 
+/**
+ * @brief Keeps the Big Dumb Reply cache across restarts.
+ *
+ * Loads `path` right away, so replies that were stable before the restart
+ * are served from the first request. Afterwards a snapshot is written every
+ * `interval_sec` while serving and once more in cwist_app_destroy. Under
+ * `use_forking` each worker writes its own cache when it drains instead,
+ * and the file holds whichever worker saved last. Tag paths
+ * with cwist_bdr_set_version on `app->bdr_ctx` before calling this, so a
+ * deploy can invalidate the replies it changed.
+ *
+ * @param app Target app; call before cwist_app_listen.
+ * @param path Snapshot file.
+ * @param interval_sec Seconds between snapshots (0 = only on destroy).
+ * @return err_i16 0 if a snapshot was loaded, -1 otherwise (snapshots are still written).
+ */
+cwist_error_t cwist_app_configure_bdr_snapshot(cwist_app *app, const char *path, time_t interval_sec);
+
+/**
+ * @brief Overrides the server concurrency settings used by cwist_app_listen.
+ * @param app Target app.
+ * @param config Settings to copy (worker_threads/queue_capacity of 0 pick defaults).
+ */
+void cwist_app_configure_server(cwist_app *app, const cwist_server_config *config);
+
 cwist_error_t cwist_app_use_https(cwist_app *app, const char *cert_path, const char *key_path);
 cwist_error_t cwist_app_use_db(cwist_app *app, const char *db_path);
 cwist_error_t cwist_app_use_nuke_db(cwist_app *app, const char *db_path, int sync_interval_ms);
@@ -174,6 +240,12 @@ void cwist_app_get(cwist_app *app, const char *path, cwist_handler_func handler)
 void cwist_app_post(cwist_app *app, const char *path, cwist_handler_func handler);
 void cwist_app_ws(cwist_app *app, const char *path, cwist_ws_handler_func handler);
 
+/**
+ * @brief Removes a route; safe to call while the app is serving.
+ * @return err_i16 = 0 when a route was removed, -1 otherwise.
+ */
+cwist_error_t cwist_app_remove_route(cwist_app *app, cwist_http_method_t method, const char *path);
+
 /**
  * @brief Serves a directory of static files at a URL prefix.
  * Files are loaded into the fixed memory pool for Zero-Copy serving.
@@ -183,6 +255,12 @@ void cwist_app_ws(cwist_app *app, const char *path, cwist_ws_handler_func handle
  * @note Additional method helpers can be added as needed.
  */
 cwist_error_t cwist_app_static(cwist_app *app, const char *url_prefix, const char *directory);
+
+/**
+ * @brief Removes every static mount at `url_prefix`; safe to call while serving.
+ * Files already loaded into the memory pool stay there.
+ */
+cwist_error_t cwist_app_unmount_static(cwist_app *app, const char *url_prefix);
 /** @} */
 
 /** @name Startup */
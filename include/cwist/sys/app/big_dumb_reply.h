@@ -7,50 +7,239 @@
 #define __CWIST_BIG_DUMB_REPLY_H__
 
 #include <cwist/core/sstring/sstring.h>
+#include <cwist/net/http/http.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <time.h>
 
+#define CWIST_BDR_SHARDS 16            ///< Independent writer locks; must be a power of two.
+#define CWIST_BDR_SHARD_BUCKETS 256    ///< Hash buckets per shard; must be a power of two.
+#define CWIST_BDR_SHARD_MAX_ENTRIES 1024 ///< Entries (replies, candidates, markers) per shard.
+#define CWIST_BDR_SKETCH_DEPTH 4       ///< Rows in the admission frequency sketch.
+#define CWIST_BDR_SKETCH_WIDTH 1024    ///< Counters per row; must be a power of two.
+#define CWIST_BDR_DISK_SEGMENTS 4      ///< Segments in the disk tier; the oldest is recycled whole.
+#define CWIST_BDR_DISK_BUCKETS 1024    ///< Disk index buckets; must be a power of two.
+#define CWIST_BDR_DISK_LOCKS 64        ///< Disk index lock stripes; a power of two no larger than the buckets.
+#define CWIST_BDR_SPLICE_MAX 256       ///< Room for the headers patched into each hit.
+#define CWIST_BDR_REQUEST_ID_MAX 128   ///< Longer client request ids are replaced, not echoed.
+
+/**
+ * @brief A cached reply, shared by reference.
+ *
+ * The cache holds one reference while the blob is published. Each hit
+ * takes another, so an eviction never frees bytes that are still being sent.
+ *
+ * A reply is `data` followed by `body`. Bodies that came from a managed
+ * pointer (e.g. a static file) are pinned rather than copied: the blob keeps
+ * the sender's reference and releases it when the blob is freed.
+ *
+ * HTTP replies are stored as a header template: the Date, Connection, Age
+ * and X-Request-Id lines are cut out, and cwist_bdr_splice_reply writes fresh ones
+ * at `head_split` on every hit.
+ */
+typedef struct cwist_bdr_blob {
+    size_t refs;               ///< Atomic reference count.
+    size_t len;                ///< Bytes in `data`
+    const unsigned char *body; ///< Pinned body, or NULL when everything is in `data`
+    size_t body_len;
+    cwist_http_body_cleanup_fn body_release;
+    void *body_release_ctx;
+    size_t head_split;         ///< Offset of the blank line ending the head; 0 if not a template
+    bool request_id;           ///< The learned reply carried X-Request-Id
+    bool conn_close;           ///< The learned reply closed its connection
+    time_t born;               ///< When these bytes were last produced (for Age)
+    unsigned char data[];
+} cwist_bdr_blob;
+
+/** @brief One hit ready for cwist_http_send_iov: the template with this request's headers spliced in. */
+typedef struct cwist_bdr_splice {
+    struct iovec iov[4];
+    int iov_cnt;
+    bool keep_alive;           ///< Whether the connection may stay open after this reply
+    char headers[CWIST_BDR_SPLICE_MAX];
+} cwist_bdr_splice;
+
 /**
  * @brief Big Dumb Reply Entry.
  * Stores a completely serialized HTTP response blob.
  */
 typedef struct bdr_entry_t {
-    uint64_t request_hash; ///< Key: SipHash(Method + Path)
-    
+    uint64_t request_hash[2]; ///< SipHash-2-4-128 of `key`
+    char *key;             ///< Canonical request key, compared on every lookup
+    size_t key_len;
+    char *vary;            ///< Vary marker: lower-case header names; such entries hold no reply
+
     uint64_t response_hash;///< Hash of the response content (for stability check)
     bool is_stable;        ///< True if response proved stable across requests
-    
-    void *response_blob;   ///< Complete HTTP response (headers + body)
-    size_t len;            ///< Length of blob
-    
-    uint64_t hits;         ///< Hit count
+
+    cwist_bdr_blob *blob;  ///< Complete HTTP response (headers + body); NULL until stable
+
+    uint64_t hits;         ///< Hit count (atomic)
     time_t created_at;     ///< Creation timestamp
-    
+    uint8_t referenced;    ///< CLOCK bit: set by hits, cleared as the hand passes
+    size_t clock_slot;     ///< Position in the shard's CLOCK ring
+    bool reply_changed;    ///< Candidate whose last two replies differed; not worth coalescing (atomic)
+
     struct bdr_entry_t *next;
 } bdr_entry_t;
 
+struct cwist_bdr_flight;
+
+/**
+ * @brief One slice of the cache. Readers walk the buckets without locking;
+ * writers hold `lock`, which also guards the byte count, the CLOCK ring and
+ * the sweep cursor.
+ *
+ * Eviction is CLOCK over every entry in the shard. Admission is TinyLFU: a
+ * count-min sketch of recent lookups, halved periodically, decides whether
+ * a newcomer is worth more than the entry CLOCK would evict for it.
+ */
+typedef struct cwist_bdr_shard {
+    pthread_mutex_t lock;
+    bdr_entry_t *buckets[CWIST_BDR_SHARD_BUCKETS];
+    size_t current_bytes;      ///< Bytes of published blobs in this shard
+    size_t gc_cursor;          ///< Round-robin sweep cursor
+
+    bdr_entry_t **clock;       ///< CLOCK ring of every entry in the shard
+    size_t clock_len;
+    size_t clock_cap;
+    size_t clock_hand;
+
+    struct cwist_bdr_flight *flights; ///< Handler runs in progress, one per key
+
+    uint8_t sketch[CWIST_BDR_SKETCH_DEPTH][CWIST_BDR_SKETCH_WIDTH]; ///< Saturating 4-bit counts (relaxed atomics)
+    size_t sketch_samples;     ///< Lookups since the last halving (atomic)
+
+    /// Statistics (atomic).
+    uint64_t stat_hits;
+    uint64_t stat_misses;
+    uint64_t stat_admitted;
+    uint64_t stat_rejected;
+    uint64_t stat_evicted;
+    uint64_t stat_coalesced;
+    uint64_t stat_stale;
+} __attribute__((aligned(64))) cwist_bdr_shard;
+
+/** @brief A waiter parked on a flight; lives on the waiter's stack. */
+typedef struct cwist_bdr_waiter {
+    int wake[2];               ///< Private pipe; the leader writes one byte when done
+    struct cwist_bdr_waiter *next;
+} cwist_bdr_waiter;
+
+/**
+ * @brief One handler execution that concurrent requests for the same key
+ * wait on instead of running the handler themselves.
+ */
+typedef struct cwist_bdr_flight {
+    struct cwist_bdr_flight *next; ///< Shard list, under the shard lock
+    cwist_bdr_shard *shard;
+    char *key;                 ///< Key the flight was opened for
+    size_t key_len;
+    size_t refs;               ///< Leader plus joined waiters (atomic)
+    pthread_mutex_t lock;      ///< Guards everything below
+    cwist_bdr_waiter *waiters;
+    bool done;
+    cwist_bdr_blob *blob;      ///< Reply for the waiters; NULL sends them to the handler
+} cwist_bdr_flight;
+
+/** @brief One region of the segment file; records are only ever appended to it. */
+typedef struct cwist_bdr_segment {
+    size_t base;               ///< Offset in the mapping
+    size_t used;               ///< Bytes appended so far
+    size_t pins;               ///< Blobs still reading from this segment (atomic)
+} cwist_bdr_segment;
+
+/** @brief Where one demoted reply lives in the segment file. */
+typedef struct cwist_bdr_disk_entry {
+    struct cwist_bdr_disk_entry *next;
+    uint64_t request_hash[2];  ///< Same hash as the RAM entry; the key itself is compared in the mapping
+    uint64_t response_hash;
+    time_t created_at;
+    size_t offset;             ///< Record offset in the mapping
+    size_t segment;
+} cwist_bdr_disk_entry;
+
+/**
+ * @brief Disk tier: an append-only segment file mapped into memory, with its
+ * index kept in RAM.
+ *
+ * The index is guarded per stripe of buckets, so lookups on different keys do
+ * not contend; an empty bucket is seen without locking at all. The context's
+ * `disk_lock` only serializes appends and segment recycling, and nests
+ * outside the stripe locks.
+ */
+typedef struct cwist_bdr_disk {
+    int fd;
+    unsigned char *map;
+    size_t capacity;
+    size_t segment_size;
+    cwist_bdr_segment segments[CWIST_BDR_DISK_SEGMENTS];
+    size_t active;             ///< Segment taking appends
+    cwist_bdr_disk_entry *buckets[CWIST_BDR_DISK_BUCKETS]; ///< Heads are stored atomically
+    pthread_mutex_t index_locks[CWIST_BDR_DISK_LOCKS]; ///< Bucket i is guarded by lock i % CWIST_BDR_DISK_LOCKS
+    size_t entries;            ///< (atomic)
+    uint64_t stat_demoted;
+    uint64_t stat_hits;        ///< (atomic)
+} cwist_bdr_disk;
+
+/** @brief The deploy version of every path under one prefix (see cwist_bdr_set_version). */
+typedef struct cwist_bdr_version {
+    char *prefix;              ///< Matched against the path; "" matches every path
+    size_t prefix_len;
+    uint64_t tag;              ///< Hash of the version string, stable across processes
+} cwist_bdr_version;
+
+/** @brief Cache counters summed over all shards. */
+typedef struct cwist_bdr_stats {
+    uint64_t hits;             ///< Lookups that returned a reply
+    uint64_t misses;           ///< Cacheable lookups that did not
+    uint64_t admitted;         ///< Replies stored, plus candidates admitted at the entry cap
+    uint64_t rejected;         ///< Newcomers refused by TinyLFU admission
+    uint64_t evicted;          ///< Entries dropped by CLOCK
+    uint64_t coalesced;        ///< Misses served by another request's handler run
+    uint64_t stale;            ///< Hits served past their TTL or hit budget
+    size_t bytes;              ///< Reply bytes currently held
+    size_t entries;            ///< Entries currently held (replies, candidates, markers)
+    uint64_t demoted;          ///< Replies written to the disk tier
+    uint64_t disk_hits;        ///< Hits served from the disk tier
+    size_t disk_bytes;         ///< Bytes appended to live segments
+    size_t disk_entries;       ///< Replies indexed on disk
+} cwist_bdr_stats;
+
 /**
  * @brief Big Dumb Reply Context.
- * Manages cache buckets and learning parameters.
+ * Manages cache shards and learning parameters.
  */
 typedef struct cwist_bdr_t {
-    bdr_entry_t **buckets;     ///< Hash buckets
-    size_t bucket_count;       ///< Number of buckets
-    
+    cwist_bdr_shard shards[CWIST_BDR_SHARDS];
+
     /// Learning configuration parameters.
     int hit_threshold;         ///< (Unused) Hits before caching
     int latency_threshold_ms;  ///< Latency threshold to trigger caching
 
-    size_t current_bytes;      ///< Total bytes stored in-memory
-    size_t max_bytes;          ///< Soft limit for cached response bytes
+    size_t max_bytes;          ///< Soft limit for cached response bytes (split across shards)
     time_t max_entry_age_sec;  ///< TTL for cached replies (0 = no TTL)
     uint64_t revalidate_hits;  ///< Force refresh after this many hits
-    size_t gc_cursor;          ///< Round-robin sweep cursor
-    
-    /// Fallback disk database mode.
-    struct sqlite3 *disk_db;   ///< Disk DB handle for low-RAM mode
-    bool is_disk_mode;         ///< True if fallback is active
+    time_t max_stale_sec;      ///< How long past its TTL a reply may be served while refreshing
+    int coalesce_wait_ms;      ///< How long a coalesced miss waits for the leader
+
+    /// Disk tier.
+    cwist_bdr_disk *disk;      ///< Segment file, opened on first use (published atomically)
+    bool is_disk_mode;         ///< Low RAM: replies stabilize on disk instead of in RAM
+    pthread_mutex_t disk_lock; ///< Serializes opening the tier, appends and segment recycling
+    char *disk_dir;            ///< Where the segment file goes (NULL = working directory)
+    size_t disk_capacity;      ///< Segment file size
+    size_t ram_floor;          ///< Free RAM below which low-RAM mode starts
+    time_t ram_checked_at;     ///< Free RAM is sampled at most once a second (atomic)
+    struct cwist_bdr_t *disk_next; ///< Next context with an open disk tier, for the fork handlers
+
+    /// Warm-start snapshots.
+    pthread_mutex_t snapshot_lock; ///< Serializes saves and loads, and guards the version table
+    cwist_bdr_version *versions;
+    size_t version_count;
+
+    uint8_t seed[16];          ///< SipHash key, fixed for the life of the context
 } cwist_bdr_t;
 
 /**
@@ -60,28 +249,187 @@ cwist_bdr_t *cwist_bdr_create(void);
 
 /**
  * @brief Destroys a BDR context and frees all cached blobs.
+ * No other thread may use the context any more.
  */
 void cwist_bdr_destroy(cwist_bdr_t *bdr);
 
 /**
- * @brief Try to find a cached response.
+ * @brief Try to find a cached response, stale ones included. Safe to call
+ * from any thread; a hit takes no lock. Unlike cwist_bdr_acquire it never
+ * coalesces or starts a refresh.
+ *
+ * Replies are keyed on the method, the path, the query string with its
+ * `&`-separated parameters sorted by name (repeated names keep their order),
+ * and the values of any request headers the cached response named in `Vary`.
+ * Keys are compared in full, not just by hash.
+ *
  * @param bdr Context.
- * @param method HTTP Method (only GET supported).
- * @param path Request path.
- * @param out_len [out] Length of the found blob.
- * @return Pointer to the blob if found, NULL otherwise.
+ * @param req Request (only GET is cached).
+ * @return A referenced blob (release it with cwist_bdr_blob_release once
+ *         sent), or NULL.
  */
-const void *cwist_bdr_get(cwist_bdr_t *bdr, const char *method, const char *path, size_t *out_len);
+cwist_bdr_blob *cwist_bdr_get(cwist_bdr_t *bdr, const cwist_http_request *req);
+
+/** @brief What cwist_bdr_acquire asks the caller to do. */
+typedef enum cwist_bdr_status {
+    CWIST_BDR_MISS,            ///< Run the handler.
+    CWIST_BDR_HIT,             ///< Send `blob`.
+    CWIST_BDR_STALE,           ///< Send `blob`, then run the handler and pass its reply to cwist_bdr_complete.
+    CWIST_BDR_LEAD             ///< Run the handler, send its reply, then pass it to cwist_bdr_complete.
+} cwist_bdr_status;
+
+typedef struct cwist_bdr_result {
+    cwist_bdr_status status;
+    cwist_bdr_blob *blob;      ///< Referenced reply for HIT and STALE
+    cwist_bdr_flight *flight;  ///< Open flight for STALE and LEAD
+} cwist_bdr_result;
+
+/**
+ * @brief Looks a request up and coordinates concurrent misses.
+ *
+ * A fresh reply is a HIT. A reply past its TTL or hit budget, but within
+ * `max_stale_sec`, is still sent; the first such caller gets STALE and runs
+ * the refresh after replying, everybody else keeps getting the stale HIT.
+ *
+ * A miss on a key that BDR has already seen once becomes LEAD for one caller.
+ * Concurrent callers wait up to `coalesce_wait_ms` for it and come back with
+ * the leader's reply as a HIT, or as a MISS if the reply could not be shared.
+ * Keys BDR has never seen are not coalesced, since nothing is known about
+ * whether their replies are shareable.
+ *
+ * @param bdr Context.
+ * @param req Request (only GET is cached).
+ * @param out Filled in; release `blob` once sent and complete any flight.
+ */
+void cwist_bdr_acquire(cwist_bdr_t *bdr, const cwist_http_request *req, cwist_bdr_result *out);
+
+/**
+ * @brief Closes the flight opened by cwist_bdr_acquire and learns the reply.
+ *
+ * Waiters are served the reply when it is now the stable cached reply for
+ * their key, or when it is a 5xx error (shared, never cached). Any other
+ * reply sends them to run the handler themselves. A 5xx never replaces a
+ * stale reply, so clients keep getting it until a refresh succeeds.
+ *
+ * @param res Response, or NULL when the handler could not produce one.
+ * @param iov Serialized response as sent (see cwist_bdr_put_iov), or NULL to abandon the flight.
+ */
+void cwist_bdr_complete(cwist_bdr_t *bdr, cwist_bdr_result *result, const cwist_http_request *req,
+                        const cwist_http_response *res, const struct iovec *iov, int iov_cnt,
+                        cwist_http_body_pin *pin);
+
+/**
+ * @brief Tunes coalescing and stale serving.
+ * @param coalesce_wait_ms How long a coalesced miss waits for its leader (<0 keeps default, 0 disables coalescing).
+ * @param max_stale_sec Grace past the TTL during which a stale reply is served (<0 keeps default).
+ */
+void cwist_bdr_set_coalescing(cwist_bdr_t *bdr, int coalesce_wait_ms, time_t max_stale_sec);
+
+/**
+ * @brief Prepares a cached reply for `req`.
+ *
+ * Fills in Date, Age, and a Connection value that matches this request. If
+ * the learned reply carried X-Request-Id, the request's own id is echoed, or a
+ * fresh one is generated. Replies that are not templates go out unchanged.
+ * `out` points into `blob`, so hold the reference until the send completes.
+ */
+void cwist_bdr_splice_reply(const cwist_bdr_blob *blob, const cwist_http_request *req, cwist_bdr_splice *out);
+
+/** @brief Drops a reference taken by cwist_bdr_get or cwist_bdr_acquire. */
+void cwist_bdr_blob_release(cwist_bdr_blob *blob);
 
 /**
  * @brief Store a response in the cache.
+ *
+ * A reply is served only after the same bytes were seen twice. The per-hit
+ * header lines (see cwist_bdr_blob) are left out of that comparison. Responses
+ * with `Vary: *` or a 5xx status are never stored. Seeing the cached bytes
+ * again renews the reply's TTL and hit budget.
+ *
  * @param bdr Context.
- * @param method HTTP Method.
- * @param path Request path.
+ * @param req The request that produced the response.
+ * @param res The response; its `Vary` header selects extra key headers.
  * @param data Serialized response data.
  * @param len Length of data.
  */
-void cwist_bdr_put(cwist_bdr_t *bdr, const char *method, const char *path, const void *data, size_t len);
+void cwist_bdr_put(cwist_bdr_t *bdr, const cwist_http_request *req, const cwist_http_response *res,
+                   const void *data, size_t len);
+
+/**
+ * @brief Store a response from the iovecs the send path transmitted.
+ *
+ * Candidates only hash the bytes; they are copied once, when the reply
+ * stabilizes. If `pin` is given it describes the last iovec, and a stable
+ * reply adopts it (clearing `pin->cleanup`) instead of copying the body.
+ */
+void cwist_bdr_put_iov(cwist_bdr_t *bdr, const cwist_http_request *req, const cwist_http_response *res,
+                       const struct iovec *iov, int iov_cnt, cwist_http_body_pin *pin);
+
+/**
+ * @brief Opens the disk tier now instead of on the first low-RAM check.
+ *
+ * Once open, stable replies that CLOCK evicts from RAM are appended to the
+ * segment file and keep being served from its mapping. When free RAM drops
+ * below `ram_floor`, RAM replies are demoted and new ones stabilize on disk
+ * until RAM recovers. Full segments are recycled oldest first.
+ *
+ * The file belongs to one process. A child forked while the tier is open
+ * (e.g. a prefork worker) gets a segment file of its own with a copy of what
+ * had been appended, so processes never write into each other's records.
+ *
+ * @param dir Directory for the segment file (NULL = working directory). The file is unlinked once mapped.
+ * @param capacity Size of the segment file (0 = default).
+ * @return err_i16 0 on success, -1 if the file could not be created or the tier is already open.
+ */
+cwist_error_t cwist_bdr_set_disk_tier(cwist_bdr_t *bdr, const char *dir, size_t capacity);
+
+/**
+ * @brief Tags the replies under `path_prefix` with a deploy version.
+ *
+ * Snapshots record the tag of each entry's path, the longest prefix that
+ * matches it. A load skips entries whose tag differs from the one configured
+ * now, so bumping the version of "/api/" drops only those replies after a
+ * deploy. Set tags before saving or loading; they are not read by lookups.
+ *
+ * @param path_prefix Path prefix (NULL or "" = every path without a longer match).
+ * @param version Any string, e.g. a build id (NULL removes the prefix).
+ * @return err_i16 0 on success, -1 on allocation failure.
+ */
+cwist_error_t cwist_bdr_set_version(cwist_bdr_t *bdr, const char *path_prefix, const char *version);
+
+/**
+ * @brief Writes the stable replies and Vary markers to a snapshot file.
+ *
+ * Each record keeps the key, the reply bytes, the response hash, when it was
+ * learned and its version tag; candidates are not saved. Replies on the disk
+ * tier are included. The file is written beside `path` and renamed over it,
+ * so readers never see a partial snapshot. Lookups keep running meanwhile;
+ * each shard is locked only while its entries are referenced.
+ *
+ * @return err_i16 0 on success, -1 on I/O failure.
+ */
+cwist_error_t cwist_bdr_snapshot_save(cwist_bdr_t *bdr, const char *path);
+
+/**
+ * @brief Warm-starts an empty context from a snapshot.
+ *
+ * The file is mapped read-only and validated (format, lengths, checksum)
+ * before anything is used; reply bodies are then served straight from the
+ * mapping. The context adopts the snapshot's hash seed so the saved hashes
+ * stay valid, which is why it must be empty and not yet serving. Entries past
+ * their TTL and stale grace, or whose version tag is no longer current, are
+ * skipped. Replies beyond the byte budget go to the disk tier if it is open.
+ *
+ * @param loaded Set to the number of entries restored (may be NULL).
+ * @return err_i16 0 on success, -1 if the file is missing, invalid, or the context is not empty.
+ */
+cwist_error_t cwist_bdr_snapshot_load(cwist_bdr_t *bdr, const char *path, size_t *loaded);
+
+/** @brief Fills `out` with counters summed over every shard. */
+void cwist_bdr_get_stats(cwist_bdr_t *bdr, cwist_bdr_stats *out);
+
+/** @brief hits / (hits + misses) since creation, or 0 before any lookup. */
+double cwist_bdr_hit_ratio(cwist_bdr_t *bdr);
 
 /**
  * @brief Adjusts guard-rail policies for the in-memory cache.
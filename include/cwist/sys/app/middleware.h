@@ -9,6 +9,11 @@
  */
 cwist_middleware_func cwist_mw_request_id(const char *header_name);
 
+#define CWIST_MW_REQUEST_ID_LEN 16
+
+/** @brief Writes a fresh request id, as the request id middleware would, plus a NUL. */
+void cwist_mw_request_id_fill(char out[CWIST_MW_REQUEST_ID_LEN + 1]);
+
 /** @brief Access log middleware output formats. */
 typedef enum {
     CWIST_LOG_COMMON,
@@ -0,0 +1,128 @@
+/**
+ * @file router.h
+ * @brief Route table used by cwist_app: exact-path hash plus a radix tree for patterns.
+ */
+
+#ifndef __CWIST_ROUTER_H__
+#define __CWIST_ROUTER_H__
+
+#include <cwist/net/http/http.h>
+#include <cwist/net/http/query.h>
+#include <cwist/net/websocket/websocket.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Maximum `:param` and `*wildcard` captures in one route pattern. */
+#define CWIST_ROUTE_MAX_PARAMS 16
+
+typedef void (*cwist_route_handler_func)(cwist_http_request *req, cwist_http_response *res);
+typedef void (*cwist_route_ws_handler_func)(cwist_websocket *ws);
+
+struct cwist_middleware_chain;
+
+/**
+ * @brief One registered (method, pattern) pair.
+ */
+typedef struct cwist_route_entry {
+    char *path;                      ///< Pattern as registered.
+    bool has_params;                 ///< Pattern contains `:param` or `*wildcard` segments.
+    cwist_http_method_t method;
+    cwist_route_handler_func handler;
+    cwist_route_ws_handler_func ws_handler;
+    char **param_names;              ///< Capture names, in pattern order.
+    size_t param_count;
+    const struct cwist_middleware_chain *middleware; ///< Precomposed chain, owned by the app; NULL runs none.
+    struct cwist_route_entry *next;  ///< Next entry in the same bucket or tree node.
+} cwist_route_entry;
+
+/** @brief A captured parameter, as a byte range of the request path. */
+typedef struct cwist_route_capture {
+    size_t offset;
+    size_t len;
+} cwist_route_capture;
+
+/**
+ * @brief Result of a route lookup. Captures point into the matched path, so
+ * nothing is copied until they are bound to a parameter map.
+ */
+typedef struct cwist_route_match {
+    const cwist_route_entry *route;
+    size_t param_count;
+    cwist_route_capture params[CWIST_ROUTE_MAX_PARAMS];
+} cwist_route_match;
+
+typedef struct cwist_route_table cwist_route_table;
+
+cwist_route_table *cwist_route_table_create(void);
+void cwist_route_table_destroy(cwist_route_table *table);
+
+/**
+ * @brief Registers `handler` (or `ws_handler`) for `method` and `path`.
+ *
+ * Segments starting with `:` capture one path segment. A final segment
+ * starting with `*` captures the rest of the path (named after the `*`, or
+ * "*" when bare). Registering the same method and pattern again replaces
+ * the handler.
+ *
+ * @return false on allocation failure, a `*` segment that is not last, or
+ *         more than CWIST_ROUTE_MAX_PARAMS captures.
+ */
+bool cwist_route_table_insert(cwist_route_table *table, const char *path, cwist_http_method_t method,
+                              cwist_route_handler_func handler, cwist_route_ws_handler_func ws_handler);
+
+/**
+ * @brief cwist_route_table_insert that also stores the route's middleware
+ * chain. The table borrows `middleware`; it must outlive every table version.
+ */
+bool cwist_route_table_insert_chain(cwist_route_table *table, const char *path, cwist_http_method_t method,
+                                    cwist_route_handler_func handler, cwist_route_ws_handler_func ws_handler,
+                                    const struct cwist_middleware_chain *middleware);
+
+/**
+ * @brief Calls `fn` on every route. Only for tables no reader can see yet
+ * (before listen, or a fresh clone); entries must not be added or removed.
+ */
+void cwist_route_table_foreach(cwist_route_table *table, void (*fn)(cwist_route_entry *entry, void *ctx), void *ctx);
+
+/**
+ * @brief Removes the route for `method` and `path` (param names do not matter).
+ * @return true if a route was removed.
+ */
+bool cwist_route_table_remove(cwist_route_table *table, cwist_http_method_t method, const char *path);
+
+/**
+ * @brief Deep copy of every route (not frozen). Used to build the next
+ * version of a table that readers are still using.
+ */
+cwist_route_table *cwist_route_table_clone(const cwist_route_table *table);
+
+/**
+ * @brief Rebuilds the exact routes as a minimal perfect hash (see phash.h).
+ *
+ * Called by cwist_app_listen once registration is done. Exact lookups then
+ * take one probe and one memcmp. Inserting afterwards drops the frozen table
+ * until the next freeze, so late registrations are never lost.
+ *
+ * @return false if the table could not be built (lookups keep using the buckets).
+ */
+bool cwist_route_table_freeze(cwist_route_table *table);
+
+/**
+ * @brief Finds the route for `method` and `path[0..len)`.
+ *
+ * Exact routes win. Otherwise the pattern tree is walked one segment at a
+ * time, preferring static segments over `:param` over `*wildcard` and
+ * backtracking when a branch has no route for the method. Empty segments
+ * are ignored, so "/a//b/" matches "/a/b". Cost grows with the path
+ * length, not the number of routes, and paths of any length are accepted.
+ */
+bool cwist_route_table_match(cwist_route_table *table, cwist_http_method_t method,
+                             const char *path, size_t len, cwist_route_match *match);
+
+/**
+ * @brief Replaces the contents of `params` with the captures of `match`.
+ * `path` must be the string the match was made against.
+ */
+void cwist_route_match_bind(const cwist_route_match *match, const char *path, cwist_query_map *params);
+
+#endif
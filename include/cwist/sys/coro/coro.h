@@ -0,0 +1,59 @@
+/**
+ * @file coro.h
+ * @brief Stackful coroutines for connection handlers.
+ *
+ * Each connection runs on a pooled stack owned by a per-thread scheduler.
+ * Socket waits inside the HTTP and WebSocket helpers go through
+ * cwist_coro_poll(), which parks the coroutine in the scheduler's epoll set
+ * instead of blocking the thread. Outside a coroutine every call behaves like
+ * its blocking counterpart, so the same code runs in both modes.
+ */
+
+#ifndef __CWIST_CORO_H__
+#define __CWIST_CORO_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <cwist/net/http/http.h>
+
+#define CWIST_CORO_DEFAULT_STACK_SIZE (128 * 1024)
+#define CWIST_CORO_STACK_CACHE 256 ///< Released stacks kept per scheduler for reuse.
+
+/**
+ * @brief True when the caller runs inside a coroutine.
+ */
+bool cwist_coro_active(void);
+
+/**
+ * @brief poll() for a single descriptor that yields inside a coroutine.
+ * @param fd Descriptor to wait on.
+ * @param events POLLIN and/or POLLOUT.
+ * @param timeout_ms Milliseconds to wait, or -1 for no limit.
+ * @return >0 when ready (or on error/hang-up), 0 on timeout, -1 on failure.
+ */
+int cwist_coro_poll(int fd, short events, int timeout_ms);
+
+/**
+ * @brief Sleeps without holding the thread when called from a coroutine.
+ */
+void cwist_coro_sleep_ms(int ms);
+
+/**
+ * @brief Lets other ready coroutines run. No-op outside a coroutine.
+ */
+void cwist_coro_yield(void);
+
+/**
+ * @brief Serve connections as coroutines.
+ *
+ * Starts config->worker_threads schedulers (0 = online CPU count). The calling
+ * thread accepts connections, makes them non-blocking and hands them out
+ * round-robin; each runs handler(fd, ctx) on its own coroutine, which must
+ * close the descriptor before returning.
+ *
+ * @return false if coroutines are unavailable on this platform (nothing was
+ *         served), true once the loop stops.
+ */
+bool cwist_coro_serve(int server_fd, cwist_server_config *config, void (*handler)(int, void *), void *ctx);
+
+#endif
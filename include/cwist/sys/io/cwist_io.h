@@ -8,6 +8,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <cwist/net/http/http.h>
 
 /**
  * @brief Opaque handle for the IO Queue.
@@ -50,4 +51,19 @@ void cwist_io_queue_run(cwist_io_queue *q);
  */
 void cwist_io_queue_destroy(cwist_io_queue *q);
 
+/**
+ * @brief Serve HTTP on the backend's native completion engine.
+ *
+ * On Linux this runs io_uring rings (multishot accept, provided-buffer recv,
+ * linked sends), one per worker thread. Framed requests are passed to
+ * config->on_request on a handler pool (use_threading) or on the ring thread.
+ *
+ * @param server_fd Listening socket.
+ * @param config Server configuration (on_request is required).
+ * @param ctx Passed to on_request.
+ * @return false if the backend is unavailable (nothing was served and the
+ *         caller should fall back to another loop), true once the engine stops.
+ */
+bool cwist_io_serve_http(int server_fd, cwist_server_config *config, void *ctx);
+
 #endif
@@ -0,0 +1,51 @@
+#include <cwist/core/mem/epoch.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+static pthread_key_t cwist_epoch_key;
+static pthread_once_t cwist_epoch_once = PTHREAD_ONCE_INIT;
+static __thread bool t_epoch_registered = false;
+
+static void cwist_epoch_thread_exit(void *unused) {
+    (void)unused;
+    ttak_epoch_deregister_thread();
+}
+
+static void cwist_epoch_key_init(void) {
+    pthread_key_create(&cwist_epoch_key, cwist_epoch_thread_exit);
+}
+
+void cwist_epoch_register(void) {
+    if (t_epoch_registered) return;
+    pthread_once(&cwist_epoch_once, cwist_epoch_key_init);
+    ttak_epoch_register_thread();
+    pthread_setspecific(cwist_epoch_key, (void *)1);
+    t_epoch_registered = true;
+}
+
+void cwist_epoch_pin(void) {
+    cwist_epoch_register();
+    ttak_epoch_enter();
+}
+
+void cwist_epoch_unpin(void) {
+    ttak_epoch_exit();
+}
+
+void cwist_epoch_retire(void *ptr, void (*cleanup)(void *)) {
+    if (!ptr) return;
+    cwist_epoch_register();
+    ttak_epoch_retire(ptr, cleanup);
+    ttak_epoch_reclaim();
+}
+
+void cwist_epoch_retire_deferred(void *ptr, void (*cleanup)(void *)) {
+    if (!ptr) return;
+    cwist_epoch_register();
+    ttak_epoch_retire(ptr, cleanup);
+}
+
+void cwist_epoch_reclaim(void) {
+    cwist_epoch_register();
+    ttak_epoch_reclaim();
+}
@@ -0,0 +1,202 @@
+#include <cwist/core/phash/phash.h>
+#include <cwist/core/siphash/siphash.h>
+#include <cwist/core/mem/alloc.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CWIST_PHASH_BUCKET_KEYS 2          ///< Average keys per displacement bucket.
+#define CWIST_PHASH_MAX_DISPLACE (1u << 22) ///< Tries per bucket before reseeding.
+#define CWIST_PHASH_MAX_SEEDS 8
+
+typedef struct {
+    uint64_t hash;
+    const char *key;
+    uint32_t len;
+    uint32_t tag;
+    void *value;
+} cwist_phash_slot;
+
+struct cwist_phash {
+    uint8_t seed[16];
+    size_t slot_count;
+    size_t bucket_count;
+    uint32_t *displace;
+    cwist_phash_slot *slots;
+    /* displacements, slots and key bytes follow in the same block */
+};
+
+static uint64_t cwist_phash_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t cwist_phash_hash(const uint8_t seed[16], uint32_t tag, const char *key, size_t len) {
+    return cwist_phash_mix(siphash13(key, len, seed) + tag);
+}
+
+static size_t cwist_phash_bucket(uint64_t hash, size_t bucket_count) {
+    return (size_t)((hash >> 32) % bucket_count);
+}
+
+static size_t cwist_phash_slot_of(uint64_t hash, uint32_t displace, size_t slot_count) {
+    return (size_t)(cwist_phash_mix(hash ^ ((uint64_t)(displace + 1) * 0x9E3779B97F4A7C15ULL)) % slot_count);
+}
+
+typedef struct {
+    size_t bucket;
+    size_t size;
+} cwist_phash_order;
+
+static int cwist_phash_order_cmp(const void *a, const void *b) {
+    const cwist_phash_order *x = (const cwist_phash_order *)a;
+    const cwist_phash_order *y = (const cwist_phash_order *)b;
+    if (x->size != y->size) return x->size < y->size ? 1 : -1;
+    return x->bucket < y->bucket ? -1 : (x->bucket > y->bucket);
+}
+
+/*
+ * Places every key for one seed. Buckets are handled largest first, since they
+ * are the hardest to fit. Returns false when some bucket cannot be displaced,
+ * or two keys share a full 64-bit hash.
+ */
+static bool cwist_phash_place(const uint64_t *hashes, size_t count, size_t bucket_count,
+                              uint32_t *displace, size_t *slot_key) {
+    bool ok = false;
+    size_t *bucket_start = (size_t *)cwist_alloc_array(bucket_count + 1, sizeof(size_t));
+    size_t *members = (size_t *)cwist_alloc_array(count, sizeof(size_t));
+    size_t *cursor = (size_t *)cwist_alloc_array(bucket_count, sizeof(size_t));
+    cwist_phash_order *order = (cwist_phash_order *)cwist_alloc_array(bucket_count, sizeof(cwist_phash_order));
+    uint8_t *taken = (uint8_t *)cwist_alloc(count);
+    size_t *trial = (size_t *)cwist_alloc_array(count, sizeof(size_t));
+    if (!bucket_start || !members || !cursor || !order || !taken || !trial) goto out;
+
+    // Group key indices by bucket (counting sort).
+    for (size_t i = 0; i < count; i++) bucket_start[cwist_phash_bucket(hashes[i], bucket_count) + 1]++;
+    for (size_t b = 0; b < bucket_count; b++) bucket_start[b + 1] += bucket_start[b];
+    for (size_t i = 0; i < count; i++) {
+        size_t b = cwist_phash_bucket(hashes[i], bucket_count);
+        members[bucket_start[b] + cursor[b]++] = i;
+    }
+    for (size_t b = 0; b < bucket_count; b++) {
+        order[b].bucket = b;
+        order[b].size = bucket_start[b + 1] - bucket_start[b];
+    }
+    qsort(order, bucket_count, sizeof(cwist_phash_order), cwist_phash_order_cmp);
+
+    for (size_t o = 0; o < bucket_count && order[o].size > 0; o++) {
+        size_t b = order[o].bucket;
+        const size_t *keys = &members[bucket_start[b]];
+        size_t size = order[o].size;
+        for (size_t i = 1; i < size; i++) {
+            for (size_t j = 0; j < i; j++) {
+                if (hashes[keys[i]] == hashes[keys[j]]) goto out;
+            }
+        }
+
+        uint32_t d = 0;
+        for (; d < CWIST_PHASH_MAX_DISPLACE; d++) {
+            size_t placed = 0;
+            for (; placed < size; placed++) {
+                size_t slot = cwist_phash_slot_of(hashes[keys[placed]], d, count);
+                if (taken[slot]) break;
+                taken[slot] = 1;
+                trial[placed] = slot;
+            }
+            if (placed == size) break;
+            for (size_t i = 0; i < placed; i++) taken[trial[i]] = 0;
+        }
+        if (d == CWIST_PHASH_MAX_DISPLACE) goto out;
+        displace[b] = d;
+        for (size_t i = 0; i < size; i++) slot_key[trial[i]] = keys[i];
+    }
+    ok = true;
+
+out:
+    cwist_free(bucket_start);
+    cwist_free(members);
+    cwist_free(cursor);
+    cwist_free(order);
+    cwist_free(taken);
+    cwist_free(trial);
+    return ok;
+}
+
+cwist_phash *cwist_phash_build(const cwist_phash_key *keys, size_t count) {
+    if (!keys || count == 0 || count > UINT32_MAX) return NULL;
+    size_t bucket_count = count / CWIST_PHASH_BUCKET_KEYS + 1;
+    size_t pool_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (keys[i].len > UINT32_MAX) return NULL;
+        pool_len += keys[i].len;
+    }
+
+    size_t displace_bytes = (bucket_count * sizeof(uint32_t) + 15) & ~(size_t)15;
+    size_t header_bytes = (sizeof(cwist_phash) + 15) & ~(size_t)15;
+    cwist_phash *ph = (cwist_phash *)cwist_alloc(header_bytes + displace_bytes + count * sizeof(cwist_phash_slot) + pool_len);
+    uint64_t *hashes = (uint64_t *)cwist_alloc_array(count, sizeof(uint64_t));
+    size_t *slot_key = (size_t *)cwist_alloc_array(count, sizeof(size_t));
+    if (!ph || !hashes || !slot_key) goto fail;
+
+    ph->slot_count = count;
+    ph->bucket_count = bucket_count;
+    ph->displace = (uint32_t *)((char *)ph + header_bytes);
+    ph->slots = (cwist_phash_slot *)((char *)ph->displace + displace_bytes);
+    char *pool = (char *)(ph->slots + count);
+
+    bool placed = false;
+    cwist_process_hash_seed(ph->seed);
+    for (int attempt = 0; attempt < CWIST_PHASH_MAX_SEEDS && !placed; attempt++) {
+        ph->seed[0] ^= (uint8_t)attempt;
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = cwist_phash_hash(ph->seed, keys[i].tag, keys[i].key, keys[i].len);
+        }
+        memset(ph->displace, 0, bucket_count * sizeof(uint32_t));
+        placed = cwist_phash_place(hashes, count, bucket_count, ph->displace, slot_key);
+    }
+    if (!placed) goto fail;
+
+    for (size_t s = 0; s < count; s++) {
+        const cwist_phash_key *in = &keys[slot_key[s]];
+        cwist_phash_slot *slot = &ph->slots[s];
+        memcpy(pool, in->key, in->len);
+        slot->hash = hashes[slot_key[s]];
+        slot->key = pool;
+        slot->len = (uint32_t)in->len;
+        slot->tag = in->tag;
+        slot->value = in->value;
+        pool += in->len;
+    }
+    cwist_free(hashes);
+    cwist_free(slot_key);
+    return ph;
+
+fail:
+    cwist_free(ph);
+    cwist_free(hashes);
+    cwist_free(slot_key);
+    return NULL;
+}
+
+void *cwist_phash_get(const cwist_phash *ph, uint32_t tag, const char *key, size_t len) {
+    if (!ph || !key) return NULL;
+    uint64_t hash = cwist_phash_hash(ph->seed, tag, key, len);
+    uint32_t d = ph->displace[cwist_phash_bucket(hash, ph->bucket_count)];
+    const cwist_phash_slot *slot = &ph->slots[cwist_phash_slot_of(hash, d, ph->slot_count)];
+    if (slot->hash != hash || slot->tag != tag || slot->len != len || memcmp(slot->key, key, len) != 0) {
+        return NULL;
+    }
+    return slot->value;
+}
+
+size_t cwist_phash_count(const cwist_phash *ph) {
+    return ph ? ph->slot_count : 0;
+}
+
+void cwist_phash_destroy(cwist_phash *ph) {
+    cwist_free(ph);
+}
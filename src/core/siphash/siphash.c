@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include <cwist/core/siphash/siphash.h>
 
 /* Left-rotate a 64-bit integer by 'b' bits */
@@ -20,7 +21,12 @@ static void sipround(uint64_t *v0, uint64_t *v1, uint64_t *v2, uint64_t *v3) {
     *v2 += *v1; *v1 = ROTL(*v1, 17); *v1 ^= *v2; *v2 = ROTL(*v2, 32);
 }
 
-uint64_t siphash24(const void *src, size_t len, const uint8_t key[16]) {
+/*
+ * SipHash-c-d: `c` rounds per message block, `d` finalization rounds.
+ * With `out128` set this is the 128-bit variant; both halves are written
+ * there and the first one is returned.
+ */
+static uint64_t siphash_cd(const void *src, size_t len, const uint8_t key[16], int c, int d, uint64_t *out128) {
     const uint8_t *m = (const uint8_t *)src;
     uint64_t k0, k1;
     
@@ -33,6 +39,7 @@ uint64_t siphash24(const void *src, size_t len, const uint8_t key[16]) {
     uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
     uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
     uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+    if (out128) v1 ^= 0xee;
 
     uint64_t b = ((uint64_t)len) << 56;
     const uint8_t *end = m + (len - (len % 8));
@@ -42,8 +49,7 @@ uint64_t siphash24(const void *src, size_t len, const uint8_t key[16]) {
     for (; m < end; m += 8) {
         memcpy(&mi, m, 8);
         v3 ^= mi;
-        sipround(&v0, &v1, &v2, &v3); /* Round 1 */
-        sipround(&v0, &v1, &v2, &v3); /* Round 2 */
+        for (int i = 0; i < c; ++i) sipround(&v0, &v1, &v2, &v3);
         v0 ^= mi;
     }
 
@@ -68,15 +74,31 @@ uint64_t siphash24(const void *src, size_t len, const uint8_t key[16]) {
     
     /* Mix length and final partial block into the state */
     v3 ^= (b | t);
-    sipround(&v0, &v1, &v2, &v3);
-    sipround(&v0, &v1, &v2, &v3);
+    for (int i = 0; i < c; ++i) sipround(&v0, &v1, &v2, &v3);
     v0 ^= (b | t);
 
-    /* 4. Finalization: 4 additional rounds for security */
-    v2 ^= 0xff;
-    for (int i = 0; i < 4; ++i) sipround(&v0, &v1, &v2, &v3);
+    /* 4. Finalization: d additional rounds for security */
+    v2 ^= out128 ? 0xee : 0xff;
+    for (int i = 0; i < d; ++i) sipround(&v0, &v1, &v2, &v3);
+    if (!out128) return v0 ^ v1 ^ v2 ^ v3;
+
+    out128[0] = v0 ^ v1 ^ v2 ^ v3;
+    v1 ^= 0xdd;
+    for (int i = 0; i < d; ++i) sipround(&v0, &v1, &v2, &v3);
+    out128[1] = v0 ^ v1 ^ v2 ^ v3;
+    return out128[0];
+}
+
+uint64_t siphash24(const void *src, size_t len, const uint8_t key[16]) {
+    return siphash_cd(src, len, key, 2, 4, NULL);
+}
+
+void siphash24_128(const void *src, size_t len, const uint8_t key[16], uint64_t out[2]) {
+    siphash_cd(src, len, key, 2, 4, out);
+}
 
-    return v0 ^ v1 ^ v2 ^ v3;
+uint64_t siphash13(const void *src, size_t len, const uint8_t key[16]) {
+    return siphash_cd(src, len, key, 1, 3, NULL);
 }
 
 void cwist_generate_hash_seed(uint8_t key[16]) {
@@ -89,3 +111,21 @@ void cwist_generate_hash_seed(uint8_t key[16]) {
         for(int i = 0; i < 16; i++) key[i] = (uint8_t)rand();
     }
 }
+
+static uint8_t g_process_seed[16];
+static pthread_once_t g_process_seed_once = PTHREAD_ONCE_INIT;
+
+static void cwist_process_seed_regenerate(void) {
+    cwist_generate_hash_seed(g_process_seed);
+}
+
+static void cwist_process_seed_init(void) {
+    cwist_generate_hash_seed(g_process_seed);
+    // Prefork workers should not share their parent's key.
+    pthread_atfork(NULL, NULL, cwist_process_seed_regenerate);
+}
+
+void cwist_process_hash_seed(uint8_t key[16]) {
+    pthread_once(&g_process_seed_once, cwist_process_seed_init);
+    memcpy(key, g_process_seed, 16);
+}
@@ -12,12 +12,33 @@ cwist_error_t cwist_sstring_copy_sstring(cwist_sstring *origin, const cwist_sstr
 cwist_error_t cwist_sstring_append_sstring(cwist_sstring *str, const cwist_sstring *from);
 cwist_error_t cwist_sstring_append_sstring_escaped(cwist_sstring *str, const cwist_sstring *from);
 
+/* Copies a view into owned storage so it can be modified in place. */
+static bool cwist_sstring_detach(cwist_sstring *str) {
+    if (!str->is_view) return true;
+    char *owned = (char *)cwist_alloc(str->size + 1);
+    if (!owned) return false;
+    if (str->data && str->size > 0) memcpy(owned, str->data, str->size);
+    owned[str->size] = '\0';
+    str->data = owned;
+    str->is_view = false;
+    return true;
+}
+
+/* Forgets a view that is about to be overwritten entirely. */
+static void cwist_sstring_drop_view(cwist_sstring *str) {
+    if (!str->is_view) return;
+    str->data = NULL;
+    str->size = 0;
+    str->is_view = false;
+}
+
 cwist_error_t cwist_sstring_assign_len(cwist_sstring *str, const char *data, size_t len) {
     if (!str) {
       cwist_error_t err = make_error(CWIST_ERR_INT8);
       err.error.err_i8 = ERR_SSTRING_NULL_STRING;
       return err;
     }
+    cwist_sstring_drop_view(str);
     
     char *new_data = (char *)cwist_realloc(str->data, len + 1);
     if (!new_data && len > 0) {
@@ -48,6 +69,13 @@ cwist_error_t cwist_sstring_append_len(cwist_sstring *str, const char *data, siz
         return err;
     }
 
+    if (!cwist_sstring_detach(str)) {
+         cwist_error_t err = make_error(CWIST_ERR_JSON);
+         err.error.err_json = cJSON_CreateObject();
+         cJSON_AddStringToObject(err.error.err_json, "err", "Cannot append: memory full");
+         return err;
+    }
+
     size_t current_len = str->size;
     size_t new_size = current_len + len;
 
@@ -78,6 +106,7 @@ cwist_error_t cwist_sstring_init(cwist_sstring *str) {
     str->data = NULL;
     str->size = 0;
     str->is_fixed = false;
+    str->is_view = false;
     str->get_size = cwist_sstring_get_size;
     str->compare = cwist_sstring_compare_sstring;
     str->copy = cwist_sstring_copy_sstring;
@@ -97,6 +126,7 @@ cwist_error_t cwist_sstring_init_escaped(cwist_sstring *str) {
     str->data = NULL;
     str->size = 0;
     str->is_fixed = false;
+    str->is_view = false;
     str->get_size = cwist_sstring_get_size;
     str->compare = cwist_sstring_compare_sstring;
     str->copy = cwist_sstring_copy_sstring;
@@ -123,6 +153,7 @@ cwist_error_t cwist_sstring_ltrim(cwist_sstring *str) {
     cwist_error_t err = make_error(CWIST_ERR_INT8);
     err.error.err_i8 = ERR_SSTRING_NULL_STRING;
     if (!str || !str->data) return err;
+    if (!cwist_sstring_detach(str)) return err;
 
     size_t len = strlen(str->data);
     size_t start = 0;
@@ -143,6 +174,7 @@ cwist_error_t cwist_sstring_rtrim(cwist_sstring *str) {
     cwist_error_t err = make_error(CWIST_ERR_INT8);
     err.error.err_i8 = ERR_SSTRING_NULL_STRING;
     if (!str || !str->data) return err; 
+    if (!cwist_sstring_detach(str)) return err;
 
     size_t len = strlen(str->data);
     
@@ -181,6 +213,10 @@ cwist_error_t cwist_sstring_change_size(cwist_sstring *str, size_t new_size, boo
       err.error.err_i8 = ERR_SSTRING_CONSTANT;
       return err;
     }
+    if (!cwist_sstring_detach(str)) {
+      err.error.err_i8 = ERR_SSTRING_RESIZE_TOO_LARGE;
+      return err;
+    }
 
     size_t current_len = str->data ? strlen(str->data) : 0;
 
@@ -224,6 +260,7 @@ cwist_error_t cwist_sstring_assign(cwist_sstring *str, char *data) {
     err.error.err_json = cJSON_CreateObject();
 
     size_t data_len = data ? strlen(data) : 0;
+    cwist_sstring_drop_view(str);
 
     if (str->is_fixed) {
         if (data_len > str->size) {
@@ -270,6 +307,13 @@ cwist_error_t cwist_sstring_append(cwist_sstring *str, const char *data) {
         return err;
     }
 
+    if (!cwist_sstring_detach(str)) {
+        cwist_error_t err = make_error(CWIST_ERR_JSON);
+        err.error.err_json = cJSON_CreateObject();
+        cJSON_AddStringToObject(err.error.err_json, "err", "Cannot append: memory full");
+        return err;
+    }
+
     size_t current_len = str->data ? strlen(str->data) : 0;
     size_t append_len = strlen(data);
     size_t new_size = current_len + append_len;
@@ -318,6 +362,13 @@ cwist_error_t cwist_sstring_append_escaped(cwist_sstring *str, const char *data)
         return err;
     }
 
+    if (!cwist_sstring_detach(str)) {
+        cwist_error_t err = make_error(CWIST_ERR_JSON);
+        err.error.err_json = cJSON_CreateObject();
+        cJSON_AddStringToObject(err.error.err_json, "err", "Cannot append: memory full");
+        return err;
+    }
+
     size_t current_len = str->data ? strlen(str->data) : 0;
     size_t input_len = strlen(data);
     size_t new_size = current_len + (input_len * 6) + 1;
@@ -469,11 +520,28 @@ cwist_sstring *cwist_sstring_create(void) {
 
 void cwist_sstring_destroy(cwist_sstring *str) {
     if (str) {
-        if (str->data) cwist_free(str->data);
+        if (str->data && !str->is_view) cwist_free(str->data);
         cwist_free(str);
     }
 }
 
+cwist_error_t cwist_sstring_init_view(cwist_sstring *str, const char *data, size_t len) {
+    cwist_error_t err = cwist_sstring_init(str);
+    if (err.error.err_i8 != ERR_SSTRING_OKAY) return err;
+    str->data = (char *)data;
+    str->size = data ? len : 0;
+    str->is_view = data != NULL;
+    return err;
+}
+
+void cwist_sstring_release(cwist_sstring *str) {
+    if (!str) return;
+    if (str->data && !str->is_view) cwist_free(str->data);
+    str->data = NULL;
+    str->size = 0;
+    str->is_view = false;
+}
+
 int cwist_sstring_compare(cwist_sstring *str, const char *compare_to) {
     if (!str || !str->data) {
         if (!compare_to) return 0; // Both NULL-ish (empty treated as NULL for comparison?)
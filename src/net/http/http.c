@@ -1,8 +1,15 @@
 #define _POSIX_C_SOURCE 200809L
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <cwist/net/http/http.h>
+#include <cwist/net/http/scan.h>
 #include <cwist/core/sstring/sstring.h>
 #include <cwist/sys/err/cwist_err.h>
 #include <cwist/core/mem/alloc.h>
+#include <cwist/sys/io/cwist_io.h>
+#include <cwist/sys/coro/coro.h>
+#include <cwist/sys/session/session_manager.h>
 
 #include <limits.h>
 #include <stdio.h>
@@ -24,8 +31,12 @@
 #include <netinet/in.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/uio.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #ifdef __linux__
 #include <sys/epoll.h>
+#include <sched.h>
 #endif
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
 #include <sys/event.h>
@@ -65,10 +76,161 @@ cwist_http_method_t cwist_http_string_to_method(const char *method_str) {
 
 /* --- Header Manipulation --- */
 
+/* --- Object Recycling --- */
+
+/* A parsed header: the node and both strings in one slot of the request's header block. */
+typedef struct cwist_http_header_slot {
+    cwist_http_header_node node;
+    cwist_sstring key;
+    cwist_sstring value;
+} cwist_http_header_slot;
+
+/* Overflow block of a request arena; the usable bytes follow the header. */
+typedef struct cwist_http_arena_chunk {
+    struct cwist_http_arena_chunk *next;
+    struct session_arena arena;
+    _Alignas(16) uint8_t data[];
+} cwist_http_arena_chunk;
+
+/*
+ * Backing storage of a request. The public strings are embedded here and, once
+ * parsed, are views into the raw frame, so parsing allocates at most a header
+ * block (plus a frame copy when the caller's buffer cannot be borrowed). The
+ * block and both query maps survive recycling, so a reused request allocates
+ * nothing for an ordinary header count.
+ */
+typedef struct cwist_http_request_storage {
+    cwist_http_request req; ///< Must stay first: requests are freed through this struct.
+    cwist_sstring path;
+    cwist_sstring query;
+    cwist_sstring version;
+    cwist_sstring body;
+    cwist_query_map query_map; ///< Filled lazily from `query` on first access.
+    cwist_query_map path_map;
+    char *frame;            ///< Owned copy of the raw request, if any.
+    cwist_http_header_slot *header_block;
+    size_t header_cap;      ///< Slots in header_block, kept across recycling.
+    char *restore_at;       ///< Byte past a borrowed frame that holds the body terminator.
+    char restore_byte;
+    struct cwist_http_request_storage *next_free;
+    struct session_arena arena;              ///< Request-scoped scratch over arena_inline.
+    struct cwist_http_arena_chunk *arena_spill; ///< Heap chunks once arena_inline is full.
+    _Alignas(16) uint8_t arena_inline[CWIST_HTTP_ARENA_SIZE];
+} cwist_http_request_storage;
+
+/* Backing storage of a response; the default strings are embedded like the request's. */
+typedef struct cwist_http_response_storage {
+    cwist_http_response res; ///< Must stay first.
+    cwist_sstring version;
+    cwist_sstring status_text;
+    cwist_sstring body;
+    struct cwist_http_response_storage *next_free;
+} cwist_http_response_storage;
+
+/*
+ * Per-thread caches of requests, responses and header nodes. A keep-alive
+ * connection destroys its objects on the same thread that creates the next
+ * ones, so steady traffic cycles through these lists instead of the allocator.
+ */
+typedef struct cwist_http_recycle_bin {
+    cwist_http_request_storage *requests;
+    size_t request_count;
+    cwist_http_response_storage *responses;
+    size_t response_count;
+    cwist_http_header_node *nodes;
+    size_t node_count;
+    bool registered;
+} cwist_http_recycle_bin;
+
+static __thread cwist_http_recycle_bin t_recycle_bin;
+static pthread_key_t g_recycle_key;
+static pthread_once_t g_recycle_once = PTHREAD_ONCE_INIT;
+
+static void cwist_http_request_free(cwist_http_request_storage *storage);
+static void cwist_http_response_free(cwist_http_response_storage *storage);
+
+static void cwist_http_recycle_bin_flush(void *arg) {
+    cwist_http_recycle_bin *bin = (cwist_http_recycle_bin *)arg;
+    while (bin->requests) {
+        cwist_http_request_storage *storage = bin->requests;
+        bin->requests = storage->next_free;
+        cwist_http_request_free(storage);
+    }
+    while (bin->responses) {
+        cwist_http_response_storage *storage = bin->responses;
+        bin->responses = storage->next_free;
+        cwist_http_response_free(storage);
+    }
+    while (bin->nodes) {
+        cwist_http_header_node *node = bin->nodes;
+        bin->nodes = node->next;
+        cwist_sstring_destroy(node->key);
+        cwist_sstring_destroy(node->value);
+        cwist_free(node);
+    }
+    bin->request_count = bin->response_count = bin->node_count = 0;
+}
+
+static void cwist_http_recycle_key_init(void) {
+    pthread_key_create(&g_recycle_key, cwist_http_recycle_bin_flush);
+}
+
+/* Returns this thread's bin, arranging for it to be emptied when the thread exits. */
+static cwist_http_recycle_bin *cwist_http_recycle_bin_get(void) {
+    cwist_http_recycle_bin *bin = &t_recycle_bin;
+    if (!bin->registered) {
+        pthread_once(&g_recycle_once, cwist_http_recycle_key_init);
+        pthread_setspecific(g_recycle_key, bin);
+        bin->registered = true;
+    }
+    return bin;
+}
+
+static cwist_http_header_node *cwist_http_header_node_acquire(void) {
+    cwist_http_recycle_bin *bin = &t_recycle_bin;
+    cwist_http_header_node *node = bin->nodes;
+    if (node) {
+        bin->nodes = node->next;
+        bin->node_count--;
+        node->next = NULL;
+        return node;
+    }
+
+    node = (cwist_http_header_node *)cwist_alloc(sizeof(cwist_http_header_node));
+    if (!node) return NULL;
+    node->key = cwist_sstring_create();
+    node->value = cwist_sstring_create();
+    if (!node->key || !node->value) {
+        cwist_sstring_destroy(node->key);
+        cwist_sstring_destroy(node->value);
+        cwist_free(node);
+        return NULL;
+    }
+    node->next = NULL;
+    node->is_view = false;
+    return node;
+}
+
+static void cwist_http_header_node_recycle(cwist_http_header_node *node) {
+    cwist_http_recycle_bin *bin = cwist_http_recycle_bin_get();
+    if (bin->node_count >= CWIST_HTTP_RECYCLE_CACHE * 4) {
+        cwist_sstring_destroy(node->key);
+        cwist_sstring_destroy(node->value);
+        cwist_free(node);
+        return;
+    }
+    // Views are dropped; owned buffers stay for the next assignment.
+    if (node->key->is_view) cwist_sstring_release(node->key);
+    if (node->value->is_view) cwist_sstring_release(node->value);
+    node->next = bin->nodes;
+    bin->nodes = node;
+    bin->node_count++;
+}
+
 cwist_error_t cwist_http_header_add(cwist_http_header_node **head, const char *key, const char *value) {
     cwist_error_t err = make_error(CWIST_ERR_INT16);
     
-    cwist_http_header_node *node = (cwist_http_header_node *)cwist_alloc(sizeof(cwist_http_header_node));
+    cwist_http_header_node *node = cwist_http_header_node_acquire();
     if (!node) {
         err = make_error(CWIST_ERR_JSON);
         err.error.err_json = cJSON_CreateObject();
@@ -76,12 +238,8 @@ cwist_error_t cwist_http_header_add(cwist_http_header_node **head, const char *k
         return err;
     }
 
-    node->key = cwist_sstring_create();
-    node->value = cwist_sstring_create();
-    node->next = NULL;
-
-    cwist_sstring_assign(node->key, (char *)key);
-    cwist_sstring_assign(node->value, (char *)value);
+    cwist_sstring_assign_len(node->key, key, key ? strlen(key) : 0);
+    cwist_sstring_assign_len(node->value, value, value ? strlen(value) : 0);
 
     node->next = *head;
     *head = node;
@@ -106,9 +264,13 @@ void cwist_http_header_free_all(cwist_http_header_node *head) {
     cwist_http_header_node *curr = head;
     while (curr) {
         cwist_http_header_node *next = curr->next;
-        cwist_sstring_destroy(curr->key);
-        cwist_sstring_destroy(curr->value);
-        cwist_free(curr);
+        if (curr->is_view) {
+            // The block is freed with its request; only copies made on write are ours.
+            cwist_sstring_release(curr->key);
+            cwist_sstring_release(curr->value);
+        } else {
+            cwist_http_header_node_recycle(curr);
+        }
         curr = next;
     }
 }
@@ -139,31 +301,108 @@ static bool headers_have_connection(cwist_http_header_node *head) {
     return false;
 }
 
-/* --- Request Lifecycle --- */
+/* --- Request Arena --- */
 
-cwist_http_request *cwist_http_request_create(void) {
-    cwist_http_request *req = (cwist_http_request *)cwist_alloc(sizeof(cwist_http_request));
+static void cwist_http_request_arena_reset(cwist_http_request_storage *storage) {
+    session_arena_reset(&storage->arena);
+    while (storage->arena_spill) {
+        cwist_http_arena_chunk *chunk = storage->arena_spill;
+        storage->arena_spill = chunk->next;
+        cwist_free(chunk);
+    }
+}
+
+void *cwist_http_request_alloc(cwist_http_request *req, size_t size) {
     if (!req) return NULL;
+    cwist_http_request_storage *storage = (cwist_http_request_storage *)req;
+    if (size == 0) size = 1;
+
+    void *ptr = session_arena_alloc(&storage->arena, size);
+    if (!ptr && storage->arena_spill) ptr = session_arena_alloc(&storage->arena_spill->arena, size);
+    if (!ptr) {
+        // Spill into a new chunk; oversized requests get a chunk of their own.
+        size_t capacity = (size + 15u) & ~(size_t)15u;
+        if (capacity < CWIST_HTTP_ARENA_SIZE) capacity = CWIST_HTTP_ARENA_SIZE;
+        cwist_http_arena_chunk *chunk = (cwist_http_arena_chunk *)cwist_alloc(sizeof(cwist_http_arena_chunk) + capacity);
+        if (!chunk) return NULL;
+        session_arena_init(&chunk->arena, chunk->data, capacity);
+        chunk->next = storage->arena_spill;
+        storage->arena_spill = chunk;
+        ptr = session_arena_alloc(&chunk->arena, size);
+        return ptr; // Fresh from cwist_alloc, already zeroed.
+    }
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+char *cwist_http_request_strndup(cwist_http_request *req, const char *src, size_t n) {
+    if (!src) return NULL;
+    size_t len = strnlen(src, n);
+    char *copy = (char *)cwist_http_request_alloc(req, len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, src, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char *cwist_http_request_strdup(cwist_http_request *req, const char *src) {
+    return src ? cwist_http_request_strndup(req, src, strlen(src)) : NULL;
+}
+
+static void *cwist_http_request_map_alloc(void *ctx, size_t size) {
+    return cwist_http_request_alloc((cwist_http_request *)ctx, size);
+}
+
+/* --- Request Lifecycle --- */
+
+/* Puts a fresh or recycled request into its default state. */
+static void cwist_http_request_init_defaults(cwist_http_request_storage *storage) {
+    cwist_http_request *req = &storage->req;
+
+    // Defaults are views of literals; they are copied only if a handler writes to them.
+    cwist_sstring_init_view(&storage->path, "/", 1);
+    cwist_sstring_init(&storage->query);
+    cwist_sstring_init_view(&storage->version, "HTTP/1.1", 8);
+    cwist_sstring_init(&storage->body);
 
     req->method = CWIST_HTTP_GET; // Default
-    req->path = cwist_sstring_create();
-    req->query = cwist_sstring_create();
-    req->query_params = cwist_query_map_create();
-    req->path_params = cwist_query_map_create();
-    req->version = cwist_sstring_create();
+    req->path = &storage->path;
+    req->query = &storage->query;
+    req->query_params = &storage->query_map;
+    req->path_params = &storage->path_map;
+    req->version = &storage->version;
     req->headers = NULL;
-    req->body = cwist_sstring_create();
+    req->body = &storage->body;
     req->keep_alive = true;
     req->client_fd = -1;
     req->app = NULL;
     req->db = NULL;
     req->upgraded = false;
+    req->private_data = NULL;
     req->content_length = 0;
+}
 
-    // Defaults
-    cwist_sstring_assign(req->version, "HTTP/1.1");
-    cwist_sstring_assign(req->path, "/");
+cwist_http_request *cwist_http_request_create(void) {
+    cwist_http_recycle_bin *bin = &t_recycle_bin;
+    cwist_http_request_storage *storage = bin->requests;
+    if (storage) {
+        bin->requests = storage->next_free;
+        bin->request_count--;
+        storage->next_free = NULL;
+        cwist_http_request_init_defaults(storage);
+        return &storage->req;
+    }
 
+    storage = (cwist_http_request_storage *)cwist_alloc(sizeof(cwist_http_request_storage));
+    if (!storage) return NULL;
+    cwist_http_request *req = &storage->req;
+    session_arena_init(&storage->arena, storage->arena_inline, sizeof(storage->arena_inline));
+    // Parameters live and die with the request, so they come from its arena.
+    cwist_query_map_init(&storage->query_map);
+    cwist_query_map_init(&storage->path_map);
+    cwist_query_map_use_arena(&storage->query_map, cwist_http_request_map_alloc, req);
+    cwist_query_map_use_arena(&storage->path_map, cwist_http_request_map_alloc, req);
+    cwist_http_request_init_defaults(storage);
     return req;
 }
 
@@ -201,17 +440,81 @@ cwist_sstring* cwist_get_client_ip_from_fd(int fd) {
     return s;
 }
 
+/* Drops everything tied to the last request; the header block and maps stay allocated. */
+static void cwist_http_request_clear(cwist_http_request_storage *storage) {
+    cwist_http_request *req = &storage->req;
+    cwist_sstring_release(&storage->path);
+    cwist_sstring_release(&storage->query);
+    cwist_sstring_release(&storage->version);
+    cwist_sstring_release(&storage->body);
+    cwist_http_header_free_all(req->headers);
+    req->headers = NULL;
+    cwist_query_map_clear(&storage->query_map);
+    cwist_query_map_clear(&storage->path_map);
+    if (storage->restore_at) *storage->restore_at = storage->restore_byte;
+    storage->restore_at = NULL;
+    cwist_free(storage->frame);
+    storage->frame = NULL;
+    cwist_http_request_arena_reset(storage);
+}
+
+static void cwist_http_request_free(cwist_http_request_storage *storage) {
+    cwist_http_request_clear(storage);
+    cwist_query_map_release(&storage->query_map);
+    cwist_query_map_release(&storage->path_map);
+    cwist_free(storage->header_block);
+    cwist_free(storage);
+}
+
 void cwist_http_request_destroy(cwist_http_request *req) {
-    if (req) {
-        cwist_sstring_destroy(req->path);
-        cwist_sstring_destroy(req->query);
-        cwist_query_map_destroy(req->query_params);
-        cwist_query_map_destroy(req->path_params);
-        cwist_sstring_destroy(req->version);
-        cwist_sstring_destroy(req->body);
-        cwist_http_header_free_all(req->headers);
-        cwist_free(req);
+    if (!req) return;
+    cwist_http_request_storage *storage = (cwist_http_request_storage *)req;
+    cwist_http_recycle_bin *bin = cwist_http_recycle_bin_get();
+    if (bin->request_count >= CWIST_HTTP_RECYCLE_CACHE) {
+        cwist_http_request_free(storage);
+        return;
     }
+
+    cwist_http_request_clear(storage);
+    // A request with an unusual number of headers should not pin a large block.
+    if (storage->header_cap > CWIST_HTTP_RECYCLE_MAX_HEADERS) {
+        cwist_free(storage->header_block);
+        storage->header_block = NULL;
+        storage->header_cap = 0;
+    }
+    storage->next_free = bin->requests;
+    bin->requests = storage;
+    bin->request_count++;
+}
+
+cwist_http_request *cwist_http_request_clone(const cwist_http_request *src) {
+    if (!src) return NULL;
+    cwist_http_request *req = cwist_http_request_create();
+    if (!req) return NULL;
+    req->method = src->method;
+    if (src->path && src->path->data) cwist_sstring_assign_len(req->path, src->path->data, src->path->size);
+    if (src->query && src->query->size > 0) cwist_sstring_assign_len(req->query, src->query->data, src->query->size);
+    if (src->version && src->version->data) cwist_sstring_assign_len(req->version, src->version->data, src->version->size);
+    if (src->body && src->body->size > 0) cwist_sstring_assign_len(req->body, src->body->data, src->body->size);
+    req->keep_alive = src->keep_alive;
+    req->content_length = src->content_length;
+
+    for (const cwist_http_header_node *curr = src->headers; curr; curr = curr->next) {
+        if (cwist_http_header_add(&req->headers, curr->key->data, curr->value->data).error.err_i16 < 0) {
+            cwist_http_request_destroy(req);
+            return NULL;
+        }
+    }
+    // header_add prepends; restore the original order.
+    cwist_http_header_node *reversed = NULL;
+    while (req->headers) {
+        cwist_http_header_node *next = req->headers->next;
+        req->headers->next = reversed;
+        reversed = req->headers;
+        req->headers = next;
+    }
+    req->headers = reversed;
+    return req;
 }
 
 /* --- Response Lifecycle --- */
@@ -228,38 +531,75 @@ static void cwist_http_response_release_ptr_body(cwist_http_response *res) {
     res->ptr_body_cleanup_ctx = NULL;
 }
 
-cwist_http_response *cwist_http_response_create(void) {
-    cwist_http_response *res = (cwist_http_response *)cwist_alloc(sizeof(cwist_http_response));
-    if (!res) return NULL;
+/* Puts a fresh or recycled response into its default state. */
+static void cwist_http_response_init_defaults(cwist_http_response_storage *storage) {
+    cwist_http_response *res = &storage->res;
+
+    // Defaults
+    cwist_sstring_init_view(&storage->version, "HTTP/1.1", 8);
+    cwist_sstring_init_view(&storage->status_text, "OK", 2);
 
-    res->version = cwist_sstring_create();
+    res->version = &storage->version;
     res->status_code = CWIST_HTTP_OK;
-    res->status_text = cwist_sstring_create();
+    res->status_text = &storage->status_text;
     res->headers = NULL;
-    res->body = cwist_sstring_create();
+    res->body = &storage->body;
     res->keep_alive = true;
     res->is_ptr_body = false;
     res->ptr_body = NULL;
     res->ptr_body_len = 0;
     res->ptr_body_cleanup = NULL;
     res->ptr_body_cleanup_ctx = NULL;
+}
 
-    // Defaults
-    cwist_sstring_assign(res->version, "HTTP/1.1");
-    cwist_sstring_assign(res->status_text, "OK");
+cwist_http_response *cwist_http_response_create(void) {
+    cwist_http_recycle_bin *bin = &t_recycle_bin;
+    cwist_http_response_storage *storage = bin->responses;
+    if (storage) {
+        bin->responses = storage->next_free;
+        bin->response_count--;
+        storage->next_free = NULL;
+    } else {
+        storage = (cwist_http_response_storage *)cwist_alloc(sizeof(cwist_http_response_storage));
+        if (!storage) return NULL;
+        cwist_sstring_init(&storage->body);
+    }
+    cwist_http_response_init_defaults(storage);
+    return &storage->res;
+}
 
-    return res;
+static void cwist_http_response_free(cwist_http_response_storage *storage) {
+    cwist_sstring_release(&storage->version);
+    cwist_sstring_release(&storage->status_text);
+    cwist_sstring_release(&storage->body);
+    cwist_free(storage);
 }
 
 void cwist_http_response_destroy(cwist_http_response *res) {
-    if (res) {
-        cwist_http_response_release_ptr_body(res);
-        cwist_sstring_destroy(res->version);
-        cwist_sstring_destroy(res->status_text);
-        cwist_sstring_destroy(res->body);
-        cwist_http_header_free_all(res->headers);
-        cwist_free(res);
+    if (!res) return;
+    cwist_http_response_storage *storage = (cwist_http_response_storage *)res;
+    cwist_http_response_release_ptr_body(res);
+    cwist_http_header_free_all(res->headers);
+    res->headers = NULL;
+
+    cwist_http_recycle_bin *bin = cwist_http_recycle_bin_get();
+    if (bin->response_count >= CWIST_HTTP_RECYCLE_CACHE) {
+        cwist_http_response_free(storage);
+        return;
+    }
+
+    cwist_sstring_release(&storage->version);
+    cwist_sstring_release(&storage->status_text);
+    // Keep an ordinary body buffer for the next response; drop views and large ones.
+    if (storage->body.is_view || storage->body.size > CWIST_HTTP_RECYCLE_MAX_BODY) {
+        cwist_sstring_release(&storage->body);
+    } else if (storage->body.data) {
+        storage->body.size = 0;
+        storage->body.data[0] = '\0';
     }
+    storage->next_free = bin->responses;
+    bin->responses = storage;
+    bin->response_count++;
 }
 
 void cwist_http_response_set_body_ptr(cwist_http_response *res, const void *ptr, size_t len) {
@@ -325,15 +665,14 @@ static size_t serialize_headers(cwist_http_response *res, char *buf, size_t buf_
     return offset;
 }
 
-#include <sys/uio.h> // For writev
-
-cwist_error_t cwist_http_send_response(int client_fd, cwist_http_response *res) {
+/*
+ * Serializes `res` into [header_buf, body] and, when client_fd >= 0, sends it.
+ * `sent` sees the bytes afterwards and may adopt a managed pointer body;
+ * otherwise the body is released here as usual.
+ */
+static cwist_error_t cwist_http_emit_response(int client_fd, cwist_http_response *res, cwist_http_sent_fn sent, void *ctx) {
     cwist_error_t err = make_error(CWIST_ERR_INT16);
-
-    if (client_fd < 0 || !res) {
-        err.error.err_i16 = -1;
-        return err;
-    }
+    err.error.err_i16 = 0;
 
     // 1. Prepare Headers (On Stack)
     char header_buf[CWIST_HTTP_MAX_HEADER_SIZE];
@@ -352,7 +691,6 @@ cwist_error_t cwist_http_send_response(int client_fd, cwist_http_response *res)
     }
 
     // 3. sendmsg (Scatter/Gather + Flags) - Zero Copy Send
-    struct msghdr msg = {0};
     struct iovec iov[2];
     int iov_cnt = 1;
 
@@ -365,22 +703,101 @@ cwist_error_t cwist_http_send_response(int client_fd, cwist_http_response *res)
         iov_cnt = 2;
     }
 
-    msg.msg_iov = iov;
-    msg.msg_iovlen = iov_cnt;
+    if (client_fd >= 0) {
+        // cwist_http_send_iov advances its iovecs; the observer needs them whole.
+        struct iovec wire[2] = { iov[0], iov[1] };
+        err = cwist_http_send_iov(client_fd, wire, iov_cnt);
+    }
+
+    if (sent && err.error.err_i16 >= 0) {
+        cwist_http_body_pin pin = {0};
+        if (res->is_ptr_body && res->ptr_body_cleanup) {
+            pin = (cwist_http_body_pin){ res->ptr_body, res->ptr_body_len, res->ptr_body_cleanup, res->ptr_body_cleanup_ctx };
+        }
+        sent(iov, iov_cnt, pin.cleanup ? &pin : NULL, ctx);
+        // Adopted: the observer now holds the reference.
+        if (pin.ptr && !pin.cleanup) res->ptr_body_cleanup = NULL;
+    }
+
+    cwist_http_response_release_ptr_body(res);
+    return err;
+}
+
+cwist_error_t cwist_http_send_response(int client_fd, cwist_http_response *res) {
+    return cwist_http_send_response_capture(client_fd, res, NULL, NULL);
+}
+
+cwist_error_t cwist_http_send_response_capture(int client_fd, cwist_http_response *res, cwist_http_sent_fn sent, void *ctx) {
+    if (client_fd < 0 || !res) {
+        cwist_error_t err = make_error(CWIST_ERR_INT16);
+        err.error.err_i16 = -1;
+        return err;
+    }
+    return cwist_http_emit_response(client_fd, res, sent, ctx);
+}
+
+void cwist_http_capture_response(cwist_http_response *res, cwist_http_sent_fn sent, void *ctx) {
+    if (!res) return;
+    cwist_http_emit_response(-1, res, sent, ctx);
+}
+
+static __thread cwist_http_send_hook_fn tls_send_hook = NULL;
+static __thread void *tls_send_hook_ctx = NULL;
+
+void cwist_http_set_send_hook(cwist_http_send_hook_fn hook, void *ctx) {
+    tls_send_hook = hook;
+    tls_send_hook_ctx = ctx;
+}
+
+cwist_error_t cwist_http_send_iov(int client_fd, struct iovec *iov, int iov_cnt) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    err.error.err_i16 = 0;
+
+    if (tls_send_hook && tls_send_hook(client_fd, iov, iov_cnt, tls_send_hook_ctx)) {
+        return err;
+    }
 
     int flags = 0;
     #if defined(MSG_NOSIGNAL)
     flags = MSG_NOSIGNAL;
     #endif
 
-    ssize_t written = sendmsg(client_fd, &msg, flags);
-    if (written < 0) {
-        err.error.err_i16 = -1;
-    } else {
-        err.error.err_i16 = 0;
+    while (iov_cnt > 0) {
+        if (iov[0].iov_len == 0) {
+            iov++;
+            iov_cnt--;
+            continue;
+        }
+
+        struct msghdr msg = {0};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_cnt;
+
+        ssize_t written = sendmsg(client_fd, &msg, flags);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Non-blocking socket with a full send buffer: wait for room.
+                int ret = cwist_coro_poll(client_fd, POLLOUT, CWIST_HTTP_TIMEOUT_MS);
+                if (ret > 0) continue;
+                if (ret < 0 && errno == EINTR) continue;
+            }
+            err.error.err_i16 = -1;
+            return err;
+        }
+
+        size_t remaining = (size_t)written;
+        while (iov_cnt > 0 && remaining >= iov[0].iov_len) {
+            remaining -= iov[0].iov_len;
+            iov++;
+            iov_cnt--;
+        }
+        if (iov_cnt > 0) {
+            iov[0].iov_base = (char *)iov[0].iov_base + remaining;
+            iov[0].iov_len -= remaining;
+        }
     }
 
-    cwist_http_response_release_ptr_body(res);
     return err;
 }
 
@@ -399,202 +816,309 @@ cwist_sstring *cwist_http_stringify_response(cwist_http_response *res) {
     return s;
 }
 
-cwist_http_request *cwist_http_parse_request(const char *raw_request) {
-    if (!raw_request) return NULL;
+static const char *cwist_find_header_end(const char *buf, size_t len) {
+    return cwist_http_scan_header_end(buf, len, NULL);
+}
 
-    cwist_http_request *req = cwist_http_request_create();
-    if (!req) return NULL;
-    
-    const char *line_start = raw_request;
-    const char *header_end = strstr(raw_request, "\r\n\r\n");
-    if (!header_end) {
-        cwist_http_request_destroy(req);
-        return NULL;
+static size_t cwist_frame_content_length(const char *headers, size_t len) {
+    static const char name[] = "content-length:";
+    const size_t name_len = sizeof(name) - 1;
+    const char *line = memchr(headers, '\n', len);
+
+    while (line && (size_t)(line - headers) + 1 < len) {
+        line++;
+        size_t remaining = len - (size_t)(line - headers);
+        if (remaining > name_len && strncasecmp(line, name, name_len) == 0) {
+            const char *v = line + name_len;
+            const char *limit = headers + len;
+            while (v < limit && (*v == ' ' || *v == '\t')) v++;
+            size_t value = 0;
+            while (v < limit && *v >= '0' && *v <= '9') {
+                if (value > (SIZE_MAX - 9) / 10) return SIZE_MAX;
+                value = value * 10 + (size_t)(*v - '0');
+                v++;
+            }
+            return value;
+        }
+        line = memchr(line, '\n', remaining);
     }
+    return 0;
+}
 
-    const char *line_end = strstr(line_start, "\r\n");
-    if (!line_end || line_end > header_end) { 
-        cwist_http_request_destroy(req); 
-        return NULL; 
+/*
+ * Parses the frame [buf, buf + frame_len) in place. Delimiters in the head
+ * are overwritten with NULs so method, path, query, version and every header
+ * become views into buf. buf[frame_len] must be writable; it receives the
+ * body terminator. buf must outlive the request.
+ */
+static bool cwist_http_parse_frame(cwist_http_request *req, char *buf, size_t header_len, size_t frame_len) {
+    cwist_http_request_storage *storage = (cwist_http_request_storage *)req;
+    char *head_end = buf + header_len - 2; // Start of the blank line.
+
+    // 1. Request line: METHOD SP target SP version
+    size_t head_len = (size_t)(head_end - buf);
+    size_t line_len = cwist_http_scan2(buf, head_len, '\n', '\n');
+    if (line_len == head_len) return false;
+    char *line_end = buf + line_len;
+    char *next_line = line_end + 1;
+    if (line_end > buf && line_end[-1] == '\r') line_end--;
+    *line_end = '\0';
+
+    char *method = buf;
+    char *sp = memchr(method, ' ', (size_t)(line_end - method));
+    if (!sp) {
+        req->method = cwist_http_string_to_method(method);
+    } else {
+        *sp = '\0';
+        req->method = cwist_http_string_to_method(method);
+
+        char *target = sp + 1;
+        while (target < line_end && *target == ' ') target++;
+        char *target_end = memchr(target, ' ', (size_t)(line_end - target));
+        if (!target_end) target_end = line_end;
+
+        if (target < target_end) {
+            char *query = memchr(target, '?', (size_t)(target_end - target));
+            char *path_end = query ? query : target_end;
+            *path_end = '\0';
+            cwist_sstring_init_view(&storage->path, target, (size_t)(path_end - target));
+            if (query) {
+                *target_end = '\0';
+                cwist_sstring_init_view(&storage->query, query + 1, (size_t)(target_end - query - 1));
+                // Handlers that never look at parameters never pay for parsing them.
+                cwist_query_map_parse_deferred(req->query_params, storage->query.data, storage->query.size);
+            } else {
+                cwist_sstring_init_view(&storage->query, "", 0);
+            }
+        }
+
+        char *version = target_end < line_end ? target_end + 1 : line_end;
+        while (version < line_end && *version == ' ') version++;
+        if (version < line_end) {
+            char *version_end = memchr(version, ' ', (size_t)(line_end - version));
+            if (version_end) *version_end = '\0';
+            else version_end = line_end;
+            cwist_sstring_init_view(&storage->version, version, (size_t)(version_end - version));
+            req->keep_alive = strcmp(version, "HTTP/1.1") == 0;
+        }
     }
 
-    // 1. Request Line
-    int request_line_len = line_end - line_start;
-    char *request_line = (char*)cwist_alloc(request_line_len + 1);
-    if (!request_line) {
-        cwist_http_request_destroy(req);
-        return NULL;
+    // 2. Headers, counted first so they share one block.
+    size_t lines = 0;
+    for (char *p = next_line; p < head_end; lines++) {
+        p += cwist_http_scan2(p, (size_t)(head_end - p), '\n', '\n') + 1;
     }
-    strncpy(request_line, line_start, request_line_len);
-    request_line[request_line_len] = '\0';
-    
-    char *next_ptr;
-    char *method_str = strtok_r(request_line, " ", &next_ptr);
-    char *path_str = strtok_r(NULL, " ", &next_ptr);
-    char *version_str = strtok_r(NULL, " ", &next_ptr);
-    
-    if (method_str) req->method = cwist_http_string_to_method(method_str);
-    if (path_str) {
-      char *query = strchr(path_str, '?');
-      if(query) {
-        *query = '\0';
-        cwist_sstring_assign(req->path, path_str);
-        cwist_sstring_assign(req->query, query + 1); // exclude ? mark
-        cwist_query_map_parse(req->query_params, req->query->data);
-      } else {
-        cwist_sstring_assign(req->path, path_str);
-        cwist_sstring_assign(req->query, "");
-      }
+    if (lines > storage->header_cap) {
+        cwist_free(storage->header_block);
+        storage->header_cap = 0;
+        storage->header_block = (cwist_http_header_slot *)cwist_alloc_array(lines, sizeof(cwist_http_header_slot));
+        if (!storage->header_block) return false;
+        storage->header_cap = lines;
     }
 
-    if (version_str) {
-        cwist_sstring_assign(req->version, version_str);
-        if (strcmp(version_str, "HTTP/1.1") == 0) {
-            req->keep_alive = true;
+    size_t used = 0;
+    char *line = next_line;
+    while (line < head_end && used < lines) {
+        // One pass per line: stop at the colon or at the line feed, whichever comes first.
+        size_t avail = (size_t)(head_end - line);
+        char *colon = line + cwist_http_scan2(line, avail, ':', '\n');
+        char *nl = colon;
+        if (colon < head_end && *colon == ':') {
+            nl = colon + 1 + cwist_http_scan2(colon + 1, (size_t)(head_end - colon - 1), '\n', '\n');
         } else {
-            req->keep_alive = false;
-        }
-    }
-    
-    cwist_free(request_line);
-
-    // 2. Headers
-    line_start = line_end + 2; // Skip \r\n
-    while (line_start < header_end) {
-        line_end = strstr(line_start, "\r\n");
-        if (!line_end) break;
-
-        if (line_end == line_start) {
-            // Empty line found
-            line_start += 2;
-            break;
+            colon = NULL;
         }
-        
-        int header_len = line_end - line_start;
-        char *header_line = (char*)cwist_alloc(header_len + 1);
-        if (header_line) {
-            strncpy(header_line, line_start, header_len);
-            header_line[header_len] = '\0';
-            
-            char *colon = strchr(header_line, ':');
-            if (colon) {
-                *colon = '\0';
-                char *key = header_line;
-                char *value = colon + 1;
-                while (*value == ' ') value++; // Trim leading space
-                
-                cwist_http_header_add(&req->headers, key, value);
-                if (header_key_is_connection(key)) {
-                    if (header_value_is_close(value)) {
-                        req->keep_alive = false;
-                    } else if (header_value_is_keep_alive(value)) {
-                        req->keep_alive = true;
-                    }
-                } else if (strcasecmp(key, "Content-Length") == 0) {
-                    req->content_length = (size_t)atoll(value);
+        if (nl >= head_end) break;
+        char *eol = (nl > line && nl[-1] == '\r') ? nl - 1 : nl;
+        if (colon && colon > eol) colon = NULL;
+        if (colon) {
+            char *value = colon + 1;
+            while (value < eol && (*value == ' ' || *value == '\t')) value++;
+            *colon = '\0';
+            *eol = '\0';
+
+            cwist_http_header_slot *slot = &storage->header_block[used++];
+            cwist_sstring_init_view(&slot->key, line, (size_t)(colon - line));
+            cwist_sstring_init_view(&slot->value, value, (size_t)(eol - value));
+            slot->node.key = &slot->key;
+            slot->node.value = &slot->value;
+            slot->node.is_view = true;
+            slot->node.next = req->headers;
+            req->headers = &slot->node;
+
+            if (header_key_is_connection(line)) {
+                if (header_value_is_close(value)) {
+                    req->keep_alive = false;
+                } else if (header_value_is_keep_alive(value)) {
+                    req->keep_alive = true;
                 }
+            } else if (strcasecmp(line, "Content-Length") == 0) {
+                req->content_length = (size_t)atoll(value);
             }
-            cwist_free(header_line);
         }
-        
-        line_start = line_end + 2;
+        line = nl + 1;
     }
 
-    const char *body_start = header_end + 4;
-    if (*body_start != '\0') {
-        cwist_sstring_assign(req->body, (char*)body_start);
+    // 3. Body
+    if (frame_len > header_len) {
+        buf[frame_len] = '\0';
+        cwist_sstring_init_view(&storage->body, buf + header_len, frame_len - header_len);
     }
-
-    return req;
+    return true;
 }
 
+cwist_http_request *cwist_http_parse_request(const char *raw_request) {
+    if (!raw_request) return NULL;
+
+    size_t len = strlen(raw_request);
+    const char *header_end = cwist_find_header_end(raw_request, len);
+    if (!header_end) return NULL;
+
+    cwist_http_request *req = cwist_http_request_create();
+    if (!req) return NULL;
 
+    // The caller keeps its buffer; parse a private copy in place.
+    char *frame = (char *)cwist_http_request_alloc(req, len + 1);
+    if (!frame) {
+        cwist_http_request_destroy(req);
+        return NULL;
+    }
+    memcpy(frame, raw_request, len);
+
+    size_t header_len = (size_t)(header_end - raw_request) + 4;
+    if (!cwist_http_parse_frame(req, frame, header_len, len)) {
+        cwist_http_request_destroy(req);
+        return NULL;
+    }
+    return req;
+}
 
 cwist_http_request *cwist_http_receive_request(int client_fd, char *read_buf, size_t buf_size, size_t *buf_len) {
     size_t total_received = *buf_len;
-    char *header_end = NULL;
+    size_t scanned = 0;
+    const char *header_end = NULL;
+    // The previous request may have been parsed in place; drop what is left of it.
+    read_buf[total_received] = '\0';
 
-    // 1. Read until headers are complete
-    while (!(header_end = strstr(read_buf, "\r\n\r\n"))) {
+    // 1. Read until headers are complete, scanning only bytes not seen before.
+    while (!(header_end = cwist_http_scan_header_end(read_buf, total_received, &scanned))) {
         if (total_received >= buf_size - 1) {
             // Buffer full, but headers not complete
             return NULL;
         }
         
-        struct pollfd pfd = { .fd = client_fd, .events = POLLIN };
-        int ret = poll(&pfd, 1, CWIST_HTTP_TIMEOUT_MS);
+        int ret = cwist_coro_poll(client_fd, POLLIN, CWIST_HTTP_TIMEOUT_MS);
         if (ret <= 0) return NULL; // Timeout or error
 
         ssize_t bytes = recv(client_fd, read_buf + total_received, buf_size - 1 - total_received, 0);
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
         if (bytes <= 0) return NULL;
         total_received += (size_t)bytes;
         read_buf[total_received] = '\0';
     }
 
-    cwist_http_request *req = cwist_http_parse_request(read_buf);
-    if (!req) return NULL;
-
-    size_t header_len = (header_end + 4) - read_buf;
-    size_t body_received = total_received - header_len;
+    size_t header_len = (size_t)(header_end - read_buf) + 4;
+    size_t content_length = cwist_frame_content_length(read_buf, header_len);
+    if (content_length > CWIST_HTTP_MAX_BODY_SIZE) return NULL;
+    size_t frame_len = header_len + content_length;
+
+    // 2. Parse in read_buf when the frame fits; copy it out only for large bodies
+    //    or when pipelined bytes must be moved to the front of the buffer.
+    char *frame = read_buf;
+    char *owned = NULL;
+    if (frame_len >= buf_size) {
+        owned = (char *)cwist_alloc(frame_len + 1);
+        if (!owned) return NULL;
+        memcpy(owned, read_buf, total_received);
+        frame = owned;
+    }
 
-    // 2. Read body based on Content-Length
-    if (req->content_length > 0) {
-        if (req->content_length > CWIST_HTTP_MAX_BODY_SIZE) {
-            cwist_http_request_destroy(req);
+    while (total_received < frame_len) {
+        int ret = cwist_coro_poll(client_fd, POLLIN, CWIST_HTTP_TIMEOUT_MS);
+        if (ret <= 0) {
+            cwist_free(owned);
             return NULL;
         }
 
-        // Allocate body
-        char *body = cwist_alloc(req->content_length + 1);
-        if (!body) {
-            cwist_http_request_destroy(req);
+        ssize_t bytes = recv(client_fd, frame + total_received, frame_len - total_received, 0);
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+        if (bytes <= 0) {
+            cwist_free(owned);
             return NULL;
         }
+        total_received += (size_t)bytes;
+    }
 
-        size_t to_copy = (body_received < req->content_length) ? body_received : req->content_length;
-        memcpy(body, header_end + 4, to_copy);
-        size_t current_body_len = to_copy;
+    size_t leftover_len = total_received - frame_len;
+    if (leftover_len > 0 && !owned) {
+        owned = (char *)cwist_alloc(frame_len + 1);
+        if (!owned) return NULL;
+        memcpy(owned, read_buf, frame_len);
+        frame = owned;
+    }
+    if (leftover_len > 0) {
+        memmove(read_buf, read_buf + frame_len, leftover_len);
+        read_buf[leftover_len] = '\0';
+    }
+    *buf_len = leftover_len;
 
-        while (current_body_len < req->content_length) {
-            struct pollfd pfd = { .fd = client_fd, .events = POLLIN };
-            int ret = poll(&pfd, 1, CWIST_HTTP_TIMEOUT_MS);
-            if (ret <= 0) {
-                cwist_free(body);
-                cwist_http_request_destroy(req);
-                return NULL;
-            }
+    cwist_http_request *req = cwist_http_request_create();
+    if (!req) {
+        cwist_free(owned);
+        return NULL;
+    }
+    ((cwist_http_request_storage *)req)->frame = owned;
+    if (!cwist_http_parse_frame(req, frame, header_len, frame_len)) {
+        cwist_http_request_destroy(req);
+        return NULL;
+    }
+    return req;
+}
 
-            ssize_t bytes = recv(client_fd, body + current_body_len, req->content_length - current_body_len, 0);
-            if (bytes <= 0) {
-                cwist_free(body);
-                cwist_http_request_destroy(req);
-                return NULL;
-            }
-            current_body_len += (size_t)bytes;
-        }
-        body[req->content_length] = '\0';
-        cwist_sstring_assign_len(req->body, body, req->content_length);
-        cwist_free(body);
+/* --- Request Framing --- */
 
-        // Calculate leftovers
-        if (body_received > req->content_length) {
-            size_t leftover_len = body_received - req->content_length;
-            memmove(read_buf, header_end + 4 + req->content_length, leftover_len);
-            *buf_len = leftover_len;
-        } else {
-            *buf_len = 0;
-        }
-    } else {
-        // No body, leftovers are everything after headers
-        if (body_received > 0) {
-            memmove(read_buf, header_end + 4, body_received);
-            *buf_len = body_received;
-        } else {
-            *buf_len = 0;
-        }
+int cwist_http_frame_request(const char *buf, size_t len, size_t *frame_len) {
+    size_t scanned = 0;
+    return cwist_http_frame_request_resume(buf, len, &scanned, frame_len);
+}
+
+int cwist_http_frame_request_resume(const char *buf, size_t len, size_t *scanned, size_t *frame_len) {
+    if (!buf || !scanned || !frame_len) return -1;
+
+    const char *header_end = cwist_http_scan_header_end(buf, len, scanned);
+    if (!header_end) {
+        return len > CWIST_HTTP_MAX_HEADER_SIZE ? -1 : 0;
     }
-    read_buf[*buf_len] = '\0';
 
+    size_t header_len = (size_t)(header_end - buf) + 4;
+    if (header_len > CWIST_HTTP_MAX_HEADER_SIZE) return -1;
+
+    size_t content_length = cwist_frame_content_length(buf, header_len);
+    if (content_length > CWIST_HTTP_MAX_BODY_SIZE) return -1;
+
+    if (len < header_len + content_length) return 0;
+    *frame_len = header_len + content_length;
+    return 1;
+}
+
+cwist_http_request *cwist_http_request_from_frame(char *buf, size_t frame_len) {
+    const char *header_end = cwist_find_header_end(buf, frame_len);
+    if (!header_end) return NULL;
+    size_t header_len = (size_t)(header_end - buf) + 4;
+
+    cwist_http_request *req = cwist_http_request_create();
+    if (!req) return NULL;
+
+    // The body terminator may land on the first byte of a pipelined request;
+    // it is put back when the request is destroyed.
+    cwist_http_request_storage *storage = (cwist_http_request_storage *)req;
+    storage->restore_at = buf + frame_len;
+    storage->restore_byte = buf[frame_len];
+
+    if (!cwist_http_parse_frame(req, buf, header_len, frame_len)) {
+        cwist_http_request_destroy(req);
+        return NULL;
+    }
     return req;
 }
 
@@ -725,7 +1249,7 @@ const char CWIST_BLOB_500[] = "HTTP/1.1 500 Internal Server Error\r\nContent-Len
 
 /* --- Socket Manipulation --- */
 
-int cwist_make_socket_ipv4(struct sockaddr_in *sockv4, const char *address, uint16_t port, uint16_t backlog) {
+static int cwist_make_listener_ipv4(struct sockaddr_in *sockv4, const char *address, uint16_t port, uint16_t backlog, bool reuse_port) {
   int server_fd = -1;
   int opt = 1;
   in_addr_t addr = inet_addr(address);
@@ -756,6 +1280,25 @@ int cwist_make_socket_ipv4(struct sockaddr_in *sockv4, const char *address, uint
     return CWIST_HTTP_SETSOCKOPT_FAILED;  
   }
 
+#ifdef SO_REUSEPORT
+  if(reuse_port && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+    cJSON *err_json = cJSON_CreateObject();
+    cJSON_AddStringToObject(err_json, "err", "Failed to enable SO_REUSEPORT");
+    char *cjson_error_log = cJSON_Print(err_json);
+    perror(cjson_error_log);
+    cwist_free(cjson_error_log);
+    cJSON_Delete(err_json);
+
+    close(server_fd);
+    return CWIST_HTTP_SETSOCKOPT_FAILED;
+  }
+#else
+  if(reuse_port) {
+    close(server_fd);
+    return CWIST_HTTP_SETSOCKOPT_FAILED;
+  }
+#endif
+
 #if defined(__APPLE__) || defined(__FreeBSD__)
   int no_sig_pipe = 1;
   setsockopt(server_fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sig_pipe, sizeof(no_sig_pipe));
@@ -795,6 +1338,69 @@ int cwist_make_socket_ipv4(struct sockaddr_in *sockv4, const char *address, uint
   return server_fd;
 }
 
+int cwist_make_socket_ipv4(struct sockaddr_in *sockv4, const char *address, uint16_t port, uint16_t backlog) {
+  return cwist_make_listener_ipv4(sockv4, address, port, backlog, false);
+}
+
+int cwist_make_socket_ipv4_reuseport(struct sockaddr_in *sockv4, const char *address, uint16_t port, uint16_t backlog) {
+  return cwist_make_listener_ipv4(sockv4, address, port, backlog, true);
+}
+
+/* --- Graceful Drain --- */
+
+static volatile sig_atomic_t g_cwist_draining = 0;
+
+static void cwist_drain_signal_handler(int sig) {
+    (void)sig;
+    g_cwist_draining = 1;
+}
+
+void cwist_http_server_request_drain(void) {
+    g_cwist_draining = 1;
+}
+
+bool cwist_http_server_is_draining(void) {
+    return g_cwist_draining != 0;
+}
+
+/* SIGTERM/SIGINT start a drain; no SA_RESTART so blocking accept()/waitpid() notice it. */
+static void cwist_install_drain_signals(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = cwist_drain_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+}
+
+static uint64_t cwist_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void cwist_sleep_ms(long ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+#define CWIST_DRAIN_POLL_MS 200
+
+/*
+ * Waits until server_fd has a connection to accept. The signal may land on
+ * another thread, so the wait wakes up periodically to look at the drain flag.
+ * Returns false once draining.
+ */
+static bool cwist_wait_acceptable(int server_fd) {
+    struct pollfd pfd = { .fd = server_fd, .events = POLLIN };
+    while (!cwist_http_server_is_draining()) {
+        int ready = poll(&pfd, 1, CWIST_DRAIN_POLL_MS);
+        if (ready > 0) return true;
+        if (ready < 0 && errno != EINTR) return true; // Let accept() report it.
+    }
+    return false;
+}
+
 static bool cwist_accept_error_should_retry(int err) {
     switch (err) {
         case EINTR:
@@ -835,31 +1441,571 @@ static void cwist_accept_error_backoff(int err) {
     }
 }
 
-struct thread_payload {
-    int client_fd;
+/*
+ * Worker pool used by use_threading. Producers (the accept loop or the
+ * reactor) push jobs into a bounded ring; when the ring is full the producer
+ * blocks, leaving further connections in the kernel backlog instead of
+ * spawning more threads.
+ */
+typedef struct cwist_worker_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    void **items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    size_t active;          ///< Jobs currently being run by a worker.
+    pthread_t *threads;
+    size_t thread_count;
+    void (*run)(void *item, void *ctx);
+    void *ctx;
+} cwist_worker_pool;
+
+static size_t cwist_default_worker_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t)cpus : 1;
+}
+
+static void *cwist_worker_main(void *arg) {
+    cwist_worker_pool *pool = (cwist_worker_pool *)arg;
+
+    // Leave drain signals to the accept/event thread so they interrupt its wait.
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->count == 0) {
+            pthread_cond_wait(&pool->not_empty, &pool->lock);
+        }
+        void *item = pool->items[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        pool->active++;
+        pthread_cond_signal(&pool->not_full);
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->run(item, pool->ctx);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->active--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+static cwist_worker_pool *cwist_worker_pool_create(cwist_server_config *config, void (*run)(void *, void *), void *ctx) {
+    size_t workers = config->worker_threads ? config->worker_threads : cwist_default_worker_count();
+    size_t capacity = config->queue_capacity ? config->queue_capacity : workers * 64;
+
+    cwist_worker_pool *pool = (cwist_worker_pool *)cwist_alloc(sizeof(cwist_worker_pool));
+    if (!pool) return NULL;
+    pool->items = (void **)cwist_alloc_array(capacity, sizeof(void *));
+    pool->threads = (pthread_t *)cwist_alloc_array(workers, sizeof(pthread_t));
+    if (!pool->items || !pool->threads) {
+        cwist_free(pool->items);
+        cwist_free(pool->threads);
+        cwist_free(pool);
+        return NULL;
+    }
+    pool->capacity = capacity;
+    pool->run = run;
+    pool->ctx = ctx;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+
+    for (size_t i = 0; i < workers; i++) {
+        if (pthread_create(&pool->threads[i], NULL, cwist_worker_main, pool) != 0) {
+            fprintf(stderr, "[CWIST] worker pool: started %zu of %zu threads\n", i, workers);
+            break;
+        }
+        pthread_detach(pool->threads[i]);
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0) {
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->not_empty);
+        pthread_cond_destroy(&pool->not_full);
+        cwist_free(pool->items);
+        cwist_free(pool->threads);
+        cwist_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+static void cwist_worker_pool_push(cwist_worker_pool *pool, void *item) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->count == pool->capacity) {
+        pthread_cond_wait(&pool->not_full, &pool->lock);
+    }
+    pool->items[(pool->head + pool->count) % pool->capacity] = item;
+    pool->count++;
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Waits (bounded by CWIST_HTTP_DRAIN_TIMEOUT_MS) until queued and running jobs finish. */
+static void cwist_worker_pool_wait_idle(cwist_worker_pool *pool) {
+    uint64_t deadline = cwist_clock_ms() + CWIST_HTTP_DRAIN_TIMEOUT_MS;
+    while (cwist_clock_ms() < deadline) {
+        pthread_mutex_lock(&pool->lock);
+        bool idle = pool->count == 0 && pool->active == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (idle) return;
+        cwist_sleep_ms(20);
+    }
+}
+
+typedef struct cwist_connection_job_ctx {
     void (*handler_func)(int, void *);
     void *ctx;
+} cwist_connection_job_ctx;
+
+static void cwist_run_connection_job(void *item, void *ctx) {
+    cwist_connection_job_ctx *job = (cwist_connection_job_ctx *)ctx;
+    job->handler_func((int)(intptr_t)item, job->ctx);
+}
+
+#ifdef __linux__
+/*
+ * Event-driven reactor. One thread owns the epoll set: it accepts, reads
+ * into per-connection buffers, and only hands a connection to a worker once
+ * a full request has been framed. Ownership follows the connection state:
+ *
+ *   IDLE    - armed in epoll (EPOLLONESHOT); only the reactor touches it.
+ *   BUSY    - a worker is running requests; the reactor will not see events.
+ *   CLOSING - shut down; the next event makes the reactor close and free it.
+ *
+ * Workers never close sockets themselves. They shut the socket down and re-arm
+ * it, so every close happens on the reactor thread and the connection list
+ * needs no lock. An idle keep-alive connection costs one cwist_reactor_conn;
+ * its read buffer is released as soon as it drains.
+ */
+enum {
+    CWIST_CONN_IDLE = 0,
+    CWIST_CONN_BUSY,
+    CWIST_CONN_CLOSING
 };
 
-static void *thread_handler(void *arg) {
-    struct thread_payload *payload = (struct thread_payload *)arg;
-    int client_fd = payload->client_fd;
-    void (*handler_func)(int, void *) = payload->handler_func;
-    void *ctx = payload->ctx;
-    free(payload);
-    handler_func(client_fd, ctx);
-    return NULL;
+#define CWIST_REACTOR_INITIAL_BUFFER 2048
+#define CWIST_REACTOR_MAX_EVENTS 64
+#define CWIST_REACTOR_SWEEP_MS 1000
+
+typedef struct cwist_reactor_conn {
+    int fd;
+    _Atomic int state;
+    bool peer_closed;
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t scanned;         ///< Header bytes of the pending request already searched.
+    _Atomic uint64_t last_active_ms;
+    struct cwist_reactor_conn *prev;
+    struct cwist_reactor_conn *next;
+} cwist_reactor_conn;
+
+typedef struct cwist_reactor {
+    int epoll_fd;
+    int server_fd;
+    cwist_reactor_conn *conns;
+    cwist_http_request_handler_fn on_request;
+    void *ctx;
+    cwist_worker_pool *pool;
+} cwist_reactor;
+
+static uint64_t cwist_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void cwist_reactor_arm(cwist_reactor *reactor, cwist_reactor_conn *conn, int op) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    epoll_ctl(reactor->epoll_fd, op, conn->fd, &ev);
 }
 
-static void handle_client_forking(int client_fd, void (*handler_func)(int, void *), void *ctx) {
+static void cwist_reactor_close(cwist_reactor *reactor, cwist_reactor_conn *conn) {
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    if (conn->prev) conn->prev->next = conn->next;
+    else reactor->conns = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    cwist_free(conn->buf);
+    cwist_free(conn);
+}
+
+static void cwist_reactor_accept(cwist_reactor *reactor) {
+    while (true) {
+        int client_fd = accept4(reactor->server_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            int accept_err = errno;
+            if (accept_err == EAGAIN || accept_err == EWOULDBLOCK) return;
+            if (cwist_accept_error_should_retry(accept_err)) {
+                cwist_accept_error_backoff(accept_err);
+                if (accept_err == EINTR || accept_err == ECONNABORTED) continue;
+            }
+            return;
+        }
+
+        cwist_reactor_conn *conn = (cwist_reactor_conn *)cwist_alloc(sizeof(cwist_reactor_conn));
+        if (!conn) {
+            close(client_fd);
+            continue;
+        }
+        conn->fd = client_fd;
+        atomic_init(&conn->state, CWIST_CONN_IDLE);
+        atomic_init(&conn->last_active_ms, cwist_monotonic_ms());
+        conn->next = reactor->conns;
+        if (reactor->conns) reactor->conns->prev = conn;
+        reactor->conns = conn;
+        cwist_reactor_arm(reactor, conn, EPOLL_CTL_ADD);
+    }
+}
+
+/* Drains the socket into the connection buffer. Returns false on a fatal error. */
+static bool cwist_reactor_fill(cwist_reactor_conn *conn) {
+    while (!conn->peer_closed) {
+        if (conn->cap - conn->len < 2) {
+            size_t limit = CWIST_HTTP_MAX_HEADER_SIZE + CWIST_HTTP_MAX_BODY_SIZE + 1;
+            if (conn->cap >= limit) return false;
+            size_t new_cap = conn->cap ? conn->cap * 2 : CWIST_REACTOR_INITIAL_BUFFER;
+            if (new_cap > limit) new_cap = limit;
+            char *grown = (char *)cwist_realloc(conn->buf, new_cap);
+            if (!grown) return false;
+            conn->buf = grown;
+            conn->cap = new_cap;
+        }
+
+        ssize_t bytes = recv(conn->fd, conn->buf + conn->len, conn->cap - 1 - conn->len, 0);
+        if (bytes > 0) {
+            conn->len += (size_t)bytes;
+            conn->buf[conn->len] = '\0';
+            continue;
+        }
+        if (bytes == 0) {
+            conn->peer_closed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        return false;
+    }
+    return true;
+}
+
+/* Runs every framed request buffered on the connection, then hands it back. */
+static void cwist_reactor_serve(void *item, void *ctx) {
+    cwist_reactor_conn *conn = (cwist_reactor_conn *)item;
+    cwist_reactor *reactor = (cwist_reactor *)ctx;
+    bool keep_alive = true;
+
+    while (keep_alive && conn->len > 0) {
+        size_t frame_len = 0;
+        int framed = cwist_http_frame_request_resume(conn->buf, conn->len, &conn->scanned, &frame_len);
+        if (framed == 0) break;
+        if (framed < 0) {
+            keep_alive = false;
+            break;
+        }
+
+        cwist_http_request *req = cwist_http_request_from_frame(conn->buf, frame_len);
+        if (!req) {
+            keep_alive = false;
+            break;
+        }
+        req->client_fd = conn->fd;
+        keep_alive = reactor->on_request(conn->fd, req, reactor->ctx);
+        cwist_http_request_destroy(req);
+
+        conn->len -= frame_len;
+        conn->scanned = 0;
+        memmove(conn->buf, conn->buf + frame_len, conn->len);
+        conn->buf[conn->len] = '\0';
+    }
+
+    if (conn->peer_closed) keep_alive = false;
+
+    if (!keep_alive) {
+        atomic_store(&conn->state, CWIST_CONN_CLOSING);
+        shutdown(conn->fd, SHUT_RDWR);
+    } else {
+        if (conn->len == 0) {
+            cwist_free(conn->buf);
+            conn->buf = NULL;
+            conn->cap = 0;
+        }
+        atomic_store(&conn->last_active_ms, cwist_monotonic_ms());
+        atomic_store(&conn->state, CWIST_CONN_IDLE);
+    }
+    // Last touch: once re-armed the reactor may pick the connection up again.
+    cwist_reactor_arm(reactor, conn, EPOLL_CTL_MOD);
+}
+
+static void cwist_reactor_on_readable(cwist_reactor *reactor, cwist_reactor_conn *conn) {
+    if (atomic_load(&conn->state) == CWIST_CONN_CLOSING) {
+        cwist_reactor_close(reactor, conn);
+        return;
+    }
+
+    if (!cwist_reactor_fill(conn)) {
+        cwist_reactor_close(reactor, conn);
+        return;
+    }
+    atomic_store(&conn->last_active_ms, cwist_monotonic_ms());
+
+    size_t frame_len = 0;
+    int framed = conn->len ? cwist_http_frame_request_resume(conn->buf, conn->len, &conn->scanned, &frame_len) : 0;
+    if (framed < 0 || (framed == 0 && conn->peer_closed)) {
+        cwist_reactor_close(reactor, conn);
+        return;
+    }
+    if (framed == 0) {
+        cwist_reactor_arm(reactor, conn, EPOLL_CTL_MOD);
+        return;
+    }
+
+    atomic_store(&conn->state, CWIST_CONN_BUSY);
+    if (reactor->pool) {
+        cwist_worker_pool_push(reactor->pool, conn);
+    } else {
+        cwist_reactor_serve(conn, reactor);
+    }
+}
+
+/* Shuts down connections that stayed idle (or half-sent) past the timeout. */
+static void cwist_reactor_sweep(cwist_reactor *reactor) {
+    uint64_t now = cwist_monotonic_ms();
+    for (cwist_reactor_conn *conn = reactor->conns; conn; conn = conn->next) {
+        if (now - atomic_load(&conn->last_active_ms) < CWIST_HTTP_TIMEOUT_MS) continue;
+        int expected = CWIST_CONN_IDLE;
+        if (atomic_compare_exchange_strong(&conn->state, &expected, CWIST_CONN_CLOSING)) {
+            shutdown(conn->fd, SHUT_RDWR);
+        }
+    }
+}
+
+static cwist_error_t cwist_reactor_run(int server_fd, cwist_server_config *config, void *ctx) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    err.error.err_i16 = -1;
+
+    // Heap-allocated: detached workers keep referencing it.
+    cwist_reactor *reactor = (cwist_reactor *)cwist_alloc(sizeof(cwist_reactor));
+    if (!reactor) return err;
+    reactor->server_fd = server_fd;
+    reactor->on_request = config->on_request;
+    reactor->ctx = ctx;
+
+    int flags = fcntl(server_fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(server_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        cwist_free(reactor);
+        return err;
+    }
+
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor->epoll_fd < 0) {
+        cwist_free(reactor);
+        return err;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL; // NULL marks the listener
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, server_fd, &event) < 0) {
+        close(reactor->epoll_fd);
+        cwist_free(reactor);
+        return err;
+    }
+
+    if (config->use_threading) {
+        reactor->pool = cwist_worker_pool_create(config, cwist_reactor_serve, reactor);
+        if (!reactor->pool) {
+            close(reactor->epoll_fd);
+            cwist_free(reactor);
+            return err;
+        }
+    }
+
+    uint64_t last_sweep = cwist_monotonic_ms();
+    uint64_t drain_deadline = 0;
+    struct epoll_event events[CWIST_REACTOR_MAX_EVENTS];
+    while (true) {
+        if (cwist_http_server_is_draining()) {
+            if (!drain_deadline) {
+                // Stop accepting; keep serving what is already buffered or in flight.
+                epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, server_fd, NULL);
+                drain_deadline = cwist_monotonic_ms() + CWIST_HTTP_DRAIN_TIMEOUT_MS;
+            }
+            for (cwist_reactor_conn *conn = reactor->conns; conn; conn = conn->next) {
+                int expected = CWIST_CONN_IDLE;
+                if (conn->len == 0 && atomic_compare_exchange_strong(&conn->state, &expected, CWIST_CONN_CLOSING)) {
+                    shutdown(conn->fd, SHUT_RDWR);
+                }
+            }
+            if (!reactor->conns || cwist_monotonic_ms() >= drain_deadline) {
+                err.error.err_i16 = 0;
+                break;
+            }
+        }
+
+        int timeout = drain_deadline ? 50 : CWIST_REACTOR_SWEEP_MS;
+        int count = epoll_wait(reactor->epoll_fd, events, CWIST_REACTOR_MAX_EVENTS, timeout);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            if (!events[i].data.ptr) {
+                cwist_reactor_accept(reactor);
+            } else {
+                cwist_reactor_on_readable(reactor, (cwist_reactor_conn *)events[i].data.ptr);
+            }
+        }
+
+        uint64_t now = cwist_monotonic_ms();
+        if (now - last_sweep >= CWIST_REACTOR_SWEEP_MS) {
+            cwist_reactor_sweep(reactor);
+            last_sweep = now;
+        }
+    }
+
+    /* Workers are detached and may still reference the reactor; it is not freed. */
+    return err;
+}
+#endif
+
+/*
+ * Prefork model: the master forks long-lived workers that share server_fd and
+ * each run the configured loop (reactor, pool or io_uring). Crashed workers
+ * are restarted; SIGTERM/SIGINT are forwarded so workers drain and exit.
+ */
+static pid_t cwist_prefork_spawn(int server_fd, cwist_server_config *worker_config, void (*handler)(int, void *), void *ctx) {
+    fflush(NULL); // Don't let children replay buffered master output.
     pid_t pid = fork();
     if (pid == 0) {
-        handler_func(client_fd, ctx);
-        close(client_fd);
-        _exit(0);
-    } else if (pid > 0) {
-        close(client_fd);
+        if (worker_config->on_worker_start) {
+            worker_config->on_worker_start(ctx);
+        }
+        cwist_error_t err = cwist_http_server_loop(server_fd, worker_config, handler, ctx);
+        if (worker_config->on_worker_exit) {
+            worker_config->on_worker_exit(ctx);
+        }
+        _exit(err.error.err_i16 == 0 ? 0 : 1);
     }
+    return pid;
+}
+
+static cwist_error_t cwist_prefork_master(int server_fd, cwist_server_config *config, void (*handler)(int, void *), void *ctx) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    size_t count = config->worker_processes ? config->worker_processes : cwist_default_worker_count();
+
+    pid_t *pids = (pid_t *)cwist_alloc_array(count, sizeof(pid_t));
+    uint64_t *started_at = (uint64_t *)cwist_alloc_array(count, sizeof(uint64_t));
+    if (!pids || !started_at) {
+        cwist_free(pids);
+        cwist_free(started_at);
+        err.error.err_i16 = -1;
+        return err;
+    }
+
+    cwist_server_config worker_config = *config;
+    worker_config.use_forking = false;
+    if (worker_config.worker_threads == 0) {
+        // Split the default thread budget across processes instead of multiplying it.
+        size_t cpus = cwist_default_worker_count();
+        worker_config.worker_threads = (cpus + count - 1) / count;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        pids[i] = cwist_prefork_spawn(server_fd, &worker_config, handler, ctx);
+        started_at[i] = cwist_clock_ms();
+        if (pids[i] < 0) {
+            fprintf(stderr, "[CWIST] prefork: fork failed: %s\n", strerror(errno));
+        }
+    }
+
+    // Poll rather than block: a SIGTERM landing between the drain check and a
+    // blocking waitpid would otherwise go unnoticed until some worker exits.
+    while (!cwist_http_server_is_draining()) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid == 0) {
+            cwist_sleep_ms(50);
+            continue;
+        }
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break; // ECHILD: nothing left to supervise.
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (pids[i] != pid) continue;
+            pids[i] = -1;
+            if (cwist_http_server_is_draining()) break;
+
+            // Status 0 means the worker drained on purpose (it was sent SIGTERM itself).
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                fprintf(stderr, "[CWIST] prefork: worker %d exited cleanly, not restarting\n", (int)pid);
+                break;
+            }
+            if (WIFSIGNALED(status)) {
+                fprintf(stderr, "[CWIST] prefork: worker %d killed by signal %d, restarting\n", (int)pid, WTERMSIG(status));
+            } else {
+                fprintf(stderr, "[CWIST] prefork: worker %d exited with %d, restarting\n", (int)pid, WEXITSTATUS(status));
+            }
+            // A worker that dies right after start is likely to do so again; don't fork-bomb.
+            if (cwist_clock_ms() - started_at[i] < 1000) {
+                cwist_sleep_ms(1000);
+            }
+            if (!cwist_http_server_is_draining()) {
+                pids[i] = cwist_prefork_spawn(server_fd, &worker_config, handler, ctx);
+                started_at[i] = cwist_clock_ms();
+            }
+            break;
+        }
+    }
+
+    // Graceful drain: forward SIGTERM, give workers time to finish, then force.
+    for (size_t i = 0; i < count; i++) {
+        if (pids[i] > 0) kill(pids[i], SIGTERM);
+    }
+    uint64_t deadline = cwist_clock_ms() + CWIST_HTTP_DRAIN_TIMEOUT_MS;
+    size_t alive = count;
+    while (alive > 0) {
+        alive = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (pids[i] <= 0) continue;
+            if (waitpid(pids[i], NULL, WNOHANG) == pids[i]) {
+                pids[i] = -1;
+            } else {
+                alive++;
+            }
+        }
+        if (alive == 0) break;
+        if (cwist_clock_ms() >= deadline) {
+            for (size_t i = 0; i < count; i++) {
+                if (pids[i] > 0) {
+                    kill(pids[i], SIGKILL);
+                    waitpid(pids[i], NULL, 0);
+                }
+            }
+            break;
+        }
+        cwist_sleep_ms(50);
+    }
+
+    cwist_free(pids);
+    cwist_free(started_at);
+    err.error.err_i16 = 0;
+    return err;
 }
 
 cwist_error_t cwist_accept_socket(int server_fd, struct sockaddr *sockv4, void (*handler_func)(int client_fd, void *), void *ctx) {
@@ -867,7 +2013,7 @@ cwist_error_t cwist_accept_socket(int server_fd, struct sockaddr *sockv4, void (
   struct sockaddr_in peer_addr;
   socklen_t addrlen = sizeof(peer_addr);
 
-  while(true) { 
+  while(cwist_wait_acceptable(server_fd)) {
     if((client_fd = accept(server_fd, (struct sockaddr *)&peer_addr, &addrlen)) < 0) {
       if (errno == EINTR) continue;
 // ... (error handling)
@@ -886,7 +2032,7 @@ cwist_error_t cwist_accept_socket(int server_fd, struct sockaddr *sockv4, void (
   }
 
   cwist_error_t err = make_error(CWIST_ERR_INT16);
-  err.error.err_i16 = -1;
+  err.error.err_i16 = cwist_http_server_is_draining() ? 0 : -1;
   return err;
 }
 
@@ -897,24 +2043,50 @@ cwist_error_t cwist_http_server_loop(int server_fd, cwist_server_config *config,
         return err;
     }
 
+    // Every model drains on SIGTERM/SIGINT; prefork workers inherit the handler.
+    cwist_install_drain_signals();
+
     if (config->use_forking) {
-        while (true) {
-            int client_fd = accept(server_fd, NULL, NULL);
-            if (client_fd < 0) {
-                int accept_err = errno;
-                if (cwist_accept_error_should_retry(accept_err)) {
-                    cwist_accept_error_backoff(accept_err);
-                    continue;
-                }
-                err.error.err_i16 = -1;
-                return err;
-            }
-            handle_client_forking(client_fd, handler, ctx);
+        return cwist_prefork_master(server_fd, config, handler, ctx);
+    }
+
+    if (config->use_coroutines) {
+        if (cwist_coro_serve(server_fd, config, handler, ctx)) {
+            err.error.err_i16 = cwist_http_server_is_draining() ? 0 : -1;
+            return err;
+        }
+        fprintf(stderr, "[CWIST] coroutines unavailable, falling back to the event loop\n");
+    }
+
+    if (config->use_io_uring && config->on_request) {
+        if (cwist_io_serve_http(server_fd, config, ctx)) {
+            err.error.err_i16 = cwist_http_server_is_draining() ? 0 : -1;
+            return err;
         }
+        fprintf(stderr, "[CWIST] io_uring engine unavailable, falling back to the event loop\n");
+    }
+
+#ifdef __linux__
+    if ((config->use_epoll || config->use_io_uring) && config->on_request) {
+        return cwist_reactor_run(server_fd, config, ctx);
     }
+#endif
 
     if (config->use_threading) {
-        while (true) {
+        cwist_connection_job_ctx *job = (cwist_connection_job_ctx *)cwist_alloc(sizeof(cwist_connection_job_ctx));
+        if (!job) {
+            err.error.err_i16 = -1;
+            return err;
+        }
+        job->handler_func = handler;
+        job->ctx = ctx;
+        cwist_worker_pool *pool = cwist_worker_pool_create(config, cwist_run_connection_job, job);
+        if (!pool) {
+            cwist_free(job);
+            err.error.err_i16 = -1;
+            return err;
+        }
+        while (cwist_wait_acceptable(server_fd)) {
             int client_fd = accept(server_fd, NULL, NULL);
             if (client_fd < 0) {
                 int accept_err = errno;
@@ -922,25 +2094,15 @@ cwist_error_t cwist_http_server_loop(int server_fd, cwist_server_config *config,
                     cwist_accept_error_backoff(accept_err);
                     continue;
                 }
+                /* Workers are detached and may still be serving queued fds. */
                 err.error.err_i16 = -1;
                 return err;
             }
-            pthread_t thread;
-            struct thread_payload *payload = malloc(sizeof(*payload));
-            if (!payload) {
-                close(client_fd);
-                continue;
-            }
-            payload->client_fd = client_fd;
-            payload->handler_func = handler;
-            payload->ctx = ctx;
-            if (pthread_create(&thread, NULL, thread_handler, payload) == 0) {
-                pthread_detach(thread);
-            } else {
-                free(payload);
-                close(client_fd);
-            }
+            cwist_worker_pool_push(pool, (void *)(intptr_t)client_fd);
         }
+        cwist_worker_pool_wait_idle(pool);
+        err.error.err_i16 = 0;
+        return err;
     }
 
 #ifdef __linux__
@@ -959,9 +2121,9 @@ cwist_error_t cwist_http_server_loop(int server_fd, cwist_server_config *config,
             return err;
         }
 
-        while (true) {
+        while (!cwist_http_server_is_draining()) {
             struct epoll_event events[16];
-            int count = epoll_wait(epoll_fd, events, 16, -1);
+            int count = epoll_wait(epoll_fd, events, 16, CWIST_DRAIN_POLL_MS);
             if (count < 0) {
                 if (errno == EINTR) continue;
                 break;
@@ -985,6 +2147,11 @@ cwist_error_t cwist_http_server_loop(int server_fd, cwist_server_config *config,
             }
         }
         close(epoll_fd);
+        if (cwist_http_server_is_draining()) {
+            // Connections are served inline, so none is left in flight.
+            err.error.err_i16 = 0;
+            return err;
+        }
     }
 #endif
 
@@ -1003,9 +2170,10 @@ cwist_error_t cwist_http_server_loop(int server_fd, cwist_server_config *config,
             return err;
         }
 
-        while (true) {
+        struct timespec poll_ts = { .tv_sec = 0, .tv_nsec = CWIST_DRAIN_POLL_MS * 1000000L };
+        while (!cwist_http_server_is_draining()) {
             struct kevent events[16];
-            int count = kevent(kqueue_fd, NULL, 0, events, 16, NULL);
+            int count = kevent(kqueue_fd, NULL, 0, events, 16, &poll_ts);
             if (count < 0) {
                 if (errno == EINTR) continue;
                 break;
@@ -1029,8 +2197,88 @@ cwist_error_t cwist_http_server_loop(int server_fd, cwist_server_config *config,
             }
         }
         close(kqueue_fd);
+        if (cwist_http_server_is_draining()) {
+            err.error.err_i16 = 0;
+            return err;
+        }
     }
 #endif
 
     return cwist_accept_socket(server_fd, NULL, handler, ctx);
 }
+
+typedef struct cwist_shard_payload {
+    int server_fd;
+    size_t index;
+    cwist_server_config config;
+    void (*handler)(int, void *);
+    void *ctx;
+} cwist_shard_payload;
+
+static void *cwist_shard_main(void *arg) {
+    cwist_shard_payload *shard = (cwist_shard_payload *)arg;
+
+#ifdef __linux__
+    if (shard->config.pin_cpus) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus > 0) {
+            // Workers spawned by this loop inherit the mask, keeping the shard on one core.
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET((int)(shard->index % (size_t)cpus), &set);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+                fprintf(stderr, "[CWIST] listener shard %zu: CPU pinning failed\n", shard->index);
+            }
+        }
+    }
+#endif
+
+    cwist_http_server_loop(shard->server_fd, &shard->config, shard->handler, shard->ctx);
+    return NULL;
+}
+
+cwist_error_t cwist_http_server_loop_sharded(const int *server_fds, size_t count, cwist_server_config *config, void (*handler)(int, void *), void *ctx) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    if (!server_fds || count == 0 || !config || !handler) {
+        err.error.err_i16 = -1;
+        return err;
+    }
+
+    // Split the worker budget across shards so N shards do not start N pools of N threads.
+    size_t total_workers = config->worker_threads ? config->worker_threads : cwist_default_worker_count();
+    size_t per_shard = (total_workers + count - 1) / count;
+
+    cwist_shard_payload *shards = (cwist_shard_payload *)cwist_alloc_array(count, sizeof(cwist_shard_payload));
+    pthread_t *threads = (pthread_t *)cwist_alloc_array(count, sizeof(pthread_t));
+    if (!shards || !threads) {
+        cwist_free(shards);
+        cwist_free(threads);
+        err.error.err_i16 = -1;
+        return err;
+    }
+
+    size_t started = 0;
+    for (size_t i = 0; i < count; i++) {
+        shards[i].server_fd = server_fds[i];
+        shards[i].index = i;
+        shards[i].config = *config;
+        shards[i].config.worker_threads = per_shard;
+        shards[i].config.listener_shards = 1;
+        shards[i].handler = handler;
+        shards[i].ctx = ctx;
+        if (pthread_create(&threads[i], NULL, cwist_shard_main, &shards[i]) != 0) {
+            fprintf(stderr, "[CWIST] listener shards: started %zu of %zu\n", i, count);
+            break;
+        }
+        started++;
+    }
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    cwist_free(shards);
+    cwist_free(threads);
+    err.error.err_i16 = started == count ? 0 : -1;
+    return err;
+}
@@ -2,110 +2,374 @@
 #include <cwist/net/http/query.h>
 #include <cwist/core/siphash/siphash.h>
 #include <cwist/core/mem/alloc.h>
+#include <cwist/net/http/scan.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <uriparser/Uri.h>
 
-#define CWIST_QUERY_MAP_DEFAULT_SIZE 16
+#define CWIST_QUERY_HEAP_PAIR  0x1 ///< key (and its original value) share one heap block.
+#define CWIST_QUERY_HEAP_VALUE 0x2 ///< value was replaced by a separate heap block.
+#define CWIST_QUERY_MAX_ENTRIES 0xFFFF
+#define CWIST_QUERY_KEY_SCRATCH 128   ///< Escaped keys up to this size are decoded on the stack.
+
+_Static_assert(sizeof(cwist_query_entry) == 64, "query entries should fill one cache line");
+
+void cwist_query_map_init(cwist_query_map *map) {
+    if (!map) return;
+    memset(map, 0, offsetof(cwist_query_map, first_block));
+    map->slots = map->inline_slots;
+    map->slot_mask = CWIST_QUERY_INLINE_SLOTS - 1;
+    map->inline_blocks[0] = map->first_block;
+    map->blocks = map->inline_blocks;
+    map->block_count = 1;
+    map->block_cap = 1;
+    cwist_process_hash_seed(map->seed);
+}
 
 cwist_query_map *cwist_query_map_create(void) {
     cwist_query_map *map = (cwist_query_map *)cwist_alloc(sizeof(cwist_query_map));
     if (!map) return NULL;
+    cwist_query_map_init(map);
+    return map;
+}
 
-    map->size = CWIST_QUERY_MAP_DEFAULT_SIZE;
-    map->buckets = (cwist_query_bucket **)cwist_alloc_array(map->size, sizeof(cwist_query_bucket *));
-    if (!map->buckets) {
-        cwist_free(map);
-        return NULL;
-    }
+static void *cwist_query_map_alloc(cwist_query_map *map, size_t size) {
+    return map->alloc ? map->alloc(map->alloc_ctx, size) : cwist_alloc(size);
+}
 
-    cwist_generate_hash_seed(map->seed);
-    return map;
+static void cwist_query_map_free_block(cwist_query_map *map, void *ptr) {
+    if (!map->alloc) cwist_free(ptr);
 }
 
-void cwist_query_map_destroy(cwist_query_map *map) {
+static cwist_query_entry *cwist_query_map_entry(cwist_query_map *map, size_t index) {
+    return &map->blocks[index / CWIST_QUERY_BLOCK_ENTRIES][index % CWIST_QUERY_BLOCK_ENTRIES];
+}
+
+static void cwist_query_map_materialize(cwist_query_map *map);
+
+void cwist_query_map_use_arena(cwist_query_map *map, cwist_query_alloc_fn alloc, void *ctx) {
     if (!map) return;
     cwist_query_map_clear(map);
-    cwist_free(map->buckets);
-    cwist_free(map);
+    map->alloc = alloc;
+    map->alloc_ctx = ctx;
 }
 
 void cwist_query_map_clear(cwist_query_map *map) {
     if (!map) return;
-    for (size_t i = 0; i < map->size; i++) {
-        cwist_query_bucket *curr = map->buckets[i];
-        while (curr) {
-            cwist_query_bucket *next = curr->next;
-            cwist_free(curr->key);
-            cwist_free(curr->value);
-            cwist_free(curr);
-            curr = next;
+    map->pending = NULL;
+    map->pending_len = 0;
+
+    if (!map->alloc) {
+        for (size_t i = 0; i < map->count; i++) {
+            cwist_query_entry *entry = cwist_query_map_entry(map, i);
+            if (entry->flags & CWIST_QUERY_HEAP_VALUE) cwist_free((void *)entry->value);
+            if (entry->flags & CWIST_QUERY_HEAP_PAIR) cwist_free((void *)entry->key);
         }
-        map->buckets[i] = NULL;
+        for (size_t b = 1; b < map->block_count; b++) cwist_free(map->blocks[b]);
+        if (map->blocks != map->inline_blocks) cwist_free(map->blocks);
+        if (map->slots != map->inline_slots) cwist_free(map->slots);
     }
+    // Arena memory is reclaimed by its owner; either way, fall back to the embedded storage.
+    map->count = 0;
+    map->slots = map->inline_slots;
+    map->slot_mask = CWIST_QUERY_INLINE_SLOTS - 1;
+    memset(map->inline_slots, 0, sizeof(map->inline_slots));
+    map->blocks = map->inline_blocks;
+    map->block_count = 1;
+    map->block_cap = 1;
 }
 
-void cwist_query_map_set(cwist_query_map *map, const char *key, const char *value) {
-    if (!map || !key || !value) return;
+void cwist_query_map_release(cwist_query_map *map) {
+    cwist_query_map_clear(map);
+}
+
+void cwist_query_map_destroy(cwist_query_map *map) {
+    if (!map) return;
+    cwist_query_map_release(map);
+    cwist_free(map);
+}
 
-    uint64_t hash = siphash24(key, strlen(key), map->seed);
-    size_t index = hash % map->size;
+static uint32_t cwist_query_hash(cwist_query_map *map, const char *key, size_t key_len) {
+    return (uint32_t)siphash13(key, key_len, map->seed);
+}
 
-    cwist_query_bucket *curr = map->buckets[index];
-    while (curr) {
-        if (strcmp(curr->key, key) == 0) {
-            // Update existing
-            cwist_free(curr->value);
-            curr->value = cwist_strdup(value);
-            return;
+/* Returns the entry index of `key`, or SIZE_MAX with *slot_out set to the free slot ending the probe. */
+static size_t cwist_query_map_find(cwist_query_map *map, const char *key, size_t key_len, uint32_t hash, size_t *slot_out) {
+    uint32_t tag = hash >> 16;
+    for (size_t i = hash & map->slot_mask;; i = (i + 1) & map->slot_mask) {
+        uint32_t slot = map->slots[i];
+        if (slot == 0) {
+            if (slot_out) *slot_out = i;
+            return SIZE_MAX;
+        }
+        if ((slot >> 16) == tag) {
+            size_t index = (slot & 0xFFFF) - 1;
+            cwist_query_entry *entry = cwist_query_map_entry(map, index);
+            if (entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) return index;
         }
-        curr = curr->next;
     }
+}
+
+/* Doubles the slot table; entries stay where they are. */
+static bool cwist_query_map_grow_slots(cwist_query_map *map) {
+    size_t capacity = (map->slot_mask + 1) * 2;
+    uint32_t *slots = (uint32_t *)cwist_query_map_alloc(map, capacity * sizeof(uint32_t));
+    if (!slots) return false;
+    memset(slots, 0, capacity * sizeof(uint32_t));
 
-    // Insert new
-    cwist_query_bucket *node = (cwist_query_bucket *)cwist_alloc(sizeof(cwist_query_bucket));
-    if (!node) return;
-    node->key = cwist_strdup(key);
-    node->value = cwist_strdup(value);
-    node->next = map->buckets[index];
-    map->buckets[index] = node;
+    for (size_t index = 0; index < map->count; index++) {
+        uint32_t hash = cwist_query_map_entry(map, index)->hash;
+        size_t i = hash & (capacity - 1);
+        while (slots[i]) i = (i + 1) & (capacity - 1);
+        slots[i] = ((hash >> 16) << 16) | (uint32_t)(index + 1);
+    }
+    if (map->slots != map->inline_slots) cwist_query_map_free_block(map, map->slots);
+    map->slots = slots;
+    map->slot_mask = capacity - 1;
+    return true;
 }
 
-const char *cwist_query_map_get(cwist_query_map *map, const char *key) {
-    if (!map || !key) return NULL;
+/* Makes room for entry number map->count. */
+static bool cwist_query_map_reserve_entry(cwist_query_map *map) {
+    if (map->count < map->block_count * CWIST_QUERY_BLOCK_ENTRIES) return true;
+
+    if (map->block_count == map->block_cap) {
+        size_t cap = map->block_cap * 2;
+        cwist_query_entry **blocks = (cwist_query_entry **)cwist_query_map_alloc(map, cap * sizeof(cwist_query_entry *));
+        if (!blocks) return false;
+        memcpy(blocks, map->blocks, map->block_count * sizeof(cwist_query_entry *));
+        if (map->blocks != map->inline_blocks) cwist_query_map_free_block(map, map->blocks);
+        map->blocks = blocks;
+        map->block_cap = cap;
+    }
+    cwist_query_entry *block = (cwist_query_entry *)cwist_query_map_alloc(map, CWIST_QUERY_BLOCK_ENTRIES * sizeof(cwist_query_entry));
+    if (!block) return false;
+    map->blocks[map->block_count++] = block;
+    return true;
+}
+
+/* --- Percent-decoding --- */
 
-    uint64_t hash = siphash24(key, strlen(key), map->seed);
-    size_t index = hash % map->size;
+static int cwist_query_hex(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool cwist_query_is_escape(const char *src, size_t i, size_t len) {
+    return i + 2 < len && cwist_query_hex(src[i + 1]) >= 0 && cwist_query_hex(src[i + 2]) >= 0;
+}
 
-    cwist_query_bucket *curr = map->buckets[index];
-    while (curr) {
-        if (strcmp(curr->key, key) == 0) {
-            return curr->value;
+/*
+ * Decodes `+` to a space and valid `%XX` escapes; a malformed `%` is kept as is.
+ * Runs without either byte are found with the vectorized scanner and copied whole.
+ * `dest` may be NULL to only measure. Returns the decoded length.
+ */
+static size_t cwist_query_decode(char *dest, const char *src, size_t len) {
+    size_t out = 0;
+    size_t i = 0;
+    while (i < len) {
+        size_t run = cwist_http_scan2(src + i, len - i, '%', '+');
+        if (dest && run) memcpy(dest + out, src + i, run);
+        out += run;
+        i += run;
+        if (i == len) break;
+
+        char c = src[i];
+        if (c == '+') {
+            c = ' ';
+            i++;
+        } else if (cwist_query_is_escape(src, i, len)) {
+            c = (char)((cwist_query_hex(src[i + 1]) << 4) | cwist_query_hex(src[i + 2]));
+            i += 3;
+        } else {
+            i++;
         }
-        curr = curr->next;
+        if (dest) dest[out] = c;
+        out++;
     }
-    return NULL;
+    return out;
 }
 
-void cwist_query_map_parse(cwist_query_map *map, const char *raw_query) {
-    if (!map || !raw_query || strlen(raw_query) == 0) return;
-
-    UriQueryListA *queryList = NULL;
-    int itemCount = 0;
-    
-    // uriparser handles & and = and url decoding
-    if (uriDissectQueryMallocA(&queryList, &itemCount, raw_query, raw_query + strlen(raw_query)) != URI_SUCCESS) {
-        return;
+/* Copies `src_len` raw bytes into `dest`, decoding them when asked, and NUL-terminates. */
+static void cwist_query_copy(char *dest, const char *src, size_t src_len, size_t out_len, bool decode) {
+    if (decode) {
+        cwist_query_decode(dest, src, src_len);
+    } else {
+        memcpy(dest, src, src_len);
     }
+    dest[out_len] = '\0';
+}
+
+/* Stores a new value for `entry`, inline next to its key when it fits. */
+static bool cwist_query_entry_set_value(cwist_query_map *map, cwist_query_entry *entry,
+                                        const char *value, size_t src_len, size_t value_len, bool decode) {
+    char *dest;
+    bool in_entry = entry->key == entry->inline_data &&
+                    entry->key_len + 1 + value_len + 1 <= CWIST_QUERY_INLINE_BYTES;
+    if (in_entry) {
+        dest = entry->inline_data + entry->key_len + 1;
+    } else {
+        dest = (char *)cwist_query_map_alloc(map, value_len + 1);
+        if (!dest) return false;
+    }
+    cwist_query_copy(dest, value, src_len, value_len, decode);
+
+    if (entry->flags & CWIST_QUERY_HEAP_VALUE) cwist_free((void *)entry->value);
+    entry->flags &= (uint8_t)~CWIST_QUERY_HEAP_VALUE;
+    if (!in_entry && !map->alloc) entry->flags |= CWIST_QUERY_HEAP_VALUE;
+    entry->value = dest;
+    entry->value_len = (uint32_t)value_len;
+    return true;
+}
+
+/*
+ * Inserts or overwrites `key`. The value is read from `src_len` bytes of `value`
+ * and, when `decode` is set, percent-decoded straight into its final storage
+ * (`value_len` is the decoded length).
+ */
+static bool cwist_query_map_store(cwist_query_map *map, const char *key, size_t key_len,
+                                  const char *value, size_t src_len, size_t value_len, bool decode) {
+    if (key_len > UINT16_MAX || value_len > UINT32_MAX - 1) return false;
+
+    uint32_t hash = cwist_query_hash(map, key, key_len);
+    size_t slot = 0;
+    size_t index = cwist_query_map_find(map, key, key_len, hash, &slot);
+    if (index != SIZE_MAX) {
+        return cwist_query_entry_set_value(map, cwist_query_map_entry(map, index), value, src_len, value_len, decode);
+    }
+
+    if (map->count >= CWIST_QUERY_MAX_ENTRIES) return false;
+    // Keep the load at or below one half so probes stay short.
+    if ((map->count + 1) * 2 > map->slot_mask + 1) {
+        if (!cwist_query_map_grow_slots(map)) return false;
+        cwist_query_map_find(map, key, key_len, hash, &slot);
+    }
+    if (!cwist_query_map_reserve_entry(map)) return false;
+
+    cwist_query_entry *entry = cwist_query_map_entry(map, map->count);
+    char *pair;
+    entry->flags = 0;
+    if (key_len + 1 + value_len + 1 <= CWIST_QUERY_INLINE_BYTES) {
+        pair = entry->inline_data;
+    } else {
+        pair = (char *)cwist_query_map_alloc(map, key_len + 1 + value_len + 1);
+        if (!pair) return false;
+        if (!map->alloc) entry->flags = CWIST_QUERY_HEAP_PAIR;
+    }
+    memcpy(pair, key, key_len);
+    pair[key_len] = '\0';
+    cwist_query_copy(pair + key_len + 1, value, src_len, value_len, decode);
+
+    entry->key = pair;
+    entry->value = pair + key_len + 1;
+    entry->hash = hash;
+    entry->key_len = (uint16_t)key_len;
+    entry->value_len = (uint32_t)value_len;
+    map->slots[slot] = ((hash >> 16) << 16) | (uint32_t)(map->count + 1);
+    map->count++;
+    return true;
+}
+
+bool cwist_query_map_set_len(cwist_query_map *map, const char *key, size_t key_len, const char *value, size_t value_len) {
+    if (!map || !key || !value) return false;
+    cwist_query_map_materialize(map);
+    return cwist_query_map_store(map, key, key_len, value, value_len, value_len, false);
+}
+
+/* Adds one raw `key=value` pair. Keys are short, so an escaped key is decoded on the stack. */
+static bool cwist_query_map_store_encoded(cwist_query_map *map, const char *key, size_t key_len,
+                                          const char *value, size_t value_len) {
+    char scratch[CWIST_QUERY_KEY_SCRATCH];
+    char *decoded_key = NULL;
+    if (cwist_http_scan2(key, key_len, '%', '+') < key_len) {
+        decoded_key = key_len <= sizeof(scratch) ? scratch : (char *)cwist_alloc(key_len);
+        if (!decoded_key) return false;
+        key_len = cwist_query_decode(decoded_key, key, key_len);
+    }
+
+    size_t decoded_len = value_len;
+    bool decode = cwist_http_scan2(value, value_len, '%', '+') < value_len;
+    if (decode) decoded_len = cwist_query_decode(NULL, value, value_len);
+
+    bool ok = cwist_query_map_store(map, decoded_key ? decoded_key : key, key_len,
+                                    value, value_len, decoded_len, decode);
+    if (decoded_key && decoded_key != scratch) cwist_free(decoded_key);
+    return ok;
+}
 
-    UriQueryListA *curr = queryList;
-    while (curr) {
-        if (curr->key) {
-            cwist_query_map_set(map, curr->key, curr->value ? curr->value : "");
+/*
+ * Single pass over a raw query: split on `&` and the first `=`, then decode each
+ * pair directly into the map. Empty segments are skipped; a key without `=` gets "".
+ */
+static void cwist_query_map_parse_raw(cwist_query_map *map, const char *raw, size_t len) {
+    const char *p = raw;
+    const char *end = raw + len;
+    while (p < end) {
+        const char *amp = memchr(p, '&', (size_t)(end - p));
+        if (!amp) amp = end;
+        if (amp > p) {
+            const char *eq = memchr(p, '=', (size_t)(amp - p));
+            const char *key_end = eq ? eq : amp;
+            const char *value = eq ? eq + 1 : amp;
+            cwist_query_map_store_encoded(map, p, (size_t)(key_end - p), value, (size_t)(amp - value));
         }
-        curr = curr->next;
+        p = amp + 1;
     }
+}
+
+/* Runs a deferred parse before the map is used. */
+static void cwist_query_map_materialize(cwist_query_map *map) {
+    if (!map->pending) return;
+    const char *raw = map->pending;
+    size_t len = map->pending_len;
+    map->pending = NULL;
+    map->pending_len = 0;
+    cwist_query_map_parse_raw(map, raw, len);
+}
+
+void cwist_query_map_set(cwist_query_map *map, const char *key, const char *value) {
+    if (!map || !key || !value) return;
+    cwist_query_map_set_len(map, key, strlen(key), value, strlen(value));
+}
+
+const char *cwist_query_map_get(cwist_query_map *map, const char *key) {
+    if (!map || !key) return NULL;
+    cwist_query_map_materialize(map);
+    if (map->count == 0) return NULL;
+
+    size_t key_len = strlen(key);
+    size_t index = cwist_query_map_find(map, key, key_len, cwist_query_hash(map, key, key_len), NULL);
+    return index == SIZE_MAX ? NULL : cwist_query_map_entry(map, index)->value;
+}
+
+size_t cwist_query_map_count(cwist_query_map *map) {
+    if (!map) return 0;
+    cwist_query_map_materialize(map);
+    return map->count;
+}
+
+bool cwist_query_map_at(cwist_query_map *map, size_t index, const char **key, const char **value) {
+    if (!map) return false;
+    cwist_query_map_materialize(map);
+    if (index >= map->count) return false;
+    cwist_query_entry *entry = cwist_query_map_entry(map, index);
+    if (key) *key = entry->key;
+    if (value) *value = entry->value;
+    return true;
+}
+
+void cwist_query_map_parse(cwist_query_map *map, const char *raw_query) {
+    if (!map || !raw_query || raw_query[0] == '\0') return;
+    cwist_query_map_parse_deferred(map, raw_query, strlen(raw_query));
+    cwist_query_map_materialize(map);
+}
 
-    uriFreeQueryListA(queryList);
+void cwist_query_map_parse_deferred(cwist_query_map *map, const char *raw_query, size_t len) {
+    if (!map || !raw_query || len == 0) return;
+    // A second deferred query must not drop the first one.
+    cwist_query_map_materialize(map);
+    map->pending = raw_query;
+    map->pending_len = len;
 }
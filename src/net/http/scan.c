@@ -0,0 +1,108 @@
+#include <cwist/net/http/scan.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define CWIST_HTTP_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+typedef size_t (*cwist_http_scan2_fn)(const char *p, size_t len, char a, char b);
+
+static size_t cwist_http_scan2_scalar(const char *p, size_t len, char a, char b) {
+    if (a == b) {
+        const char *hit = memchr(p, a, len);
+        return hit ? (size_t)(hit - p) : len;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] == a || p[i] == b) return i;
+    }
+    return len;
+}
+
+#ifdef CWIST_HTTP_SCAN_X86
+
+static size_t cwist_http_scan2_sse2(const char *p, size_t len, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+        if (mask) return i + (size_t)__builtin_ctz((unsigned)mask);
+    }
+    return i + cwist_http_scan2_scalar(p + i, len - i, a, b);
+}
+
+__attribute__((target("avx2")))
+static size_t cwist_http_scan2_avx2(const char *p, size_t len, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    size_t i = 0;
+    unsigned mask = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        mask = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+        if (mask) break;
+    }
+    // Clear the upper lanes before returning to SSE code; otherwise every
+    // legacy SSE instruction afterwards pays a state transition penalty.
+    _mm256_zeroupper();
+    if (mask) return i + (size_t)__builtin_ctz(mask);
+    return i + cwist_http_scan2_sse2(p + i, len - i, a, b);
+}
+
+#endif
+
+static cwist_http_scan2_fn g_scan2 = cwist_http_scan2_scalar;
+static const char *g_scan_name = "scalar";
+static pthread_once_t g_scan_once = PTHREAD_ONCE_INIT;
+
+static void cwist_http_scan_resolve(void) {
+#ifdef CWIST_HTTP_SCAN_X86
+    const char *cap = getenv("CWIST_HTTP_SCAN");
+    if (cap && strcmp(cap, "scalar") == 0) return;
+
+    g_scan2 = cwist_http_scan2_sse2;
+    g_scan_name = "sse2";
+    if (cap && strcmp(cap, "sse2") == 0) return;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        g_scan2 = cwist_http_scan2_avx2;
+        g_scan_name = "avx2";
+    }
+#endif
+}
+
+size_t cwist_http_scan2(const char *p, size_t len, char a, char b) {
+    if (a == b) return cwist_http_scan2_scalar(p, len, a, b);
+    pthread_once(&g_scan_once, cwist_http_scan_resolve);
+    return g_scan2(p, len, a, b);
+}
+
+const char *cwist_http_scan_impl(void) {
+    pthread_once(&g_scan_once, cwist_http_scan_resolve);
+    return g_scan_name;
+}
+
+const char *cwist_http_scan_header_end(const char *buf, size_t len, size_t *scanned) {
+    // Only line feeds can complete the terminator, so jump from LF to LF and
+    // look back three bytes; that also catches a CRLF CRLF split across reads.
+    // A single-byte search is memchr's job, which libc already vectorizes.
+    size_t pos = scanned ? *scanned : 0;
+    while (pos < len) {
+        const char *hit = memchr(buf + pos, '\n', len - pos);
+        if (!hit) break;
+        size_t nl = (size_t)(hit - buf);
+        if (nl >= 3 && buf[nl - 1] == '\r' && buf[nl - 2] == '\n' && buf[nl - 3] == '\r') {
+            // Park on the terminator so a repeated call finds it right away.
+            if (scanned) *scanned = nl - 3;
+            return buf + nl - 3;
+        }
+        pos = nl + 1;
+    }
+    if (scanned) *scanned = len;
+    return NULL;
+}
@@ -2,6 +2,7 @@
 #include <cwist/net/websocket/websocket.h>
 #include <cwist/net/http/http.h>
 #include <cwist/core/mem/alloc.h>
+#include <cwist/sys/coro/coro.h>
 #include "ws_utils.h"
 
 #include <stdio.h>
@@ -10,6 +11,8 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 
 #define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
 
@@ -51,6 +54,13 @@ cwist_websocket *cwist_websocket_upgrade(cwist_http_request *req, int client_fd)
 
     if (err.error.err_i16 != 0) return NULL;
 
+    // Frames are read with blocking recv(); the reactor hands sockets over non-blocking.
+    // Coroutines keep O_NONBLOCK and park in cwist_coro_poll() instead.
+    int flags = fcntl(client_fd, F_GETFL, 0);
+    if (!cwist_coro_active() && flags >= 0 && (flags & O_NONBLOCK)) {
+        fcntl(client_fd, F_SETFL, flags & ~O_NONBLOCK);
+    }
+
     req->upgraded = true;
 
     cwist_websocket *ws = (cwist_websocket *)cwist_alloc(sizeof(cwist_websocket));
@@ -63,6 +73,10 @@ static ssize_t read_exact(int fd, void *buf, size_t len) {
     size_t total = 0;
     while (total < len) {
         ssize_t n = recv(fd, (uint8_t *)buf + total, len - total, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            if (cwist_coro_poll(fd, POLLIN, -1) < 0) return -1;
+            continue;
+        }
         if (n <= 0) return -1;
         total += n;
     }
@@ -162,10 +176,11 @@ int cwist_websocket_send(cwist_websocket *ws, cwist_ws_opcode_t opcode, const ui
 
     // Server does not mask frames
 
-    if (send(ws->fd, head, head_len, 0) < 0) return -1;
-    if (len > 0) {
-        if (send(ws->fd, data, len, 0) < 0) return -1;
-    }
+    struct iovec iov[2] = {
+        { .iov_base = head, .iov_len = head_len },
+        { .iov_base = (void *)data, .iov_len = len }
+    };
+    if (cwist_http_send_iov(ws->fd, iov, len > 0 ? 2 : 1).error.err_i16 < 0) return -1;
 
     return 0;
 }
@@ -1,6 +1,8 @@
 #define _POSIX_C_SOURCE 200809L
 #define _DEFAULT_SOURCE
 #include <cwist/sys/app/app.h>
+#include <cwist/sys/app/router.h>
+#include <cwist/core/phash/phash.h>
 #include <cwist/net/http/http.h>
 #include <cwist/net/http/https.h>
 #include <cwist/core/sstring/sstring.h>
@@ -18,9 +20,9 @@
 #include <time.h>
 #include <pthread.h>
 #include <ttak/mem/mem.h>
+#include <cwist/core/mem/epoch.h>
 #include <ttak/timing/timing.h>
 
-#define CWIST_ROUTE_BUCKETS 127
 #define CWIST_STATIC_RETIRE_NS TT_SECOND(5)
 
 static inline uint64_t cwist_mem_now(void) {
@@ -186,197 +188,55 @@ static bool cwist_mem_refresh_file(cwist_fix_server_mem *mem, cwist_file_t *entr
 }
 
 
-typedef struct cwist_route_entry {
-    char *path;
-    bool has_params;
-    cwist_http_method_t method;
-    cwist_handler_func handler;
-    cwist_ws_handler_func ws_handler;
-    struct cwist_route_entry *next;
-} cwist_route_entry;
-
-struct cwist_route_table {
-    size_t bucket_count;
-    cwist_route_entry **buckets;
-    cwist_route_entry *param_routes;
-};
-
 struct cwist_static_dir {
     char *url_prefix;
+    size_t prefix_len;
     char *fs_root;
+    size_t rank;     ///< Position in static_dirs when frozen; lower wins.
+    const cwist_middleware_chain *middleware;
     struct cwist_static_dir *next;
 };
 
+/*
+ * Immutable snapshot of the static mounts, published at listen time and
+ * replaced wholesale when mounts change while serving. It owns copies of the
+ * mounts, so readers never touch app->static_dirs. A perfect hash maps each
+ * prefix to its mount; a request path is probed once per distinct prefix
+ * length at which it has a segment boundary.
+ */
+struct cwist_static_index {
+    cwist_phash *prefixes;
+    size_t *lengths;
+    size_t length_count;
+    cwist_static_dir *mounts;
+    size_t mount_count;
+};
+
 typedef struct {
-    cwist_middleware_node *current_mw_node;
+    const cwist_middleware_chain *chain;
+    size_t next_mw;
     cwist_handler_func final_handler;
     void *handler_data;
 } mw_executor_ctx;
 
 typedef struct {
-    cwist_static_dir *mapping;
+    const char *fs_root;       ///< Request-arena copy; the mount itself may be retired mid-request.
     const char *relative_ptr;
     bool use_index;
+    const cwist_middleware_chain *middleware;
 } cwist_static_request_info;
 
-static cwist_route_table *cwist_route_table_create(void);
-static void cwist_route_table_destroy(cwist_route_table *table);
-static void cwist_route_table_insert(cwist_route_table *table, const char *path, cwist_http_method_t method, cwist_handler_func handler, cwist_ws_handler_func ws_handler);
-static cwist_route_entry *cwist_route_table_lookup(cwist_route_table *table, cwist_http_method_t method, const char *path);
-static cwist_route_entry *cwist_route_table_match_params(cwist_route_table *table, cwist_http_request *req);
-static bool match_path(const char *pattern, const char *actual, cwist_query_map *params);
-static void execute_chain(cwist_app *app, cwist_http_request *req, cwist_http_response *res, cwist_handler_func final_handler, void *handler_data);
+static void execute_chain(const cwist_middleware_chain *chain, cwist_http_request *req, cwist_http_response *res,
+                          cwist_handler_func final_handler, void *handler_data);
 static bool cwist_prepare_static(cwist_app *app, cwist_http_request *req, cwist_static_request_info *info);
 static void cwist_static_handler(cwist_http_request *req, cwist_http_response *res);
-
-static bool route_has_params(const char *path) {
-    if (!path) return false;
-    return strchr(path, ':') != NULL;
-}
-
-static size_t cwist_route_hash(cwist_http_method_t method, const char *path, size_t bucket_count) {
-    const unsigned long long FNV_OFFSET = 1469598103934665603ULL;
-    const unsigned long long FNV_PRIME = 1099511628211ULL;
-    unsigned long long hash = FNV_OFFSET ^ (unsigned long long)method;
-    const unsigned char *ptr = (const unsigned char *)path;
-    while (ptr && *ptr) {
-        hash ^= (unsigned long long)(*ptr++);
-        hash *= FNV_PRIME;
-    }
-    return (size_t)(hash % bucket_count);
-}
-
-static cwist_route_entry *cwist_route_entry_create(const char *path, cwist_http_method_t method, cwist_handler_func handler, cwist_ws_handler_func ws_handler) {
-    cwist_route_entry *entry = (cwist_route_entry *)cwist_alloc(sizeof(cwist_route_entry));
-    if (!entry) return NULL;
-    entry->path = cwist_strdup(path ? path : "/");
-    entry->method = method;
-    entry->handler = handler;
-    entry->ws_handler = ws_handler;
-    entry->has_params = route_has_params(entry->path);
-    entry->next = NULL;
-    return entry;
-}
-
-static void cwist_route_entry_free(cwist_route_entry *entry) {
-    if (!entry) return;
-    cwist_free(entry->path);
-    cwist_free(entry);
-}
-
-static cwist_route_table *cwist_route_table_create(void) {
-    cwist_route_table *table = (cwist_route_table *)cwist_alloc(sizeof(cwist_route_table));
-    if (!table) return NULL;
-    table->bucket_count = CWIST_ROUTE_BUCKETS;
-    table->buckets = (cwist_route_entry **)cwist_alloc_array(table->bucket_count, sizeof(cwist_route_entry *));
-    if (!table->buckets) {
-        cwist_free(table);
-        return NULL;
-    }
-    table->param_routes = NULL;
-    return table;
-}
-
-static void cwist_route_table_destroy(cwist_route_table *table) {
-    if (!table) return;
-    for (size_t i = 0; i < table->bucket_count; i++) {
-        cwist_route_entry *curr = table->buckets[i];
-        while (curr) {
-            cwist_route_entry *next = curr->next;
-            cwist_route_entry_free(curr);
-            curr = next;
-        }
-    }
-    cwist_free(table->buckets);
-
-    cwist_route_entry *param = table->param_routes;
-    while (param) {
-        cwist_route_entry *next = param->next;
-        cwist_route_entry_free(param);
-        param = next;
-    }
-    cwist_free(table);
-}
-
-static void cwist_route_table_insert(cwist_route_table *table, const char *path, cwist_http_method_t method, cwist_handler_func handler, cwist_ws_handler_func ws_handler) {
-    if (!table || !path) return;
-    cwist_route_entry *entry = cwist_route_entry_create(path, method, handler, ws_handler);
-    if (!entry) return;
-
-    if (entry->has_params) {
-        entry->next = table->param_routes;
-        table->param_routes = entry;
-        return;
-    }
-
-    size_t idx = cwist_route_hash(method, entry->path, table->bucket_count);
-    cwist_route_entry **bucket = &table->buckets[idx];
-    cwist_route_entry *curr = *bucket;
-    while (curr) {
-        if (!curr->has_params && curr->method == method && strcmp(curr->path, entry->path) == 0) {
-            curr->handler = handler;
-            curr->ws_handler = ws_handler;
-            cwist_route_entry_free(entry);
-            return;
-        }
-        curr = curr->next;
-    }
-
-    entry->next = *bucket;
-    *bucket = entry;
-}
-
-static cwist_route_entry *cwist_route_table_lookup(cwist_route_table *table, cwist_http_method_t method, const char *path) {
-    if (!table || !path) return NULL;
-    size_t idx = cwist_route_hash(method, path, table->bucket_count);
-    cwist_route_entry *curr = table->buckets[idx];
-    
-    // Tiny string optimization: if length <= 8, cast to uint64 and compare in one shot
-    // Note: We need to handle potential access beyond string end safely.
-    // However, simplest heuristic is checking length first.
-    // Actually, we can just check length.
-    
-    size_t path_len = strlen(path);
-    uint64_t path_u64 = 0;
-    bool use_fast_path = (path_len <= 8);
-    if (use_fast_path) {
-        memcpy(&path_u64, path, path_len); // Safe copy
-    }
-
-    while (curr) {
-        if (curr->method == method) {
-            if (use_fast_path) {
-                 // Fast path check
-                 size_t curr_len = strlen(curr->path);
-                 if (curr_len == path_len) {
-                     uint64_t curr_u64 = 0;
-                     memcpy(&curr_u64, curr->path, curr_len);
-                     if (path_u64 == curr_u64) return curr;
-                 }
-            } else {
-                if (strcmp(curr->path, path) == 0) {
-                    return curr;
-                }
-            }
-        }
-        curr = curr->next;
-    }
-    return NULL;
-}
-
-static cwist_route_entry *cwist_route_table_match_params(cwist_route_table *table, cwist_http_request *req) {
-    if (!table || !req || !req->path || !req->path->data) return NULL;
-    cwist_route_entry *curr = table->param_routes;
-    while (curr) {
-        if (curr->method == req->method) {
-            if (match_path(curr->path, req->path->data, req->path_params)) {
-                return curr;
-            }
-        }
-        curr = curr->next;
-    }
-    return NULL;
-}
+static bool static_http_request_handler(int client_fd, cwist_http_request *req, void *ctx);
+static cwist_file_t *cwist_mem_get_file(cwist_fix_server_mem *mem, const char *fs_path);
+static void cwist_app_start_watcher(cwist_app *app);
+typedef struct cwist_bdr_jobs cwist_bdr_jobs;
+static cwist_bdr_jobs *cwist_bdr_jobs_create(void);
+static void cwist_app_bdr_jobs_stop(cwist_app *app);
+static void cwist_bdr_jobs_destroy(cwist_bdr_jobs *jobs);
 
 static bool cwist_path_has_parent_ref(const char *path) {
     if (!path) return false;
@@ -429,27 +289,168 @@ static bool cwist_static_match_entry(const cwist_static_dir *entry, const char *
     return true;
 }
 
+/* Among matching mounts the most recently added wins, as in the list walk. */
+static const cwist_static_dir *cwist_static_index_match(const cwist_static_index *index, const char *path, size_t path_len) {
+    const cwist_static_dir *best = NULL;
+    for (size_t i = 0; i < index->length_count; i++) {
+        size_t len = index->lengths[i];
+        if (len > path_len) continue;
+        if (len > 1 && len < path_len && path[len] != '/') continue;
+        const cwist_static_dir *entry = (const cwist_static_dir *)cwist_phash_get(index->prefixes, 0, path, len);
+        if (entry && (!best || entry->rank < best->rank)) best = entry;
+    }
+    return best;
+}
+
 static bool cwist_prepare_static(cwist_app *app, cwist_http_request *req, cwist_static_request_info *info) {
     if (!app || !req || !req->path || !req->path->data) return false;
-    if (!app->static_dirs) return false;
     if (req->method != CWIST_HTTP_GET && req->method != CWIST_HTTP_HEAD) return false;
 
-    cwist_static_dir *entry = app->static_dirs;
     const char *path = req->path->data;
-    while (entry) {
-        bool use_index = false;
-        const char *relative = NULL;
-        if (cwist_static_match_entry(entry, path, &relative, &use_index)) {
-            if (info) {
-                info->mapping = entry;
-                info->relative_ptr = relative;
-                info->use_index = use_index;
-            }
-            return true;
+    bool use_index = false;
+    const char *relative = NULL;
+    const char *fs_root = NULL;
+    const cwist_middleware_chain *middleware = NULL;
+
+    if (__atomic_load_n(&app->routes_live, __ATOMIC_ACQUIRE)) {
+        cwist_epoch_pin();
+        const cwist_static_index *index = __atomic_load_n(&app->static_index, __ATOMIC_ACQUIRE);
+        const cwist_static_dir *entry = index ? cwist_static_index_match(index, path, req->path->size) : NULL;
+        if (entry && cwist_static_match_entry(entry, path, &relative, &use_index)) {
+            fs_root = cwist_http_request_strdup(req, entry->fs_root);
+            middleware = entry->middleware;
+        }
+        cwist_epoch_unpin();
+    } else {
+        const cwist_static_dir *entry = app->static_dirs;
+        while (entry && !cwist_static_match_entry(entry, path, &relative, &use_index)) {
+            entry = entry->next;
+        }
+        if (entry) {
+            fs_root = entry->fs_root;
+            middleware = entry->middleware;
         }
-        entry = entry->next;
     }
-    return false;
+    if (!fs_root) return false;
+
+    if (info) {
+        info->fs_root = fs_root;
+        info->relative_ptr = relative;
+        info->use_index = use_index;
+        info->middleware = middleware;
+    }
+    return true;
+}
+
+static void cwist_static_index_destroy(cwist_static_index *index) {
+    if (!index) return;
+    cwist_phash_destroy(index->prefixes);
+    cwist_free(index->lengths);
+    for (size_t i = 0; i < index->mount_count; i++) {
+        cwist_free(index->mounts[i].url_prefix);
+        cwist_free(index->mounts[i].fs_root);
+    }
+    cwist_free(index->mounts);
+    cwist_free(index);
+}
+
+static void cwist_static_index_retire(void *index) {
+    cwist_static_index_destroy((cwist_static_index *)index);
+}
+
+static int cwist_size_desc_cmp(const void *a, const void *b) {
+    size_t x = *(const size_t *)a;
+    size_t y = *(const size_t *)b;
+    return (x < y) - (x > y);
+}
+
+/* Snapshots the mount list; NULL when there are no mounts or on allocation failure. */
+static cwist_static_index *cwist_static_index_build(const cwist_static_dir *dirs) {
+    size_t count = 0;
+    for (const cwist_static_dir *curr = dirs; curr; curr = curr->next) count++;
+    if (count == 0) return NULL;
+
+    cwist_static_index *index = (cwist_static_index *)cwist_alloc(sizeof(cwist_static_index));
+    cwist_phash_key *keys = (cwist_phash_key *)cwist_alloc_array(count, sizeof(cwist_phash_key));
+    if (index) {
+        index->lengths = (size_t *)cwist_alloc_array(count, sizeof(size_t));
+        index->mounts = (cwist_static_dir *)cwist_alloc_array(count, sizeof(cwist_static_dir));
+    }
+    if (!index || !keys || !index->lengths || !index->mounts) goto fail;
+
+    size_t rank = 0;
+    for (const cwist_static_dir *curr = dirs; curr; curr = curr->next, rank++) {
+        // A mount re-added under the same prefix is shadowed by the newer one.
+        bool shadowed = false;
+        for (size_t i = 0; i < index->mount_count && !shadowed; i++) {
+            shadowed = keys[i].len == curr->prefix_len && memcmp(keys[i].key, curr->url_prefix, curr->prefix_len) == 0;
+        }
+        if (shadowed) continue;
+
+        cwist_static_dir *mount = &index->mounts[index->mount_count];
+        mount->url_prefix = cwist_strdup(curr->url_prefix);
+        mount->fs_root = cwist_strdup(curr->fs_root);
+        mount->prefix_len = curr->prefix_len;
+        mount->rank = rank;
+        mount->middleware = curr->middleware;
+        index->mount_count++;
+        if (!mount->url_prefix || !mount->fs_root) goto fail;
+        keys[index->mount_count - 1] = (cwist_phash_key){ mount->url_prefix, mount->prefix_len, 0, mount };
+
+        bool known = false;
+        for (size_t i = 0; i < index->length_count && !known; i++) known = index->lengths[i] == curr->prefix_len;
+        if (!known) index->lengths[index->length_count++] = curr->prefix_len;
+    }
+    qsort(index->lengths, index->length_count, sizeof(size_t), cwist_size_desc_cmp);
+    index->prefixes = cwist_phash_build(keys, index->mount_count);
+    if (!index->prefixes) goto fail;
+    cwist_free(keys);
+    return index;
+
+fail:
+    cwist_free(keys);
+    cwist_static_index_destroy(index);
+    return NULL;
+}
+
+static void cwist_route_table_retire(void *table) {
+    cwist_route_table_destroy((cwist_route_table *)table);
+}
+
+/*
+ * Registration is over once the app listens: compile exact routes and static
+ * mounts into perfect hashes, and switch later changes to copy-on-write.
+ */
+static void cwist_app_freeze(cwist_app *app) {
+    pthread_mutex_lock(&app->route_lock);
+    if (!__atomic_load_n(&app->routes_live, __ATOMIC_RELAXED)) {
+        if (!cwist_route_table_freeze(app->router)) {
+            fprintf(stderr, "[CWIST] Could not freeze the route table; using hashed buckets.\n");
+        }
+        app->static_index = cwist_static_index_build(app->static_dirs);
+        if (app->static_dirs && !app->static_index) {
+            fprintf(stderr, "[CWIST] Could not index static mounts.\n");
+        }
+        __atomic_store_n(&app->routes_live, true, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&app->route_lock);
+}
+
+/*
+ * Publishes a new router version. Readers that loaded the old pointer keep
+ * using it inside their epoch; it is freed once none can still see it.
+ * Called with route_lock held.
+ */
+static void cwist_app_publish_router(cwist_app *app, cwist_route_table *next) {
+    cwist_route_table_freeze(next);
+    cwist_route_table *prev = __atomic_exchange_n(&app->router, next, __ATOMIC_ACQ_REL);
+    cwist_epoch_retire(prev, cwist_route_table_retire);
+}
+
+/* Same as cwist_app_publish_router for the static mount snapshot. */
+static void cwist_app_publish_static(cwist_app *app, cwist_static_index *next) {
+    cwist_static_index *prev = __atomic_exchange_n(&app->static_index, next, __ATOMIC_ACQ_REL);
+    cwist_epoch_retire(prev, cwist_static_index_retire);
 }
 
 static void cwist_scan_recursive(const char *fs_root, size_t *total_size, cwist_fix_server_mem *mem, bool dry_run) {
@@ -471,7 +472,7 @@ static void cwist_scan_recursive(const char *fs_root, size_t *total_size, cwist_
         } else if (S_ISREG(st.st_mode)) {
             if (dry_run) {
                 if (total_size) *total_size += st.st_size;
-            } else if (mem) {
+            } else if (mem && !cwist_mem_get_file(mem, full_path)) {
                 if (!cwist_mem_register_file(mem, full_path, &st)) {
                     fprintf(stderr, "[StaticMem] Failed to load %s\n", full_path);
                 }
@@ -606,7 +607,7 @@ static void cwist_static_release_body(const void *ptr, size_t len, void *ctx) {
 static void cwist_static_handler(cwist_http_request *req, cwist_http_response *res) {
     mw_executor_ctx *ctx = (mw_executor_ctx *)req->private_data;
     cwist_static_request_info *info = ctx ? (cwist_static_request_info *)ctx->handler_data : NULL;
-    if (!info || !info->mapping) {
+    if (!info || !info->fs_root) {
         res->status_code = CWIST_HTTP_INTERNAL_ERROR;
         cwist_sstring_assign(res->body, "Static handler misconfigured");
         return;
@@ -627,7 +628,7 @@ static void cwist_static_handler(cwist_http_request *req, cwist_http_response *r
     }
 
     char fs_path[PATH_MAX];
-    int written = snprintf(fs_path, sizeof(fs_path), "%s/%s", info->mapping->fs_root, relative_buf);
+    int written = snprintf(fs_path, sizeof(fs_path), "%s/%s", info->fs_root, relative_buf);
     if (written < 0 || written >= (int)sizeof(fs_path)) {
         res->status_code = CWIST_HTTP_BAD_REQUEST;
         cwist_sstring_assign(res->body, "Static path too long");
@@ -707,31 +708,166 @@ cwist_app *cwist_app_create(void) {
     app->ssl_ctx = NULL;
     app->error_handler = NULL;
     app->static_dirs = NULL;
+    app->static_index = NULL;
+    pthread_mutex_init(&app->route_lock, NULL);
+    app->routes_live = false;
     app->db = NULL;
     app->db_path = NULL;
     app->nuke_enabled = false;
     app->max_mem_space = 0;
     app->mem_manager = NULL;
     app->bdr_ctx = cwist_bdr_create();
+    app->bdr_jobs = app->bdr_ctx ? cwist_bdr_jobs_create() : NULL;
+    app->server_config.use_forking = false;
+    app->server_config.use_threading = true;
+#ifdef __linux__
+    app->server_config.use_epoll = true;
+#else
+    app->server_config.use_epoll = false;
+#endif
+    app->server_config.worker_threads = 0;
+    app->server_config.queue_capacity = 0;
+    app->server_config.on_request = static_http_request_handler;
+    app->server_config.use_io_uring = false;
+    app->server_config.listen_backlog = 0;
+    app->server_config.listener_shards = 1;
+    app->server_config.pin_cpus = false;
+    app->server_config.worker_processes = 0;
+    app->server_config.on_worker_start = NULL;
+    app->server_config.on_worker_exit = NULL;
+    app->server_config.use_coroutines = false;
+    app->server_config.coroutine_stack_size = 0;
     
     return app;
 }
 
-void cwist_app_use(cwist_app *app, cwist_middleware_func mw) {
-    if (!app || !mw) return;
-    cwist_middleware_node *node = cwist_alloc(sizeof(cwist_middleware_node));
-    node->func = mw;
-    node->next = NULL;
+static bool cwist_middleware_covers(const cwist_middleware_node *node, const char *path) {
+    if (!node->prefix || node->prefix_len == 1) return true;
+    if (strncmp(path, node->prefix, node->prefix_len) != 0) return false;
+    return path[node->prefix_len] == '\0' || path[node->prefix_len] == '/';
+}
+
+/*
+ * Flattens the middleware that applies to `path` into *out (NULL when none
+ * does). Chains are interned, so routes with the same middleware share one.
+ * Called with route_lock held.
+ */
+static bool cwist_app_resolve_chain(cwist_app *app, const char *path, const cwist_middleware_chain **out) {
+    size_t count = 0;
+    for (const cwist_middleware_node *node = app->middlewares; node; node = node->next) {
+        if (cwist_middleware_covers(node, path)) count++;
+    }
+    *out = NULL;
+    if (count == 0) return true;
+
+    cwist_middleware_chain *chain = (cwist_middleware_chain *)cwist_alloc(
+        sizeof(cwist_middleware_chain) + count * sizeof(cwist_middleware_func));
+    if (!chain) return false;
+    for (const cwist_middleware_node *node = app->middlewares; node; node = node->next) {
+        if (cwist_middleware_covers(node, path)) chain->funcs[chain->count++] = node->func;
+    }
+
+    for (cwist_middleware_chain *curr = app->mw_chains; curr; curr = curr->next) {
+        if (curr->count == count && memcmp(curr->funcs, chain->funcs, count * sizeof(cwist_middleware_func)) == 0) {
+            cwist_free(chain);
+            *out = curr;
+            return true;
+        }
+    }
+    chain->next = app->mw_chains;
+    app->mw_chains = chain;
+    *out = chain;
+    return true;
+}
 
-    if (!app->middlewares) {
-        app->middlewares = node;
+typedef struct {
+    cwist_app *app;
+    bool ok;
+} cwist_relink_ctx;
+
+static void cwist_route_relink(cwist_route_entry *entry, void *ctx) {
+    cwist_relink_ctx *relink = (cwist_relink_ctx *)ctx;
+    const cwist_middleware_chain *chain;
+    if (cwist_app_resolve_chain(relink->app, entry->path, &chain)) {
+        entry->middleware = chain;
     } else {
-        cwist_middleware_node *curr = app->middlewares;
-        while (curr->next) curr = curr->next;
-        curr->next = node;
+        relink->ok = false;
     }
 }
 
+/*
+ * Re-resolves every route and mount after the middleware list changed.
+ * Once serving, routes are relinked on a copy and mounts through a new
+ * snapshot, exactly like any other runtime change.
+ */
+static bool cwist_app_relink_middleware(cwist_app *app) {
+    cwist_relink_ctx relink = { app, true };
+    for (cwist_static_dir *dir = app->static_dirs; dir; dir = dir->next) {
+        const cwist_middleware_chain *chain;
+        if (cwist_app_resolve_chain(app, dir->url_prefix, &chain)) {
+            dir->middleware = chain;
+        } else {
+            relink.ok = false;
+        }
+    }
+
+    if (!app->routes_live) {
+        cwist_route_table_foreach(app->router, cwist_route_relink, &relink);
+        return relink.ok;
+    }
+
+    cwist_route_table *next = cwist_route_table_clone(app->router);
+    if (!next) return false;
+    cwist_route_table_foreach(next, cwist_route_relink, &relink);
+    cwist_app_publish_router(app, next);
+    if (app->static_dirs) {
+        cwist_static_index *index = cwist_static_index_build(app->static_dirs);
+        if (index) {
+            cwist_app_publish_static(app, index);
+        } else {
+            relink.ok = false;
+        }
+    }
+    return relink.ok;
+}
+
+static bool cwist_app_add_middleware(cwist_app *app, const char *prefix, cwist_middleware_func mw) {
+    cwist_middleware_node *node = (cwist_middleware_node *)cwist_alloc(sizeof(cwist_middleware_node));
+    if (!node) return false;
+    node->func = mw;
+    if (prefix) {
+        node->prefix = cwist_normalize_prefix(prefix);
+        if (!node->prefix) {
+            cwist_free(node);
+            return false;
+        }
+        node->prefix_len = strlen(node->prefix);
+    }
+
+    pthread_mutex_lock(&app->route_lock);
+    cwist_middleware_node **link = &app->middlewares;
+    while (*link) link = &(*link)->next;
+    *link = node;
+    bool ok = cwist_app_relink_middleware(app);
+    pthread_mutex_unlock(&app->route_lock);
+    return ok;
+}
+
+void cwist_app_use(cwist_app *app, cwist_middleware_func mw) {
+    if (!app || !mw) return;
+    if (!cwist_app_add_middleware(app, NULL, mw)) {
+        fprintf(stderr, "[CWIST] Could not apply middleware to every route.\n");
+    }
+}
+
+cwist_error_t cwist_app_use_prefix(cwist_app *app, const char *prefix, cwist_middleware_func mw) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    err.error.err_i16 = -1;
+    if (!app || !prefix || !mw) return err;
+    if (cwist_app_add_middleware(app, prefix, mw)) err.error.err_i16 = 0;
+    return err;
+}
+
 void cwist_app_set_max_memspace(cwist_app *app, size_t size) {
     if (app) app->max_mem_space = size;
 }
@@ -745,21 +881,55 @@ void cwist_app_configure_bdr(cwist_app *app, size_t max_bytes, time_t max_entry_
     cwist_bdr_set_limits(app->bdr_ctx, max_bytes, max_entry_age_sec, revalidate_hits);
 }
 
+cwist_error_t cwist_app_configure_bdr_snapshot(cwist_app *app, const char *path, time_t interval_sec) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    err.error.err_i16 = -1;
+    if (!app || !app->bdr_ctx || !path) return err;
+    char *copy = cwist_strdup(path);
+    if (!copy) return err;
+    cwist_free(app->bdr_snapshot_path);
+    app->bdr_snapshot_path = copy;
+    app->bdr_snapshot_interval = interval_sec > 0 ? interval_sec : 0;
+    app->bdr_snapshot_at = time(NULL);
+
+    size_t loaded = 0;
+    err = cwist_bdr_snapshot_load(app->bdr_ctx, path, &loaded);
+    if (err.error.err_i16 == 0) printf("[BDR] Warm start: %zu replies restored from %s\n", loaded, path);
+    return err;
+}
+
+void cwist_app_configure_server(cwist_app *app, const cwist_server_config *config) {
+    if (!app || !config) return;
+    app->server_config = *config;
+}
+
 void cwist_app_destroy(cwist_app *app) {
     if (!app) return;
+    // Stale-reply refreshes still use the routes, the database and the cache; snapshots use the cache.
+    cwist_app_bdr_jobs_stop(app);
     if (app->cert_path) cwist_free(app->cert_path);
     if (app->key_path) cwist_free(app->key_path);
     if (app->ssl_ctx) cwist_https_destroy_context(app->ssl_ctx);
 
     cwist_route_table_destroy(app->router);
+    pthread_mutex_destroy(&app->route_lock);
 
     cwist_middleware_node *curr_m = app->middlewares;
     while (curr_m) {
         cwist_middleware_node *next = curr_m->next;
+        cwist_free(curr_m->prefix);
         cwist_free(curr_m);
         curr_m = next;
     }
+    while (app->mw_chains) {
+        cwist_middleware_chain *next = app->mw_chains->next;
+        cwist_free(app->mw_chains);
+        app->mw_chains = next;
+    }
 
+    cwist_static_index_destroy(app->static_index);
+    // Free router and mount versions retired while serving.
+    ttak_epoch_reclaim();
     cwist_static_dir *curr_s = app->static_dirs;
     while (curr_s) {
         cwist_static_dir *next = curr_s->next;
@@ -794,8 +964,15 @@ void cwist_app_destroy(cwist_app *app) {
     }
     
     if (app->bdr_ctx) {
+        // Last snapshot, so the next start is warm. A prefork master only holds what it
+        // loaded before forking, and would overwrite what its workers saved.
+        if (app->bdr_snapshot_path && !app->bdr_snapshot_in_workers) {
+            cwist_bdr_snapshot_save(app->bdr_ctx, app->bdr_snapshot_path);
+        }
         cwist_bdr_destroy(app->bdr_ctx);
     }
+    cwist_free(app->bdr_snapshot_path);
+    cwist_bdr_jobs_destroy(app->bdr_jobs);
 
     if (app->nuke_enabled) {
         cwist_nuke_close();
@@ -828,20 +1005,25 @@ static void mw_next_wrapper(cwist_http_request *req, cwist_http_response *res) {
     mw_executor_ctx *ctx = (mw_executor_ctx *)req->private_data;
     if (!ctx) return;
 
-    if (ctx->current_mw_node) {
-        cwist_middleware_node *node = ctx->current_mw_node;
+    if (ctx->chain && ctx->next_mw < ctx->chain->count) {
         // Advance the chain for the next "next" call
-        ctx->current_mw_node = node->next;
-        node->func(req, res, mw_next_wrapper);
+        cwist_middleware_func mw = ctx->chain->funcs[ctx->next_mw++];
+        mw(req, res, mw_next_wrapper);
     } else if (ctx->final_handler) {
         ctx->final_handler(req, res);
     }
 }
 
-static void execute_chain(cwist_app *app, cwist_http_request *req, cwist_http_response *res, cwist_handler_func final_handler, void *handler_data) {
-    mw_executor_ctx ctx = { app->middlewares, final_handler, handler_data };
+static void execute_chain(const cwist_middleware_chain *chain, cwist_http_request *req, cwist_http_response *res,
+                          cwist_handler_func final_handler, void *handler_data) {
+    mw_executor_ctx ctx = { chain, 0, final_handler, handler_data };
     req->private_data = &ctx;
-    mw_next_wrapper(req, res);
+    if (chain) {
+        mw_next_wrapper(req, res);
+    } else if (final_handler) {
+        // Routes without middleware skip the trampoline entirely.
+        final_handler(req, res);
+    }
     req->private_data = NULL;
 }
 
@@ -968,17 +1150,123 @@ cwist_error_t cwist_app_static(cwist_app *app, const char *url_prefix, const cha
     }
 
     entry->url_prefix = normalized;
+    entry->prefix_len = strlen(normalized);
     entry->fs_root = resolved;
+
+    pthread_mutex_lock(&app->route_lock);
+    if (!cwist_app_resolve_chain(app, entry->url_prefix, &entry->middleware)) {
+        pthread_mutex_unlock(&app->route_lock);
+        cwist_free(entry->url_prefix);
+        cwist_free(entry->fs_root);
+        cwist_free(entry);
+        err.error.err_i16 = -1;
+        return err;
+    }
     entry->next = app->static_dirs;
     app->static_dirs = entry;
+    if (app->routes_live) {
+        // Serving already: load the files first, then make the mount visible.
+        if (app->mem_manager) {
+            pthread_mutex_lock(&app->mem_manager->lock);
+            cwist_scan_recursive(entry->fs_root, NULL, app->mem_manager, false);
+            pthread_mutex_unlock(&app->mem_manager->lock);
+        } else {
+            cwist_mem_init(app);
+            cwist_app_start_watcher(app);
+        }
+        cwist_static_index *next = cwist_static_index_build(app->static_dirs);
+        if (next) {
+            cwist_app_publish_static(app, next);
+        } else {
+            app->static_dirs = entry->next;
+            cwist_free(entry->url_prefix);
+            cwist_free(entry->fs_root);
+            cwist_free(entry);
+            err.error.err_i16 = -1;
+            pthread_mutex_unlock(&app->route_lock);
+            return err;
+        }
+    }
+    pthread_mutex_unlock(&app->route_lock);
+
+    err.error.err_i16 = 0;
+    return err;
+}
+
+cwist_error_t cwist_app_unmount_static(cwist_app *app, const char *url_prefix) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    err.error.err_i16 = -1;
+    if (!app || !url_prefix) return err;
 
+    char *normalized = cwist_normalize_prefix(url_prefix);
+    if (!normalized) return err;
+
+    pthread_mutex_lock(&app->route_lock);
+    cwist_static_dir *removed = NULL;
+    for (cwist_static_dir **link = &app->static_dirs; *link; ) {
+        cwist_static_dir *curr = *link;
+        if (strcmp(curr->url_prefix, normalized) == 0) {
+            *link = curr->next;
+            curr->next = removed;
+            removed = curr;
+        } else {
+            link = &curr->next;
+        }
+    }
+    if (removed && app->routes_live) {
+        cwist_static_index *next = cwist_static_index_build(app->static_dirs);
+        if (next || !app->static_dirs) cwist_app_publish_static(app, next);
+    }
+    pthread_mutex_unlock(&app->route_lock);
+    cwist_free(normalized);
+
+    if (!removed) return err;
+    while (removed) {
+        cwist_static_dir *next = removed->next;
+        cwist_free(removed->url_prefix);
+        cwist_free(removed->fs_root);
+        cwist_free(removed);
+        removed = next;
+    }
     err.error.err_i16 = 0;
     return err;
 }
 
+/*
+ * Before listen the table is private and changed in place. Afterwards each
+ * change is made on a copy that replaces the live table in one atomic swap,
+ * so lookups never take a lock.
+ */
+static bool cwist_app_update_route(cwist_app *app, const char *path, cwist_http_method_t method,
+                                   cwist_handler_func handler, cwist_ws_handler_func ws_handler, bool remove) {
+    if (!app || !app->router || !path) return false;
+    const cwist_middleware_chain *chain = NULL;
+    bool ok;
+    pthread_mutex_lock(&app->route_lock);
+    if (!remove && !cwist_app_resolve_chain(app, path, &chain)) {
+        ok = false;
+    } else if (!app->routes_live) {
+        ok = remove ? cwist_route_table_remove(app->router, method, path)
+                    : cwist_route_table_insert_chain(app->router, path, method, handler, ws_handler, chain);
+    } else {
+        cwist_route_table *next = cwist_route_table_clone(app->router);
+        ok = next != NULL;
+        if (ok) {
+            ok = remove ? cwist_route_table_remove(next, method, path)
+                        : cwist_route_table_insert_chain(next, path, method, handler, ws_handler, chain);
+        }
+        if (ok) {
+            cwist_app_publish_router(app, next);
+        } else {
+            cwist_route_table_destroy(next);
+        }
+    }
+    pthread_mutex_unlock(&app->route_lock);
+    return ok;
+}
+
 static void add_route(cwist_app *app, const char *path, cwist_http_method_t method, cwist_handler_func handler) {
-    if (!app || !app->router || !path) return;
-    cwist_route_table_insert(app->router, path, method, handler, NULL);
+    cwist_app_update_route(app, path, method, handler, NULL, false);
 }
 
 void cwist_app_get(cwist_app *app, const char *path, cwist_handler_func handler) {
@@ -990,36 +1278,13 @@ void cwist_app_post(cwist_app *app, const char *path, cwist_handler_func handler
 }
 
 void cwist_app_ws(cwist_app *app, const char *path, cwist_ws_handler_func handler) {
-    if (!app || !app->router || !path) return;
-    cwist_route_table_insert(app->router, path, CWIST_HTTP_GET, NULL, handler);
+    cwist_app_update_route(app, path, CWIST_HTTP_GET, NULL, handler, false);
 }
 
-static bool match_path(const char *pattern, const char *actual, cwist_query_map *params) {
-    char p[256], a[256];
-    strncpy(p, pattern, 255);
-    strncpy(a, actual, 255);
-    p[255] = a[255] = '\0';
-
-    if (params) {
-        cwist_query_map_clear(params);
-    }
-
-    char *saveptr_p, *saveptr_a;
-    char *tok_p = strtok_r(p, "/", &saveptr_p);
-    char *tok_a = strtok_r(a, "/", &saveptr_a);
-
-    while (tok_p && tok_a) {
-        if (tok_p[0] == ':') {
-            // Path Parameter
-            cwist_query_map_set(params, tok_p + 1, tok_a);
-        } else if (strcmp(tok_p, tok_a) != 0) {
-            return false;
-        }
-        tok_p = strtok_r(NULL, "/", &saveptr_p);
-        tok_a = strtok_r(NULL, "/", &saveptr_a);
-    }
-
-    return tok_p == NULL && tok_a == NULL;
+cwist_error_t cwist_app_remove_route(cwist_app *app, cwist_http_method_t method, const char *path) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    err.error.err_i16 = cwist_app_update_route(app, path, method, NULL, NULL, true) ? 0 : -1;
+    return err;
 }
 
 // Internal Router Logic
@@ -1028,27 +1293,36 @@ static void internal_route_handler(cwist_app *app, cwist_http_request *req, cwis
 
     cwist_static_request_info static_info = {0};
     if (cwist_prepare_static(app, req, &static_info)) {
-        execute_chain(app, req, res, cwist_static_handler, &static_info);
+        execute_chain(static_info.middleware, req, res, cwist_static_handler, &static_info);
         return;
     }
 
-    const char *path = (req->path && req->path->data) ? req->path->data : "/";
-    cwist_route_entry *found_route = cwist_route_table_lookup(app->router, req->method, path);
-
-    if (found_route && req->path_params) {
-        cwist_query_map_clear(req->path_params);
+    const char *path = "/";
+    size_t path_len = 1;
+    if (req->path && req->path->data) {
+        path = req->path->data;
+        path_len = req->path->size;
     }
 
-    if (!found_route) {
-        found_route = cwist_route_table_match_params(app->router, req);
+    // Copy what the handler needs while the table version is pinned; a writer may retire it right after.
+    cwist_route_match match;
+    cwist_route_entry found = {0};
+    bool found_route = false;
+    cwist_epoch_pin();
+    cwist_route_table *router = __atomic_load_n(&app->router, __ATOMIC_ACQUIRE);
+    if (cwist_route_table_match(router, req->method, path, path_len, &match)) {
+        found = *match.route;
+        found_route = true;
+        cwist_route_match_bind(&match, path, req->path_params);
     }
+    cwist_epoch_unpin();
 
     if (found_route) {
-        if (found_route->ws_handler) {
+        if (found.ws_handler) {
             if (req->client_fd >= 0) {
                 cwist_websocket *ws = cwist_websocket_upgrade(req, req->client_fd);
                 if (ws) {
-                    found_route->ws_handler(ws);
+                    found.ws_handler(ws);
                     cwist_websocket_destroy(ws);
                 } else {
                     res->status_code = CWIST_HTTP_BAD_REQUEST;
@@ -1056,7 +1330,7 @@ static void internal_route_handler(cwist_app *app, cwist_http_request *req, cwis
                 }
             }
         } else {
-            execute_chain(app, req, res, found_route->handler, NULL);
+            execute_chain(found.middleware, req, res, found.handler, NULL);
         }
     } else {
         if (app->error_handler) {
@@ -1083,6 +1357,257 @@ static void static_ssl_handler(cwist_https_connection *conn, void *ctx) {
     cwist_http_request_destroy(req);
 }
 
+/* What the send path needs to hand a transmitted reply to BDR. */
+typedef struct cwist_bdr_learn_ctx {
+    cwist_app *app;
+    const cwist_http_request *req;
+    const cwist_http_response *res;
+    cwist_bdr_result *cached;
+} cwist_bdr_learn_ctx;
+
+/* Send observer: BDR learns the exact bytes that went out, adopting a pinned body instead of copying it. */
+static void cwist_bdr_learn_sent(const struct iovec *iov, int iov_cnt, cwist_http_body_pin *pin, void *arg) {
+    cwist_bdr_learn_ctx *learn = (cwist_bdr_learn_ctx *)arg;
+    if (learn->cached->flight) {
+        cwist_bdr_complete(learn->app->bdr_ctx, learn->cached, learn->req, learn->res, iov, iov_cnt, pin);
+    } else {
+        cwist_bdr_put_iov(learn->app->bdr_ctx, learn->req, learn->res, iov, iov_cnt, pin);
+    }
+}
+
+/*
+ * Stale refreshes and periodic snapshots run on one background thread fed by
+ * a fixed ring; a refresh that finds the ring full is dropped and the stale
+ * reply keeps being served until a later hit gets a slot.
+ */
+#define CWIST_BDR_JOB_SLOTS 64
+
+typedef struct cwist_bdr_refresh_job {
+    cwist_app *app;
+    cwist_http_request *req;
+    cwist_bdr_result cached;
+} cwist_bdr_refresh_job;
+
+struct cwist_bdr_jobs {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    bool running;
+    bool stopping;
+    bool snapshot_due;
+    size_t head;
+    size_t count;
+    cwist_bdr_refresh_job *slots[CWIST_BDR_JOB_SLOTS];
+};
+
+static cwist_bdr_jobs *cwist_bdr_jobs_create(void) {
+    cwist_bdr_jobs *jobs = (cwist_bdr_jobs *)cwist_alloc(sizeof(cwist_bdr_jobs));
+    if (!jobs) return NULL;
+    pthread_mutex_init(&jobs->lock, NULL);
+    pthread_cond_init(&jobs->wake, NULL);
+    return jobs;
+}
+
+/* Call after cwist_app_bdr_jobs_stop. */
+static void cwist_bdr_jobs_destroy(cwist_bdr_jobs *jobs) {
+    if (!jobs) return;
+    pthread_cond_destroy(&jobs->wake);
+    pthread_mutex_destroy(&jobs->lock);
+    cwist_free(jobs);
+}
+
+/* Releases the flight's waiters without learning anything; the cached reply stays stale. */
+static void cwist_bdr_refresh_drop(cwist_bdr_refresh_job *job) {
+    cwist_bdr_complete(job->app->bdr_ctx, &job->cached, job->req, NULL, NULL, 0, NULL);
+    cwist_http_request_destroy(job->req);
+    cwist_free(job);
+}
+
+static void cwist_bdr_refresh_run(cwist_bdr_refresh_job *job) {
+    cwist_http_response *res = cwist_http_response_create();
+    if (res) {
+        internal_route_handler(job->app, job->req, res);
+        // No socket here: the reply is framed exactly as a send would frame it.
+        cwist_bdr_learn_ctx learn = { job->app, job->req, res, &job->cached };
+        cwist_http_capture_response(res, cwist_bdr_learn_sent, &learn);
+    }
+    // Serialization failures never reach the observer; waiters are released either way.
+    cwist_http_response_destroy(res);
+    cwist_bdr_refresh_drop(job);
+}
+
+static void *cwist_bdr_jobs_main(void *arg) {
+    cwist_app *app = (cwist_app *)arg;
+    cwist_bdr_jobs *jobs = app->bdr_jobs;
+    pthread_mutex_lock(&jobs->lock);
+    while (!jobs->stopping) {
+        if (jobs->snapshot_due) {
+            jobs->snapshot_due = false;
+            pthread_mutex_unlock(&jobs->lock);
+            cwist_bdr_snapshot_save(app->bdr_ctx, app->bdr_snapshot_path);
+            pthread_mutex_lock(&jobs->lock);
+        } else if (jobs->count > 0) {
+            cwist_bdr_refresh_job *job = jobs->slots[jobs->head];
+            jobs->head = (jobs->head + 1) % CWIST_BDR_JOB_SLOTS;
+            jobs->count--;
+            pthread_mutex_unlock(&jobs->lock);
+            cwist_bdr_refresh_run(job);
+            pthread_mutex_lock(&jobs->lock);
+        } else {
+            pthread_cond_wait(&jobs->wake, &jobs->lock);
+        }
+    }
+    pthread_mutex_unlock(&jobs->lock);
+    return NULL;
+}
+
+/* Caller holds jobs->lock. Threads do not survive fork(), so each serving process starts its own on first use. */
+static bool cwist_bdr_jobs_ready(cwist_app *app) {
+    cwist_bdr_jobs *jobs = app->bdr_jobs;
+    if (!jobs->running && !jobs->stopping) {
+        jobs->running = pthread_create(&jobs->thread, NULL, cwist_bdr_jobs_main, app) == 0;
+    }
+    return jobs->running && !jobs->stopping;
+}
+
+/* Joins the job thread after its current job; queued refreshes are dropped. Later jobs are refused. */
+static void cwist_app_bdr_jobs_stop(cwist_app *app) {
+    cwist_bdr_jobs *jobs = app->bdr_jobs;
+    if (!jobs) return;
+    pthread_mutex_lock(&jobs->lock);
+    jobs->stopping = true;
+    bool running = jobs->running;
+    jobs->running = false;
+    pthread_cond_signal(&jobs->wake);
+    pthread_mutex_unlock(&jobs->lock);
+    if (running) pthread_join(jobs->thread, NULL);
+
+    while (jobs->count > 0) {
+        cwist_bdr_refresh_job *job = jobs->slots[jobs->head];
+        jobs->head = (jobs->head + 1) % CWIST_BDR_JOB_SLOTS;
+        jobs->count--;
+        cwist_bdr_refresh_drop(job);
+    }
+}
+
+/* The client already has the stale reply; neither this connection nor this worker waits for the handler. */
+static void cwist_app_bdr_refresh(cwist_app *app, const cwist_http_request *req, cwist_bdr_result *cached) {
+    cwist_bdr_refresh_job *job = app->bdr_jobs ? (cwist_bdr_refresh_job *)cwist_alloc(sizeof(cwist_bdr_refresh_job)) : NULL;
+    cwist_http_request *copy = job ? cwist_http_request_clone(req) : NULL;
+    if (!copy) {
+        cwist_free(job);
+        cwist_bdr_complete(app->bdr_ctx, cached, req, NULL, NULL, 0, NULL);
+        return;
+    }
+    copy->app = app;
+    copy->db = app->db;
+    job->app = app;
+    job->req = copy;
+    job->cached = *cached;
+    cached->flight = NULL;
+
+    cwist_bdr_jobs *jobs = app->bdr_jobs;
+    pthread_mutex_lock(&jobs->lock);
+    bool queued = cwist_bdr_jobs_ready(app) && jobs->count < CWIST_BDR_JOB_SLOTS;
+    if (queued) {
+        jobs->slots[(jobs->head + jobs->count) % CWIST_BDR_JOB_SLOTS] = job;
+        jobs->count++;
+        pthread_cond_signal(&jobs->wake);
+    }
+    pthread_mutex_unlock(&jobs->lock);
+    if (!queued) cwist_bdr_refresh_drop(job);
+}
+
+/* Queues a periodic snapshot once the interval has passed; one request wins the race. */
+static void cwist_app_bdr_snapshot_tick(cwist_app *app) {
+    if (!app->bdr_snapshot_path || app->bdr_snapshot_interval <= 0 || !app->bdr_jobs) return;
+    time_t now = time(NULL);
+    time_t last = __atomic_load_n(&app->bdr_snapshot_at, __ATOMIC_RELAXED);
+    if (now - last < app->bdr_snapshot_interval) return;
+    if (!__atomic_compare_exchange_n(&app->bdr_snapshot_at, &last, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return;
+
+    cwist_bdr_jobs *jobs = app->bdr_jobs;
+    pthread_mutex_lock(&jobs->lock);
+    // If the thread cannot start, try again next interval rather than stall this request.
+    if (cwist_bdr_jobs_ready(app)) {
+        jobs->snapshot_due = true;
+        pthread_cond_signal(&jobs->wake);
+    }
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+/* Serves one framed request on client_fd. Returns true if the connection stays open. */
+static bool cwist_app_serve_request(cwist_app *app, int client_fd, cwist_http_request *req) {
+    req->client_fd = client_fd;
+    req->app = app;
+    req->db = app->db;
+
+    // --- Big Dumb Reply (Read) ---
+    cwist_bdr_result cached = {0};
+    if (app->bdr_ctx) cwist_app_bdr_snapshot_tick(app);
+    if (app->bdr_ctx && req->method == CWIST_HTTP_GET) {
+        cwist_bdr_acquire(app->bdr_ctx, req, &cached);
+        if (cached.blob) {
+            // BDR Hit! Blast it out in one vectored write, with this request's Date,
+            // Connection, Age and request id spliced into the cached head.
+            // Our reference keeps the blob alive if it is evicted meanwhile.
+            cwist_bdr_splice splice;
+            cwist_bdr_splice_reply(cached.blob, req, &splice);
+            bool sent = cwist_http_send_iov(client_fd, splice.iov, splice.iov_cnt).error.err_i16 >= 0;
+            cwist_bdr_blob_release(cached.blob);
+            cached.blob = NULL;
+            if (cached.status == CWIST_BDR_STALE) cwist_app_bdr_refresh(app, req, &cached);
+            return sent && splice.keep_alive;
+        }
+    }
+    // -----------------------------
+
+    cwist_http_response *res = cwist_http_response_create();
+    if (!res) {
+        cwist_bdr_complete(app->bdr_ctx, &cached, req, NULL, NULL, 0, NULL);
+        return false;
+    }
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    internal_route_handler(app, req, res);
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t duration_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+
+    bool keep_alive = req->keep_alive && res->keep_alive;
+    
+    if (!req->upgraded) {
+        // --- Big Dumb Reply (Learn) ---
+        // BDR watches the send and learns the bytes that actually went out.
+        // A leader always reports back so its waiters are released.
+        bool slow = app->bdr_ctx && duration_ms > (uint64_t)app->bdr_ctx->latency_threshold_ms;
+        bool learn = cached.flight || (slow && req->method == CWIST_HTTP_GET);
+        cwist_bdr_learn_ctx learn_ctx = { app, req, res, &cached };
+        cwist_error_t sent = learn ? cwist_http_send_response_capture(client_fd, res, cwist_bdr_learn_sent, &learn_ctx)
+                                   : cwist_http_send_response(client_fd, res);
+        cwist_bdr_complete(app->bdr_ctx, &cached, req, NULL, NULL, 0, NULL);
+        // ------------------------------
+        if (sent.error.err_i16 < 0) {
+            cwist_http_response_destroy(res);
+            return false;
+        }
+    } else {
+        cwist_bdr_complete(app->bdr_ctx, &cached, req, NULL, NULL, 0, NULL);
+        keep_alive = false;
+    }
+    
+    cwist_http_response_destroy(res);
+    return keep_alive;
+}
+
+/* Reactor entry point: invoked once a full request has been framed. */
+static bool static_http_request_handler(int client_fd, cwist_http_request *req, void *ctx) {
+    return cwist_app_serve_request((cwist_app *)ctx, client_fd, req);
+}
+
+/* Connection entry point for the blocking (thread pool / forking) loops. */
 static void static_http_handler(int client_fd, void *ctx) {
     cwist_app *app = (cwist_app *)ctx;
     char *read_buf = cwist_alloc(CWIST_HTTP_READ_BUFFER_SIZE);
@@ -1098,71 +1623,10 @@ static void static_http_handler(int client_fd, void *ctx) {
         if (!req) {
             break;
         }
-        req->client_fd = client_fd;
-        req->app = app;
-        req->db = app->db;
-
-        // --- Big Dumb Reply (Read) ---
-        if (app->bdr_ctx && req->method == CWIST_HTTP_GET) {
-            size_t cached_len = 0;
-            const void *cached_blob = cwist_bdr_get(app->bdr_ctx, "GET", req->path->data, &cached_len);
-            if (cached_blob) {
-                // BDR Hit! Blast it out.
-                send(client_fd, cached_blob, cached_len, 0); // Flags handled by socket opt ideally or just 0
-                
-                // Cleanup and Loop
-                bool keep_alive = req->keep_alive;
-                cwist_http_request_destroy(req);
-                if (!keep_alive) break;
-                continue;
-            }
-        }
-        // -----------------------------
-
-        cwist_http_response *res = cwist_http_response_create();
-        if (!res) {
-            cwist_http_request_destroy(req);
-            break;
-        }
-        
-        struct timespec start, end;
-        clock_gettime(CLOCK_MONOTONIC, &start);
-
-        internal_route_handler(app, req, res);
-        
-        clock_gettime(CLOCK_MONOTONIC, &end);
-        uint64_t duration_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
-
-        bool keep_alive = req->keep_alive && res->keep_alive;
-        bool upgraded = req->upgraded;
-        
-        if (!req->upgraded) {
-            if (cwist_http_send_response(client_fd, res).error.err_i16 < 0) {
-                cwist_http_response_destroy(res);
-                cwist_http_request_destroy(req);
-                break;
-            }
-            
-            // --- Big Dumb Reply (Learn) ---
-            if (app->bdr_ctx && req->method == CWIST_HTTP_GET && duration_ms > (uint64_t)app->bdr_ctx->latency_threshold_ms) {
-                // Too slow! Cache it.
-                // We need to serialize the response we just sent.
-                // Note: This duplicates serialization work (once in send_response, once here).
-                // Optimization: send_response could return the blob, or we serialize first then send.
-                // For now, re-serialize for BDR.
-                cwist_sstring *serialized = cwist_http_stringify_response(res);
-                if (serialized) {
-                     cwist_bdr_put(app->bdr_ctx, "GET", req->path->data, serialized->data, serialized->size);
-                     cwist_sstring_destroy(serialized);
-                }
-            }
-            // ------------------------------
-        }
-        
-        cwist_http_response_destroy(res);
+        bool keep_alive = cwist_app_serve_request(app, client_fd, req);
         cwist_http_request_destroy(req);
         
-        if (!keep_alive || upgraded) {
+        if (!keep_alive) {
             break;
         }
     }
@@ -1171,36 +1635,89 @@ static void static_http_handler(int client_fd, void *ctx) {
     close(client_fd);
 }
 
+static void cwist_app_start_watcher(cwist_app *app) {
+    if (app->mem_manager) {
+        app->mem_manager->watcher_running = true;
+        pthread_create(&app->mem_manager->watcher_thread, NULL, cwist_mem_watcher, app);
+    }
+}
+
+/* Threads do not survive fork(), so prefork workers start their own watcher. */
+static void cwist_app_worker_start(void *ctx) {
+    cwist_app *app = (cwist_app *)ctx;
+    cwist_app_start_watcher(app);
+    if (app->server_config.on_worker_start) {
+        app->server_config.on_worker_start(ctx);
+    }
+}
+
+/* A drained prefork worker saves what it learned; its process exits right after. */
+static void cwist_app_worker_exit(void *ctx) {
+    cwist_app *app = (cwist_app *)ctx;
+    cwist_app_bdr_jobs_stop(app);
+    if (app->bdr_ctx && app->bdr_snapshot_path) {
+        cwist_bdr_snapshot_save(app->bdr_ctx, app->bdr_snapshot_path);
+    }
+    if (app->server_config.on_worker_exit) {
+        app->server_config.on_worker_exit(ctx);
+    }
+}
+
 int cwist_app_listen(cwist_app *app, int port) {
     if (!app) return -1;
     app->port = port;
     
+    cwist_app_freeze(app);
+
     // Initialize Memory Manager
     cwist_mem_init(app);
-    if (app->mem_manager) {
-        app->mem_manager->watcher_running = true;
-        pthread_create(&app->mem_manager->watcher_thread, NULL, cwist_mem_watcher, app);
+
+    cwist_server_config run_config = app->server_config;
+    cwist_server_config *config = &run_config;
+    if (config->use_forking && !app->use_ssl) {
+        config->on_worker_start = cwist_app_worker_start;
+        config->on_worker_exit = cwist_app_worker_exit;
+        app->bdr_snapshot_in_workers = true;
+    } else {
+        cwist_app_start_watcher(app);
     }
     
+    int backlog = config->listen_backlog > 0 ? config->listen_backlog : SOMAXCONN;
+    if (backlog > UINT16_MAX) backlog = UINT16_MAX;
+
+    size_t shards = (!app->use_ssl && !config->use_forking && config->listener_shards > 1) ? config->listener_shards : 1;
+    int *server_fds = (int *)cwist_alloc_array(shards, sizeof(int));
+    if (!server_fds) return -1;
+
     struct sockaddr_in addr;
-    int server_fd = cwist_make_socket_ipv4(&addr, "0.0.0.0", port, 128);
-    if (server_fd < 0) {
-        perror("Failed to bind port");
-        return -1;
+    for (size_t i = 0; i < shards; i++) {
+        server_fds[i] = shards > 1
+            ? cwist_make_socket_ipv4_reuseport(&addr, "0.0.0.0", port, (uint16_t)backlog)
+            : cwist_make_socket_ipv4(&addr, "0.0.0.0", port, (uint16_t)backlog);
+        if (server_fds[i] < 0) {
+            perror("Failed to bind port");
+            for (size_t j = 0; j < i; j++) close(server_fds[j]);
+            cwist_free(server_fds);
+            return -1;
+        }
     }
+    int server_fd = server_fds[0];
     
     printf("CWIST App running on port %d (SSL: %s)\n", port, app->use_ssl ? "On" : "Off");
     
     if (app->use_ssl) {
         if (!app->ssl_ctx) {
             fprintf(stderr, "SSL enabled but context not initialized.\n");
+            cwist_free(server_fds);
             return -1;
         }
         cwist_https_server_loop(server_fd, app->ssl_ctx, static_ssl_handler, app);
+    } else if (shards > 1) {
+        cwist_http_server_loop_sharded(server_fds, shards, config, static_http_handler, app);
     } else {
-        cwist_server_config config = { .use_forking = false, .use_threading = true, .use_epoll = false };
-        cwist_http_server_loop(server_fd, &config, static_http_handler, app);
+        cwist_http_server_loop(server_fd, config, static_http_handler, app);
     }
     
+    cwist_free(server_fds);
     return 0;
 }
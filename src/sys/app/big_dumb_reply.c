@@ -1,482 +1,2174 @@
 #define _POSIX_C_SOURCE 200809L
 #include <cwist/sys/app/big_dumb_reply.h>
 #include <cwist/core/mem/alloc.h>
+#include <cwist/core/mem/epoch.h>
 #include <cwist/core/siphash/siphash.h>
 #include <cwist/sys/sys_info.h>
+#include <cwist/sys/coro/coro.h>
 #include <cwist/core/macros.h>
-#include <sqlite3.h>
+#include <cwist/sys/app/middleware.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#define BDR_BUCKETS 1024
 #define BDR_GC_SWEEP 8
 #define BDR_DEFAULT_MAX_BYTES CWIST_MIB(32)
 #define BDR_DEFAULT_ENTRY_TTL 300
 #define BDR_DEFAULT_REVALIDATE_HITS 100000
+#define BDR_DEFAULT_MAX_STALE 60
+#define BDR_DEFAULT_COALESCE_WAIT_MS 5000
+#define BDR_DEFAULT_DISK_CAPACITY CWIST_MIB(256)
+#define BDR_DEFAULT_RAM_FLOOR CWIST_MIB(64)
+#define BDR_QUERY_INLINE 32
+#define BDR_CLOCK_INITIAL 64
+#define BDR_SKETCH_MAX 15
+#define BDR_SKETCH_RESET (CWIST_BDR_SKETCH_WIDTH * 10)
+
+/*
+ * Concurrency: readers pin an epoch and walk a shard's chains with acquire
+ * loads, then take a reference on the blob before unpinning. Writers hold the
+ * shard lock, publish with release stores, and hand anything they unlink to
+ * the epoch collector, so a reader mid-walk never touches freed memory. The
+ * cache's own reference on a blob is dropped only after that grace period.
+ *
+ * Flights hang off the shard under its lock. Each carries its own mutex for
+ * the leader/waiter handoff, and waiters park on private pipes so the wait
+ * yields inside a coroutine.
+ */
+
+static cwist_bdr_shard *bdr_shard_of(cwist_bdr_t *bdr, const uint64_t hash[2]) {
+    return &bdr->shards[hash[1] & (CWIST_BDR_SHARDS - 1)];
+}
 
-// SipHash key for BDR (Hardcoded or random at startup)
-static const uint8_t BDR_KEY[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
-                                    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+static size_t bdr_bucket_of(const uint64_t hash[2]) {
+    return (size_t)(hash[0] & (CWIST_BDR_SHARD_BUCKETS - 1));
+}
 
-static void bdr_release_blob(cwist_bdr_t *bdr, bdr_entry_t *entry) {
-    if (!entry || !entry->response_blob) return;
-    if (bdr) {
-        if (bdr->current_bytes >= entry->len) {
-            bdr->current_bytes -= entry->len;
-        } else {
-            bdr->current_bytes = 0;
-        }
-    }
-    cwist_free(entry->response_blob);
-    entry->response_blob = NULL;
-    entry->len = 0;
+/* --- Request keys --- */
+
+/* Canonical key under construction; short keys never leave the stack. */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    bool ok;
+    uint64_t hash[2];
+    char inline_buf[256];
+} bdr_key;
+
+static void bdr_key_init(bdr_key *key) {
+    key->data = key->inline_buf;
+    key->len = 0;
+    key->cap = sizeof(key->inline_buf);
+    key->ok = true;
 }
 
-static void bdr_remove_entry(cwist_bdr_t *bdr, size_t idx, bdr_entry_t *prev, bdr_entry_t *entry) {
-    if (!bdr || !entry || idx >= bdr->bucket_count) return;
-    bdr_release_blob(bdr, entry);
-    if (prev) {
-        prev->next = entry->next;
-    } else {
-        bdr->buckets[idx] = entry->next;
-    }
-    cwist_free(entry);
+static void bdr_key_free(bdr_key *key) {
+    if (key->data != key->inline_buf) cwist_free(key->data);
 }
 
-static bool bdr_entry_should_decay(const cwist_bdr_t *bdr, const bdr_entry_t *entry, time_t now) {
-    if (!bdr || !entry) return false;
-    if (bdr->max_entry_age_sec > 0 && entry->created_at > 0) {
-        if (now - entry->created_at > bdr->max_entry_age_sec) {
-            return true;
+static void bdr_key_append(bdr_key *key, const char *src, size_t len) {
+    if (!key->ok) return;
+    if (key->len + len > key->cap) {
+        size_t cap = key->cap * 2;
+        if (cap < key->len + len) cap = key->len + len;
+        char *grown = (char *)cwist_alloc(cap);
+        if (!grown) {
+            key->ok = false;
+            return;
         }
+        memcpy(grown, key->data, key->len);
+        bdr_key_free(key);
+        key->data = grown;
+        key->cap = cap;
     }
-    if (entry->is_stable && bdr->revalidate_hits > 0 && entry->hits >= bdr->revalidate_hits) {
-        return true;
-    }
-    return false;
+    memcpy(key->data + key->len, src, len);
+    key->len += len;
 }
 
-static bool bdr_trim_oldest(cwist_bdr_t *bdr, time_t now) {
-    if (!bdr) return false;
-    size_t victim_idx = SIZE_MAX;
-    bdr_entry_t *victim = NULL;
-    bdr_entry_t *victim_prev = NULL;
-    time_t oldest = now;
+static void bdr_key_seal(const cwist_bdr_t *bdr, bdr_key *key) {
+    siphash24_128(key->data, key->len, bdr->seed, key->hash);
+}
 
-    for (size_t i = 0; i < bdr->bucket_count; ++i) {
-        bdr_entry_t *prev = NULL;
-        bdr_entry_t *curr = bdr->buckets[i];
-        while (curr) {
-            if (curr->response_blob && (!victim || curr->created_at < oldest)) {
-                victim = curr;
-                victim_prev = prev;
-                victim_idx = i;
-                oldest = curr->created_at;
-            }
-            prev = curr;
-            curr = curr->next;
+typedef struct {
+    const char *ptr;
+    size_t len;
+    size_t name_len;           ///< Bytes before '=' (all of them when there is none)
+    size_t order;              ///< Position in the request
+} bdr_span;
+
+/*
+ * Orders parameters by name only, and by request order among equal names:
+ * handlers see the last `a` of ?a=1&a=2, so that order is part of the key.
+ */
+static int bdr_span_cmp(const void *a, const void *b) {
+    const bdr_span *x = (const bdr_span *)a;
+    const bdr_span *y = (const bdr_span *)b;
+    int c = memcmp(x->ptr, y->ptr, x->name_len < y->name_len ? x->name_len : y->name_len);
+    if (c != 0) return c;
+    if (x->name_len != y->name_len) return (x->name_len > y->name_len) - (x->name_len < y->name_len);
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+/* Appends the query with empty parameters dropped and the rest sorted by name, so ?b=1&a=2 == ?a=2&b=1. */
+static void bdr_key_append_query(bdr_key *key, const char *query, size_t len) {
+    size_t count = 1;
+    for (size_t i = 0; i < len; i++) count += query[i] == '&';
+
+    bdr_span inline_spans[BDR_QUERY_INLINE];
+    bdr_span *spans = inline_spans;
+    if (count > BDR_QUERY_INLINE) {
+        spans = (bdr_span *)cwist_alloc_array(count, sizeof(bdr_span));
+        if (!spans) {
+            key->ok = false;
+            return;
         }
     }
 
-    if (!victim || victim_idx == SIZE_MAX) return false;
-    bdr_remove_entry(bdr, victim_idx, victim_prev, victim);
-    return true;
-}
-
-static void bdr_sweep(cwist_bdr_t *bdr, size_t steps) {
-    if (!bdr || bdr->bucket_count == 0 || steps == 0) return;
-    time_t now = time(NULL);
-    for (size_t i = 0; i < steps; ++i) {
-        size_t idx = bdr->gc_cursor % bdr->bucket_count;
-        bdr->gc_cursor = (bdr->gc_cursor + 1) % bdr->bucket_count;
-        bdr_entry_t *prev = NULL;
-        bdr_entry_t *curr = bdr->buckets[idx];
-        while (curr) {
-            if (bdr_entry_should_decay(bdr, curr, now)) {
-                bdr_entry_t *victim = curr;
-                curr = curr->next;
-                bdr_remove_entry(bdr, idx, prev, victim);
-                continue;
-            }
-            prev = curr;
-            curr = curr->next;
+    size_t used = 0;
+    const char *cursor = query;
+    const char *end = query + len;
+    while (cursor < end) {
+        const char *amp = memchr(cursor, '&', (size_t)(end - cursor));
+        const char *stop = amp ? amp : end;
+        if (stop > cursor) {
+            const char *eq = memchr(cursor, '=', (size_t)(stop - cursor));
+            size_t name_len = (size_t)((eq ? eq : stop) - cursor);
+            spans[used] = (bdr_span){ cursor, (size_t)(stop - cursor), name_len, used };
+            used++;
         }
+        cursor = stop + 1;
     }
+    qsort(spans, used, sizeof(bdr_span), bdr_span_cmp);
+
+    for (size_t i = 0; i < used; i++) {
+        bdr_key_append(key, i == 0 ? "?" : "&", 1);
+        bdr_key_append(key, spans[i].ptr, spans[i].len);
+    }
+    if (spans != inline_spans) cwist_free(spans);
 }
 
-static void bdr_guardrails(cwist_bdr_t *bdr) {
-    if (!bdr) return;
-    bdr_sweep(bdr, BDR_GC_SWEEP);
+/* "GET /path?a=1&b=2\n" */
+static bool bdr_key_build_base(const cwist_bdr_t *bdr, const cwist_http_request *req, bdr_key *key) {
+    bdr_key_init(key);
+    const char *method = cwist_http_method_to_string(req->method);
+    bdr_key_append(key, method, strlen(method));
+    bdr_key_append(key, " ", 1);
+    bdr_key_append(key, req->path->data, req->path->size);
+    if (req->query && req->query->data && req->query->size > 0) {
+        bdr_key_append_query(key, req->query->data, req->query->size);
+    }
+    bdr_key_append(key, "\n", 1);
+    bdr_key_seal(bdr, key);
+    return key->ok;
+}
 
-    if (bdr->max_bytes == 0) return;
-    time_t now = time(NULL);
-    while (bdr->current_bytes > bdr->max_bytes) {
-        if (!bdr_trim_oldest(bdr, now)) break;
+static const char *bdr_header_find(const cwist_http_header_node *head, const char *name, size_t name_len) {
+    for (; head; head = head->next) {
+        if (head->key && head->key->data && head->key->size == name_len &&
+            strncasecmp(head->key->data, name, name_len) == 0) {
+            return head->value ? head->value->data : "";
+        }
     }
+    return NULL;
 }
 
-cwist_bdr_t *cwist_bdr_create(void) {
-    cwist_bdr_t *bdr = cwist_alloc(sizeof(cwist_bdr_t));
-    if (!bdr) return NULL;
-    bdr->bucket_count = BDR_BUCKETS;
-    bdr->buckets = cwist_alloc_array(BDR_BUCKETS, sizeof(bdr_entry_t *));
-    bdr->latency_threshold_ms = 10; 
-    bdr->current_bytes = 0;
-    bdr->max_bytes = BDR_DEFAULT_MAX_BYTES;
-    bdr->max_entry_age_sec = BDR_DEFAULT_ENTRY_TTL;
-    bdr->revalidate_hits = BDR_DEFAULT_REVALIDATE_HITS;
-    bdr->gc_cursor = 0;
-    bdr->disk_db = NULL;
-    bdr->is_disk_mode = false;
-    return bdr;
+/* Appends "name:value\n" (or "name\n" when absent) for each name in a normalized Vary list. */
+static bool bdr_key_extend_vary(const cwist_bdr_t *bdr, const cwist_http_request *req, const char *vary, bdr_key *key) {
+    while (*vary) {
+        const char *comma = strchr(vary, ',');
+        size_t name_len = comma ? (size_t)(comma - vary) : strlen(vary);
+        const char *value = bdr_header_find(req->headers, vary, name_len);
+        bdr_key_append(key, vary, name_len);
+        if (value) {
+            bdr_key_append(key, ":", 1);
+            bdr_key_append(key, value, strlen(value));
+        }
+        bdr_key_append(key, "\n", 1);
+        vary += name_len + (comma ? 1 : 0);
+    }
+    bdr_key_seal(bdr, key);
+    return key->ok;
 }
 
-void cwist_bdr_destroy(cwist_bdr_t *bdr) {
-    if (!bdr) return;
-    for (size_t i = 0; i < bdr->bucket_count; i++) {
-        bdr_entry_t *curr = bdr->buckets[i];
-        while (curr) {
-            bdr_entry_t *next = curr->next;
-            bdr_release_blob(bdr, curr);
-            cwist_free(curr);
-            curr = next;
+/*
+ * Lower-cases and trims a Vary header value into "a,b". Returns false when
+ * the response must not be cached (`Vary: *`) or on allocation failure.
+ */
+static bool bdr_vary_normalize(const char *header, char **out) {
+    *out = NULL;
+    size_t len = strlen(header);
+    char *vary = (char *)cwist_alloc(len + 1);
+    if (!vary) return false;
+    size_t used = 0;
+    const char *cursor = header;
+    while (*cursor) {
+        while (*cursor == ' ' || *cursor == '\t' || *cursor == ',') cursor++;
+        const char *start = cursor;
+        while (*cursor && *cursor != ',') cursor++;
+        const char *stop = cursor;
+        while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t')) stop--;
+        if (stop == start) continue;
+        if (stop - start == 1 && *start == '*') {
+            cwist_free(vary);
+            return false;
         }
+        if (used > 0) vary[used++] = ',';
+        for (const char *c = start; c < stop; c++) vary[used++] = (char)tolower((unsigned char)*c);
     }
-    cwist_free(bdr->buckets);
-    if (bdr->disk_db) {
-        sqlite3_close(bdr->disk_db);
-        remove("cwist_bdr_fallback.db"); // Cleanup temp db
+    vary[used] = '\0';
+    if (used == 0) {
+        cwist_free(vary);
+        return true;
     }
-    cwist_free(bdr);
+    *out = vary;
+    return true;
 }
 
-static uint64_t bdr_hash(const char *method, const char *path) {
-    uint64_t h = siphash24((const void*)path, strlen(path), BDR_KEY);
-    h ^= (uint64_t)(method[0]); 
-    return h;
+/* Walks one chain; safe both under the shard lock and inside an epoch. */
+static bdr_entry_t *bdr_find(cwist_bdr_shard *shard, const bdr_key *key) {
+    bdr_entry_t *curr = __atomic_load_n(&shard->buckets[bdr_bucket_of(key->hash)], __ATOMIC_ACQUIRE);
+    for (; curr; curr = __atomic_load_n(&curr->next, __ATOMIC_ACQUIRE)) {
+        if (curr->request_hash[0] == key->hash[0] && curr->request_hash[1] == key->hash[1] &&
+            curr->key_len == key->len && memcmp(curr->key, key->data, key->len) == 0) {
+            return curr;
+        }
+    }
+    return NULL;
 }
 
-static void bdr_check_ram(cwist_bdr_t *bdr) {
-    if (bdr->is_disk_mode) return;
-    
-    // Threshold: 64MB free (conservative)
-    if (cwist_is_ram_critical(CWIST_MIB(64))) {
-        printf("[BDR] Low RAM. Switching to Disk Cache.\n");
-        // Open Disk DB
-        if (sqlite3_open("cwist_bdr_fallback.db", &bdr->disk_db) == SQLITE_OK) {
-             char *err = NULL;
-             sqlite3_exec(bdr->disk_db, "CREATE TABLE IF NOT EXISTS bdr (hash INTEGER PRIMARY KEY, blob BLOB);", NULL, NULL, &err);
-             if (err) sqlite3_free(err);
-             
-             // Move existing memory items to disk
-             sqlite3_exec(bdr->disk_db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
-             for (size_t i = 0; i < bdr->bucket_count; i++) {
-                bdr_entry_t *curr = bdr->buckets[i];
-                while (curr) {
-                    if (curr->is_stable) { // Only move stable items
-                        sqlite3_stmt *stmt;
-                        sqlite3_prepare_v2(bdr->disk_db, "INSERT INTO bdr (hash, blob) VALUES (?, ?);", -1, &stmt, NULL);
-                        sqlite3_bind_int64(stmt, 1, curr->request_hash);
-                        sqlite3_bind_blob(stmt, 2, curr->response_blob, curr->len, SQLITE_STATIC);
-                        sqlite3_step(stmt);
-                        sqlite3_finalize(stmt);
-                    }
-                    
-                    // Free memory
-                    bdr_entry_t *next = curr->next;
-                    bdr_release_blob(bdr, curr);
-                    cwist_free(curr);
-                    curr = next;
-                }
-                bdr->buckets[i] = NULL;
-             }
-             sqlite3_exec(bdr->disk_db, "COMMIT;", NULL, NULL, NULL);
-             bdr->is_disk_mode = true;
+static bdr_entry_t **bdr_find_link(cwist_bdr_shard *shard, const bdr_key *key) {
+    for (bdr_entry_t **link = &shard->buckets[bdr_bucket_of(key->hash)]; *link; link = &(*link)->next) {
+        bdr_entry_t *curr = *link;
+        if (curr->request_hash[0] == key->hash[0] && curr->request_hash[1] == key->hash[1] &&
+            curr->key_len == key->len && memcmp(curr->key, key->data, key->len) == 0) {
+            return link;
         }
     }
+    return NULL;
 }
 
-static uint64_t bdr_hash_data(const void *data, size_t len) {
-
-    return siphash24(data, len, BDR_KEY);
-
+static bdr_entry_t *bdr_entry_create(const bdr_key *key) {
+    bdr_entry_t *entry = (bdr_entry_t *)cwist_alloc(sizeof(bdr_entry_t));
+    if (!entry) return NULL;
+    entry->key = (char *)cwist_alloc(key->len);
+    if (!entry->key) {
+        cwist_free(entry);
+        return NULL;
+    }
+    memcpy(entry->key, key->data, key->len);
+    entry->key_len = key->len;
+    entry->request_hash[0] = key->hash[0];
+    entry->request_hash[1] = key->hash[1];
+    entry->created_at = time(NULL);
+    return entry;
 }
 
+/* --- CLOCK ring --- */
 
+/* Shard lock held. */
+static bool bdr_clock_add(cwist_bdr_shard *shard, bdr_entry_t *entry) {
+    if (shard->clock_len == shard->clock_cap) {
+        size_t cap = shard->clock_cap ? shard->clock_cap * 2 : BDR_CLOCK_INITIAL;
+        bdr_entry_t **grown = (bdr_entry_t **)cwist_realloc(shard->clock, cap * sizeof(bdr_entry_t *));
+        if (!grown) return false;
+        shard->clock = grown;
+        shard->clock_cap = cap;
+    }
+    entry->clock_slot = shard->clock_len;
+    shard->clock[shard->clock_len++] = entry;
+    return true;
+}
 
-const void *cwist_bdr_get(cwist_bdr_t *bdr, const char *method, const char *path, size_t *out_len) {
-
-    if (!bdr || !method || !path) return NULL;
-
-    if (strcmp(method, "GET") != 0) return NULL;
-
-
-
-    uint64_t h = bdr_hash(method, path);
-
-
+/* Swap-removes `entry` from the ring. Shard lock held. */
+static void bdr_clock_drop(cwist_bdr_shard *shard, bdr_entry_t *entry) {
+    size_t slot = entry->clock_slot;
+    bdr_entry_t *last = shard->clock[--shard->clock_len];
+    shard->clock[slot] = last;
+    last->clock_slot = slot;
+    if (shard->clock_hand >= shard->clock_len) shard->clock_hand = 0;
+}
 
-    // Disk Mode
+/*
+ * Advances the hand to the first entry whose referenced bit is clear,
+ * clearing bits on the way. With `need_blob` only published replies qualify.
+ * Two sweeps suffice: the first clears every bit it passes.
+ */
+static bdr_entry_t *bdr_clock_victim(cwist_bdr_shard *shard, const bdr_entry_t *exclude, bool need_blob) {
+    for (size_t steps = 0; steps < shard->clock_len * 2; steps++) {
+        bdr_entry_t *curr = shard->clock[shard->clock_hand];
+        shard->clock_hand = (shard->clock_hand + 1) % shard->clock_len;
+        if (curr == exclude || (need_blob && !curr->blob)) continue;
+        if (__atomic_exchange_n(&curr->referenced, 0, __ATOMIC_RELAXED)) continue;
+        return curr;
+    }
+    return NULL;
+}
 
-    if (bdr->is_disk_mode) {
+/* Shard lock held. */
+static bool bdr_insert(cwist_bdr_shard *shard, bdr_entry_t *entry) {
+    if (!bdr_clock_add(shard, entry)) return false;
+    entry->referenced = 1;
+    bdr_entry_t **head = &shard->buckets[bdr_bucket_of(entry->request_hash)];
+    entry->next = *head;
+    __atomic_store_n(head, entry, __ATOMIC_RELEASE);
+    return true;
+}
 
-        // Disk mode logic remains same (Fail-safe: return NULL or implement read)
+static bdr_entry_t **bdr_link_of(cwist_bdr_shard *shard, const bdr_entry_t *entry) {
+    bdr_entry_t **link = &shard->buckets[bdr_bucket_of(entry->request_hash)];
+    while (*link != entry) link = &(*link)->next;
+    return link;
+}
 
-        // For now, we stick to "Write-only" on disk for safety as per previous step.
+/* --- TinyLFU admission sketch --- */
 
-        return NULL; 
+static size_t bdr_sketch_slot(const uint64_t hash[2], int row) {
+    return (size_t)((hash[0] >> (row * 16)) ^ (hash[1] >> (row * 16 + 8))) & (CWIST_BDR_SKETCH_WIDTH - 1);
+}
 
+/* Ages the sketch by halving every counter, so old popularity fades. */
+static void bdr_sketch_age(cwist_bdr_shard *shard) {
+    for (int row = 0; row < CWIST_BDR_SKETCH_DEPTH; row++) {
+        for (size_t i = 0; i < CWIST_BDR_SKETCH_WIDTH; i++) {
+            uint8_t c = __atomic_load_n(&shard->sketch[row][i], __ATOMIC_RELAXED);
+            __atomic_store_n(&shard->sketch[row][i], (uint8_t)(c >> 1), __ATOMIC_RELAXED);
+        }
     }
+    __atomic_store_n(&shard->sketch_samples, 0, __ATOMIC_RELAXED);
+}
 
+/* Counts one lookup. Lost increments under contention are harmless. */
+static void bdr_sketch_touch(cwist_bdr_shard *shard, const uint64_t hash[2]) {
+    for (int row = 0; row < CWIST_BDR_SKETCH_DEPTH; row++) {
+        uint8_t *cell = &shard->sketch[row][bdr_sketch_slot(hash, row)];
+        uint8_t c = __atomic_load_n(cell, __ATOMIC_RELAXED);
+        if (c < BDR_SKETCH_MAX) __atomic_store_n(cell, (uint8_t)(c + 1), __ATOMIC_RELAXED);
+    }
+    if (__atomic_add_fetch(&shard->sketch_samples, 1, __ATOMIC_RELAXED) >= BDR_SKETCH_RESET &&
+        pthread_mutex_trylock(&shard->lock) == 0) {
+        if (__atomic_load_n(&shard->sketch_samples, __ATOMIC_RELAXED) >= BDR_SKETCH_RESET) bdr_sketch_age(shard);
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
 
+static uint8_t bdr_sketch_estimate(cwist_bdr_shard *shard, const uint64_t hash[2]) {
+    uint8_t best = BDR_SKETCH_MAX;
+    for (int row = 0; row < CWIST_BDR_SKETCH_DEPTH; row++) {
+        uint8_t c = __atomic_load_n(&shard->sketch[row][bdr_sketch_slot(hash, row)], __ATOMIC_RELAXED);
+        if (c < best) best = c;
+    }
+    return best;
+}
 
-    // Memory Mode
+static size_t bdr_iov_len(const struct iovec *iov, int iov_cnt) {
+    size_t len = 0;
+    for (int i = 0; i < iov_cnt; i++) len += iov[i].iov_len;
+    return len;
+}
 
-    size_t idx = h % bdr->bucket_count;
+#define BDR_REPLY_IOV 16
+
+/*
+ * A sent reply with its per-hit header lines cut out. The iovecs point into
+ * the caller's buffers: the kept pieces of the head, whatever followed the
+ * head in the same buffer, then the remaining iovecs as given. Identical
+ * replies that differ only in those lines yield identical views.
+ */
+typedef struct bdr_reply {
+    struct iovec iov[BDR_REPLY_IOV];
+    int iov_cnt;               ///< 0 when the reply does not fit the view
+    size_t head_len;           ///< Bytes of the cut head; 0 if no HTTP head was found
+    bool request_id;
+    bool conn_close;
+} bdr_reply;
+
+static bool bdr_reply_push(bdr_reply *reply, const void *base, size_t len) {
+    if (len == 0) return true;
+    if (reply->iov_cnt == BDR_REPLY_IOV) return false;
+    reply->iov[reply->iov_cnt].iov_base = (void *)base;
+    reply->iov[reply->iov_cnt].iov_len = len;
+    reply->iov_cnt++;
+    return true;
+}
 
-    bdr_entry_t *prev = NULL;
-    bdr_entry_t *curr = bdr->buckets[idx];
+/* Header names BDR rewrites on every hit. */
+static bool bdr_line_is(const char *line, size_t len, const char *name) {
+    size_t n = strlen(name);
+    return len > n && line[n] == ':' && strncasecmp(line, name, n) == 0;
+}
 
-    while (curr) {
+static bool bdr_reply_cut_head(const struct iovec *iov, int iov_cnt, bdr_reply *reply) {
+    const char *p = (const char *)iov[0].iov_base;
+    const char *blank = memmem(p, iov[0].iov_len, "\r\n\r\n", 4);
+    if (!blank) return false;
+    const char *head_end = blank + 4;
+    const char *line = memchr(p, '\n', (size_t)(head_end - p)) + 1; // Skip the status line
+    const char *kept = p;
+
+    while (line < blank + 2) {
+        const char *nl = memchr(line, '\n', (size_t)(head_end - line));
+        size_t len = (size_t)(nl - line) + 1;
+        bool conn = bdr_line_is(line, len, "Connection");
+        bool rid = bdr_line_is(line, len, "X-Request-Id");
+        if (conn || rid || bdr_line_is(line, len, "Date") || bdr_line_is(line, len, "Age")) {
+            if (!bdr_reply_push(reply, kept, (size_t)(line - kept))) return false;
+            reply->head_len += (size_t)(line - kept);
+            kept = line + len;
+            if (conn && memmem(line, len, "close", 5)) reply->conn_close = true;
+            if (rid) reply->request_id = true;
+        }
+        line = nl + 1;
+    }
+    if (!bdr_reply_push(reply, kept, (size_t)(head_end - kept))) return false;
+    reply->head_len += (size_t)(head_end - kept);
+    // Split off what followed the head so a contiguous reply views like a sent one.
+    if (!bdr_reply_push(reply, head_end, iov[0].iov_len - (size_t)(head_end - p))) return false;
+    for (int i = 1; i < iov_cnt; i++) {
+        if (!bdr_reply_push(reply, iov[i].iov_base, iov[i].iov_len)) return false;
+    }
+    return true;
+}
 
-        if (curr->request_hash == h) {
+static void bdr_reply_view(const struct iovec *iov, int iov_cnt, bdr_reply *reply) {
+    memset(reply, 0, sizeof(*reply));
+    if (!iov || iov_cnt <= 0) return;
+    if (bdr_reply_cut_head(iov, iov_cnt, reply)) return;
 
-            curr->hits++;
+    // Not an HTTP head we can template: keep the bytes as they are.
+    memset(reply, 0, sizeof(*reply));
+    for (int i = 0; i < iov_cnt; i++) {
+        if (!bdr_reply_push(reply, iov[i].iov_base, iov[i].iov_len)) {
+            reply->iov_cnt = 0;
+            return;
+        }
+    }
+}
 
-            if (bdr_entry_should_decay(bdr, curr, time(NULL))) {
-                bdr_remove_entry(bdr, idx, prev, curr);
-                return NULL;
-            }
+/* True when `pin` is the managed body in the last iovec and may be adopted. */
+static bool bdr_pin_matches(const bdr_reply *reply, const cwist_http_body_pin *pin) {
+    return pin && pin->cleanup && reply->iov_cnt > 0 && reply->iov[reply->iov_cnt - 1].iov_base == pin->ptr &&
+           reply->iov[reply->iov_cnt - 1].iov_len == pin->len;
+}
 
-            if (curr->is_stable && curr->response_blob) {
+/* Copies the reply into one blob, except a matching pinned body, which the blob adopts. */
+static cwist_bdr_blob *bdr_blob_create(const bdr_reply *reply, cwist_http_body_pin *pin) {
+    bool adopt = bdr_pin_matches(reply, pin);
+    int copied = adopt ? reply->iov_cnt - 1 : reply->iov_cnt;
+    size_t len = bdr_iov_len(reply->iov, copied);
+    cwist_bdr_blob *blob = (cwist_bdr_blob *)cwist_alloc(sizeof(cwist_bdr_blob) + len);
+    if (!blob) return NULL;
+    blob->refs = 1;
+    blob->len = len;
+    blob->head_split = reply->head_len ? reply->head_len - 2 : 0;
+    blob->request_id = reply->request_id;
+    blob->conn_close = reply->conn_close;
+    blob->born = time(NULL);
+    size_t offset = 0;
+    for (int i = 0; i < copied; i++) {
+        memcpy(blob->data + offset, reply->iov[i].iov_base, reply->iov[i].iov_len);
+        offset += reply->iov[i].iov_len;
+    }
+    if (adopt) {
+        blob->body = (const unsigned char *)pin->ptr;
+        blob->body_len = pin->len;
+        blob->body_release = pin->cleanup;
+        blob->body_release_ctx = pin->ctx;
+        pin->cleanup = NULL;
+    }
+    return blob;
+}
 
-                if (out_len) *out_len = curr->len;
+static size_t bdr_blob_size(const cwist_bdr_blob *blob) {
+    return blob->len + blob->body_len;
+}
 
-                return curr->response_blob;
+void cwist_bdr_blob_release(cwist_bdr_blob *blob) {
+    if (!blob) return;
+    if (__atomic_sub_fetch(&blob->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        if (blob->body_release) blob->body_release(blob->body, blob->body_len, blob->body_release_ctx);
+        cwist_free(blob);
+    }
+}
 
-            }
+/* IMF-fixdate for `now`, formatted at most once a second per thread. */
+static const char *bdr_http_date(time_t now) {
+    static __thread time_t cached_sec;
+    static __thread char cached[40];
+    if (now != cached_sec || !cached[0]) {
+        struct tm tm;
+        gmtime_r(&now, &tm);
+        strftime(cached, sizeof(cached), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        cached_sec = now;
+    }
+    return cached;
+}
 
-            return NULL; // Found but not stable yet
+void cwist_bdr_splice_reply(const cwist_bdr_blob *blob, const cwist_http_request *req, cwist_bdr_splice *out) {
+    out->keep_alive = req && req->keep_alive && !blob->conn_close;
+    if (!blob->head_split) {
+        out->iov[0] = (struct iovec){ .iov_base = (void *)blob->data, .iov_len = blob->len };
+        out->iov[1] = (struct iovec){ .iov_base = (void *)blob->body, .iov_len = blob->body_len };
+        out->iov_cnt = blob->body ? 2 : 1;
+        return;
+    }
 
+    time_t now = time(NULL);
+    time_t born = __atomic_load_n(&blob->born, __ATOMIC_RELAXED);
+    int n = snprintf(out->headers, sizeof(out->headers), "Date: %s\r\nConnection: %s\r\nAge: %lld\r\n",
+                     bdr_http_date(now), out->keep_alive ? "keep-alive" : "close",
+                     (long long)(now > born ? now - born : 0));
+    if (blob->request_id) {
+        const char *rid = req ? cwist_http_header_get(req->headers, "X-Request-Id") : NULL;
+        char fresh[CWIST_MW_REQUEST_ID_LEN + 1];
+        if (!rid || strlen(rid) > CWIST_BDR_REQUEST_ID_MAX) {
+            cwist_mw_request_id_fill(fresh);
+            rid = fresh;
         }
-
-        prev = curr;
-        curr = curr->next;
-
+        n += snprintf(out->headers + n, sizeof(out->headers) - (size_t)n, "X-Request-Id: %s\r\n", rid);
     }
 
-    return NULL;
-
+    out->iov[0] = (struct iovec){ .iov_base = (void *)blob->data, .iov_len = blob->head_split };
+    out->iov[1] = (struct iovec){ .iov_base = out->headers, .iov_len = (size_t)n };
+    out->iov[2] = (struct iovec){ .iov_base = (void *)(blob->data + blob->head_split),
+                                  .iov_len = blob->len - blob->head_split };
+    out->iov[3] = (struct iovec){ .iov_base = (void *)blob->body, .iov_len = blob->body_len };
+    out->iov_cnt = blob->body ? 4 : 3;
 }
 
+static void bdr_blob_retire(void *blob) {
+    cwist_bdr_blob_release((cwist_bdr_blob *)blob);
+}
 
+static void bdr_entry_retire(void *ptr) {
+    bdr_entry_t *entry = (bdr_entry_t *)ptr;
+    cwist_bdr_blob_release(entry->blob);
+    cwist_free(entry->key);
+    cwist_free(entry->vary);
+    cwist_free(entry);
+}
 
-void cwist_bdr_put(cwist_bdr_t *bdr, const char *method, const char *path, const void *data, size_t len) {
-
-    if (!bdr || !method || !path || !data || len == 0) return;
+/*
+ * Evictions under a shard lock only queue what they retire; the thread that
+ * queued something reclaims once, after the lock is dropped, so cleanups never
+ * run inside the critical section and a pass that evicts many entries pays
+ * for one reclaim.
+ */
+static __thread bool bdr_reclaim_due = false;
+
+static void bdr_shard_unlock(cwist_bdr_shard *shard) {
+    pthread_mutex_unlock(&shard->lock);
+    if (bdr_reclaim_due) {
+        bdr_reclaim_due = false;
+        cwist_epoch_reclaim();
+    }
+}
 
-    if (strcmp(method, "GET") != 0) return;
+/* Unpublishes the entry's blob. Shard lock held. */
+static void bdr_release_blob(cwist_bdr_shard *shard, bdr_entry_t *entry) {
+    cwist_bdr_blob *blob = __atomic_exchange_n(&entry->blob, NULL, __ATOMIC_ACQ_REL);
+    entry->is_stable = false;
+    if (!blob) return;
+    size_t size = bdr_blob_size(blob);
+    shard->current_bytes = shard->current_bytes >= size ? shard->current_bytes - size : 0;
+    cwist_epoch_retire_deferred(blob, bdr_blob_retire);
+    bdr_reclaim_due = true;
+}
 
+/* Unlinks `entry`, which `*link` points at. Shard lock held. */
+static void bdr_remove_entry(cwist_bdr_shard *shard, bdr_entry_t **link, bdr_entry_t *entry) {
+    __atomic_store_n(link, entry->next, __ATOMIC_RELEASE);
+    bdr_clock_drop(shard, entry);
+    if (entry->blob) {
+        size_t size = bdr_blob_size(entry->blob);
+        shard->current_bytes = shard->current_bytes >= size ? shard->current_bytes - size : 0;
+    }
+    cwist_epoch_retire_deferred(entry, bdr_entry_retire);
+    bdr_reclaim_due = true;
+}
 
+/* --- Disk tier --- */
+
+#define BDR_DISK_MAGIC 0x53524442u /* "BDRS" */
+
+/*
+ * A record in the segment file: this header, the key, the head template
+ * (copied back to RAM per hit so Date etc. can be spliced), then the rest of
+ * the reply, which hits send straight from the mapping.
+ */
+typedef struct bdr_disk_record {
+    uint32_t magic;
+    uint32_t key_len;
+    uint64_t head_len;
+    uint64_t tail_len;
+    uint64_t response_hash;
+    int64_t born;
+    uint8_t request_id;
+    uint8_t conn_close;
+    uint8_t pad[6];
+} bdr_disk_record;
+
+static size_t bdr_disk_record_size(size_t key_len, size_t reply_len) {
+    return (sizeof(bdr_disk_record) + key_len + reply_len + 7) & ~(size_t)7;
+}
 
-    // Check RAM health before adding
+static cwist_bdr_disk *bdr_disk_get(const cwist_bdr_t *bdr) {
+    return __atomic_load_n(&bdr->disk, __ATOMIC_ACQUIRE);
+}
 
-    bdr_check_ram(bdr);
+static size_t bdr_disk_bucket_of(const uint64_t hash[2]) {
+    return (size_t)(hash[1] & (CWIST_BDR_DISK_BUCKETS - 1));
+}
 
+static pthread_mutex_t *bdr_disk_lock_of(cwist_bdr_disk *disk, size_t bucket) {
+    return &disk->index_locks[bucket & (CWIST_BDR_DISK_LOCKS - 1)];
+}
 
+/* Creates, unlinks and maps a segment file of `size` bytes. Returns MAP_FAILED on error. */
+static unsigned char *bdr_disk_map_file(const char *dir, size_t size, int *fd_out) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/cwist_bdr.%ld.seg", dir ? dir : ".", (long)getpid());
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) return MAP_FAILED;
+    // Nobody else needs a name for it, and it cannot outlive the process.
+    unlink(path);
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return MAP_FAILED;
+    }
+    madvise(map, size, MADV_RANDOM);
+    *fd_out = fd;
+    return (unsigned char *)map;
+}
 
-    uint64_t req_h = bdr_hash(method, path);
+/*
+ * Contexts with an open disk tier. A MAP_SHARED segment file inherited over
+ * fork() would be appended to by parent and child with separate cursors, so
+ * the child handler gives every child a private copy (see bdr_atfork_child).
+ * Lock order: registry, then disk_lock, then the stripe locks.
+ */
+static pthread_mutex_t bdr_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static cwist_bdr_t *bdr_registry;
+static pthread_once_t bdr_atfork_once = PTHREAD_ONCE_INIT;
+
+/* Holds every disk lock across fork() so the child never inherits one mid-update. */
+static void bdr_atfork_prepare(void) {
+    pthread_mutex_lock(&bdr_registry_lock);
+    for (cwist_bdr_t *bdr = bdr_registry; bdr; bdr = bdr->disk_next) {
+        pthread_mutex_lock(&bdr->disk_lock);
+        for (size_t i = 0; i < CWIST_BDR_DISK_LOCKS; i++) pthread_mutex_lock(&bdr->disk->index_locks[i]);
+    }
+}
 
-    uint64_t res_h = bdr_hash_data(data, len);
+static void bdr_atfork_release(void) {
+    for (cwist_bdr_t *bdr = bdr_registry; bdr; bdr = bdr->disk_next) {
+        for (size_t i = 0; i < CWIST_BDR_DISK_LOCKS; i++) pthread_mutex_unlock(&bdr->disk->index_locks[i]);
+        pthread_mutex_unlock(&bdr->disk_lock);
+    }
+    pthread_mutex_unlock(&bdr_registry_lock);
+}
 
+static void bdr_disk_close(cwist_bdr_disk *disk);
+
+/*
+ * Moves the child onto its own segment file, copying what was appended so
+ * far so the inherited index stays valid. Threads that held pins did not
+ * survive the fork, so the pins are cleared. A child that cannot get a file
+ * of its own loses the tier rather than share the parent's.
+ */
+static void bdr_atfork_child(void) {
+    bool lost = false;
+    for (cwist_bdr_t **link = &bdr_registry; *link;) {
+        cwist_bdr_t *bdr = *link;
+        cwist_bdr_disk *disk = bdr->disk;
+        int fd = -1;
+        unsigned char *map = bdr_disk_map_file(bdr->disk_dir, disk->capacity, &fd);
+        if (map != MAP_FAILED) {
+            for (size_t i = 0; i < CWIST_BDR_DISK_SEGMENTS; i++) {
+                memcpy(map + disk->segments[i].base, disk->map + disk->segments[i].base, disk->segments[i].used);
+                disk->segments[i].pins = 0;
+            }
+            munmap(disk->map, disk->capacity);
+            close(disk->fd);
+            disk->map = map;
+            disk->fd = fd;
+        }
+        for (size_t i = 0; i < CWIST_BDR_DISK_LOCKS; i++) pthread_mutex_unlock(&disk->index_locks[i]);
+        pthread_mutex_unlock(&bdr->disk_lock);
+        if (map != MAP_FAILED) {
+            link = &bdr->disk_next;
+            continue;
+        }
+        bdr->disk = NULL;
+        bdr->is_disk_mode = false;
+        *link = bdr->disk_next;
+        bdr->disk_next = NULL;
+        bdr_disk_close(disk);
+        lost = true;
+    }
+    pthread_mutex_unlock(&bdr_registry_lock);
+    if (lost) {
+        // Another thread may have held stdio's lock at fork time.
+        static const char msg[] = "[BDR] Could not copy the disk tier after fork; continuing without it.\n";
+        ssize_t n = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        (void)n;
+    }
+}
 
+static void bdr_atfork_register(void) {
+    pthread_atfork(bdr_atfork_prepare, bdr_atfork_release, bdr_atfork_child);
+}
 
-    if (bdr->is_disk_mode) {
+/* Creates, unlinks and maps the segment file. Registry lock and disk_lock held. */
+static cwist_bdr_disk *bdr_disk_open_locked(cwist_bdr_t *bdr) {
+    size_t capacity = bdr->disk_capacity ? bdr->disk_capacity : BDR_DEFAULT_DISK_CAPACITY;
+    size_t segment_size = (capacity / CWIST_BDR_DISK_SEGMENTS) & ~(size_t)7;
+    if (segment_size < sizeof(bdr_disk_record)) return NULL;
+    pthread_once(&bdr_atfork_once, bdr_atfork_register);
+
+    int fd = -1;
+    unsigned char *map = bdr_disk_map_file(bdr->disk_dir, segment_size * CWIST_BDR_DISK_SEGMENTS, &fd);
+    if (map == MAP_FAILED) return NULL;
+    cwist_bdr_disk *disk = (cwist_bdr_disk *)cwist_alloc(sizeof(cwist_bdr_disk));
+    if (!disk) {
+        munmap(map, segment_size * CWIST_BDR_DISK_SEGMENTS);
+        close(fd);
+        return NULL;
+    }
+    disk->fd = fd;
+    disk->map = map;
+    disk->segment_size = segment_size;
+    disk->capacity = segment_size * CWIST_BDR_DISK_SEGMENTS;
+    for (size_t i = 0; i < CWIST_BDR_DISK_SEGMENTS; i++) disk->segments[i].base = i * segment_size;
+    for (size_t i = 0; i < CWIST_BDR_DISK_LOCKS; i++) pthread_mutex_init(&disk->index_locks[i], NULL);
+    __atomic_store_n(&bdr->disk, disk, __ATOMIC_RELEASE);
+    bdr->disk_next = bdr_registry;
+    bdr_registry = bdr;
+    return disk;
+}
 
-         // In disk mode, we assume stability check is too expensive or we just dump.
+static cwist_bdr_disk *bdr_disk_open(cwist_bdr_t *bdr) {
+    cwist_bdr_disk *disk = bdr_disk_get(bdr);
+    if (disk) return disk;
+    pthread_mutex_lock(&bdr_registry_lock);
+    pthread_mutex_lock(&bdr->disk_lock);
+    disk = bdr->disk ? bdr->disk : bdr_disk_open_locked(bdr);
+    pthread_mutex_unlock(&bdr->disk_lock);
+    pthread_mutex_unlock(&bdr_registry_lock);
+    return disk;
+}
 
-         // Actually, to respect "Stability Check" even on disk, we need read-modify-write.
+static void bdr_disk_close(cwist_bdr_disk *disk) {
+    if (!disk) return;
+    for (size_t i = 0; i < CWIST_BDR_DISK_BUCKETS; i++) {
+        cwist_bdr_disk_entry *curr = disk->buckets[i];
+        while (curr) {
+            cwist_bdr_disk_entry *next = curr->next;
+            cwist_free(curr);
+            curr = next;
+        }
+    }
+    for (size_t i = 0; i < CWIST_BDR_DISK_LOCKS; i++) pthread_mutex_destroy(&disk->index_locks[i]);
+    munmap(disk->map, disk->capacity);
+    close(disk->fd);
+    cwist_free(disk);
+}
 
-         // But disk is fallback. Let's just update.
+static bdr_disk_record *bdr_disk_record_at(const cwist_bdr_disk *disk, const cwist_bdr_disk_entry *entry) {
+    return (bdr_disk_record *)(disk->map + entry->offset);
+}
 
-         // Or simpler: Disk mode = Emergency. Just save it.
+/* The key's stripe lock held. Keys are compared against the copy in the mapping. */
+static cwist_bdr_disk_entry **bdr_disk_find_link(cwist_bdr_disk *disk, const char *key, size_t key_len,
+                                                 const uint64_t hash[2]) {
+    cwist_bdr_disk_entry **link = &disk->buckets[bdr_disk_bucket_of(hash)];
+    for (; *link; link = &(*link)->next) {
+        cwist_bdr_disk_entry *curr = *link;
+        if (curr->request_hash[0] != hash[0] || curr->request_hash[1] != hash[1]) continue;
+        const bdr_disk_record *rec = bdr_disk_record_at(disk, curr);
+        if (rec->key_len == key_len && memcmp(rec + 1, key, key_len) == 0) return link;
+    }
+    return NULL;
+}
 
-         sqlite3_stmt *stmt;
+/* The entry's stripe lock held. */
+static void bdr_disk_unlink(cwist_bdr_disk *disk, cwist_bdr_disk_entry **link) {
+    cwist_bdr_disk_entry *entry = *link;
+    __atomic_store_n(link, entry->next, __ATOMIC_RELEASE);
+    __atomic_sub_fetch(&disk->entries, 1, __ATOMIC_RELAXED);
+    cwist_free(entry);
+}
 
-         sqlite3_prepare_v2(bdr->disk_db, "INSERT OR REPLACE INTO bdr (hash, blob) VALUES (?, ?);", -1, &stmt, NULL);
+/*
+ * Empties the oldest segment so appends can wrap into it. disk_lock held.
+ * Hits pin a segment under their stripe lock, so once every stripe has been
+ * swept of the segment's entries no new pin can appear, and the count read
+ * afterwards is final.
+ */
+static bool bdr_disk_recycle(cwist_bdr_disk *disk, size_t segment) {
+    // A hit may still be sending from it.
+    if (__atomic_load_n(&disk->segments[segment].pins, __ATOMIC_ACQUIRE) > 0) return false;
+    for (size_t stripe = 0; stripe < CWIST_BDR_DISK_LOCKS; stripe++) {
+        pthread_mutex_lock(&disk->index_locks[stripe]);
+        for (size_t i = stripe; i < CWIST_BDR_DISK_BUCKETS; i += CWIST_BDR_DISK_LOCKS) {
+            cwist_bdr_disk_entry **link = &disk->buckets[i];
+            while (*link) {
+                if ((*link)->segment == segment) bdr_disk_unlink(disk, link);
+                else link = &(*link)->next;
+            }
+        }
+        pthread_mutex_unlock(&disk->index_locks[stripe]);
+    }
+    // A hit that got in during the sweep: its replies are gone, but the bytes must stay until it is sent.
+    if (__atomic_load_n(&disk->segments[segment].pins, __ATOMIC_ACQUIRE) > 0) return false;
+    disk->segments[segment].used = 0;
+    return true;
+}
 
-         sqlite3_bind_int64(stmt, 1, req_h);
+/*
+ * Appends a stable reply and points the index at it. disk_lock held; the
+ * stripe lock is taken only to check the index and to publish the record.
+ */
+static bool bdr_disk_append(cwist_bdr_disk *disk, const char *key, size_t key_len, const uint64_t hash[2],
+                            const cwist_bdr_blob *blob, uint64_t response_hash, time_t created_at) {
+    size_t head_len = blob->head_split ? blob->head_split + 2 : 0;
+    size_t need = bdr_disk_record_size(key_len, bdr_blob_size(blob));
+    if (need > disk->segment_size) return false;
+    size_t bucket = bdr_disk_bucket_of(hash);
+    pthread_mutex_t *lock = bdr_disk_lock_of(disk, bucket);
+
+    pthread_mutex_lock(lock);
+    cwist_bdr_disk_entry **link = bdr_disk_find_link(disk, key, key_len, hash);
+    bool current = link && (*link)->response_hash == response_hash;
+    // Already there: just as fresh as the RAM copy.
+    if (current && (*link)->created_at < created_at) (*link)->created_at = created_at;
+    pthread_mutex_unlock(lock);
+    if (current) return true;
+
+    cwist_bdr_segment *segment = &disk->segments[disk->active];
+    if (segment->used + need > disk->segment_size) {
+        size_t next = (disk->active + 1) % CWIST_BDR_DISK_SEGMENTS;
+        if (!bdr_disk_recycle(disk, next)) return false;
+        disk->active = next;
+        segment = &disk->segments[next];
+    }
+    cwist_bdr_disk_entry *fresh = (cwist_bdr_disk_entry *)cwist_alloc(sizeof(cwist_bdr_disk_entry));
+    if (!fresh) return false;
+
+    // Nothing indexes these bytes yet, so readers cannot see them half written.
+    size_t offset = segment->base + segment->used;
+    bdr_disk_record *rec = (bdr_disk_record *)(disk->map + offset);
+    *rec = (bdr_disk_record){
+        .magic = BDR_DISK_MAGIC,
+        .key_len = (uint32_t)key_len,
+        .head_len = head_len,
+        .tail_len = bdr_blob_size(blob) - head_len,
+        .response_hash = response_hash,
+        .born = __atomic_load_n(&blob->born, __ATOMIC_RELAXED),
+        .request_id = blob->request_id,
+        .conn_close = blob->conn_close,
+    };
+    unsigned char *p = (unsigned char *)(rec + 1);
+    memcpy(p, key, key_len);
+    memcpy(p + key_len, blob->data, blob->len);
+    if (blob->body_len) memcpy(p + key_len + blob->len, blob->body, blob->body_len);
+    segment->used += need;
+
+    pthread_mutex_lock(lock);
+    link = bdr_disk_find_link(disk, key, key_len, hash); // Recycling may have dropped it
+    cwist_bdr_disk_entry *entry = link ? *link : fresh;
+    entry->response_hash = response_hash;
+    entry->created_at = created_at;
+    entry->offset = offset;
+    entry->segment = (size_t)(segment - disk->segments);
+    if (!link) {
+        entry->request_hash[0] = hash[0];
+        entry->request_hash[1] = hash[1];
+        entry->next = disk->buckets[bucket];
+        __atomic_store_n(&disk->buckets[bucket], entry, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&disk->entries, 1, __ATOMIC_RELAXED);
+        fresh = NULL;
+    }
+    pthread_mutex_unlock(lock);
+    cwist_free(fresh);
+    disk->stat_demoted++;
+    return true;
+}
 
-         sqlite3_bind_blob(stmt, 2, data, len, SQLITE_STATIC);
+/* Demotes a stable reply. Called with a shard lock held: shard lock, then disk_lock, then a stripe lock. */
+static bool bdr_disk_store(cwist_bdr_t *bdr, const char *key, size_t key_len, const uint64_t hash[2],
+                           const cwist_bdr_blob *blob, uint64_t response_hash, time_t created_at) {
+    cwist_bdr_disk *disk = bdr_disk_get(bdr);
+    if (!disk || !blob) return false;
+    pthread_mutex_lock(&bdr->disk_lock);
+    bool ok = bdr_disk_append(disk, key, key_len, hash, blob, response_hash, created_at);
+    pthread_mutex_unlock(&bdr->disk_lock);
+    return ok;
+}
 
-         sqlite3_step(stmt);
+static void bdr_disk_unpin(const void *ptr, size_t len, void *ctx) {
+    (void)ptr;
+    (void)len;
+    __atomic_sub_fetch(&((cwist_bdr_segment *)ctx)->pins, 1, __ATOMIC_RELEASE);
+}
 
-         sqlite3_finalize(stmt);
+/* A hit on disk: the head template is copied, the rest is sent from the pinned mapping. Stripe lock held. */
+static cwist_bdr_blob *bdr_disk_blob(cwist_bdr_disk *disk, const cwist_bdr_disk_entry *entry) {
+    const bdr_disk_record *rec = bdr_disk_record_at(disk, entry);
+    const unsigned char *head = (const unsigned char *)(rec + 1) + rec->key_len;
+    cwist_bdr_blob *blob = (cwist_bdr_blob *)cwist_alloc(sizeof(cwist_bdr_blob) + rec->head_len);
+    if (!blob) return NULL;
+    cwist_bdr_segment *segment = &disk->segments[entry->segment];
+    blob->refs = 1;
+    blob->len = rec->head_len;
+    memcpy(blob->data, head, rec->head_len);
+    blob->body = head + rec->head_len;
+    blob->body_len = rec->tail_len;
+    blob->body_release = bdr_disk_unpin;
+    blob->body_release_ctx = segment;
+    blob->head_split = rec->head_len ? rec->head_len - 2 : 0;
+    blob->request_id = rec->request_id;
+    blob->conn_close = rec->conn_close;
+    blob->born = (time_t)rec->born;
+    __atomic_add_fetch(&segment->pins, 1, __ATOMIC_ACQ_REL);
+    return blob;
+}
 
-         bdr_guardrails(bdr);
+/* Looks `key` up on disk, with the same TTL and stale grace as RAM replies. */
+static cwist_bdr_blob *bdr_disk_lookup(cwist_bdr_t *bdr, const bdr_key *key, time_t now, bool *stale) {
+    cwist_bdr_disk *disk = bdr_disk_get(bdr);
+    if (!disk) return NULL;
+    time_t max_age = __atomic_load_n(&bdr->max_entry_age_sec, __ATOMIC_RELAXED);
+    time_t max_stale = __atomic_load_n(&bdr->max_stale_sec, __ATOMIC_RELAXED);
+    size_t bucket = bdr_disk_bucket_of(key->hash);
+    // Nothing demoted in this bucket: the common RAM miss takes no lock.
+    if (!__atomic_load_n(&disk->buckets[bucket], __ATOMIC_ACQUIRE)) return NULL;
+    cwist_bdr_blob *blob = NULL;
+
+    pthread_mutex_t *lock = bdr_disk_lock_of(disk, bucket);
+    pthread_mutex_lock(lock);
+    cwist_bdr_disk_entry **link = bdr_disk_find_link(disk, key->data, key->len, key->hash);
+    if (link) {
+        time_t age = now - (*link)->created_at;
+        if (max_age > 0 && age > max_age + max_stale) {
+            bdr_disk_unlink(disk, link);
+        } else {
+            blob = bdr_disk_blob(disk, *link);
+            *stale = max_age > 0 && age > max_age;
+        }
+    }
+    pthread_mutex_unlock(lock);
+    if (blob) __atomic_add_fetch(&disk->stat_hits, 1, __ATOMIC_RELAXED);
+    return blob;
+}
 
-         return;
+/*
+ * A reply for `key` was just produced. If the disk holds the same bytes they
+ * are fresh again (and returned, referenced, when `want` is set); if it holds
+ * different bytes, they are no longer the reply and are dropped.
+ */
+static cwist_bdr_blob *bdr_disk_observe(cwist_bdr_t *bdr, const bdr_key *key, uint64_t response_hash, bool want) {
+    cwist_bdr_disk *disk = bdr_disk_get(bdr);
+    if (!disk) return NULL;
+    size_t bucket = bdr_disk_bucket_of(key->hash);
+    if (!__atomic_load_n(&disk->buckets[bucket], __ATOMIC_ACQUIRE)) return NULL;
+    cwist_bdr_blob *blob = NULL;
+    pthread_mutex_t *lock = bdr_disk_lock_of(disk, bucket);
+    pthread_mutex_lock(lock);
+    cwist_bdr_disk_entry **link = bdr_disk_find_link(disk, key->data, key->len, key->hash);
+    if (link && (*link)->response_hash != response_hash) {
+        bdr_disk_unlink(disk, link);
+    } else if (link) {
+        (*link)->created_at = time(NULL);
+        if (want) blob = bdr_disk_blob(disk, *link);
+    }
+    pthread_mutex_unlock(lock);
+    return blob;
+}
 
+cwist_error_t cwist_bdr_set_disk_tier(cwist_bdr_t *bdr, const char *dir, size_t capacity) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    err.error.err_i16 = -1;
+    if (!bdr) return err;
+    pthread_mutex_lock(&bdr_registry_lock);
+    pthread_mutex_lock(&bdr->disk_lock);
+    if (!bdr->disk) {
+        char *copy = dir ? cwist_strdup(dir) : NULL;
+        if (!dir || copy) {
+            cwist_free(bdr->disk_dir);
+            bdr->disk_dir = copy;
+            if (capacity) bdr->disk_capacity = capacity;
+            if (bdr_disk_open_locked(bdr)) err.error.err_i16 = 0;
+        }
     }
+    pthread_mutex_unlock(&bdr->disk_lock);
+    pthread_mutex_unlock(&bdr_registry_lock);
+    return err;
+}
 
+/* A cached reply past its TTL or hit budget: still served, but due for a refresh. */
+static bool bdr_entry_is_stale(const cwist_bdr_t *bdr, const bdr_entry_t *entry, time_t now) {
+    time_t max_age = __atomic_load_n(&bdr->max_entry_age_sec, __ATOMIC_RELAXED);
+    time_t created_at = __atomic_load_n(&entry->created_at, __ATOMIC_RELAXED);
+    if (max_age > 0 && created_at > 0) {
+        if (now - created_at > max_age) {
+            return true;
+        }
+    }
+    uint64_t revalidate = __atomic_load_n(&bdr->revalidate_hits, __ATOMIC_RELAXED);
+    if (revalidate > 0 && __atomic_load_n(&entry->hits, __ATOMIC_RELAXED) >= revalidate) {
+        return true;
+    }
+    return false;
+}
 
+/*
+ * Past any use: candidates after the TTL, replies once the stale grace has
+ * run out as well. Vary markers only redirect lookups and are left to CLOCK.
+ */
+static bool bdr_entry_expired(const cwist_bdr_t *bdr, const bdr_entry_t *entry, time_t now) {
+    if (!bdr || !entry || entry->vary) return false;
+    time_t max_age = __atomic_load_n(&bdr->max_entry_age_sec, __ATOMIC_RELAXED);
+    time_t created_at = __atomic_load_n(&entry->created_at, __ATOMIC_RELAXED);
+    if (max_age <= 0 || created_at <= 0) return false;
+    if (__atomic_load_n(&entry->blob, __ATOMIC_RELAXED)) max_age += __atomic_load_n(&bdr->max_stale_sec, __ATOMIC_RELAXED);
+    return now - created_at > max_age;
+}
 
-    size_t idx = req_h % bdr->bucket_count;
+/* Drops a CLOCK victim. With the disk tier open, a stable reply moves there instead of being lost. */
+static void bdr_evict(cwist_bdr_t *bdr, cwist_bdr_shard *shard, bdr_entry_t *victim) {
+    if (victim->is_stable && victim->blob && bdr_disk_get(bdr)) {
+        bdr_disk_store(bdr, victim->key, victim->key_len, victim->request_hash, victim->blob,
+                       victim->response_hash, __atomic_load_n(&victim->created_at, __ATOMIC_RELAXED));
+    }
+    bdr_remove_entry(shard, bdr_link_of(shard, victim), victim);
+    __atomic_add_fetch(&shard->stat_evicted, 1, __ATOMIC_RELAXED);
+}
 
-    
+static size_t bdr_shard_budget(const cwist_bdr_t *bdr) {
+    size_t max_bytes = __atomic_load_n(&bdr->max_bytes, __ATOMIC_RELAXED);
+    if (max_bytes == 0) return SIZE_MAX;
+    size_t budget = max_bytes / CWIST_BDR_SHARDS;
+    return budget ? budget : 1;
+}
 
-    // Check exist
+/*
+ * TinyLFU admission: makes room for `extra` bytes (and, for a new entry, one
+ * ring slot) by evicting CLOCK victims, but only while the newcomer has been
+ * looked up more often than each victim. Shard lock held.
+ */
+static bool bdr_admit(cwist_bdr_t *bdr, cwist_bdr_shard *shard, const bdr_entry_t *self,
+                      const uint64_t hash[2], size_t extra, bool new_entry) {
+    size_t budget = bdr_shard_budget(bdr);
+    bool ok = extra <= budget;
+    uint8_t freq = bdr_sketch_estimate(shard, hash);
+    while (ok && new_entry && shard->clock_len >= CWIST_BDR_SHARD_MAX_ENTRIES) {
+        bdr_entry_t *victim = bdr_clock_victim(shard, self, false);
+        if (!victim || freq <= bdr_sketch_estimate(shard, victim->request_hash)) ok = false;
+        else bdr_evict(bdr, shard, victim);
+    }
+    while (ok && extra > 0 && shard->current_bytes + extra > budget) {
+        bdr_entry_t *victim = bdr_clock_victim(shard, self, true);
+        if (!victim || freq <= bdr_sketch_estimate(shard, victim->request_hash)) ok = false;
+        else bdr_evict(bdr, shard, victim);
+    }
+    __atomic_add_fetch(ok ? &shard->stat_admitted : &shard->stat_rejected, 1, __ATOMIC_RELAXED);
+    return ok;
+}
 
-    bdr_entry_t *curr = bdr->buckets[idx];
+static void bdr_sweep(cwist_bdr_t *bdr, cwist_bdr_shard *shard, size_t steps) {
+    time_t now = time(NULL);
+    for (size_t i = 0; i < steps; ++i) {
+        size_t idx = shard->gc_cursor;
+        shard->gc_cursor = (shard->gc_cursor + 1) % CWIST_BDR_SHARD_BUCKETS;
+        bdr_entry_t **link = &shard->buckets[idx];
+        while (*link) {
+            bdr_entry_t *curr = *link;
+            if (bdr_entry_expired(bdr, curr, now)) {
+                bdr_remove_entry(shard, link, curr);
+                continue;
+            }
+            link = &curr->next;
+        }
+    }
+}
 
-    while (curr) {
+/* Shard lock held. Each shard keeps its share of max_bytes; a lowered limit evicts without admission. */
+static void bdr_guardrails(cwist_bdr_t *bdr, cwist_bdr_shard *shard) {
+    bdr_sweep(bdr, shard, BDR_GC_SWEEP);
 
-        if (curr->request_hash == req_h) {
+    size_t budget = bdr_shard_budget(bdr);
+    while (shard->current_bytes > budget) {
+        bdr_entry_t *victim = bdr_clock_victim(shard, NULL, true);
+        if (!victim) break;
+        bdr_evict(bdr, shard, victim);
+    }
+}
 
-            // Entry exists. Check stability.
+cwist_bdr_t *cwist_bdr_create(void) {
+    cwist_bdr_t *bdr = cwist_alloc(sizeof(cwist_bdr_t));
+    if (!bdr) return NULL;
+    for (size_t i = 0; i < CWIST_BDR_SHARDS; i++) {
+        pthread_mutex_init(&bdr->shards[i].lock, NULL);
+    }
+    pthread_mutex_init(&bdr->disk_lock, NULL);
+    pthread_mutex_init(&bdr->snapshot_lock, NULL);
+    bdr->latency_threshold_ms = 10;
+    bdr->max_bytes = BDR_DEFAULT_MAX_BYTES;
+    bdr->max_entry_age_sec = BDR_DEFAULT_ENTRY_TTL;
+    bdr->revalidate_hits = BDR_DEFAULT_REVALIDATE_HITS;
+    bdr->max_stale_sec = BDR_DEFAULT_MAX_STALE;
+    bdr->coalesce_wait_ms = BDR_DEFAULT_COALESCE_WAIT_MS;
+    bdr->disk = NULL;
+    bdr->is_disk_mode = false;
+    bdr->disk_capacity = BDR_DEFAULT_DISK_CAPACITY;
+    bdr->ram_floor = BDR_DEFAULT_RAM_FLOOR;
+    cwist_process_hash_seed(bdr->seed);
+    return bdr;
+}
 
-            if (curr->is_stable) {
+void cwist_bdr_destroy(cwist_bdr_t *bdr) {
+    if (!bdr) return;
+    for (size_t s = 0; s < CWIST_BDR_SHARDS; s++) {
+        cwist_bdr_shard *shard = &bdr->shards[s];
+        for (size_t i = 0; i < CWIST_BDR_SHARD_BUCKETS; i++) {
+            bdr_entry_t *curr = shard->buckets[i];
+            while (curr) {
+                bdr_entry_t *next = curr->next;
+                bdr_entry_retire(curr);
+                curr = next;
+            }
+        }
+        cwist_free(shard->clock);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    if (bdr->disk) {
+        pthread_mutex_lock(&bdr_registry_lock);
+        cwist_bdr_t **link = &bdr_registry;
+        while (*link && *link != bdr) link = &(*link)->disk_next;
+        if (*link) *link = bdr->disk_next;
+        pthread_mutex_unlock(&bdr_registry_lock);
+    }
+    bdr_disk_close(bdr->disk);
+    cwist_free(bdr->disk_dir);
+    pthread_mutex_destroy(&bdr->disk_lock);
+    for (size_t i = 0; i < bdr->version_count; i++) cwist_free(bdr->versions[i].prefix);
+    cwist_free(bdr->versions);
+    pthread_mutex_destroy(&bdr->snapshot_lock);
+    cwist_free(bdr);
+}
 
-                // Already stable. 
+/*
+ * Samples free RAM at most once a second. Below `ram_floor`, stable replies
+ * move to the disk tier and new ones stabilize there; once RAM recovers, new
+ * replies go back to RAM and the demoted ones keep being served from disk.
+ */
+static void bdr_check_ram(cwist_bdr_t *bdr) {
+    time_t now = time(NULL);
+    if (__atomic_exchange_n(&bdr->ram_checked_at, now, __ATOMIC_RELAXED) == now) return;
 
-                // Optional: Re-verify occasionally? For now, assume "Big Dumb" means permanent.
+    bool critical = cwist_is_ram_critical(__atomic_load_n(&bdr->ram_floor, __ATOMIC_RELAXED));
+    if (!critical) {
+        if (__atomic_exchange_n(&bdr->is_disk_mode, false, __ATOMIC_ACQ_REL)) {
+            printf("[BDR] RAM recovered. Caching replies in memory again.\n");
+        }
+        return;
+    }
+    if (__atomic_load_n(&bdr->is_disk_mode, __ATOMIC_ACQUIRE) || !bdr_disk_open(bdr)) return;
+    bool expected = false;
+    if (!__atomic_compare_exchange_n(&bdr->is_disk_mode, &expected, true, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return;
+    printf("[BDR] Low RAM. Demoting cached replies to the segment file.\n");
+
+    // One shard at a time; candidates and Vary markers are small and stay.
+    for (size_t s = 0; s < CWIST_BDR_SHARDS; s++) {
+        cwist_bdr_shard *shard = &bdr->shards[s];
+        pthread_mutex_lock(&shard->lock);
+        for (size_t i = 0; i < CWIST_BDR_SHARD_BUCKETS; i++) {
+            bdr_entry_t **link = &shard->buckets[i];
+            while (*link) {
+                bdr_entry_t *curr = *link;
+                if (curr->is_stable && curr->blob) {
+                    bdr_evict(bdr, shard, curr);
+                    continue;
+                }
+                link = &curr->next;
+            }
+        }
+        bdr_shard_unlock(shard);
+    }
+}
 
-                // If we want to detect changes:
+/* Hashes the reply segment by segment; the send path always splits a reply the same way. */
+static uint64_t bdr_hash_iov(const cwist_bdr_t *bdr, const struct iovec *iov, int iov_cnt) {
+    uint64_t hash = 0;
+    for (int i = 0; i < iov_cnt; i++) {
+        hash = (hash * 0x9E3779B97F4A7C15ULL) ^ siphash24(iov[i].iov_base, iov[i].iov_len, bdr->seed);
+    }
+    return hash;
+}
 
-                if (curr->response_hash != res_h) {
+/* Drops the entry for `key` if it has expired. */
+static void bdr_remove_expired(cwist_bdr_t *bdr, cwist_bdr_shard *shard, const bdr_key *key) {
+    pthread_mutex_lock(&shard->lock);
+    bdr_entry_t **link = bdr_find_link(shard, key);
+    if (link && bdr_entry_expired(bdr, *link, time(NULL))) bdr_remove_entry(shard, link, *link);
+    bdr_shard_unlock(shard);
+}
 
-                    // Changed! Invalidated.
+static bool bdr_cacheable_request(const cwist_http_request *req) {
+    return req && req->method == CWIST_HTTP_GET && req->path && req->path->data;
+}
 
-                    // Downgrade to unstable? Or update immediately?
+typedef struct {
+    cwist_bdr_blob *blob;   ///< Referenced reply, fresh or stale
+    bool stale;
+    bool known;             ///< A candidate whose reply has repeated so far
+} bdr_probe_state;
+
+/* Lock-free lookup shared by get and acquire. Leaves the final key in `key`. */
+static bool bdr_probe(cwist_bdr_t *bdr, const cwist_http_request *req, bdr_key *key, bdr_probe_state *state) {
+    memset(state, 0, sizeof(*state));
+    if (!bdr_key_build_base(bdr, req, key)) return false;
+    cwist_bdr_shard *shard = bdr_shard_of(bdr, key->hash);
+    time_t now = time(NULL);
+    bool expired = false;
+
+    cwist_epoch_pin();
+    bdr_entry_t *entry = bdr_find(shard, key);
+    if (entry && entry->vary) {
+        // The reply varies on request headers: look again under the full key.
+        __atomic_store_n(&entry->referenced, 1, __ATOMIC_RELAXED);
+        bdr_sketch_touch(shard, key->hash);
+        if (bdr_key_extend_vary(bdr, req, entry->vary, key)) {
+            shard = bdr_shard_of(bdr, key->hash);
+            entry = bdr_find(shard, key);
+        } else {
+            entry = NULL;
+        }
+    }
+    if (key->ok) bdr_sketch_touch(shard, key->hash);
+    if (entry && !entry->vary) {
+        __atomic_store_n(&entry->referenced, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&entry->hits, 1, __ATOMIC_RELAXED);
+        cwist_bdr_blob *blob = __atomic_load_n(&entry->blob, __ATOMIC_ACQUIRE);
+        if (bdr_entry_expired(bdr, entry, now)) {
+            expired = true;
+        } else if (blob) {
+            // The cache's own reference cannot drop before we unpin.
+            __atomic_add_fetch(&blob->refs, 1, __ATOMIC_RELAXED);
+            state->blob = blob;
+            state->stale = bdr_entry_is_stale(bdr, entry, now);
+        } else {
+            state->known = !__atomic_load_n(&entry->reply_changed, __ATOMIC_RELAXED);
+        }
+    }
+    cwist_epoch_unpin();
+
+    if (!key->ok) return false;
+    // Not in RAM: it may have been demoted.
+    if (!state->blob && !expired) state->blob = bdr_disk_lookup(bdr, key, now, &state->stale);
+    __atomic_add_fetch(state->blob ? &shard->stat_hits : &shard->stat_misses, 1, __ATOMIC_RELAXED);
+    if (state->stale) __atomic_add_fetch(&shard->stat_stale, 1, __ATOMIC_RELAXED);
+    if (expired) bdr_remove_expired(bdr, shard, key);
+    return true;
+}
 
-                    // "Only cache if totally matching".
+cwist_bdr_blob *cwist_bdr_get(cwist_bdr_t *bdr, const cwist_http_request *req) {
+    if (!bdr || !bdr_cacheable_request(req)) return NULL;
 
-                    // If it changed, it's not dumb-cacheable.
+    bdr_key key;
+    bdr_probe_state state;
+    bdr_probe(bdr, req, &key, &state);
+    bdr_key_free(&key);
+    return state.blob;
+}
 
-                    // Evict it.
+/* --- Flights --- */
 
-                    curr->is_stable = false;
+/* Shard lock held. */
+static cwist_bdr_flight *bdr_flight_find(cwist_bdr_shard *shard, const bdr_key *key) {
+    for (cwist_bdr_flight *flight = shard->flights; flight; flight = flight->next) {
+        if (flight->key_len == key->len && memcmp(flight->key, key->data, key->len) == 0) return flight;
+    }
+    return NULL;
+}
 
-                    curr->hits = 0;
+/* Shard lock held. */
+static cwist_bdr_flight *bdr_flight_open(cwist_bdr_shard *shard, const bdr_key *key) {
+    cwist_bdr_flight *flight = (cwist_bdr_flight *)cwist_alloc(sizeof(cwist_bdr_flight));
+    if (!flight) return NULL;
+    flight->key = (char *)cwist_alloc(key->len);
+    if (!flight->key) {
+        cwist_free(flight);
+        return NULL;
+    }
+    memcpy(flight->key, key->data, key->len);
+    flight->key_len = key->len;
+    flight->shard = shard;
+    flight->refs = 1;
+    pthread_mutex_init(&flight->lock, NULL);
+    flight->next = shard->flights;
+    shard->flights = flight;
+    return flight;
+}
 
-                    bdr_release_blob(bdr, curr);
+static void bdr_flight_release(cwist_bdr_flight *flight) {
+    if (__atomic_sub_fetch(&flight->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+    cwist_bdr_blob_release(flight->blob);
+    pthread_mutex_destroy(&flight->lock);
+    cwist_free(flight->key);
+    cwist_free(flight);
+}
 
-                    curr->response_hash = res_h; // New candidate
+/* Parks until the leader completes or `wait_ms` passes. Returns the shared reply, referenced, or NULL. */
+static cwist_bdr_blob *bdr_flight_wait(cwist_bdr_flight *flight, int wait_ms) {
+    cwist_bdr_waiter waiter = { .wake = { -1, -1 }, .next = NULL };
+    cwist_bdr_blob *blob = NULL;
+
+    pthread_mutex_lock(&flight->lock);
+    if (!flight->done && pipe(waiter.wake) == 0) {
+        waiter.next = flight->waiters;
+        flight->waiters = &waiter;
+        pthread_mutex_unlock(&flight->lock);
+
+        int ready;
+        do {
+            ready = cwist_coro_poll(waiter.wake[0], POLLIN, wait_ms);
+        } while (ready < 0 && errno == EINTR);
+
+        pthread_mutex_lock(&flight->lock);
+        for (cwist_bdr_waiter **link = &flight->waiters; *link; link = &(*link)->next) {
+            if (*link == &waiter) {
+                *link = waiter.next;
+                break;
+            }
+        }
+        close(waiter.wake[0]);
+        close(waiter.wake[1]);
+    }
+    if (flight->done && flight->blob) {
+        blob = flight->blob;
+        __atomic_add_fetch(&blob->refs, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&flight->lock);
+    return blob;
+}
 
-                    curr->created_at = time(NULL);
+void cwist_bdr_acquire(cwist_bdr_t *bdr, const cwist_http_request *req, cwist_bdr_result *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!bdr || !bdr_cacheable_request(req)) return;
+
+    bdr_key key;
+    bdr_probe_state state;
+    if (!bdr_probe(bdr, req, &key, &state)) {
+        cwist_bdr_blob_release(state.blob);
+        bdr_key_free(&key);
+        return;
+    }
+    cwist_bdr_shard *shard = bdr_shard_of(bdr, key.hash);
+
+    if (state.blob) {
+        out->status = CWIST_BDR_HIT;
+        out->blob = state.blob;
+        if (state.stale) {
+            // Exactly one caller refreshes; the rest keep getting the stale reply.
+            pthread_mutex_lock(&shard->lock);
+            if (!bdr_flight_find(shard, &key)) out->flight = bdr_flight_open(shard, &key);
+            bdr_shard_unlock(shard);
+            if (out->flight) out->status = CWIST_BDR_STALE;
+        }
+    } else if (state.known && __atomic_load_n(&bdr->coalesce_wait_ms, __ATOMIC_RELAXED) > 0) {
+        pthread_mutex_lock(&shard->lock);
+        cwist_bdr_flight *flight = bdr_flight_find(shard, &key);
+        if (flight) {
+            __atomic_add_fetch(&flight->refs, 1, __ATOMIC_RELAXED);
+        } else {
+            out->flight = bdr_flight_open(shard, &key);
+        }
+        bdr_shard_unlock(shard);
+
+        if (out->flight) {
+            out->status = CWIST_BDR_LEAD;
+        } else if (flight) {
+            out->blob = bdr_flight_wait(flight, __atomic_load_n(&bdr->coalesce_wait_ms, __ATOMIC_RELAXED));
+            bdr_flight_release(flight);
+            if (out->blob) {
+                out->status = CWIST_BDR_HIT;
+                __atomic_add_fetch(&shard->stat_coalesced, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    bdr_key_free(&key);
+}
 
+/*
+ * Keeps the Vary marker under the base key in line with the latest response:
+ * installs or replaces it when the reply varies, drops it when it no longer does.
+ */
+static bool bdr_sync_vary_marker(cwist_bdr_t *bdr, const bdr_key *base, char *vary) {
+    cwist_bdr_shard *shard = bdr_shard_of(bdr, base->hash);
+    bool ok = true;
+    pthread_mutex_lock(&shard->lock);
+    bdr_entry_t **link = bdr_find_link(shard, base);
+    bdr_entry_t *curr = link ? *link : NULL;
+    bool current = curr && ((!vary && !curr->vary) || (vary && curr->vary && strcmp(vary, curr->vary) == 0));
+    if (!current) {
+        if (curr && (vary || curr->vary)) bdr_remove_entry(shard, link, curr);
+        if (vary) {
+            bdr_entry_t *marker = bdr_entry_create(base);
+            if (marker) {
+                marker->vary = cwist_strdup(vary);
+                if (!marker->vary || !bdr_insert(shard, marker)) {
+                    bdr_entry_retire(marker);
+                    ok = false;
                 }
-
             } else {
+                ok = false;
+            }
+        }
+    }
+    bdr_shard_unlock(shard);
+    return ok;
+}
 
-                // Was unstable/candidate. Check if matches candidate.
-
-                if (curr->response_hash == res_h) {
-
-                    // Match! Stabilize.
+/*
+ * Learns one reply. Returns a reference to the published blob when the reply
+ * now cached under `key` is exactly these bytes. `key` is left for the caller
+ * to free.
+ */
+static cwist_bdr_blob *bdr_learn(cwist_bdr_t *bdr, const cwist_http_request *req, const cwist_http_response *res,
+                                 const struct iovec *iov, int iov_cnt, cwist_http_body_pin *pin, bdr_key *key) {
+    bdr_key_init(key);
+    size_t len = iov ? bdr_iov_len(iov, iov_cnt) : 0;
+    if (!bdr || !bdr_cacheable_request(req) || !res || len == 0) return NULL;
+    // Errors are never learned, so a failing refresh leaves the stale reply in place.
+    if ((int)res->status_code >= 500) return NULL;
+
+    char *vary = NULL;
+    const char *vary_header = bdr_header_find(res->headers, "Vary", 4);
+    if (vary_header && !bdr_vary_normalize(vary_header, &vary)) return NULL;
 
-                    void *blob = cwist_alloc(len);
+    // Check RAM health before adding
+    bdr_check_ram(bdr);
 
-                    if (blob) {
+    bool ok = bdr_key_build_base(bdr, req, key);
+    if (ok) ok = bdr_sync_vary_marker(bdr, key, vary);
+    if (ok && vary) ok = bdr_key_extend_vary(bdr, req, vary, key);
+    cwist_free(vary);
+    if (!ok) return NULL;
+
+    bdr_reply reply;
+    bdr_reply_view(iov, iov_cnt, &reply);
+    if (reply.iov_cnt == 0) return NULL;
+    len = bdr_iov_len(reply.iov, reply.iov_cnt);
+    // A handler that forces Connection: close makes a different reply, even though the line itself is cut.
+    uint64_t res_h = bdr_hash_iov(bdr, reply.iov, reply.iov_cnt) ^ (reply.conn_close ? 0x636c6f7365ULL : 0);
+    cwist_bdr_shard *shard = bdr_shard_of(bdr, key->hash);
+    cwist_bdr_blob *stable = NULL;
+
+    pthread_mutex_lock(&shard->lock);
+    bdr_entry_t *curr = bdr_find(shard, key);
+    if (curr) {
+        if (curr->is_stable) {
+            if (curr->response_hash != res_h) {
+                // "Only cache if totally matching": a stable reply that changed is not
+                // dumb-cacheable any more. Drop the blob and start over as a candidate.
+                bdr_release_blob(shard, curr);
+                __atomic_store_n(&curr->hits, 0, __ATOMIC_RELAXED);
+                curr->response_hash = res_h; // New candidate
+                __atomic_store_n(&curr->created_at, time(NULL), __ATOMIC_RELAXED);
+            } else {
+                // Same bytes again: the reply is fresh for another TTL and hit budget.
+                time_t now = time(NULL);
+                __atomic_store_n(&curr->hits, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&curr->created_at, now, __ATOMIC_RELAXED);
+                stable = curr->blob;
+                __atomic_store_n(&stable->born, now, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&stable->refs, 1, __ATOMIC_RELAXED);
+            }
+        } else if (curr->response_hash == res_h) {
+            // Was a candidate and the reply matched again: stabilize. In low-RAM mode, or
+            // when admission keeps it out of RAM, it stabilizes in the segment file and
+            // RAM keeps only the candidate.
+            cwist_bdr_blob *blob = NULL;
+            bool in_ram = !__atomic_load_n(&bdr->is_disk_mode, __ATOMIC_ACQUIRE);
+            if (in_ram && bdr_admit(bdr, shard, curr, key->hash, len, false)) blob = bdr_blob_create(&reply, pin);
+            if (!blob && bdr_disk_get(bdr)) {
+                cwist_bdr_blob *copy = bdr_blob_create(&reply, NULL);
+                if (copy) bdr_disk_store(bdr, key->data, key->len, key->hash, copy, res_h, time(NULL));
+                cwist_bdr_blob_release(copy);
+                __atomic_store_n(&curr->reply_changed, false, __ATOMIC_RELAXED);
+            } else if (blob) {
+                __atomic_store_n(&curr->hits, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&curr->created_at, time(NULL), __ATOMIC_RELAXED);
+                __atomic_store_n(&curr->reply_changed, false, __ATOMIC_RELAXED);
+                bdr_release_blob(shard, curr);
+                curr->is_stable = true;
+                shard->current_bytes += bdr_blob_size(blob);
+                stable = blob;
+                blob->refs++;
+                __atomic_store_n(&curr->blob, blob, __ATOMIC_RELEASE);
+                bdr_guardrails(bdr, shard);
+            }
+        } else {
+            // Mismatch. Keep unstable, update candidate.
+            curr->response_hash = res_h;
+            __atomic_store_n(&curr->reply_changed, true, __ATOMIC_RELAXED);
+        }
+    } else {
+        // New Entry (Candidate); at the entry cap it must win admission first.
+        bdr_entry_t *entry = NULL;
+        if (shard->clock_len < CWIST_BDR_SHARD_MAX_ENTRIES || bdr_admit(bdr, shard, NULL, key->hash, 0, true)) {
+            entry = bdr_entry_create(key);
+        }
+        if (entry) {
+            entry->response_hash = res_h;
+            entry->is_stable = false; // Start as candidate
+            if (bdr_insert(shard, entry)) bdr_guardrails(bdr, shard);
+            else bdr_entry_retire(entry);
+        }
+    }
+    bdr_shard_unlock(shard);
 
-                        memcpy(blob, data, len);
+    // A demoted copy of these bytes is fresh again; a demoted copy of other bytes is dropped.
+    cwist_bdr_blob *on_disk = bdr_disk_observe(bdr, key, res_h, !stable);
+    return stable ? stable : on_disk;
+}
 
-                        bdr_release_blob(bdr, curr);
+void cwist_bdr_put_iov(cwist_bdr_t *bdr, const cwist_http_request *req, const cwist_http_response *res,
+                       const struct iovec *iov, int iov_cnt, cwist_http_body_pin *pin) {
+    bdr_key key;
+    cwist_bdr_blob_release(bdr_learn(bdr, req, res, iov, iov_cnt, pin, &key));
+    bdr_key_free(&key);
+}
 
-                        curr->response_blob = blob;
+void cwist_bdr_put(cwist_bdr_t *bdr, const cwist_http_request *req, const cwist_http_response *res,
+                   const void *data, size_t len) {
+    struct iovec iov = { .iov_base = (void *)data, .iov_len = data ? len : 0 };
+    cwist_bdr_put_iov(bdr, req, res, &iov, 1, NULL);
+}
 
-                        curr->len = len;
+void cwist_bdr_complete(cwist_bdr_t *bdr, cwist_bdr_result *result, const cwist_http_request *req,
+                        const cwist_http_response *res, const struct iovec *iov, int iov_cnt,
+                        cwist_http_body_pin *pin) {
+    if (!bdr || !result || !result->flight) return;
+    cwist_bdr_flight *flight = result->flight;
+    result->flight = NULL;
+
+    bool has_reply = res && iov && bdr_iov_len(iov, iov_cnt) > 0;
+    bool failed = has_reply && (int)res->status_code >= 500;
+    cwist_bdr_blob *shared = NULL;
+    if (has_reply && !failed) {
+        bdr_key key;
+        cwist_bdr_blob *stable = bdr_learn(bdr, req, res, iov, iov_cnt, pin, &key);
+        if (stable && key.len == flight->key_len && memcmp(key.data, flight->key, key.len) == 0) {
+            shared = stable;
+        } else {
+            cwist_bdr_blob_release(stable);
+        }
+        bdr_key_free(&key);
+    }
 
-                        curr->is_stable = true;
+    // Nobody can join once the flight is off the shard list.
+    cwist_bdr_shard *shard = flight->shard;
+    pthread_mutex_lock(&shard->lock);
+    for (cwist_bdr_flight **link = &shard->flights; *link; link = &(*link)->next) {
+        if (*link == flight) {
+            *link = flight->next;
+            break;
+        }
+    }
+    bdr_shard_unlock(shard);
+
+    pthread_mutex_lock(&flight->lock);
+    // An error reaches everyone who waited for it instead of each retrying the handler.
+    if (failed && flight->waiters) {
+        bdr_reply reply;
+        bdr_reply_view(iov, iov_cnt, &reply);
+        if (reply.iov_cnt) shared = bdr_blob_create(&reply, NULL);
+    }
+    flight->blob = shared;
+    flight->done = true;
+    for (cwist_bdr_waiter *waiter = flight->waiters; waiter; waiter = waiter->next) {
+        ssize_t n = write(waiter->wake[1], "", 1);
+        (void)n;
+    }
+    pthread_mutex_unlock(&flight->lock);
+    bdr_flight_release(flight);
+}
 
-                        curr->hits = 0;
+/* --- Snapshots --- */
+
+#define BDR_SNAPSHOT_MAGIC "CWBDRSNP"
+#define BDR_SNAPSHOT_FORMAT 1
+
+/*
+ * A snapshot file: this header, then `count` records. Each record is a
+ * bdr_snapshot_record followed by the key, the Vary names (markers only) and
+ * the reply (head template, then the rest), padded to 8 bytes. The checksum
+ * chains a SipHash of every record under a fixed key, since the cache's own
+ * seed is only learned from the file.
+ */
+typedef struct bdr_snapshot_header {
+    char magic[8];
+    uint32_t format;
+    uint32_t record_size;      ///< sizeof(bdr_snapshot_record), so a layout change is caught
+    uint8_t seed[16];          ///< Seed the saved request and response hashes were made with
+    int64_t written_at;
+    uint64_t count;
+    uint64_t payload_len;      ///< Bytes of records after the header
+    uint64_t checksum;
+} bdr_snapshot_header;
+
+typedef struct bdr_snapshot_record {
+    uint64_t version;          ///< Tag of the key's path when saved
+    uint64_t response_hash;
+    int64_t created_at;
+    int64_t born;
+    uint64_t head_len;         ///< Head template bytes; 0 for markers and non-template replies
+    uint64_t tail_len;
+    uint32_t key_len;
+    uint32_t vary_len;         ///< Non-zero for a Vary marker, which holds no reply
+    uint8_t request_id;
+    uint8_t conn_close;
+    uint8_t pad[6];
+} bdr_snapshot_record;
+
+static const uint8_t bdr_snapshot_key[16] = { 'c', 'w', 'i', 's', 't', '-', 'b', 'd', 'r', '-', 's', 'n', 'a', 'p' };
+
+static uint64_t bdr_snapshot_mix(uint64_t checksum, const void *record, size_t len) {
+    return (checksum * 0x9E3779B97F4A7C15ULL) ^ siphash24(record, len, bdr_snapshot_key);
+}
 
-                        curr->created_at = time(NULL);
+/* Tag of the longest matching prefix of the key's path. snapshot_lock held. */
+static uint64_t bdr_version_of(const cwist_bdr_t *bdr, const char *key, size_t key_len) {
+    const char *space = memchr(key, ' ', key_len);
+    const char *path = space ? space + 1 : key;
+    size_t path_len = key_len - (size_t)(path - key);
+    const cwist_bdr_version *best = NULL;
+    for (size_t i = 0; i < bdr->version_count; i++) {
+        const cwist_bdr_version *v = &bdr->versions[i];
+        if (v->prefix_len <= path_len && memcmp(v->prefix, path, v->prefix_len) == 0 &&
+            (!best || v->prefix_len > best->prefix_len)) {
+            best = v;
+        }
+    }
+    return best ? best->tag : 0;
+}
 
-                        bdr->current_bytes += len;
+cwist_error_t cwist_bdr_set_version(cwist_bdr_t *bdr, const char *path_prefix, const char *version) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    err.error.err_i16 = -1;
+    if (!bdr) return err;
+    if (!path_prefix) path_prefix = "";
+    size_t prefix_len = strlen(path_prefix);
+
+    pthread_mutex_lock(&bdr->snapshot_lock);
+    size_t i = 0;
+    while (i < bdr->version_count &&
+           (bdr->versions[i].prefix_len != prefix_len || strcmp(bdr->versions[i].prefix, path_prefix) != 0)) {
+        i++;
+    }
+    if (!version) {
+        if (i < bdr->version_count) {
+            cwist_free(bdr->versions[i].prefix);
+            bdr->versions[i] = bdr->versions[--bdr->version_count];
+        }
+        err.error.err_i16 = 0;
+    } else if (i < bdr->version_count) {
+        bdr->versions[i].tag = siphash24(version, strlen(version), bdr_snapshot_key);
+        err.error.err_i16 = 0;
+    } else {
+        char *copy = cwist_strdup(path_prefix);
+        cwist_bdr_version *grown = copy ? (cwist_bdr_version *)cwist_realloc(
+            bdr->versions, (bdr->version_count + 1) * sizeof(cwist_bdr_version)) : NULL;
+        if (grown) {
+            bdr->versions = grown;
+            grown[bdr->version_count++] = (cwist_bdr_version){
+                .prefix = copy,
+                .prefix_len = prefix_len,
+                .tag = siphash24(version, strlen(version), bdr_snapshot_key),
+            };
+            err.error.err_i16 = 0;
+        } else {
+            cwist_free(copy);
+        }
+    }
+    pthread_mutex_unlock(&bdr->snapshot_lock);
+    return err;
+}
 
-                        bdr_guardrails(bdr);
+typedef struct {
+    FILE *out;
+    unsigned char *buf;        ///< One record at a time, reused
+    size_t cap;
+    uint64_t count;
+    uint64_t payload_len;
+    uint64_t checksum;
+    bool ok;
+} bdr_snapshot_writer;
+
+/* Assembles one record from `parts`, checksums it and appends it. */
+static void bdr_snapshot_emit(bdr_snapshot_writer *w, const bdr_snapshot_record *rec,
+                              const struct iovec *parts, int part_cnt) {
+    if (!w->ok) return;
+    size_t size = (sizeof(*rec) + bdr_iov_len(parts, part_cnt) + 7) & ~(size_t)7;
+    if (size > w->cap) {
+        unsigned char *grown = (unsigned char *)cwist_realloc(w->buf, size);
+        if (!grown) {
+            w->ok = false;
+            return;
+        }
+        w->buf = grown;
+        w->cap = size;
+    }
+    memcpy(w->buf, rec, sizeof(*rec));
+    size_t offset = sizeof(*rec);
+    for (int i = 0; i < part_cnt; i++) {
+        if (parts[i].iov_len) memcpy(w->buf + offset, parts[i].iov_base, parts[i].iov_len);
+        offset += parts[i].iov_len;
+    }
+    memset(w->buf + offset, 0, size - offset);
+    w->checksum = bdr_snapshot_mix(w->checksum, w->buf, size);
+    w->ok = fwrite(w->buf, 1, size, w->out) == size;
+    w->count++;
+    w->payload_len += size;
+}
 
-                        // printf("[BDR] Stabilized: %s\n", path);
+/* What a shard entry looked like when referenced; written after the shard is unlocked. */
+typedef struct {
+    char *key;
+    size_t key_len;
+    char *vary;
+    cwist_bdr_blob *blob;
+    uint64_t response_hash;
+    time_t created_at;
+} bdr_snapshot_item;
+
+static void bdr_snapshot_shard(cwist_bdr_t *bdr, cwist_bdr_shard *shard, bdr_snapshot_writer *w) {
+    pthread_mutex_lock(&shard->lock);
+    size_t count = 0;
+    bdr_snapshot_item *items = shard->clock_len ?
+        (bdr_snapshot_item *)cwist_alloc_array(shard->clock_len, sizeof(bdr_snapshot_item)) : NULL;
+    if (shard->clock_len && !items) w->ok = false;
+    for (size_t i = 0; items && i < shard->clock_len; i++) {
+        bdr_entry_t *entry = shard->clock[i];
+        // Candidates have nothing worth keeping yet.
+        if (!entry->vary && !(entry->is_stable && entry->blob)) continue;
+        bdr_snapshot_item *item = &items[count];
+        item->key = (char *)cwist_alloc(entry->key_len);
+        item->vary = entry->vary ? cwist_strdup(entry->vary) : NULL;
+        if (!item->key || (entry->vary && !item->vary)) {
+            cwist_free(item->key);
+            cwist_free(item->vary);
+            w->ok = false;
+            break;
+        }
+        memcpy(item->key, entry->key, entry->key_len);
+        item->key_len = entry->key_len;
+        item->response_hash = entry->response_hash;
+        item->created_at = __atomic_load_n(&entry->created_at, __ATOMIC_RELAXED);
+        if (!entry->vary) {
+            item->blob = entry->blob;
+            __atomic_add_fetch(&item->blob->refs, 1, __ATOMIC_RELAXED);
+        }
+        count++;
+    }
+    bdr_shard_unlock(shard);
+
+    for (size_t i = 0; i < count; i++) {
+        bdr_snapshot_item *item = &items[i];
+        const cwist_bdr_blob *blob = item->blob;
+        bdr_snapshot_record rec = {
+            .version = bdr_version_of(bdr, item->key, item->key_len),
+            .response_hash = item->response_hash,
+            .created_at = (int64_t)item->created_at,
+            .key_len = (uint32_t)item->key_len,
+        };
+        struct iovec parts[4] = { { item->key, item->key_len } };
+        int part_cnt = 1;
+        if (item->vary) {
+            rec.vary_len = (uint32_t)strlen(item->vary);
+            parts[part_cnt++] = (struct iovec){ item->vary, rec.vary_len };
+        } else {
+            rec.born = (int64_t)__atomic_load_n(&blob->born, __ATOMIC_RELAXED);
+            rec.head_len = blob->head_split ? blob->head_split + 2 : 0;
+            rec.tail_len = bdr_blob_size(blob) - rec.head_len;
+            rec.request_id = blob->request_id;
+            rec.conn_close = blob->conn_close;
+            parts[part_cnt++] = (struct iovec){ (void *)blob->data, blob->len };
+            parts[part_cnt++] = (struct iovec){ (void *)blob->body, blob->body_len };
+        }
+        bdr_snapshot_emit(w, &rec, parts, part_cnt);
+        cwist_bdr_blob_release(item->blob);
+        cwist_free(item->key);
+        cwist_free(item->vary);
+    }
+    cwist_free(items);
+}
 
+/* Demoted replies, read from the mapping with their segments pinned against recycling. */
+static void bdr_snapshot_disk(cwist_bdr_t *bdr, bdr_snapshot_writer *w) {
+    cwist_bdr_disk *disk = bdr_disk_get(bdr);
+    if (!disk) return;
+    size_t count = 0;
+    size_t cap = 0;
+    cwist_bdr_disk_entry *items = NULL;
+    for (size_t stripe = 0; stripe < CWIST_BDR_DISK_LOCKS && w->ok; stripe++) {
+        pthread_mutex_lock(&disk->index_locks[stripe]);
+        for (size_t i = stripe; i < CWIST_BDR_DISK_BUCKETS && w->ok; i += CWIST_BDR_DISK_LOCKS) {
+            for (cwist_bdr_disk_entry *curr = disk->buckets[i]; curr && w->ok; curr = curr->next) {
+                if (count == cap) {
+                    size_t grown_cap = cap ? cap * 2 : 64;
+                    cwist_bdr_disk_entry *grown = (cwist_bdr_disk_entry *)cwist_realloc(
+                        items, grown_cap * sizeof(cwist_bdr_disk_entry));
+                    if (!grown) {
+                        w->ok = false;
+                        break;
                     }
-
-                } else {
-
-                    // Mismatch. Keep unstable, update candidate.
-
-                    curr->response_hash = res_h;
-
+                    items = grown;
+                    cap = grown_cap;
                 }
-
+                items[count++] = *curr;
+                __atomic_add_fetch(&disk->segments[curr->segment].pins, 1, __ATOMIC_ACQ_REL);
             }
-
-            return;
-
         }
-
-        curr = curr->next;
-
+        pthread_mutex_unlock(&disk->index_locks[stripe]);
     }
 
-    
-
-    // New Entry (Candidate)
-
-    bdr_entry_t *entry = cwist_alloc(sizeof(bdr_entry_t));
-
-    if (!entry) return;
+    for (size_t i = 0; i < count; i++) {
+        const bdr_disk_record *disk_rec = bdr_disk_record_at(disk, &items[i]);
+        const char *key = (const char *)(disk_rec + 1);
+        bdr_snapshot_record rec = {
+            .version = bdr_version_of(bdr, key, disk_rec->key_len),
+            .response_hash = items[i].response_hash,
+            .created_at = (int64_t)items[i].created_at,
+            .born = disk_rec->born,
+            .head_len = disk_rec->head_len,
+            .tail_len = disk_rec->tail_len,
+            .key_len = disk_rec->key_len,
+            .request_id = disk_rec->request_id,
+            .conn_close = disk_rec->conn_close,
+        };
+        struct iovec parts[2] = {
+            { (void *)key, disk_rec->key_len },
+            { (void *)(key + disk_rec->key_len), disk_rec->head_len + disk_rec->tail_len },
+        };
+        bdr_snapshot_emit(w, &rec, parts, 2);
+        bdr_disk_unpin(NULL, 0, &disk->segments[items[i].segment]);
+    }
+    cwist_free(items);
+}
 
+cwist_error_t cwist_bdr_snapshot_save(cwist_bdr_t *bdr, const char *path) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    err.error.err_i16 = -1;
+    if (!bdr || !path) return err;
+    char tmp[PATH_MAX];
+    if ((size_t)snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid()) >= sizeof(tmp)) return err;
+
+    pthread_mutex_lock(&bdr->snapshot_lock);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    FILE *out = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!out) {
+        if (fd >= 0) close(fd);
+        pthread_mutex_unlock(&bdr->snapshot_lock);
+        return err;
+    }
 
+    bdr_snapshot_header header = {0};
+    bdr_snapshot_writer w = { .out = out, .ok = true };
+    // Placeholder; rewritten once the records and their checksum are known.
+    w.ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    for (size_t s = 0; s < CWIST_BDR_SHARDS; s++) bdr_snapshot_shard(bdr, &bdr->shards[s], &w);
+    bdr_snapshot_disk(bdr, &w);
+    cwist_free(w.buf);
+
+    memcpy(header.magic, BDR_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.format = BDR_SNAPSHOT_FORMAT;
+    header.record_size = sizeof(bdr_snapshot_record);
+    memcpy(header.seed, bdr->seed, sizeof(header.seed));
+    header.written_at = (int64_t)time(NULL);
+    header.count = w.count;
+    header.payload_len = w.payload_len;
+    header.checksum = w.checksum;
+    bool ok = w.ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1 &&
+              fflush(out) == 0 && fsync(fileno(out)) == 0;
+    ok = fclose(out) == 0 && ok;
+    if (ok && rename(tmp, path) == 0) err.error.err_i16 = 0;
+    else unlink(tmp);
+    pthread_mutex_unlock(&bdr->snapshot_lock);
+    return err;
+}
 
-    entry->request_hash = req_h;
+/* The read-only mapping of a loaded snapshot, shared by every blob whose tail points into it. */
+typedef struct {
+    size_t refs;               ///< Loader plus blobs (atomic)
+    void *base;
+    size_t len;
+} bdr_snapshot_map;
+
+static void bdr_snapshot_unref(const void *ptr, size_t len, void *ctx) {
+    (void)ptr;
+    (void)len;
+    bdr_snapshot_map *map = (bdr_snapshot_map *)ctx;
+    if (__atomic_sub_fetch(&map->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+    munmap(map->base, map->len);
+    cwist_free(map);
+}
 
-    entry->response_hash = res_h;
+/* Bytes the record at `rec` spans with its padding, or 0 if it is malformed or overruns `avail`. */
+static size_t bdr_snapshot_record_span(const bdr_snapshot_record *rec, size_t avail) {
+    size_t left = avail - sizeof(*rec);
+    if (rec->key_len == 0 || rec->key_len > left) return 0;
+    left -= rec->key_len;
+    if (rec->vary_len > left) return 0;
+    left -= rec->vary_len;
+    if (rec->head_len > left || rec->tail_len > left - rec->head_len) return 0;
+    left -= rec->head_len + rec->tail_len;
+    // A marker holds no reply, a reply holds bytes, and a head template at least ends in CRLF.
+    bool has_reply = rec->head_len + rec->tail_len > 0;
+    if ((rec->vary_len > 0) == has_reply || (rec->head_len > 0 && rec->head_len < 2)) return 0;
+    size_t pad = (8 - (avail - left) % 8) % 8;
+    if (pad > left) return 0;
+    return avail - left + pad;
+}
 
-    entry->is_stable = false; // Start as candidate
+/* Walks every record: bounds first, then the checksum. */
+static bool bdr_snapshot_validate(const unsigned char *base, size_t size) {
+    if (size < sizeof(bdr_snapshot_header)) return false;
+    const bdr_snapshot_header *header = (const bdr_snapshot_header *)base;
+    if (memcmp(header->magic, BDR_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->format != BDR_SNAPSHOT_FORMAT || header->record_size != sizeof(bdr_snapshot_record) ||
+        header->payload_len != size - sizeof(*header)) {
+        return false;
+    }
+    uint64_t checksum = 0;
+    size_t offset = sizeof(*header);
+    for (uint64_t i = 0; i < header->count; i++) {
+        if (size - offset < sizeof(bdr_snapshot_record)) return false;
+        size_t span = bdr_snapshot_record_span((const bdr_snapshot_record *)(base + offset), size - offset);
+        if (span == 0) return false;
+        checksum = bdr_snapshot_mix(checksum, base + offset, span);
+        offset += span;
+    }
+    return offset == size && checksum == header->checksum;
+}
 
-    entry->response_blob = NULL;
+static bool bdr_is_empty(cwist_bdr_t *bdr) {
+    bool empty = true;
+    for (size_t s = 0; s < CWIST_BDR_SHARDS && empty; s++) {
+        pthread_mutex_lock(&bdr->shards[s].lock);
+        empty = bdr->shards[s].clock_len == 0;
+        pthread_mutex_unlock(&bdr->shards[s].lock);
+    }
+    cwist_bdr_disk *disk = bdr_disk_get(bdr);
+    if (empty && disk) empty = __atomic_load_n(&disk->entries, __ATOMIC_RELAXED) == 0;
+    return empty;
+}
 
-    entry->len = 0;
+/* Like a disk hit: the head template is copied, the rest stays in the mapping. */
+static cwist_bdr_blob *bdr_snapshot_blob(bdr_snapshot_map *map, const bdr_snapshot_record *rec) {
+    const unsigned char *head = (const unsigned char *)(rec + 1) + rec->key_len;
+    cwist_bdr_blob *blob = (cwist_bdr_blob *)cwist_alloc(sizeof(cwist_bdr_blob) + rec->head_len);
+    if (!blob) return NULL;
+    blob->refs = 1;
+    blob->len = rec->head_len;
+    memcpy(blob->data, head, rec->head_len);
+    if (rec->tail_len) {
+        blob->body = head + rec->head_len;
+        blob->body_len = rec->tail_len;
+        blob->body_release = bdr_snapshot_unref;
+        blob->body_release_ctx = map;
+        __atomic_add_fetch(&map->refs, 1, __ATOMIC_ACQ_REL);
+    }
+    blob->head_split = rec->head_len ? rec->head_len - 2 : 0;
+    blob->request_id = rec->request_id;
+    blob->conn_close = rec->conn_close;
+    blob->born = (time_t)rec->born;
+    return blob;
+}
 
-    entry->hits = 0;
+/* Restores one record unless a copy of its key is already in. Returns true if it was kept. */
+static bool bdr_snapshot_restore(cwist_bdr_t *bdr, bdr_snapshot_map *map, const bdr_snapshot_record *rec) {
+    const char *data = (const char *)(rec + 1);
+    bdr_key key;
+    bdr_key_init(&key);
+    bdr_key_append(&key, data, rec->key_len);
+    bdr_key_seal(bdr, &key);
+    if (!key.ok) return false;
+
+    cwist_bdr_shard *shard = bdr_shard_of(bdr, key.hash);
+    bool kept = false;
+    pthread_mutex_lock(&shard->lock);
+    // Saved RAM copies come before demoted ones, so the first copy of a key wins.
+    bool present = bdr_find(shard, &key) != NULL;
+    bool free_slot = shard->clock_len < CWIST_BDR_SHARD_MAX_ENTRIES;
+    if (!present && rec->vary_len) {
+        bdr_entry_t *marker = free_slot ? bdr_entry_create(&key) : NULL;
+        if (marker) {
+            marker->vary = (char *)cwist_alloc(rec->vary_len + 1);
+            if (marker->vary) memcpy(marker->vary, data + rec->key_len, rec->vary_len);
+            kept = marker->vary && bdr_insert(shard, marker);
+            if (!kept) bdr_entry_retire(marker);
+        }
+    } else if (!present) {
+        cwist_bdr_blob *blob = bdr_snapshot_blob(map, rec);
+        size_t size = blob ? bdr_blob_size(blob) : 0;
+        bool fits = free_slot && !__atomic_load_n(&bdr->is_disk_mode, __ATOMIC_ACQUIRE) &&
+                    shard->current_bytes + size <= bdr_shard_budget(bdr);
+        bdr_entry_t *entry = blob && fits ? bdr_entry_create(&key) : NULL;
+        if (entry) {
+            entry->response_hash = rec->response_hash;
+            entry->is_stable = true;
+            entry->created_at = (time_t)rec->created_at;
+            entry->blob = blob;
+            kept = bdr_insert(shard, entry);
+            if (kept) {
+                shard->current_bytes += size;
+                blob = NULL;
+            } else {
+                entry->blob = NULL;
+                bdr_entry_retire(entry);
+            }
+        }
+        if (!kept && blob) {
+            // No room in RAM: the disk tier may still take it.
+            kept = bdr_disk_store(bdr, key.data, key.len, key.hash, blob, rec->response_hash, (time_t)rec->created_at);
+        }
+        cwist_bdr_blob_release(blob);
+    }
+    bdr_shard_unlock(shard);
+    bdr_key_free(&key);
+    return kept;
+}
 
-    entry->created_at = time(NULL);
+cwist_error_t cwist_bdr_snapshot_load(cwist_bdr_t *bdr, const char *path, size_t *loaded) {
+    cwist_error_t err = make_error(CWIST_ERR_INT16);
+    err.error.err_i16 = -1;
+    if (loaded) *loaded = 0;
+    if (!bdr || !path) return err;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return err;
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) return err;
+    size_t size = (size_t)st.st_size;
+
+    pthread_mutex_lock(&bdr->snapshot_lock);
+    bdr_snapshot_map *map = NULL;
+    if (bdr_snapshot_validate((const unsigned char *)base, size) && bdr_is_empty(bdr)) {
+        map = (bdr_snapshot_map *)cwist_alloc(sizeof(bdr_snapshot_map));
+    }
+    if (!map) {
+        pthread_mutex_unlock(&bdr->snapshot_lock);
+        munmap(base, size);
+        return err;
+    }
+    map->refs = 1;
+    map->base = base;
+    map->len = size;
 
-    
+    const bdr_snapshot_header *header = (const bdr_snapshot_header *)base;
+    // The saved hashes were made with this seed; keys built from now on must match them.
+    memcpy(bdr->seed, header->seed, sizeof(bdr->seed));
+    time_t now = time(NULL);
+    time_t max_age = __atomic_load_n(&bdr->max_entry_age_sec, __ATOMIC_RELAXED);
+    time_t max_stale = __atomic_load_n(&bdr->max_stale_sec, __ATOMIC_RELAXED);
+    size_t restored = 0;
+    size_t offset = sizeof(*header);
+    for (uint64_t i = 0; i < header->count; i++) {
+        const bdr_snapshot_record *rec = (const bdr_snapshot_record *)((const unsigned char *)base + offset);
+        offset += bdr_snapshot_record_span(rec, size - offset);
+        if (rec->version != bdr_version_of(bdr, (const char *)(rec + 1), rec->key_len)) continue;
+        if (!rec->vary_len && max_age > 0 && now - (time_t)rec->created_at > max_age + max_stale) continue;
+        if (bdr_snapshot_restore(bdr, map, rec)) restored++;
+    }
+    pthread_mutex_unlock(&bdr->snapshot_lock);
+    bdr_snapshot_unref(NULL, 0, map);
 
-    entry->next = bdr->buckets[idx];
+    if (loaded) *loaded = restored;
+    err.error.err_i16 = 0;
+    return err;
+}
 
-    bdr->buckets[idx] = entry;
+void cwist_bdr_set_coalescing(cwist_bdr_t *bdr, int coalesce_wait_ms, time_t max_stale_sec) {
+    if (!bdr) return;
+    if (coalesce_wait_ms >= 0) {
+        __atomic_store_n(&bdr->coalesce_wait_ms, coalesce_wait_ms, __ATOMIC_RELAXED);
+    }
+    if (max_stale_sec >= 0) {
+        __atomic_store_n(&bdr->max_stale_sec, max_stale_sec, __ATOMIC_RELAXED);
+    }
+}
 
-    bdr_guardrails(bdr);
+void cwist_bdr_get_stats(cwist_bdr_t *bdr, cwist_bdr_stats *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!bdr) return;
+    for (size_t s = 0; s < CWIST_BDR_SHARDS; s++) {
+        cwist_bdr_shard *shard = &bdr->shards[s];
+        out->hits += __atomic_load_n(&shard->stat_hits, __ATOMIC_RELAXED);
+        out->misses += __atomic_load_n(&shard->stat_misses, __ATOMIC_RELAXED);
+        out->admitted += __atomic_load_n(&shard->stat_admitted, __ATOMIC_RELAXED);
+        out->rejected += __atomic_load_n(&shard->stat_rejected, __ATOMIC_RELAXED);
+        out->evicted += __atomic_load_n(&shard->stat_evicted, __ATOMIC_RELAXED);
+        out->coalesced += __atomic_load_n(&shard->stat_coalesced, __ATOMIC_RELAXED);
+        out->stale += __atomic_load_n(&shard->stat_stale, __ATOMIC_RELAXED);
+        pthread_mutex_lock(&shard->lock);
+        out->bytes += shard->current_bytes;
+        out->entries += shard->clock_len;
+        bdr_shard_unlock(shard);
+    }
+    cwist_bdr_disk *disk = bdr_disk_get(bdr);
+    if (disk) {
+        pthread_mutex_lock(&bdr->disk_lock);
+        out->demoted = disk->stat_demoted;
+        out->disk_hits = __atomic_load_n(&disk->stat_hits, __ATOMIC_RELAXED);
+        out->disk_entries = __atomic_load_n(&disk->entries, __ATOMIC_RELAXED);
+        for (size_t i = 0; i < CWIST_BDR_DISK_SEGMENTS; i++) out->disk_bytes += disk->segments[i].used;
+        pthread_mutex_unlock(&bdr->disk_lock);
+    }
+}
 
+double cwist_bdr_hit_ratio(cwist_bdr_t *bdr) {
+    cwist_bdr_stats stats;
+    cwist_bdr_get_stats(bdr, &stats);
+    uint64_t lookups = stats.hits + stats.misses;
+    return lookups ? (double)stats.hits / (double)lookups : 0.0;
 }
 
 void cwist_bdr_set_limits(cwist_bdr_t *bdr, size_t max_bytes, time_t max_entry_age_sec, uint64_t revalidate_hits) {
-
     if (!bdr) return;
-
     if (max_bytes > 0) {
-
-        bdr->max_bytes = max_bytes;
-
+        __atomic_store_n(&bdr->max_bytes, max_bytes, __ATOMIC_RELAXED);
     }
-
     if (max_entry_age_sec > 0) {
-
-        bdr->max_entry_age_sec = max_entry_age_sec;
-
+        __atomic_store_n(&bdr->max_entry_age_sec, max_entry_age_sec, __ATOMIC_RELAXED);
     }
-
     if (revalidate_hits > 0) {
-
-        bdr->revalidate_hits = revalidate_hits;
-
+        __atomic_store_n(&bdr->revalidate_hits, revalidate_hits, __ATOMIC_RELAXED);
+    }
+    for (size_t s = 0; s < CWIST_BDR_SHARDS; s++) {
+        pthread_mutex_lock(&bdr->shards[s].lock);
+        bdr_guardrails(bdr, &bdr->shards[s]);
+        pthread_mutex_unlock(&bdr->shards[s].lock);
     }
-
-    bdr_guardrails(bdr);
-
 }
@@ -17,19 +17,24 @@
 static pthread_mutex_t rid_mutex = PTHREAD_MUTEX_INITIALIZER;
 static unsigned int rid_seed = 0;
 
-static char *generate_request_id() {
+void cwist_mw_request_id_fill(char out[CWIST_MW_REQUEST_ID_LEN + 1]) {
     static const char charset[] = "abcdefghijklmnopqrstuvwxyz0123456789";
-    char *id = cwist_alloc(17);
-    
+
     pthread_mutex_lock(&rid_mutex);
     if (rid_seed == 0) rid_seed = (unsigned int)time(NULL) ^ (unsigned int)pthread_self();
     unsigned int seed = rid_seed++;
     pthread_mutex_unlock(&rid_mutex);
 
-    for (int i = 0; i < 16; i++) {
-        id[i] = charset[rand_r(&seed) % (sizeof(charset) - 1)];
+    for (int i = 0; i < CWIST_MW_REQUEST_ID_LEN; i++) {
+        out[i] = charset[rand_r(&seed) % (sizeof(charset) - 1)];
     }
-    id[16] = '\0';
+    out[CWIST_MW_REQUEST_ID_LEN] = '\0';
+}
+
+static char *generate_request_id(cwist_http_request *req) {
+    char *id = cwist_http_request_alloc(req, CWIST_MW_REQUEST_ID_LEN + 1);
+    if (!id) return NULL;
+    cwist_mw_request_id_fill(id);
     return id;
 }
 
@@ -38,17 +43,17 @@ void cwist_mw_request_id_handler(cwist_http_request *req, cwist_http_response *r
     char *existing = cwist_http_header_get(req->headers, header_name);
     char *rid;
 
+    // Scratch comes from the request arena and is released with the request.
     if (existing) {
-        rid = cwist_strdup(existing);
+        rid = existing;
     } else {
-        rid = generate_request_id();
-        cwist_http_header_add(&req->headers, header_name, rid);
+        rid = generate_request_id(req);
+        if (rid) cwist_http_header_add(&req->headers, header_name, rid);
     }
 
-    cwist_http_header_add(&res->headers, header_name, rid);
+    if (rid) cwist_http_header_add(&res->headers, header_name, rid);
 
     next(req, res);
-    cwist_free(rid);
 }
 
 cwist_middleware_func cwist_mw_request_id(const char *header_name) {
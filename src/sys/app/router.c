@@ -0,0 +1,661 @@
+#define _POSIX_C_SOURCE 200809L
+#include <cwist/sys/app/router.h>
+#include <cwist/core/mem/alloc.h>
+#include <cwist/core/phash/phash.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CWIST_ROUTE_BUCKETS 127
+
+/*
+ * Pattern routes live in a segment-keyed radix tree. A static edge holds one or
+ * more whole segments joined by single slashes ("api/v1"), and is split when a
+ * later pattern diverges inside it. Siblings never share a first segment, so a
+ * child is picked with one binary search. `:param` and `*wildcard` segments get
+ * a dedicated child each; their names live on the route, not in the tree, so
+ * "/users/:id" and "/users/:name/posts" share a node.
+ */
+typedef struct cwist_route_node {
+    char *label;                          ///< Static segments; NULL for param and wildcard nodes.
+    size_t label_len;
+    struct cwist_route_node **children;   ///< Static children sorted by first segment.
+    size_t child_count;
+    size_t child_cap;
+    struct cwist_route_node *param;
+    struct cwist_route_node *wildcard;
+    cwist_route_entry *routes;            ///< Routes ending here, one per method.
+} cwist_route_node;
+
+struct cwist_route_table {
+    size_t bucket_count;
+    cwist_route_entry **buckets;          ///< Exact (pattern-free) routes.
+    size_t exact_count;
+    cwist_phash *frozen;                  ///< Perfect hash over the exact routes, once frozen.
+    cwist_route_node *root;
+};
+
+typedef struct {
+    const char *ptr;
+    size_t len;
+} cwist_route_segment;
+
+/* --- Segments --- */
+
+/* Advances *pos past empty segments and returns the next one, or false at the end. */
+static bool cwist_route_next_segment(const char *s, size_t len, size_t *pos, cwist_route_segment *seg) {
+    size_t i = *pos;
+    while (i < len && s[i] == '/') i++;
+    if (i == len) {
+        *pos = i;
+        return false;
+    }
+    const char *slash = memchr(s + i, '/', len - i);
+    size_t end = slash ? (size_t)(slash - s) : len;
+    seg->ptr = s + i;
+    seg->len = end - i;
+    *pos = end;
+    return true;
+}
+
+static int cwist_route_segment_cmp(const char *a, size_t alen, const char *b, size_t blen) {
+    int cmp = memcmp(a, b, alen < blen ? alen : blen);
+    if (cmp != 0) return cmp;
+    return (alen > blen) - (alen < blen);
+}
+
+static size_t cwist_route_first_segment_len(const cwist_route_node *node) {
+    const char *slash = memchr(node->label, '/', node->label_len);
+    return slash ? (size_t)(slash - node->label) : node->label_len;
+}
+
+/* --- Entries --- */
+
+static void cwist_route_entry_free(cwist_route_entry *entry) {
+    if (!entry) return;
+    for (size_t i = 0; i < entry->param_count; i++) {
+        cwist_free(entry->param_names[i]);
+    }
+    cwist_free(entry->param_names);
+    cwist_free(entry->path);
+    cwist_free(entry);
+}
+
+static cwist_route_entry *cwist_route_entry_create(const char *path, cwist_http_method_t method,
+                                                   cwist_route_handler_func handler, cwist_route_ws_handler_func ws_handler) {
+    cwist_route_entry *entry = (cwist_route_entry *)cwist_alloc(sizeof(cwist_route_entry));
+    if (!entry) return NULL;
+    entry->path = cwist_strdup(path);
+    if (!entry->path) {
+        cwist_free(entry);
+        return NULL;
+    }
+    entry->method = method;
+    entry->handler = handler;
+    entry->ws_handler = ws_handler;
+    return entry;
+}
+
+/*
+ * Adds `entry` to a list. An entry for the same method (and, in a shared hash
+ * bucket, the same path) is replaced, so re-registering a route overrides it.
+ * Returns true when the list grew.
+ */
+static bool cwist_route_list_put(cwist_route_entry **head, cwist_route_entry *entry, bool same_path_only) {
+    for (cwist_route_entry **link = head; *link; link = &(*link)->next) {
+        cwist_route_entry *curr = *link;
+        if (curr->method == entry->method && (!same_path_only || strcmp(curr->path, entry->path) == 0)) {
+            entry->next = curr->next;
+            *link = entry;
+            cwist_route_entry_free(curr);
+            return false;
+        }
+    }
+    entry->next = *head;
+    *head = entry;
+    return true;
+}
+
+static const cwist_route_entry *cwist_route_list_find(const cwist_route_entry *head, cwist_http_method_t method) {
+    for (; head; head = head->next) {
+        if (head->method == method) return head;
+    }
+    return NULL;
+}
+
+/* --- Exact routes --- */
+
+static size_t cwist_route_hash(cwist_http_method_t method, const char *path, size_t len, size_t bucket_count) {
+    const unsigned long long FNV_OFFSET = 1469598103934665603ULL;
+    const unsigned long long FNV_PRIME = 1099511628211ULL;
+    unsigned long long hash = FNV_OFFSET ^ (unsigned long long)method;
+    const unsigned char *ptr = (const unsigned char *)path;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned long long)ptr[i];
+        hash *= FNV_PRIME;
+    }
+    return (size_t)(hash % bucket_count);
+}
+
+static const cwist_route_entry *cwist_route_table_lookup_exact(cwist_route_table *table, cwist_http_method_t method,
+                                                               const char *path, size_t len) {
+    if (table->frozen) {
+        return (const cwist_route_entry *)cwist_phash_get(table->frozen, (uint32_t)method, path, len);
+    }
+    size_t idx = cwist_route_hash(method, path, len, table->bucket_count);
+    for (cwist_route_entry *curr = table->buckets[idx]; curr; curr = curr->next) {
+        if (curr->method == method && strncmp(curr->path, path, len) == 0 && curr->path[len] == '\0') {
+            return curr;
+        }
+    }
+    return NULL;
+}
+
+/* --- Pattern tree --- */
+
+static cwist_route_node *cwist_route_node_create(const char *label, size_t label_len) {
+    cwist_route_node *node = (cwist_route_node *)cwist_alloc(sizeof(cwist_route_node));
+    if (!node) return NULL;
+    if (label) {
+        node->label = cwist_strndup(label, label_len);
+        if (!node->label) {
+            cwist_free(node);
+            return NULL;
+        }
+        node->label_len = label_len;
+    }
+    return node;
+}
+
+static void cwist_route_node_destroy(cwist_route_node *node) {
+    if (!node) return;
+    for (size_t i = 0; i < node->child_count; i++) {
+        cwist_route_node_destroy(node->children[i]);
+    }
+    cwist_free(node->children);
+    cwist_route_node_destroy(node->param);
+    cwist_route_node_destroy(node->wildcard);
+    cwist_route_entry *curr = node->routes;
+    while (curr) {
+        cwist_route_entry *next = curr->next;
+        cwist_route_entry_free(curr);
+        curr = next;
+    }
+    cwist_free(node->label);
+    cwist_free(node);
+}
+
+/* Binary search for the child whose first segment is `seg`; *slot gets the insertion point on a miss. */
+static cwist_route_node *cwist_route_node_child(const cwist_route_node *node, const char *seg, size_t seg_len, size_t *slot) {
+    size_t lo = 0;
+    size_t hi = node->child_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const cwist_route_node *child = node->children[mid];
+        int cmp = cwist_route_segment_cmp(seg, seg_len, child->label, cwist_route_first_segment_len(child));
+        if (cmp == 0) {
+            if (slot) *slot = mid;
+            return node->children[mid];
+        }
+        if (cmp < 0) hi = mid;
+        else lo = mid + 1;
+    }
+    if (slot) *slot = lo;
+    return NULL;
+}
+
+static bool cwist_route_node_add_child(cwist_route_node *node, size_t slot, cwist_route_node *child) {
+    if (node->child_count == node->child_cap) {
+        size_t cap = node->child_cap ? node->child_cap * 2 : 4;
+        cwist_route_node **children = (cwist_route_node **)cwist_realloc(node->children, cap * sizeof(cwist_route_node *));
+        if (!children) return false;
+        node->children = children;
+        node->child_cap = cap;
+    }
+    memmove(&node->children[slot + 1], &node->children[slot], (node->child_count - slot) * sizeof(cwist_route_node *));
+    node->children[slot] = child;
+    node->child_count++;
+    return true;
+}
+
+/* Splits `child` after its first `keep` bytes of label; the new parent takes its slot. */
+static cwist_route_node *cwist_route_node_split(cwist_route_node *parent, size_t slot, size_t keep) {
+    cwist_route_node *child = parent->children[slot];
+    cwist_route_node *head = cwist_route_node_create(child->label, keep);
+    if (!head) return NULL;
+    char *rest = cwist_strndup(child->label + keep + 1, child->label_len - keep - 1);
+    head->children = (cwist_route_node **)cwist_alloc(4 * sizeof(cwist_route_node *));
+    if (!rest || !head->children) {
+        cwist_free(rest);
+        cwist_route_node_destroy(head);
+        return NULL;
+    }
+    head->child_cap = 4;
+    head->children[0] = child;
+    head->child_count = 1;
+
+    cwist_free(child->label);
+    child->label = rest;
+    child->label_len -= keep + 1;
+    parent->children[slot] = head;
+    return head;
+}
+
+/* Joins static segments seg[0..count) with single slashes. */
+static char *cwist_route_join(const cwist_route_segment *seg, size_t count, size_t *out_len) {
+    size_t len = count - 1;
+    for (size_t i = 0; i < count; i++) len += seg[i].len;
+    char *label = (char *)cwist_alloc(len + 1);
+    if (!label) return NULL;
+    size_t off = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i) label[off++] = '/';
+        memcpy(label + off, seg[i].ptr, seg[i].len);
+        off += seg[i].len;
+    }
+    *out_len = len;
+    return label;
+}
+
+/* Walks or creates the static run seg[0..count) below `node`; returns the node after it. */
+static cwist_route_node *cwist_route_node_insert_static(cwist_route_node *node, const cwist_route_segment *seg, size_t count) {
+    while (count > 0) {
+        size_t slot = 0;
+        cwist_route_node *child = cwist_route_node_child(node, seg[0].ptr, seg[0].len, &slot);
+        if (!child) {
+            size_t label_len = 0;
+            char *label = cwist_route_join(seg, count, &label_len);
+            if (!label) return NULL;
+            child = cwist_route_node_create(NULL, 0);
+            if (!child) {
+                cwist_free(label);
+                return NULL;
+            }
+            child->label = label;
+            child->label_len = label_len;
+            if (!cwist_route_node_add_child(node, slot, child)) {
+                cwist_route_node_destroy(child);
+                return NULL;
+            }
+            return child;
+        }
+
+        // Count how many of the child's segments the pattern shares.
+        size_t pos = 0;
+        size_t shared = 0;
+        size_t shared_bytes = 0;
+        cwist_route_segment label_seg;
+        while (shared < count && cwist_route_next_segment(child->label, child->label_len, &pos, &label_seg)) {
+            if (label_seg.len != seg[shared].len || memcmp(label_seg.ptr, seg[shared].ptr, label_seg.len) != 0) break;
+            shared_bytes = pos;
+            shared++;
+        }
+        if (shared_bytes < child->label_len) {
+            child = cwist_route_node_split(node, slot, shared_bytes);
+            if (!child) return NULL;
+        }
+        node = child;
+        seg += shared;
+        count -= shared;
+    }
+    return node;
+}
+
+/* Matches the static segments of `node`'s label against the path at *pos. */
+static bool cwist_route_match_label(const cwist_route_node *node, const char *path, size_t len, size_t *pos) {
+    size_t label_pos = 0;
+    size_t p = *pos;
+    cwist_route_segment label_seg, seg;
+    while (cwist_route_next_segment(node->label, node->label_len, &label_pos, &label_seg)) {
+        if (!cwist_route_next_segment(path, len, &p, &seg)) return false;
+        if (seg.len != label_seg.len || memcmp(seg.ptr, label_seg.ptr, seg.len) != 0) return false;
+    }
+    *pos = p;
+    return true;
+}
+
+/*
+ * Depth-first match: static child, then `:param`, then `*wildcard`. On failure
+ * match->param_count is left as it was on entry.
+ */
+static const cwist_route_entry *cwist_route_node_match(const cwist_route_node *node, cwist_http_method_t method,
+                                                       const char *path, size_t len, size_t pos, cwist_route_match *match) {
+    const cwist_route_entry *found;
+    cwist_route_segment seg;
+    size_t next = pos;
+    if (!cwist_route_next_segment(path, len, &next, &seg)) {
+        found = cwist_route_list_find(node->routes, method);
+        if (found) return found;
+        if (node->wildcard && match->param_count < CWIST_ROUTE_MAX_PARAMS) {
+            found = cwist_route_list_find(node->wildcard->routes, method);
+            if (found) {
+                match->params[match->param_count++] = (cwist_route_capture){ len, 0 };
+                return found;
+            }
+        }
+        return NULL;
+    }
+
+    const cwist_route_node *child = cwist_route_node_child(node, seg.ptr, seg.len, NULL);
+    if (child) {
+        size_t after = pos;
+        if (cwist_route_match_label(child, path, len, &after)) {
+            found = cwist_route_node_match(child, method, path, len, after, match);
+            if (found) return found;
+        }
+    }
+
+    if (match->param_count >= CWIST_ROUTE_MAX_PARAMS) return NULL;
+    size_t offset = (size_t)(seg.ptr - path);
+    if (node->param) {
+        size_t saved = match->param_count;
+        match->params[match->param_count++] = (cwist_route_capture){ offset, seg.len };
+        found = cwist_route_node_match(node->param, method, path, len, next, match);
+        if (found) return found;
+        match->param_count = saved;
+    }
+    if (node->wildcard) {
+        found = cwist_route_list_find(node->wildcard->routes, method);
+        if (found) {
+            match->params[match->param_count++] = (cwist_route_capture){ offset, len - offset };
+            return found;
+        }
+    }
+    return NULL;
+}
+
+/* --- Table --- */
+
+cwist_route_table *cwist_route_table_create(void) {
+    cwist_route_table *table = (cwist_route_table *)cwist_alloc(sizeof(cwist_route_table));
+    if (!table) return NULL;
+    table->bucket_count = CWIST_ROUTE_BUCKETS;
+    table->buckets = (cwist_route_entry **)cwist_alloc_array(table->bucket_count, sizeof(cwist_route_entry *));
+    table->root = cwist_route_node_create(NULL, 0);
+    if (!table->buckets || !table->root) {
+        cwist_free(table->buckets);
+        cwist_free(table->root);
+        cwist_free(table);
+        return NULL;
+    }
+    return table;
+}
+
+void cwist_route_table_destroy(cwist_route_table *table) {
+    if (!table) return;
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        cwist_route_entry *curr = table->buckets[i];
+        while (curr) {
+            cwist_route_entry *next = curr->next;
+            cwist_route_entry_free(curr);
+            curr = next;
+        }
+    }
+    cwist_free(table->buckets);
+    cwist_phash_destroy(table->frozen);
+    cwist_route_node_destroy(table->root);
+    cwist_free(table);
+}
+
+/* Splits a pattern into its non-empty segments; NULL when it has none or on allocation failure. */
+static cwist_route_segment *cwist_route_split(const char *path, size_t *count_out) {
+    size_t len = strlen(path);
+    size_t pos = 0;
+    size_t count = 0;
+    cwist_route_segment seg;
+    while (cwist_route_next_segment(path, len, &pos, &seg)) count++;
+    *count_out = count;
+    if (count == 0) return NULL;
+
+    cwist_route_segment *segs = (cwist_route_segment *)cwist_alloc_array(count, sizeof(cwist_route_segment));
+    if (!segs) return NULL;
+    pos = 0;
+    for (size_t i = 0; i < count; i++) cwist_route_next_segment(path, len, &pos, &segs[i]);
+    return segs;
+}
+
+static bool cwist_route_table_insert_pattern(cwist_route_table *table, cwist_route_entry *entry) {
+    const char *path = entry->path;
+    size_t count = 0;
+    cwist_route_segment *segs = cwist_route_split(path, &count);
+    if (!segs) return false;
+
+    size_t params = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (segs[i].ptr[0] == ':' || segs[i].ptr[0] == '*') params++;
+        if (segs[i].ptr[0] == '*' && i + 1 != count) {
+            fprintf(stderr, "[Router] '*' must be the last segment: %s\n", path);
+            cwist_free(segs);
+            return false;
+        }
+    }
+    if (params > CWIST_ROUTE_MAX_PARAMS) {
+        fprintf(stderr, "[Router] Too many parameters (max %d): %s\n", CWIST_ROUTE_MAX_PARAMS, path);
+        cwist_free(segs);
+        return false;
+    }
+    entry->param_names = (char **)cwist_alloc_array(params, sizeof(char *));
+    if (!entry->param_names) {
+        cwist_free(segs);
+        return false;
+    }
+
+    cwist_route_node *node = table->root;
+    size_t i = 0;
+    while (node && i < count) {
+        char kind = segs[i].ptr[0];
+        if (kind == ':' || kind == '*') {
+            cwist_route_node **slot = kind == ':' ? &node->param : &node->wildcard;
+            if (!*slot) *slot = cwist_route_node_create(NULL, 0);
+            node = *slot;
+            const char *name = segs[i].len > 1 || kind == ':' ? segs[i].ptr + 1 : segs[i].ptr;
+            size_t name_len = segs[i].len > 1 || kind == ':' ? segs[i].len - 1 : 1;
+            char *copy = cwist_strndup(name, name_len);
+            if (!copy) node = NULL;
+            else entry->param_names[entry->param_count++] = copy;
+            i++;
+            continue;
+        }
+        size_t run = 1;
+        while (i + run < count && segs[i + run].ptr[0] != ':' && segs[i + run].ptr[0] != '*') run++;
+        node = cwist_route_node_insert_static(node, &segs[i], run);
+        i += run;
+    }
+    cwist_free(segs);
+    if (!node) return false;
+
+    cwist_route_list_put(&node->routes, entry, false);
+    return true;
+}
+
+bool cwist_route_table_insert(cwist_route_table *table, const char *path, cwist_http_method_t method,
+                              cwist_route_handler_func handler, cwist_route_ws_handler_func ws_handler) {
+    return cwist_route_table_insert_chain(table, path, method, handler, ws_handler, NULL);
+}
+
+bool cwist_route_table_insert_chain(cwist_route_table *table, const char *path, cwist_http_method_t method,
+                                    cwist_route_handler_func handler, cwist_route_ws_handler_func ws_handler,
+                                    const struct cwist_middleware_chain *middleware) {
+    if (!table || !path) return false;
+    cwist_route_entry *entry = cwist_route_entry_create(path[0] ? path : "/", method, handler, ws_handler);
+    if (!entry) return false;
+    entry->middleware = middleware;
+
+    size_t len = strlen(entry->path);
+    size_t pos = 0;
+    cwist_route_segment seg;
+    while (cwist_route_next_segment(entry->path, len, &pos, &seg)) {
+        if (seg.ptr[0] == ':' || seg.ptr[0] == '*') entry->has_params = true;
+    }
+
+    if (entry->has_params) {
+        if (!cwist_route_table_insert_pattern(table, entry)) {
+            cwist_route_entry_free(entry);
+            return false;
+        }
+        return true;
+    }
+
+    size_t idx = cwist_route_hash(method, entry->path, len, table->bucket_count);
+    if (cwist_route_list_put(&table->buckets[idx], entry, true)) table->exact_count++;
+    // The frozen table no longer covers every route; lookups use the buckets until the next freeze.
+    cwist_phash_destroy(table->frozen);
+    table->frozen = NULL;
+    return true;
+}
+
+/* Follows a pattern through the tree without creating nodes. */
+static cwist_route_node *cwist_route_node_find_pattern(cwist_route_node *node, const cwist_route_segment *segs, size_t count) {
+    size_t i = 0;
+    while (node && i < count) {
+        char kind = segs[i].ptr[0];
+        if (kind == ':' || kind == '*') {
+            node = kind == ':' ? node->param : node->wildcard;
+            i++;
+            continue;
+        }
+        cwist_route_node *child = cwist_route_node_child(node, segs[i].ptr, segs[i].len, NULL);
+        if (!child) return NULL;
+        size_t pos = 0;
+        cwist_route_segment label_seg;
+        while (cwist_route_next_segment(child->label, child->label_len, &pos, &label_seg)) {
+            if (i == count || label_seg.len != segs[i].len || memcmp(label_seg.ptr, segs[i].ptr, label_seg.len) != 0) {
+                return NULL;
+            }
+            i++;
+        }
+        node = child;
+    }
+    return node;
+}
+
+static bool cwist_route_list_remove(cwist_route_entry **head, cwist_http_method_t method, const char *path) {
+    for (cwist_route_entry **link = head; *link; link = &(*link)->next) {
+        cwist_route_entry *curr = *link;
+        if (curr->method == method && (!path || strcmp(curr->path, path) == 0)) {
+            *link = curr->next;
+            cwist_route_entry_free(curr);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool cwist_route_table_remove(cwist_route_table *table, cwist_http_method_t method, const char *path) {
+    if (!table || !path) return false;
+    if (!path[0]) path = "/";
+
+    size_t count = 0;
+    cwist_route_segment *segs = cwist_route_split(path, &count);
+    bool pattern = false;
+    for (size_t i = 0; i < count && segs; i++) {
+        if (segs[i].ptr[0] == ':' || segs[i].ptr[0] == '*') pattern = true;
+    }
+
+    bool removed;
+    if (pattern) {
+        // Param names are not part of the tree, so "/u/:name" removes "/u/:id" too.
+        cwist_route_node *node = cwist_route_node_find_pattern(table->root, segs, count);
+        removed = node && cwist_route_list_remove(&node->routes, method, NULL);
+    } else {
+        size_t idx = cwist_route_hash(method, path, strlen(path), table->bucket_count);
+        removed = cwist_route_list_remove(&table->buckets[idx], method, path);
+        if (removed) {
+            table->exact_count--;
+            cwist_phash_destroy(table->frozen);
+            table->frozen = NULL;
+        }
+    }
+    cwist_free(segs);
+    return removed;
+}
+
+static bool cwist_route_node_copy_routes(cwist_route_table *dst, const cwist_route_node *node) {
+    for (const cwist_route_entry *curr = node->routes; curr; curr = curr->next) {
+        if (!cwist_route_table_insert_chain(dst, curr->path, curr->method, curr->handler, curr->ws_handler,
+                                            curr->middleware)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < node->child_count; i++) {
+        if (!cwist_route_node_copy_routes(dst, node->children[i])) return false;
+    }
+    if (node->param && !cwist_route_node_copy_routes(dst, node->param)) return false;
+    if (node->wildcard && !cwist_route_node_copy_routes(dst, node->wildcard)) return false;
+    return true;
+}
+
+cwist_route_table *cwist_route_table_clone(const cwist_route_table *table) {
+    if (!table) return NULL;
+    cwist_route_table *copy = cwist_route_table_create();
+    if (!copy) return NULL;
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        for (const cwist_route_entry *curr = table->buckets[i]; curr; curr = curr->next) {
+            if (!cwist_route_table_insert_chain(copy, curr->path, curr->method, curr->handler, curr->ws_handler,
+                                                curr->middleware)) {
+                cwist_route_table_destroy(copy);
+                return NULL;
+            }
+        }
+    }
+    if (!cwist_route_node_copy_routes(copy, table->root)) {
+        cwist_route_table_destroy(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+static void cwist_route_node_foreach(cwist_route_node *node, void (*fn)(cwist_route_entry *, void *), void *ctx) {
+    for (cwist_route_entry *curr = node->routes; curr; curr = curr->next) fn(curr, ctx);
+    for (size_t i = 0; i < node->child_count; i++) cwist_route_node_foreach(node->children[i], fn, ctx);
+    if (node->param) cwist_route_node_foreach(node->param, fn, ctx);
+    if (node->wildcard) cwist_route_node_foreach(node->wildcard, fn, ctx);
+}
+
+void cwist_route_table_foreach(cwist_route_table *table, void (*fn)(cwist_route_entry *entry, void *ctx), void *ctx) {
+    if (!table || !fn) return;
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        for (cwist_route_entry *curr = table->buckets[i]; curr; curr = curr->next) fn(curr, ctx);
+    }
+    cwist_route_node_foreach(table->root, fn, ctx);
+}
+
+bool cwist_route_table_freeze(cwist_route_table *table) {
+    if (!table) return false;
+    cwist_phash_destroy(table->frozen);
+    table->frozen = NULL;
+    if (table->exact_count == 0) return true;
+
+    cwist_phash_key *keys = (cwist_phash_key *)cwist_alloc_array(table->exact_count, sizeof(cwist_phash_key));
+    if (!keys) return false;
+    size_t n = 0;
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        for (cwist_route_entry *curr = table->buckets[i]; curr; curr = curr->next) {
+            keys[n++] = (cwist_phash_key){ curr->path, strlen(curr->path), (uint32_t)curr->method, curr };
+        }
+    }
+    table->frozen = cwist_phash_build(keys, n);
+    cwist_free(keys);
+    return table->frozen != NULL;
+}
+
+bool cwist_route_table_match(cwist_route_table *table, cwist_http_method_t method,
+                             const char *path, size_t len, cwist_route_match *match) {
+    if (!table || !path || !match) return false;
+    match->param_count = 0;
+    match->route = cwist_route_table_lookup_exact(table, method, path, len);
+    if (!match->route) {
+        match->route = cwist_route_node_match(table->root, method, path, len, 0, match);
+    }
+    return match->route != NULL;
+}
+
+void cwist_route_match_bind(const cwist_route_match *match, const char *path, cwist_query_map *params) {
+    if (!match || !params) return;
+    cwist_query_map_clear(params);
+    if (!match->route || !path) return;
+    for (size_t i = 0; i < match->param_count && i < match->route->param_count; i++) {
+        const char *name = match->route->param_names[i];
+        cwist_query_map_set_len(params, name, strlen(name), path + match->params[i].offset, match->params[i].len);
+    }
+}
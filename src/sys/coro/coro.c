@@ -0,0 +1,495 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <cwist/sys/coro/coro.h>
+#include <cwist/core/mem/alloc.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+
+#include <ucontext.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#define CWIST_CORO_MIN_STACK_SIZE (16 * 1024)
+#define CWIST_CORO_MAX_EVENTS 64
+#define CWIST_CORO_DRAIN_POLL_MS 200
+
+typedef struct cwist_coro_sched cwist_coro_sched;
+
+typedef struct cwist_coro {
+    ucontext_t uc;
+    char *stack;              ///< mmap base; the lowest page is a guard page.
+    size_t stack_len;
+    int client_fd;
+    int wait_fd;              ///< Descriptor registered in the scheduler's epoll set, or -1.
+    uint32_t revents;
+    uint64_t deadline_ms;
+    bool waiting;
+    bool done;
+    struct cwist_coro *next;  ///< Ready queue or free list.
+    struct cwist_coro *timer_prev;
+    struct cwist_coro *timer_next;
+} cwist_coro;
+
+struct cwist_coro_sched {
+    int epoll_fd;
+    int wake_fd;              ///< eventfd signalled when the inbox has new connections.
+    ucontext_t main_uc;
+    cwist_coro *current;
+    cwist_coro *ready_head;
+    cwist_coro *ready_tail;
+    cwist_coro *timers;       ///< Waiters with a deadline (unsorted; scanned once per loop).
+    cwist_coro *free_list;
+    size_t free_count;
+    size_t live;
+    size_t stack_size;
+    pthread_mutex_t inbox_lock;
+    int *inbox;
+    size_t inbox_len;
+    size_t inbox_cap;
+    bool stopping;
+    void (*handler)(int, void *);
+    void *ctx;
+    pthread_t thread;
+};
+
+static __thread cwist_coro_sched *t_coro_sched = NULL;
+
+static uint64_t cwist_coro_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void cwist_coro_ready_push(cwist_coro_sched *sched, cwist_coro *co) {
+    co->next = NULL;
+    if (sched->ready_tail) sched->ready_tail->next = co;
+    else sched->ready_head = co;
+    sched->ready_tail = co;
+}
+
+static void cwist_coro_timer_add(cwist_coro_sched *sched, cwist_coro *co) {
+    co->timer_prev = NULL;
+    co->timer_next = sched->timers;
+    if (sched->timers) sched->timers->timer_prev = co;
+    sched->timers = co;
+}
+
+static void cwist_coro_timer_remove(cwist_coro_sched *sched, cwist_coro *co) {
+    if (!co->deadline_ms) return;
+    if (co->timer_prev) co->timer_prev->timer_next = co->timer_next;
+    else sched->timers = co->timer_next;
+    if (co->timer_next) co->timer_next->timer_prev = co->timer_prev;
+    co->timer_prev = co->timer_next = NULL;
+    co->deadline_ms = 0;
+}
+
+/* Wakes a parked coroutine; it runs on the next pass over the ready queue. */
+static void cwist_coro_wake(cwist_coro_sched *sched, cwist_coro *co, uint32_t revents) {
+    co->waiting = false;
+    co->revents = revents;
+    cwist_coro_timer_remove(sched, co);
+    cwist_coro_ready_push(sched, co);
+}
+
+static void cwist_coro_entry(void) {
+    cwist_coro_sched *sched = t_coro_sched;
+    cwist_coro *co = sched->current;
+    sched->handler(co->client_fd, sched->ctx);
+    co->done = true;
+    // Returning resumes uc_link, i.e. the scheduler.
+}
+
+static bool cwist_coro_prepare(cwist_coro_sched *sched, cwist_coro *co) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (getcontext(&co->uc) < 0) return false;
+    co->uc.uc_stack.ss_sp = co->stack + page;
+    co->uc.uc_stack.ss_size = co->stack_len - page;
+    co->uc.uc_link = &sched->main_uc;
+    makecontext(&co->uc, cwist_coro_entry, 0);
+    return true;
+}
+
+static cwist_coro *cwist_coro_acquire(cwist_coro_sched *sched) {
+    cwist_coro *co = sched->free_list;
+    if (co) {
+        sched->free_list = co->next;
+        sched->free_count--;
+    } else {
+        co = (cwist_coro *)cwist_alloc(sizeof(cwist_coro));
+        if (!co) return NULL;
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        co->stack_len = sched->stack_size + page;
+        void *stack = mmap(NULL, co->stack_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if (stack == MAP_FAILED) {
+            cwist_free(co);
+            return NULL;
+        }
+        mprotect(stack, page, PROT_NONE); // Overflow faults instead of corrupting a neighbour.
+        co->stack = (char *)stack;
+    }
+
+    if (!cwist_coro_prepare(sched, co)) {
+        munmap(co->stack, co->stack_len);
+        cwist_free(co);
+        return NULL;
+    }
+
+    co->wait_fd = -1;
+    co->revents = 0;
+    co->deadline_ms = 0;
+    co->waiting = false;
+    co->done = false;
+    co->next = co->timer_prev = co->timer_next = NULL;
+    return co;
+}
+
+static void cwist_coro_release(cwist_coro_sched *sched, cwist_coro *co) {
+    if (sched->free_count < CWIST_CORO_STACK_CACHE) {
+        co->next = sched->free_list;
+        sched->free_list = co;
+        sched->free_count++;
+        return;
+    }
+    munmap(co->stack, co->stack_len);
+    cwist_free(co);
+}
+
+static void cwist_coro_suspend(cwist_coro_sched *sched, cwist_coro *co) {
+    swapcontext(&co->uc, &sched->main_uc);
+}
+
+static void cwist_coro_run_ready(cwist_coro_sched *sched) {
+    // Only run what is ready now; coroutines that yield go to the next pass.
+    cwist_coro *batch = sched->ready_head;
+    sched->ready_head = sched->ready_tail = NULL;
+    while (batch) {
+        cwist_coro *co = batch;
+        batch = co->next;
+        sched->current = co;
+        swapcontext(&sched->main_uc, &co->uc);
+        sched->current = NULL;
+        if (co->done) {
+            sched->live--;
+            cwist_coro_release(sched, co);
+        }
+    }
+}
+
+static void cwist_coro_take_inbox(cwist_coro_sched *sched) {
+    uint64_t value;
+    while (read(sched->wake_fd, &value, sizeof(value)) == sizeof(value)) {}
+
+    pthread_mutex_lock(&sched->inbox_lock);
+    int *fds = sched->inbox;
+    size_t count = sched->inbox_len;
+    sched->inbox = NULL;
+    sched->inbox_len = sched->inbox_cap = 0;
+    pthread_mutex_unlock(&sched->inbox_lock);
+
+    for (size_t i = 0; i < count; i++) {
+        cwist_coro *co = cwist_coro_acquire(sched);
+        if (!co) {
+            close(fds[i]);
+            continue;
+        }
+        co->client_fd = fds[i];
+        sched->live++;
+        cwist_coro_ready_push(sched, co);
+    }
+    cwist_free(fds);
+}
+
+static void cwist_coro_expire_timers(cwist_coro_sched *sched, uint64_t now) {
+    cwist_coro *co = sched->timers;
+    while (co) {
+        cwist_coro *next = co->timer_next;
+        if (co->deadline_ms <= now) {
+            // Drop the registration so a late event cannot wake a recycled coroutine.
+            if (co->wait_fd >= 0) epoll_ctl(sched->epoll_fd, EPOLL_CTL_DEL, co->wait_fd, NULL);
+            cwist_coro_wake(sched, co, 0);
+        }
+        co = next;
+    }
+}
+
+static int cwist_coro_next_timeout(cwist_coro_sched *sched, uint64_t now) {
+    if (sched->ready_head) return 0;
+    uint64_t nearest = 0;
+    for (cwist_coro *co = sched->timers; co; co = co->timer_next) {
+        if (!nearest || co->deadline_ms < nearest) nearest = co->deadline_ms;
+    }
+    if (!nearest) return -1;
+    return nearest <= now ? 0 : (int)(nearest - now);
+}
+
+static void *cwist_coro_sched_main(void *arg) {
+    cwist_coro_sched *sched = (cwist_coro_sched *)arg;
+    t_coro_sched = sched;
+
+    // Drain signals belong to the accepting thread.
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    uint64_t drain_deadline = 0;
+    struct epoll_event events[CWIST_CORO_MAX_EVENTS];
+    while (true) {
+        cwist_coro_run_ready(sched);
+
+        pthread_mutex_lock(&sched->inbox_lock);
+        bool stopping = sched->stopping && sched->inbox_len == 0;
+        pthread_mutex_unlock(&sched->inbox_lock);
+
+        uint64_t now = cwist_coro_now_ms();
+        int timeout = cwist_coro_next_timeout(sched, now);
+        if (stopping) {
+            if (!drain_deadline) drain_deadline = now + CWIST_HTTP_DRAIN_TIMEOUT_MS;
+            if (sched->live == 0 || now >= drain_deadline) break;
+            if (timeout < 0 || timeout > 100) timeout = 100;
+        }
+
+        int count = epoll_wait(sched->epoll_fd, events, CWIST_CORO_MAX_EVENTS, timeout);
+        if (count < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            cwist_coro *co = (cwist_coro *)events[i].data.ptr;
+            if (!co) {
+                cwist_coro_take_inbox(sched);
+            } else if (co->waiting) {
+                cwist_coro_wake(sched, co, events[i].events);
+            }
+        }
+        cwist_coro_expire_timers(sched, cwist_coro_now_ms());
+    }
+
+    t_coro_sched = NULL;
+    return NULL;
+}
+
+static void cwist_coro_submit(cwist_coro_sched *sched, int fd) {
+    pthread_mutex_lock(&sched->inbox_lock);
+    if (sched->inbox_len == sched->inbox_cap) {
+        size_t cap = sched->inbox_cap ? sched->inbox_cap * 2 : 16;
+        int *grown = (int *)cwist_realloc(sched->inbox, cap * sizeof(int));
+        if (!grown) {
+            pthread_mutex_unlock(&sched->inbox_lock);
+            close(fd);
+            return;
+        }
+        sched->inbox = grown;
+        sched->inbox_cap = cap;
+    }
+    sched->inbox[sched->inbox_len++] = fd;
+    pthread_mutex_unlock(&sched->inbox_lock);
+
+    uint64_t one = 1;
+    ssize_t ignored = write(sched->wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+static void cwist_coro_sched_stop(cwist_coro_sched *sched) {
+    pthread_mutex_lock(&sched->inbox_lock);
+    sched->stopping = true;
+    pthread_mutex_unlock(&sched->inbox_lock);
+    uint64_t one = 1;
+    ssize_t ignored = write(sched->wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+static void cwist_coro_sched_cleanup(cwist_coro_sched *sched) {
+    if (sched->epoll_fd >= 0) close(sched->epoll_fd);
+    if (sched->wake_fd >= 0) close(sched->wake_fd);
+    while (sched->free_list) {
+        cwist_coro *co = sched->free_list;
+        sched->free_list = co->next;
+        munmap(co->stack, co->stack_len);
+        cwist_free(co);
+    }
+    for (size_t i = 0; i < sched->inbox_len; i++) close(sched->inbox[i]);
+    cwist_free(sched->inbox);
+    pthread_mutex_destroy(&sched->inbox_lock);
+}
+
+static bool cwist_coro_sched_init(cwist_coro_sched *sched, size_t stack_size, void (*handler)(int, void *), void *ctx) {
+    sched->stack_size = stack_size;
+    sched->handler = handler;
+    sched->ctx = ctx;
+    sched->wake_fd = -1;
+    pthread_mutex_init(&sched->inbox_lock, NULL);
+
+    sched->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (sched->epoll_fd < 0) return false;
+    sched->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (sched->wake_fd < 0) return false;
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    return epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, sched->wake_fd, &ev) == 0;
+}
+
+bool cwist_coro_active(void) {
+    return t_coro_sched && t_coro_sched->current;
+}
+
+int cwist_coro_poll(int fd, short events, int timeout_ms) {
+    cwist_coro_sched *sched = t_coro_sched;
+    cwist_coro *co = sched ? sched->current : NULL;
+    if (!co) {
+        struct pollfd pfd = { .fd = fd, .events = events };
+        return poll(&pfd, 1, timeout_ms);
+    }
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLONESHOT;
+    if (events & POLLIN) ev.events |= EPOLLIN | EPOLLRDHUP;
+    if (events & POLLOUT) ev.events |= EPOLLOUT;
+    ev.data.ptr = co;
+    if (epoll_ctl(sched->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        if (errno != ENOENT) return -1;
+        if (epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            // Regular files are always ready, as with poll().
+            return errno == EPERM ? 1 : -1;
+        }
+    }
+
+    co->wait_fd = fd;
+    co->waiting = true;
+    if (timeout_ms >= 0) {
+        co->deadline_ms = cwist_coro_now_ms() + (uint64_t)timeout_ms;
+        if (!co->deadline_ms) co->deadline_ms = 1;
+        cwist_coro_timer_add(sched, co);
+    }
+    cwist_coro_suspend(sched, co);
+    return co->revents ? 1 : 0;
+}
+
+void cwist_coro_sleep_ms(int ms) {
+    cwist_coro_sched *sched = t_coro_sched;
+    cwist_coro *co = sched ? sched->current : NULL;
+    if (!co) {
+        struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+        nanosleep(&ts, NULL);
+        return;
+    }
+    co->wait_fd = -1;
+    co->waiting = true;
+    co->deadline_ms = cwist_coro_now_ms() + (uint64_t)(ms > 0 ? ms : 0);
+    if (!co->deadline_ms) co->deadline_ms = 1;
+    cwist_coro_timer_add(sched, co);
+    cwist_coro_suspend(sched, co);
+}
+
+void cwist_coro_yield(void) {
+    cwist_coro_sched *sched = t_coro_sched;
+    cwist_coro *co = sched ? sched->current : NULL;
+    if (!co) return;
+    cwist_coro_ready_push(sched, co);
+    cwist_coro_suspend(sched, co);
+}
+
+bool cwist_coro_serve(int server_fd, cwist_server_config *config, void (*handler)(int, void *), void *ctx) {
+    if (server_fd < 0 || !config || !handler) return false;
+
+    size_t count = config->worker_threads;
+    if (count == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cpus > 0 ? (size_t)cpus : 1;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t stack_size = config->coroutine_stack_size ? config->coroutine_stack_size : CWIST_CORO_DEFAULT_STACK_SIZE;
+    if (stack_size < CWIST_CORO_MIN_STACK_SIZE) stack_size = CWIST_CORO_MIN_STACK_SIZE;
+    stack_size = (stack_size + page - 1) / page * page;
+
+    cwist_coro_sched *scheds = (cwist_coro_sched *)cwist_alloc_array(count, sizeof(cwist_coro_sched));
+    if (!scheds) return false;
+
+    size_t started = 0;
+    for (size_t i = 0; i < count; i++) {
+        cwist_coro_sched *sched = &scheds[i];
+        if (!cwist_coro_sched_init(sched, stack_size, handler, ctx) ||
+            pthread_create(&sched->thread, NULL, cwist_coro_sched_main, sched) != 0) {
+            cwist_coro_sched_cleanup(sched);
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        cwist_free(scheds);
+        return false;
+    }
+
+    size_t next = 0;
+    struct pollfd listener = { .fd = server_fd, .events = POLLIN };
+    while (!cwist_http_server_is_draining()) {
+        // The drain signal may land on another thread; wake up now and then to look.
+        int ready = poll(&listener, 1, CWIST_CORO_DRAIN_POLL_MS);
+        if (ready == 0 || (ready < 0 && errno == EINTR)) continue;
+        int client_fd = accept4(server_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN || errno == EPROTO) continue;
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                fprintf(stderr, "[CWIST] coroutine accept backoff: %s\n", strerror(errno));
+                struct timespec ts = { .tv_sec = 0, .tv_nsec = 50 * 1000 * 1000 };
+                nanosleep(&ts, NULL);
+                continue;
+            }
+            perror("accept");
+            break;
+        }
+        cwist_coro_submit(&scheds[next++ % started], client_fd);
+    }
+
+    for (size_t i = 0; i < started; i++) cwist_coro_sched_stop(&scheds[i]);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(scheds[i].thread, NULL);
+        cwist_coro_sched_cleanup(&scheds[i]);
+    }
+    cwist_free(scheds);
+    return true;
+}
+
+#else
+
+bool cwist_coro_active(void) {
+    return false;
+}
+
+int cwist_coro_poll(int fd, short events, int timeout_ms) {
+    struct pollfd pfd = { .fd = fd, .events = events };
+    return poll(&pfd, 1, timeout_ms);
+}
+
+void cwist_coro_sleep_ms(int ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+void cwist_coro_yield(void) {}
+
+bool cwist_coro_serve(int server_fd, cwist_server_config *config, void (*handler)(int, void *), void *ctx) {
+    (void)server_fd;
+    (void)config;
+    (void)handler;
+    (void)ctx;
+    return false; // Scheduler is epoll/ucontext based.
+}
+
+#endif
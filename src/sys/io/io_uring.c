@@ -2,6 +2,48 @@
 #include <cwist/core/mem/alloc.h>
 #include <pthread.h>
 
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/**
+ * io_uring backend.
+ *
+ * The ring is driven through the raw syscalls (no liburing dependency):
+ *  - cwist_io_serve_http runs one ring per worker thread with a multishot
+ *    accept on the shared listener, multishot recv into a provided-buffer
+ *    ring, and response writes queued as SEND ops (linked to SHUTDOWN when
+ *    the connection ends). Framed requests run on a handler pool so a slow
+ *    handler never stalls the ring; finished batches come back through an
+ *    eventfd the ring keeps a READ armed on.
+ *
+ * Kernels without io_uring (or without multishot/provided-buffer rings) are
+ * detected at runtime; the HTTP engine then reports itself unavailable so the
+ * server loop can use epoll. The cwist_io_queue job API is a mutex queue.
+ */
+
+/* --- Job Queue --- */
+
+/*
+ * Jobs are plain function calls handed between threads of this process; a
+ * NOP round trip through a ring would cost a syscall per submit and buy
+ * nothing, so the job API stays on an unbounded mutex + condvar queue and
+ * only the HTTP engine below drives io_uring.
+ */
+
 struct job_wrapper {
     cwist_job_func func;
     void *arg;
@@ -88,3 +130,1096 @@ void cwist_io_queue_destroy(cwist_io_queue *q) {
     pthread_mutex_destroy(&q->lock);
     cwist_free(q);
 }
+
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT)
+
+/* --- Raw ring --- */
+
+typedef struct cwist_uring {
+    int fd;
+    unsigned sq_entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_local_tail;
+    unsigned sq_submitted;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    size_t sq_map_len;
+    void *cq_map;
+    size_t cq_map_len;
+    size_t sqes_len;
+} cwist_uring;
+
+static int cwist_uring_sys_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int cwist_uring_sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int cwist_uring_sys_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void cwist_uring_exit(cwist_uring *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_map && ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_len);
+    if (ring->sq_map && ring->sq_map != MAP_FAILED) munmap(ring->sq_map, ring->sq_map_len);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+static bool cwist_uring_init(cwist_uring *ring, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    int fd = cwist_uring_sys_setup(entries, &p);
+    if (fd < 0) return false;
+    ring->fd = fd;
+
+    ring->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_len > ring->sq_map_len) ring->sq_map_len = ring->cq_map_len;
+    }
+
+    ring->sq_map = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = NULL;
+        cwist_uring_exit(ring);
+        return false;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_map = ring->sq_map;
+    } else {
+        ring->cq_map = mmap(NULL, ring->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) {
+            ring->cq_map = NULL;
+            cwist_uring_exit(ring);
+            return false;
+        }
+    }
+
+    ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        cwist_uring_exit(ring);
+        return false;
+    }
+
+    char *sq = (char *)ring->sq_map;
+    char *cq = (char *)ring->cq_map;
+    ring->sq_entries = p.sq_entries;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->sq_submitted = ring->sq_local_tail;
+    return true;
+}
+
+/* Publishes queued SQEs and optionally waits for completions. */
+static int cwist_uring_submit(cwist_uring *ring, unsigned wait_nr) {
+    unsigned to_submit = ring->sq_local_tail - ring->sq_submitted;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    ring->sq_submitted = ring->sq_local_tail;
+    if (to_submit == 0 && wait_nr == 0) return 0;
+
+    while (true) {
+        int ret = cwist_uring_sys_enter(ring->fd, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (ret < 0 && errno == EINTR) {
+            if (wait_nr == 0) return 0;
+            to_submit = 0;
+            continue;
+        }
+        return ret;
+    }
+}
+
+static struct io_uring_sqe *cwist_uring_get_sqe(cwist_uring *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        // SQ full: flush what we have so the kernel consumes it.
+        cwist_uring_submit(ring, 0);
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (ring->sq_local_tail - head >= ring->sq_entries) return NULL;
+    }
+    unsigned idx = ring->sq_local_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+/* --- HTTP Engine --- */
+
+#define CWIST_URING_ENTRIES 512
+#define CWIST_URING_BUF_GROUP 0
+#define CWIST_URING_BUF_COUNT 256
+#define CWIST_URING_BUF_SIZE 4096
+#define CWIST_URING_SWEEP_NS (1000LL * 1000 * 1000)
+
+/* user_data = object pointer | op tag (objects are at least 8-byte aligned). */
+enum {
+    CWIST_UOP_ACCEPT = 0,
+    CWIST_UOP_RECV = 1,
+    CWIST_UOP_SEND = 2,
+    CWIST_UOP_SHUTDOWN = 3,
+    CWIST_UOP_CANCEL = 4,
+    CWIST_UOP_TIMEOUT = 5,
+    CWIST_UOP_WAKE = 6
+};
+#define CWIST_UOP_MASK 7ULL
+
+typedef struct cwist_uring_worker cwist_uring_worker;
+
+typedef struct cwist_uring_conn {
+    int fd;
+    cwist_uring_worker *worker;
+    bool recv_armed;
+    bool cancel_pending;   ///< A recv cancel is still owed; no SQE was free when it was needed.
+    bool busy;             ///< A handler thread owns the job_* and reply fields.
+    bool send_inflight;
+    bool shutdown_inflight;
+    bool closing;          ///< No further requests; shut down once output drains.
+    bool shutdown_done;
+    bool handoff;          ///< Blocking session (websocket) waiting for ring ops to stop.
+    char *in;              ///< Bytes of a partially received request.
+    size_t in_len;
+    size_t in_cap;
+    size_t in_scanned;     ///< Header bytes of `in` already searched for the terminator.
+    char *out;             ///< Responses queued while a send is in flight.
+    size_t out_len;
+    size_t out_cap;
+    char *wire;            ///< Buffer currently owned by the in-flight SEND.
+    size_t wire_len;
+    size_t wire_sent;
+    size_t wire_cap;
+    char *job_in;          ///< Complete requests handed to the handler pool.
+    size_t job_len;
+    bool job_keep_alive;
+    char *reply;           ///< Responses written by the handler while busy.
+    size_t reply_len;
+    size_t reply_cap;
+    bool reply_failed;
+    struct cwist_uring_conn *job_next; ///< Link in the pool queue, then in the worker's done list.
+    uint64_t last_active_ms;
+    struct cwist_uring_conn *prev;
+    struct cwist_uring_conn *next;
+} cwist_uring_conn;
+
+/*
+ * Handler threads shared by every ring. A connection has at most one job
+ * queued or running, so the queue is bounded by the open connections.
+ */
+typedef struct cwist_uring_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    cwist_uring_conn *head;
+    cwist_uring_conn *tail;
+    bool stopping;
+    pthread_t *threads;
+    size_t thread_count;
+} cwist_uring_pool;
+
+struct cwist_uring_worker {
+    cwist_uring ring;
+    int server_fd;
+    cwist_server_config *config;
+    void *ctx;
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_len;
+    char *buf_base;
+    unsigned short buf_tail;
+    cwist_uring_conn *conns;
+    cwist_uring_pool *pool;   ///< NULL runs handlers inline on the ring thread.
+    int wake_fd;              ///< eventfd handler threads signal when a job is done.
+    uint64_t wake_count;
+    bool wake_armed;
+    pthread_mutex_t done_lock;
+    cwist_uring_conn *done;   ///< Finished jobs waiting for the ring (done_lock).
+    size_t cancels_pending;
+    struct __kernel_timespec sweep_ts;
+    bool accept_armed;
+    uint64_t drain_deadline; ///< Non-zero once the worker stopped accepting to drain.
+    bool failed;            ///< Engine not usable on this kernel.
+    bool served;            ///< At least one connection was accepted.
+};
+
+typedef struct cwist_uring_handoff {
+    int fd;
+    char *frame;
+    size_t frame_len;
+    cwist_http_request_handler_fn on_request;
+    void *ctx;
+} cwist_uring_handoff;
+
+static uint64_t cwist_uring_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static bool cwist_uring_reserve(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return true;
+    size_t new_cap = *cap ? *cap : 1024;
+    while (new_cap < need) new_cap *= 2;
+    char *grown = (char *)cwist_realloc(*buf, new_cap);
+    if (!grown) return false;
+    *buf = grown;
+    *cap = new_cap;
+    return true;
+}
+
+static void cwist_uring_recycle_buffer(cwist_uring_worker *w, unsigned short bid) {
+    unsigned short mask = CWIST_URING_BUF_COUNT - 1;
+    struct io_uring_buf *buf = &w->buf_ring->bufs[w->buf_tail & mask];
+    buf->addr = (uint64_t)(uintptr_t)(w->buf_base + (size_t)bid * (CWIST_URING_BUF_SIZE + 1));
+    buf->len = CWIST_URING_BUF_SIZE;
+    buf->bid = bid;
+    w->buf_tail++;
+    __atomic_store_n(&w->buf_ring->tail, w->buf_tail, __ATOMIC_RELEASE);
+}
+
+static bool cwist_uring_setup_buffers(cwist_uring_worker *w) {
+    w->buf_ring_len = CWIST_URING_BUF_COUNT * sizeof(struct io_uring_buf);
+    void *ring_mem = mmap(NULL, w->buf_ring_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring_mem == MAP_FAILED) return false;
+    w->buf_ring = (struct io_uring_buf_ring *)ring_mem;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring_mem;
+    reg.ring_entries = CWIST_URING_BUF_COUNT;
+    reg.bgid = CWIST_URING_BUF_GROUP;
+    if (cwist_uring_sys_register(w->ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(ring_mem, w->buf_ring_len);
+        w->buf_ring = NULL;
+        return false;
+    }
+
+    // One spare byte per buffer so framed requests can be NUL-terminated in place.
+    w->buf_base = (char *)cwist_alloc((size_t)CWIST_URING_BUF_COUNT * (CWIST_URING_BUF_SIZE + 1));
+    if (!w->buf_base) return false;
+    w->buf_tail = 0;
+    for (unsigned short i = 0; i < CWIST_URING_BUF_COUNT; i++) {
+        cwist_uring_recycle_buffer(w, i);
+    }
+    return true;
+}
+
+static void cwist_uring_worker_cleanup(cwist_uring_worker *w) {
+    cwist_uring_exit(&w->ring);
+    if (w->wake_fd >= 0) close(w->wake_fd);
+    w->wake_fd = -1;
+    if (w->buf_ring) munmap(w->buf_ring, w->buf_ring_len);
+    w->buf_ring = NULL;
+    cwist_free(w->buf_base);
+    w->buf_base = NULL;
+}
+
+static bool cwist_uring_arm_accept(cwist_uring_worker *w) {
+    struct io_uring_sqe *sqe = cwist_uring_get_sqe(&w->ring);
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = w->server_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = CWIST_UOP_ACCEPT;
+    w->accept_armed = true;
+    return true;
+}
+
+static bool cwist_uring_arm_recv(cwist_uring_worker *w, cwist_uring_conn *conn) {
+    struct io_uring_sqe *sqe = cwist_uring_get_sqe(&w->ring);
+    if (!sqe) return false;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = CWIST_URING_BUF_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | CWIST_UOP_RECV;
+    conn->recv_armed = true;
+    return true;
+}
+
+static void cwist_uring_arm_timeout(cwist_uring_worker *w) {
+    struct io_uring_sqe *sqe = cwist_uring_get_sqe(&w->ring);
+    if (!sqe) return;
+    w->sweep_ts.tv_sec = CWIST_URING_SWEEP_NS / 1000000000LL;
+    w->sweep_ts.tv_nsec = 0;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&w->sweep_ts;
+    sqe->len = 1;
+    sqe->user_data = CWIST_UOP_TIMEOUT;
+}
+
+static void cwist_uring_arm_wake(cwist_uring_worker *w) {
+    struct io_uring_sqe *sqe = cwist_uring_get_sqe(&w->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = w->wake_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&w->wake_count;
+    sqe->len = sizeof(w->wake_count);
+    sqe->user_data = CWIST_UOP_WAKE;
+    w->wake_armed = true;
+}
+
+static void cwist_uring_queue_shutdown(cwist_uring_worker *w, cwist_uring_conn *conn) {
+    if (conn->shutdown_inflight || conn->shutdown_done) return;
+    struct io_uring_sqe *sqe = cwist_uring_get_sqe(&w->ring);
+    if (!sqe) {
+        shutdown(conn->fd, SHUT_RDWR);
+        conn->shutdown_done = true;
+        return;
+    }
+    sqe->opcode = IORING_OP_SHUTDOWN;
+    sqe->fd = conn->fd;
+    sqe->len = SHUT_RDWR;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | CWIST_UOP_SHUTDOWN;
+    conn->shutdown_inflight = true;
+}
+
+/*
+ * Moves queued output onto the wire. When the connection is ending, the SEND
+ * is linked to a SHUTDOWN so both go down in the same submission.
+ */
+static void cwist_uring_flush(cwist_uring_worker *w, cwist_uring_conn *conn) {
+    if (conn->send_inflight) return;
+
+    if (conn->wire_sent >= conn->wire_len && conn->out_len > 0) {
+        char *tmp = conn->wire;
+        size_t tmp_cap = conn->wire_cap;
+        conn->wire = conn->out;
+        conn->wire_cap = conn->out_cap;
+        conn->wire_len = conn->out_len;
+        conn->wire_sent = 0;
+        conn->out = tmp;
+        conn->out_cap = tmp_cap;
+        conn->out_len = 0;
+    }
+
+    if (conn->wire_sent < conn->wire_len) {
+        struct io_uring_sqe *sqe = cwist_uring_get_sqe(&w->ring);
+        if (!sqe) {
+            conn->closing = true;
+            conn->wire_len = conn->wire_sent = 0;
+            cwist_uring_queue_shutdown(w, conn);
+            return;
+        }
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = conn->fd;
+        sqe->addr = (uint64_t)(uintptr_t)(conn->wire + conn->wire_sent);
+        sqe->len = (unsigned)(conn->wire_len - conn->wire_sent);
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->user_data = (uint64_t)(uintptr_t)conn | CWIST_UOP_SEND;
+        conn->send_inflight = true;
+
+        if (conn->closing && conn->out_len == 0 && !conn->handoff && !conn->busy) {
+            sqe->flags |= IOSQE_IO_LINK;
+            cwist_uring_queue_shutdown(w, conn);
+        }
+        return;
+    }
+
+    if (conn->closing && !conn->handoff && !conn->busy) {
+        cwist_uring_queue_shutdown(w, conn);
+    }
+}
+
+/*
+ * Runs on the handler thread. The iov usually points into a response that is
+ * freed as soon as the handler returns, long before the ring's SEND runs, so
+ * the bytes are copied into the connection's reply buffer.
+ */
+static bool cwist_uring_send_hook(int client_fd, const struct iovec *iov, int iov_cnt, void *ctx) {
+    cwist_uring_conn *conn = (cwist_uring_conn *)ctx;
+    if (!conn || conn->fd != client_fd) return false;
+
+    size_t total = 0;
+    for (int i = 0; i < iov_cnt; i++) total += iov[i].iov_len;
+    if (!cwist_uring_reserve(&conn->reply, &conn->reply_cap, conn->reply_len + total)) {
+        conn->reply_failed = true;
+        return true;
+    }
+    for (int i = 0; i < iov_cnt; i++) {
+        memcpy(conn->reply + conn->reply_len, iov[i].iov_base, iov[i].iov_len);
+        conn->reply_len += iov[i].iov_len;
+    }
+    return true;
+}
+
+/* Runs the handed-over requests on the calling thread, then passes the connection back to its ring. */
+static void cwist_uring_serve(cwist_uring_conn *conn) {
+    cwist_uring_worker *w = conn->worker;
+    bool keep_alive = true;
+    size_t offset = 0;
+
+    cwist_http_set_send_hook(cwist_uring_send_hook, conn);
+    while (keep_alive && offset < conn->job_len) {
+        size_t frame_len = 0;
+        if (cwist_http_frame_request(conn->job_in + offset, conn->job_len - offset, &frame_len) != 1) break;
+        cwist_http_request *req = cwist_http_request_from_frame(conn->job_in + offset, frame_len);
+        offset += frame_len;
+        if (!req) {
+            keep_alive = false;
+            break;
+        }
+        req->client_fd = conn->fd;
+        keep_alive = w->config->on_request(conn->fd, req, w->ctx);
+        cwist_http_request_destroy(req);
+    }
+    cwist_http_set_send_hook(NULL, NULL);
+    conn->job_keep_alive = keep_alive && !conn->reply_failed;
+
+    // The ring may free the worker once its last connection is released; the
+    // wake goes out under done_lock, which the ring takes before it looks.
+    pthread_mutex_lock(&w->done_lock);
+    conn->job_next = w->done;
+    w->done = conn;
+    uint64_t one = 1;
+    if (write(w->wake_fd, &one, sizeof(one)) < 0) {
+        // The counter only saturates with wakes still unread; the ring is already due.
+    }
+    pthread_mutex_unlock(&w->done_lock);
+}
+
+static void *cwist_uring_pool_main(void *arg) {
+    cwist_uring_pool *pool = (cwist_uring_pool *)arg;
+
+    // Leave drain signals to the ring threads so they interrupt io_uring_enter.
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->head && !pool->stopping) {
+            pthread_cond_wait(&pool->not_empty, &pool->lock);
+        }
+        if (pool->stopping) break;
+        cwist_uring_conn *conn = pool->head;
+        pool->head = conn->job_next;
+        if (!pool->head) pool->tail = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        cwist_uring_serve(conn);
+
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static cwist_uring_pool *cwist_uring_pool_create(size_t threads) {
+    cwist_uring_pool *pool = (cwist_uring_pool *)cwist_alloc(sizeof(cwist_uring_pool));
+    if (!pool) return NULL;
+    pool->threads = (pthread_t *)cwist_alloc_array(threads, sizeof(pthread_t));
+    if (!pool->threads) {
+        cwist_free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    for (size_t i = 0; i < threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, cwist_uring_pool_main, pool) != 0) break;
+        pool->thread_count++;
+    }
+    if (pool->thread_count == 0) {
+        pthread_cond_destroy(&pool->not_empty);
+        pthread_mutex_destroy(&pool->lock);
+        cwist_free(pool->threads);
+        cwist_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+/* Lets running jobs finish and joins the threads; jobs still queued are never run. */
+static void cwist_uring_pool_destroy(cwist_uring_pool *pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_mutex_destroy(&pool->lock);
+    cwist_free(pool->threads);
+    cwist_free(pool);
+}
+
+static void cwist_uring_pool_push(cwist_uring_pool *pool, cwist_uring_conn *conn) {
+    conn->job_next = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail) {
+        pool->tail->job_next = conn;
+    } else {
+        pool->head = conn;
+    }
+    pool->tail = conn;
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void *cwist_uring_handoff_main(void *arg) {
+    cwist_uring_handoff *handoff = (cwist_uring_handoff *)arg;
+    cwist_http_request *req = cwist_http_request_from_frame(handoff->frame, handoff->frame_len);
+    if (req) {
+        req->client_fd = handoff->fd;
+        handoff->on_request(handoff->fd, req, handoff->ctx);
+        cwist_http_request_destroy(req);
+    }
+    close(handoff->fd);
+    cwist_free(handoff->frame);
+    free(handoff);
+    return NULL;
+}
+
+static bool cwist_uring_is_upgrade(const char *frame, size_t frame_len) {
+    const char *p = frame;
+    const char *end = frame + frame_len;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (!nl) break;
+        p = nl + 1;
+        if ((size_t)(end - p) > 8 && strncasecmp(p, "upgrade:", 8) == 0) return true;
+        if (p + 1 < end && p[0] == '\r' && p[1] == '\n') break;
+    }
+    return false;
+}
+
+static void cwist_uring_conn_free(cwist_uring_worker *w, cwist_uring_conn *conn, bool close_fd) {
+    if (close_fd) close(conn->fd);
+    if (conn->prev) conn->prev->next = conn->next;
+    else w->conns = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    if (conn->cancel_pending) w->cancels_pending--;
+    cwist_free(conn->in);
+    cwist_free(conn->out);
+    cwist_free(conn->wire);
+    cwist_free(conn->job_in);
+    cwist_free(conn->reply);
+    cwist_free(conn);
+}
+
+/* Frees the connection (or hands it to a blocking thread) once no ring op references it. */
+static bool cwist_uring_try_release(cwist_uring_worker *w, cwist_uring_conn *conn) {
+    if (conn->busy || conn->recv_armed || conn->send_inflight || conn->shutdown_inflight) return false;
+
+    if (conn->handoff) {
+        if (conn->out_len > 0 || conn->wire_sent < conn->wire_len) return false;
+        size_t frame_len = 0;
+        cwist_uring_handoff *handoff = malloc(sizeof(*handoff));
+        if (handoff && cwist_http_frame_request(conn->in, conn->in_len, &frame_len) == 1) {
+            handoff->fd = conn->fd;
+            handoff->frame = conn->in;
+            handoff->frame_len = frame_len;
+            handoff->on_request = w->config->on_request;
+            handoff->ctx = w->ctx;
+            conn->in = NULL;
+
+            int flags = fcntl(conn->fd, F_GETFL, 0);
+            if (flags >= 0) fcntl(conn->fd, F_SETFL, flags & ~O_NONBLOCK);
+
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, cwist_uring_handoff_main, handoff) == 0) {
+                pthread_detach(thread);
+                cwist_uring_conn_free(w, conn, false);
+                return true;
+            }
+            conn->in = handoff->frame;
+        }
+        free(handoff);
+        cwist_uring_conn_free(w, conn, true);
+        return true;
+    }
+
+    if (conn->closing && (conn->shutdown_done || conn->fd < 0)) {
+        cwist_uring_conn_free(w, conn, true);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * get_sqe already flushed the SQ once when it comes back empty-handed; the
+ * cancel is then owed and retried after the next completion pass.
+ */
+static void cwist_uring_cancel_recv(cwist_uring_worker *w, cwist_uring_conn *conn) {
+    if (!conn->recv_armed) return;
+    struct io_uring_sqe *sqe = cwist_uring_get_sqe(&w->ring);
+    if (!sqe) {
+        if (!conn->cancel_pending) {
+            conn->cancel_pending = true;
+            w->cancels_pending++;
+        }
+        return;
+    }
+    if (conn->cancel_pending) {
+        conn->cancel_pending = false;
+        w->cancels_pending--;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)conn | CWIST_UOP_RECV;
+    sqe->user_data = (uint64_t)(uintptr_t)conn | CWIST_UOP_CANCEL;
+}
+
+static void cwist_uring_retry_cancels(cwist_uring_worker *w) {
+    cwist_uring_conn *conn = w->conns;
+    while (conn && w->cancels_pending > 0) {
+        cwist_uring_conn *next = conn->next;
+        if (conn->cancel_pending) {
+            if (conn->recv_armed) {
+                cwist_uring_cancel_recv(w, conn);
+            } else {
+                conn->cancel_pending = false;
+                w->cancels_pending--;
+            }
+        }
+        conn = next;
+    }
+}
+
+/*
+ * Hands every complete request buffered on an idle connection to the handler
+ * pool. A request asking for a protocol upgrade stops the batch and stays
+ * buffered for the blocking handoff thread.
+ */
+static void cwist_uring_dispatch(cwist_uring_worker *w, cwist_uring_conn *conn) {
+    size_t take = 0;
+    while (!conn->closing && take < conn->in_len) {
+        size_t frame_len = 0;
+        int framed = cwist_http_frame_request(conn->in + take, conn->in_len - take, &frame_len);
+        if (framed == 0) break;
+        if (framed < 0) {
+            // Serve what came before the bad request, then close.
+            conn->closing = true;
+            break;
+        }
+        if (cwist_uring_is_upgrade(conn->in + take, frame_len)) {
+            conn->handoff = true;
+            cwist_uring_cancel_recv(w, conn);
+            break;
+        }
+        take += frame_len;
+    }
+    if (take == 0) return;
+
+    // The handler takes the buffer; bytes past the batch start a fresh one.
+    size_t rest = conn->in_len - take;
+    char *next = NULL;
+    size_t next_cap = 0;
+    if (rest > 0) {
+        if (!cwist_uring_reserve(&next, &next_cap, rest + 1)) {
+            conn->closing = true;
+            return;
+        }
+        memcpy(next, conn->in + take, rest);
+        next[rest] = '\0';
+    }
+    conn->job_in = conn->in;
+    conn->job_len = take;
+    conn->in = next;
+    conn->in_cap = next_cap;
+    conn->in_len = rest;
+    conn->in_scanned = 0;
+    conn->reply_len = 0;
+    conn->reply_failed = false;
+    conn->busy = true;
+
+    if (w->pool) {
+        cwist_uring_pool_push(w->pool, conn);
+    } else {
+        cwist_uring_serve(conn);
+    }
+}
+
+/* Takes a finished job back: queues its replies and dispatches whatever arrived meanwhile. */
+static void cwist_uring_finish(cwist_uring_worker *w, cwist_uring_conn *conn) {
+    conn->busy = false;
+    cwist_free(conn->job_in);
+    conn->job_in = NULL;
+    conn->job_len = 0;
+    if (!conn->job_keep_alive) conn->closing = true;
+
+    if (conn->reply_len > 0) {
+        if (conn->out_len == 0) {
+            char *tmp = conn->out;
+            size_t tmp_cap = conn->out_cap;
+            conn->out = conn->reply;
+            conn->out_cap = conn->reply_cap;
+            conn->out_len = conn->reply_len;
+            conn->reply = tmp;
+            conn->reply_cap = tmp_cap;
+        } else if (cwist_uring_reserve(&conn->out, &conn->out_cap, conn->out_len + conn->reply_len)) {
+            memcpy(conn->out + conn->out_len, conn->reply, conn->reply_len);
+            conn->out_len += conn->reply_len;
+        } else {
+            conn->closing = true;
+        }
+        conn->reply_len = 0;
+    }
+    if (conn->reply_cap > CWIST_URING_BUF_SIZE) {
+        cwist_free(conn->reply);
+        conn->reply = NULL;
+        conn->reply_cap = 0;
+    }
+
+    conn->last_active_ms = cwist_uring_now_ms();
+    if (!conn->closing && !conn->handoff) cwist_uring_dispatch(w, conn);
+    cwist_uring_flush(w, conn);
+    cwist_uring_try_release(w, conn);
+}
+
+static void cwist_uring_on_wake(cwist_uring_worker *w) {
+    w->wake_armed = false;
+    pthread_mutex_lock(&w->done_lock);
+    cwist_uring_conn *conn = w->done;
+    w->done = NULL;
+    pthread_mutex_unlock(&w->done_lock);
+    while (conn) {
+        cwist_uring_conn *next = conn->job_next;
+        cwist_uring_finish(w, conn);
+        conn = next;
+    }
+}
+
+static void cwist_uring_on_data(cwist_uring_worker *w, cwist_uring_conn *conn, char *data, size_t len) {
+    conn->last_active_ms = cwist_uring_now_ms();
+    if (conn->closing || conn->handoff) return;
+
+    // Pipelined bytes queue up behind a busy handler, up to one maximal request.
+    size_t limit = CWIST_HTTP_MAX_HEADER_SIZE + CWIST_HTTP_MAX_BODY_SIZE;
+    if (conn->in_len + len > limit ||
+        !cwist_uring_reserve(&conn->in, &conn->in_cap, conn->in_len + len + 1)) {
+        conn->closing = true;
+        return;
+    }
+    memcpy(conn->in + conn->in_len, data, len);
+    conn->in_len += len;
+    conn->in[conn->in_len] = '\0';
+
+    // A large header block arrives over many reads; only search the new bytes.
+    size_t frame_len = 0;
+    int framed = cwist_http_frame_request_resume(conn->in, conn->in_len, &conn->in_scanned, &frame_len);
+    if (framed < 0) conn->closing = true;
+    if (framed <= 0 || conn->busy) return;
+
+    cwist_uring_dispatch(w, conn);
+}
+
+static void cwist_uring_on_accept(cwist_uring_worker *w, struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        w->accept_armed = false;
+    }
+    if (cqe->res < 0) {
+        if (cqe->res == -EINVAL && !w->served) {
+            w->failed = true; // Multishot accept not supported by this kernel.
+        } else if (cqe->res == -EMFILE || cqe->res == -ENFILE || cqe->res == -ENOBUFS || cqe->res == -ENOMEM) {
+            fprintf(stderr, "[CWIST] io_uring accept backoff: %s\n", strerror(-cqe->res));
+            struct timespec ts = { .tv_sec = 0, .tv_nsec = 50 * 1000 * 1000 };
+            nanosleep(&ts, NULL);
+        }
+        return;
+    }
+
+    w->served = true;
+    cwist_uring_conn *conn = (cwist_uring_conn *)cwist_alloc(sizeof(cwist_uring_conn));
+    if (!conn) {
+        close(cqe->res);
+        return;
+    }
+    conn->fd = cqe->res;
+    conn->worker = w;
+    conn->last_active_ms = cwist_uring_now_ms();
+    conn->next = w->conns;
+    if (w->conns) w->conns->prev = conn;
+    w->conns = conn;
+    if (!cwist_uring_arm_recv(w, conn)) {
+        cwist_uring_conn_free(w, conn, true);
+    }
+}
+
+static void cwist_uring_on_recv(cwist_uring_worker *w, cwist_uring_conn *conn, struct io_uring_cqe *cqe) {
+    bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+
+    if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+        unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        char *data = w->buf_base + (size_t)bid * (CWIST_URING_BUF_SIZE + 1);
+        cwist_uring_on_data(w, conn, data, (size_t)cqe->res);
+        cwist_uring_recycle_buffer(w, bid);
+    } else if (cqe->res == 0) {
+        conn->closing = true;  // Peer closed its side.
+    } else if (cqe->res == -ENOBUFS) {
+        // Provided buffers ran dry; they are recycled immediately, so just re-arm.
+    } else if (cqe->res != -ECANCELED) {
+        if (cqe->res == -EINVAL && !w->served) w->failed = true;
+        conn->closing = true;
+    }
+
+    if (!more) {
+        conn->recv_armed = false;
+        if (!conn->closing && !conn->handoff) {
+            if (!cwist_uring_arm_recv(w, conn)) conn->closing = true;
+        }
+    }
+
+    cwist_uring_flush(w, conn);
+    cwist_uring_try_release(w, conn);
+}
+
+static void cwist_uring_on_send(cwist_uring_worker *w, cwist_uring_conn *conn, struct io_uring_cqe *cqe) {
+    conn->send_inflight = false;
+    if (cqe->res < 0) {
+        conn->closing = true;
+        conn->out_len = 0;
+        conn->wire_len = conn->wire_sent = 0;
+        cwist_uring_cancel_recv(w, conn);
+    } else {
+        conn->wire_sent += (size_t)cqe->res;
+        if (conn->wire_sent >= conn->wire_len) {
+            conn->wire_len = conn->wire_sent = 0;
+        }
+    }
+    cwist_uring_flush(w, conn);
+    cwist_uring_try_release(w, conn);
+}
+
+static void cwist_uring_on_shutdown(cwist_uring_worker *w, cwist_uring_conn *conn, struct io_uring_cqe *cqe) {
+    conn->shutdown_inflight = false;
+    if (cqe->res == -ECANCELED) {
+        // The linked SEND came up short; the shutdown is reissued after it drains.
+        cwist_uring_flush(w, conn);
+    } else {
+        conn->shutdown_done = true;
+        if (conn->recv_armed) cwist_uring_cancel_recv(w, conn);
+    }
+    cwist_uring_try_release(w, conn);
+}
+
+static void cwist_uring_sweep(cwist_uring_worker *w) {
+    uint64_t now = cwist_uring_now_ms();
+    cwist_uring_conn *conn = w->conns;
+    while (conn) {
+        cwist_uring_conn *next = conn->next;
+        if (!conn->closing && !conn->handoff && !conn->busy && now - conn->last_active_ms >= CWIST_HTTP_TIMEOUT_MS) {
+            conn->closing = true;
+            cwist_uring_flush(w, conn);
+        }
+        conn = next;
+    }
+}
+
+/* Stops accepting and closes idle connections; busy ones close after their current response. */
+static void cwist_uring_begin_drain(cwist_uring_worker *w) {
+    w->drain_deadline = cwist_uring_now_ms() + CWIST_HTTP_DRAIN_TIMEOUT_MS;
+    if (w->accept_armed) {
+        struct io_uring_sqe *sqe = cwist_uring_get_sqe(&w->ring);
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = CWIST_UOP_ACCEPT;
+            sqe->user_data = CWIST_UOP_CANCEL;
+        }
+    }
+    cwist_uring_conn *conn = w->conns;
+    while (conn) {
+        cwist_uring_conn *next = conn->next;
+        if (!conn->closing && !conn->handoff) {
+            conn->closing = true;
+            cwist_uring_flush(w, conn);
+        }
+        conn = next;
+    }
+}
+
+static void cwist_uring_worker_loop(cwist_uring_worker *w) {
+    if (!cwist_uring_arm_accept(w)) {
+        w->failed = true;
+        return;
+    }
+    cwist_uring_arm_timeout(w);
+
+    while (!w->failed) {
+        if (cwist_http_server_is_draining()) {
+            if (!w->drain_deadline) cwist_uring_begin_drain(w);
+            if (!w->conns || cwist_uring_now_ms() >= w->drain_deadline) break;
+        }
+
+        if (!w->wake_armed) cwist_uring_arm_wake(w);
+        if (cwist_uring_submit(&w->ring, 1) < 0 && errno != EINTR && errno != EBUSY) {
+            perror("io_uring_enter");
+            break;
+        }
+
+        cwist_uring *ring = &w->ring;
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+            head++;
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+            unsigned op = (unsigned)(cqe.user_data & CWIST_UOP_MASK);
+            cwist_uring_conn *conn = (cwist_uring_conn *)(uintptr_t)(cqe.user_data & ~CWIST_UOP_MASK);
+            switch (op) {
+                case CWIST_UOP_ACCEPT: cwist_uring_on_accept(w, &cqe); break;
+                case CWIST_UOP_RECV: cwist_uring_on_recv(w, conn, &cqe); break;
+                case CWIST_UOP_SEND: cwist_uring_on_send(w, conn, &cqe); break;
+                case CWIST_UOP_SHUTDOWN: cwist_uring_on_shutdown(w, conn, &cqe); break;
+                case CWIST_UOP_TIMEOUT:
+                    cwist_uring_sweep(w);
+                    cwist_uring_arm_timeout(w);
+                    break;
+                case CWIST_UOP_WAKE: cwist_uring_on_wake(w); break;
+                default: break; // CANCEL results carry no state.
+            }
+            tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        }
+
+        if (w->cancels_pending > 0) cwist_uring_retry_cancels(w);
+        if (!w->accept_armed && !w->failed && !w->drain_deadline) {
+            cwist_uring_arm_accept(w);
+        }
+    }
+}
+
+static void *cwist_uring_worker_main(void *arg) {
+    cwist_uring_worker_loop((cwist_uring_worker *)arg);
+    return NULL;
+}
+
+/* Checks that this kernel supports provided-buffer rings and multishot recv. */
+static bool cwist_uring_probe(void) {
+    cwist_uring_worker w;
+    memset(&w, 0, sizeof(w));
+    w.wake_fd = -1;
+    if (!cwist_uring_init(&w.ring, 8)) return false;
+    if (!cwist_uring_setup_buffers(&w)) {
+        cwist_uring_worker_cleanup(&w);
+        return false;
+    }
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        cwist_uring_worker_cleanup(&w);
+        return false;
+    }
+
+    bool ok = false;
+    struct io_uring_sqe *sqe = cwist_uring_get_sqe(&w.ring);
+    if (sqe) {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = sv[0];
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = CWIST_URING_BUF_GROUP;
+        sqe->user_data = 1;
+        if (write(sv[1], "x", 1) == 1 && cwist_uring_submit(&w.ring, 1) >= 0) {
+            unsigned head = *w.ring.cq_head;
+            struct io_uring_cqe *cqe = &w.ring.cqes[head & *w.ring.cq_mask];
+            ok = cqe->res == 1 && (cqe->flags & IORING_CQE_F_BUFFER) && (cqe->flags & IORING_CQE_F_MORE);
+        }
+    }
+
+    close(sv[0]);
+    close(sv[1]);
+    cwist_uring_worker_cleanup(&w);
+    return ok;
+}
+
+bool cwist_io_serve_http(int server_fd, cwist_server_config *config, void *ctx) {
+    if (server_fd < 0 || !config || !config->on_request) return false;
+    if (!cwist_uring_probe()) return false;
+
+    size_t workers = config->worker_threads;
+    if (workers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (size_t)cpus : 1;
+    }
+
+    cwist_uring_worker *pool = (cwist_uring_worker *)cwist_alloc_array(workers, sizeof(cwist_uring_worker));
+    pthread_t *threads = (pthread_t *)cwist_alloc_array(workers, sizeof(pthread_t));
+    if (!pool || !threads) {
+        cwist_free(pool);
+        cwist_free(threads);
+        return false;
+    }
+
+    // Without use_threading, handlers run on the ring thread as they are framed.
+    cwist_uring_pool *handlers = config->use_threading ? cwist_uring_pool_create(workers) : NULL;
+
+    size_t started = 0;
+    for (size_t i = 0; i < workers; i++) {
+        cwist_uring_worker *w = &pool[i];
+        w->server_fd = server_fd;
+        w->config = config;
+        w->ctx = ctx;
+        w->pool = handlers;
+        pthread_mutex_init(&w->done_lock, NULL);
+        w->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (w->wake_fd < 0 || !cwist_uring_init(&w->ring, CWIST_URING_ENTRIES) || !cwist_uring_setup_buffers(w)) {
+            cwist_uring_worker_cleanup(w);
+            pthread_mutex_destroy(&w->done_lock);
+            break;
+        }
+        if (pthread_create(&threads[i], NULL, cwist_uring_worker_main, w) != 0) {
+            cwist_uring_worker_cleanup(w);
+            pthread_mutex_destroy(&w->done_lock);
+            break;
+        }
+        started++;
+    }
+
+    bool any_served = false;
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        if (pool[i].served) any_served = true;
+    }
+    // Handlers still running past the drain deadline post to their ring; keep it until they stop.
+    cwist_uring_pool_destroy(handlers);
+    for (size_t i = 0; i < started; i++) {
+        cwist_uring_worker_cleanup(&pool[i]);
+        pthread_mutex_destroy(&pool[i].done_lock);
+    }
+    cwist_free(pool);
+    cwist_free(threads);
+
+    // Rings that failed before serving anything let the caller fall back to epoll.
+    return any_served || cwist_http_server_is_draining();
+}
+
+#else
+
+bool cwist_io_serve_http(int server_fd, cwist_server_config *config, void *ctx) {
+    (void)server_fd;
+    (void)config;
+    (void)ctx;
+    return false; // Kernel headers predate multishot io_uring.
+}
+
+#endif
@@ -86,3 +86,10 @@ void cwist_io_queue_destroy(cwist_io_queue *q) {
         cwist_free(q);
     }
 }
+
+bool cwist_io_serve_http(int server_fd, cwist_server_config *config, void *ctx) {
+    (void)server_fd;
+    (void)config;
+    (void)ctx;
+    return false; // No completion engine on this backend; use the server loop.
+}
@@ -0,0 +1,96 @@
+#include <cwist/net/http/http.h>
+#include <cwist/net/http/scan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Microbenchmark for request framing and parsing.
+ * Run with CWIST_HTTP_SCAN=scalar|sse2|avx2 to compare scanner implementations.
+ */
+
+#define CHUNK 64
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static char *build_request(size_t header_bytes, size_t *out_len) {
+    size_t cap = header_bytes + 1024;
+    char *buf = malloc(cap);
+    size_t len = (size_t)snprintf(buf, cap,
+        "GET /api/v1/items/42?sort=desc&limit=20 HTTP/1.1\r\n"
+        "Host: bench.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.5\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Connection: keep-alive\r\n");
+    // Stop one filler line short of the limit so the block stays acceptable.
+    for (int i = 0; len + 96 < header_bytes; i++) {
+        len += (size_t)snprintf(buf + len, cap - len, "X-Filler-%d: %s\r\n", i,
+                                "abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz");
+    }
+    len += (size_t)snprintf(buf + len, cap - len, "\r\n");
+    *out_len = len;
+    return buf;
+}
+
+static void bench_parse(const char *label, const char *req, size_t len, int iters) {
+    char *work = malloc(len + 1);
+    double start = now_ns();
+    for (int i = 0; i < iters; i++) {
+        memcpy(work, req, len);
+        work[len] = '\0';
+        size_t frame_len = 0;
+        if (cwist_http_frame_request(work, len, &frame_len) != 1) abort();
+        cwist_http_request *parsed = cwist_http_request_from_frame(work, frame_len);
+        if (!parsed) abort();
+        cwist_http_request_destroy(parsed);
+    }
+    double elapsed = now_ns() - start;
+    printf("  %-22s %6zu B  %9.1f ns/req\n", label, len, elapsed / iters);
+    free(work);
+}
+
+/* Frames a request that arrives CHUNK bytes at a time, as a reactor would see it. */
+static void bench_chunked(const char *label, const char *req, size_t len, int iters, bool resume) {
+    double start = now_ns();
+    for (int i = 0; i < iters; i++) {
+        size_t scanned = 0;
+        size_t frame_len = 0;
+        int framed = 0;
+        for (size_t have = CHUNK; framed == 0; have += CHUNK) {
+            if (have > len) have = len;
+            if (!resume) scanned = 0;
+            framed = cwist_http_frame_request_resume(req, have, &scanned, &frame_len);
+        }
+        if (framed != 1) abort();
+    }
+    double elapsed = now_ns() - start;
+    printf("  %-22s %6zu B  %9.1f ns/req (%s)\n", label, len, elapsed / iters,
+           resume ? "resumed" : "rescanned");
+}
+
+int main(int argc, char **argv) {
+    int iters = argc > 1 ? atoi(argv[1]) : 200000;
+    if (iters <= 0) iters = 1;
+
+    size_t typical_len = 0;
+    size_t large_len = 0;
+    char *typical = build_request(0, &typical_len);
+    char *large = build_request(CWIST_HTTP_MAX_HEADER_SIZE, &large_len);
+
+    printf("HTTP parse benchmark (scanner: %s, %d iterations)\n", cwist_http_scan_impl(), iters);
+    bench_parse("typical request", typical, typical_len, iters);
+    bench_parse("8 KB header block", large, large_len, iters / 10 + 1);
+    bench_chunked("8 KB in 64 B reads", large, large_len, iters / 100 + 1, false);
+    bench_chunked("8 KB in 64 B reads", large, large_len, iters / 100 + 1, true);
+
+    free(typical);
+    free(large);
+    return 0;
+}
@@ -0,0 +1,786 @@
+#include <cwist/sys/app/big_dumb_reply.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static cwist_http_request *make_req(const char *path, const char *query) {
+    cwist_http_request *req = cwist_http_request_create();
+    req->method = CWIST_HTTP_GET;
+    cwist_sstring_assign(req->path, (char *)path);
+    if (query) cwist_sstring_assign(req->query, (char *)query);
+    return req;
+}
+
+static cwist_http_response *res_none;
+
+static void put(cwist_bdr_t *bdr, cwist_http_request *req, cwist_http_response *res, const char *reply) {
+    cwist_bdr_put(bdr, req, res ? res : res_none, reply, strlen(reply));
+}
+
+static void put_twice(cwist_bdr_t *bdr, cwist_http_request *req, const char *reply) {
+    put(bdr, req, NULL, reply);
+    put(bdr, req, NULL, reply);
+}
+
+static void complete(cwist_bdr_t *bdr, cwist_bdr_result *result, cwist_http_request *req, cwist_http_response *res,
+                     const char *reply, size_t len) {
+    struct iovec iov = { .iov_base = (void *)reply, .iov_len = len };
+    cwist_bdr_complete(bdr, result, req, res, &iov, 1, NULL);
+}
+
+// Compares a blob's copied bytes followed by its adopted body, if any.
+static bool blob_is(const cwist_bdr_blob *blob, const char *reply) {
+    size_t len = strlen(reply);
+    if (blob->len + blob->body_len != len || memcmp(blob->data, reply, blob->len) != 0) return false;
+    return !blob->body || memcmp(blob->body, reply + blob->len, blob->body_len) == 0;
+}
+
+static bool hit_is(cwist_bdr_t *bdr, cwist_http_request *req, const char *reply) {
+    cwist_bdr_blob *blob = cwist_bdr_get(bdr, req);
+    if (!blob) return reply == NULL;
+    bool same = reply && blob_is(blob, reply);
+    cwist_bdr_blob_release(blob);
+    return same;
+}
+
+void test_learn_and_invalidate() {
+    printf("Testing BDR learning...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    assert(bdr);
+    cwist_http_request *req = make_req("/a", NULL);
+
+    // One sighting is only a candidate.
+    put(bdr, req, NULL, "one");
+    assert(hit_is(bdr, req, NULL));
+    put(bdr, req, NULL, "one");
+    cwist_bdr_blob *blob = cwist_bdr_get(bdr, req);
+    assert(blob && blob->len == 3 && memcmp(blob->data, "one", 3) == 0);
+
+    // A different reply drops the stable blob, but the reference we hold stays valid.
+    put(bdr, req, NULL, "two");
+    assert(hit_is(bdr, req, NULL));
+    assert(memcmp(blob->data, "one", 3) == 0);
+    cwist_bdr_blob_release(blob);
+
+    put(bdr, req, NULL, "two");
+    assert(hit_is(bdr, req, "two"));
+
+    req->method = CWIST_HTTP_POST;
+    assert(cwist_bdr_get(bdr, req) == NULL);
+    cwist_http_request_destroy(req);
+    cwist_bdr_destroy(bdr);
+    printf("Passed BDR learning.\n");
+}
+
+void test_revalidate_hits() {
+    printf("Testing BDR hit budget...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    cwist_bdr_set_limits(bdr, 0, 0, 3);
+    cwist_http_request *req = make_req("/h", NULL);
+    put_twice(bdr, req, "reply");
+    for (int i = 0; i < 2; i++) assert(hit_is(bdr, req, "reply"));
+
+    // Past the budget the reply is stale: still served, and exactly one caller refreshes it.
+    cwist_bdr_result first, second;
+    cwist_bdr_acquire(bdr, req, &first);
+    cwist_bdr_acquire(bdr, req, &second);
+    assert(first.status == CWIST_BDR_STALE && first.flight && first.blob);
+    assert(second.status == CWIST_BDR_HIT && !second.flight && second.blob);
+    cwist_bdr_blob_release(first.blob);
+    cwist_bdr_blob_release(second.blob);
+
+    // A failing refresh leaves the stale reply in place.
+    cwist_http_response *err = cwist_http_response_create();
+    err->status_code = CWIST_HTTP_INTERNAL_ERROR;
+    complete(bdr, &first, req, err, "oops", 4);
+    assert(first.flight == NULL);
+    assert(hit_is(bdr, req, "reply"));
+
+    // Refreshing with the same bytes renews the hit budget.
+    cwist_bdr_acquire(bdr, req, &first);
+    assert(first.status == CWIST_BDR_STALE);
+    cwist_bdr_blob_release(first.blob);
+    complete(bdr, &first, req, res_none, "reply", 5);
+    cwist_bdr_acquire(bdr, req, &first);
+    assert(first.status == CWIST_BDR_HIT && !first.flight);
+    cwist_bdr_blob_release(first.blob);
+
+    cwist_bdr_stats stats;
+    cwist_bdr_get_stats(bdr, &stats);
+    assert(stats.stale == 4);
+    cwist_http_response_destroy(err);
+    cwist_http_request_destroy(req);
+    cwist_bdr_destroy(bdr);
+    printf("Passed BDR hit budget.\n");
+}
+
+void test_query_keys() {
+    printf("Testing BDR query keys...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    cwist_http_request *page1 = make_req("/items", "page=1&size=10");
+    cwist_http_request *page2 = make_req("/items", "page=2&size=10");
+    cwist_http_request *bare = make_req("/items", NULL);
+    put_twice(bdr, page1, "first page");
+    put_twice(bdr, page2, "second page");
+    assert(hit_is(bdr, page1, "first page"));
+    assert(hit_is(bdr, page2, "second page"));
+    assert(hit_is(bdr, bare, NULL));
+
+    // Parameter order and empty segments do not matter.
+    cwist_http_request *reordered = make_req("/items", "size=10&&page=1&");
+    assert(hit_is(bdr, reordered, "first page"));
+
+    // Repeated names keep their order: the handler sees the last value, so these are different requests.
+    cwist_http_request *last2 = make_req("/tags", "a=1&z=0&a=2");
+    cwist_http_request *last1 = make_req("/tags", "a=2&a=1&z=0");
+    put_twice(bdr, last2, "a is 2");
+    assert(hit_is(bdr, last2, "a is 2"));
+    assert(hit_is(bdr, last1, NULL));
+    put_twice(bdr, last1, "a is 1");
+    assert(hit_is(bdr, last1, "a is 1"));
+    assert(hit_is(bdr, last2, "a is 2"));
+
+    cwist_http_request_destroy(last1);
+    cwist_http_request_destroy(last2);
+    cwist_http_request_destroy(page1);
+    cwist_http_request_destroy(page2);
+    cwist_http_request_destroy(bare);
+    cwist_http_request_destroy(reordered);
+    cwist_bdr_destroy(bdr);
+    printf("Passed BDR query keys.\n");
+}
+
+void test_vary_keys() {
+    printf("Testing BDR Vary keys...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    cwist_http_response *res = cwist_http_response_create();
+    cwist_http_header_add(&res->headers, "Vary", " Accept-Language ,accept-encoding");
+
+    cwist_http_request *en = make_req("/doc", NULL);
+    cwist_http_header_add(&en->headers, "accept-language", "en");
+    cwist_http_request *ko = make_req("/doc", NULL);
+    cwist_http_header_add(&ko->headers, "Accept-Language", "ko");
+    cwist_http_request *none = make_req("/doc", NULL);
+
+    put(bdr, en, res, "hello");
+    put(bdr, en, res, "hello");
+    put(bdr, ko, res, "annyeong");
+    put(bdr, ko, res, "annyeong");
+    assert(hit_is(bdr, en, "hello"));
+    assert(hit_is(bdr, ko, "annyeong"));
+    assert(hit_is(bdr, none, NULL));
+
+    // Vary: * is never cached.
+    cwist_http_response *star = cwist_http_response_create();
+    cwist_http_header_add(&star->headers, "Vary", "*");
+    cwist_http_request *other = make_req("/star", NULL);
+    put(bdr, other, star, "x");
+    put(bdr, other, star, "x");
+    assert(hit_is(bdr, other, NULL));
+
+    cwist_http_request_destroy(en);
+    cwist_http_request_destroy(ko);
+    cwist_http_request_destroy(none);
+    cwist_http_request_destroy(other);
+    cwist_http_response_destroy(res);
+    cwist_http_response_destroy(star);
+    cwist_bdr_destroy(bdr);
+    printf("Passed BDR Vary keys.\n");
+}
+
+void test_stats() {
+    printf("Testing BDR stats...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    cwist_http_request *req = make_req("/s", NULL);
+    assert(cwist_bdr_hit_ratio(bdr) == 0.0);
+    assert(hit_is(bdr, req, NULL));
+    put_twice(bdr, req, "stat");
+    for (int i = 0; i < 3; i++) assert(hit_is(bdr, req, "stat"));
+
+    cwist_bdr_stats stats;
+    cwist_bdr_get_stats(bdr, &stats);
+    assert(stats.hits == 3 && stats.misses == 1);
+    assert(stats.admitted == 1 && stats.rejected == 0 && stats.evicted == 0);
+    assert(stats.bytes == 4 && stats.entries == 1);
+    assert(cwist_bdr_hit_ratio(bdr) == 0.75);
+    cwist_http_request_destroy(req);
+    cwist_bdr_destroy(bdr);
+    printf("Passed BDR stats.\n");
+}
+
+typedef struct {
+    cwist_bdr_t *bdr;
+    const char *path;
+    const char *expect;
+    cwist_bdr_status status;
+    bool matched;
+} flight_ctx;
+
+static void *flight_waiter(void *arg) {
+    flight_ctx *ctx = (flight_ctx *)arg;
+    cwist_http_request *req = make_req(ctx->path, NULL);
+    cwist_bdr_result result;
+    cwist_bdr_acquire(ctx->bdr, req, &result);
+    ctx->status = result.status;
+    ctx->matched = result.blob && blob_is(result.blob, ctx->expect);
+    cwist_bdr_blob_release(result.blob);
+    cwist_http_request_destroy(req);
+    return NULL;
+}
+
+// Runs `count` waiters against an open flight and completes it with `reply` once all have joined.
+static void run_flight(cwist_bdr_t *bdr, cwist_bdr_result *lead, cwist_http_request *req, const char *reply,
+                       flight_ctx *ctx, int count) {
+    pthread_t threads[8];
+    for (int i = 0; i < count; i++) pthread_create(&threads[i], NULL, flight_waiter, &ctx[i]);
+    for (int spin = 0; spin < 2000 && __atomic_load_n(&lead->flight->refs, __ATOMIC_ACQUIRE) < (size_t)count + 1; spin++) {
+        usleep(1000);
+    }
+    complete(bdr, lead, req, res_none, reply, strlen(reply));
+    for (int i = 0; i < count; i++) pthread_join(threads[i], NULL);
+}
+
+void test_single_flight() {
+    printf("Testing BDR single-flight...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    cwist_http_request *req = make_req("/slow", NULL);
+    cwist_bdr_result lead;
+
+    // A key BDR has never seen is not coalesced.
+    cwist_bdr_acquire(bdr, req, &lead);
+    assert(lead.status == CWIST_BDR_MISS && !lead.flight);
+
+    // Once seen, one caller leads and the rest are served its reply.
+    put(bdr, req, NULL, "slow");
+    cwist_bdr_acquire(bdr, req, &lead);
+    assert(lead.status == CWIST_BDR_LEAD && lead.flight);
+    flight_ctx ctx[4];
+    for (int i = 0; i < 4; i++) ctx[i] = (flight_ctx){ bdr, "/slow", "slow", CWIST_BDR_MISS, false };
+    run_flight(bdr, &lead, req, "slow", ctx, 4);
+    for (int i = 0; i < 4; i++) assert(ctx[i].status == CWIST_BDR_HIT && ctx[i].matched);
+    assert(hit_is(bdr, req, "slow"));
+
+    cwist_bdr_stats stats;
+    cwist_bdr_get_stats(bdr, &stats);
+    assert(stats.coalesced == 4);
+
+    // A reply that did not repeat is not shared; the waiters run the handler themselves.
+    cwist_sstring_assign(req->path, "/volatile");
+    put(bdr, req, NULL, "a");
+    cwist_bdr_acquire(bdr, req, &lead);
+    assert(lead.status == CWIST_BDR_LEAD);
+    for (int i = 0; i < 2; i++) ctx[i] = (flight_ctx){ bdr, "/volatile", "b", CWIST_BDR_HIT, false };
+    run_flight(bdr, &lead, req, "b", ctx, 2);
+    for (int i = 0; i < 2; i++) assert(ctx[i].status == CWIST_BDR_MISS && !ctx[i].matched);
+
+    // Its replies keep changing, so later misses are not coalesced either.
+    cwist_bdr_acquire(bdr, req, &lead);
+    assert(lead.status == CWIST_BDR_MISS && !lead.flight);
+
+    cwist_http_request_destroy(req);
+    cwist_bdr_destroy(bdr);
+    printf("Passed BDR single-flight.\n");
+}
+
+#define SCAN_HOT 32
+#define SCAN_COLD 2000
+
+// Looks the key up first, as the app does, and learns the reply on a miss.
+static void visit(cwist_bdr_t *bdr, cwist_http_request *req, const char *path, const char *reply) {
+    cwist_sstring_assign(req->path, (char *)path);
+    cwist_bdr_blob *blob = cwist_bdr_get(bdr, req);
+    if (blob) {
+        cwist_bdr_blob_release(blob);
+        return;
+    }
+    put(bdr, req, NULL, reply);
+}
+
+void test_scan_resistance() {
+    printf("Testing BDR scan resistance...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    // Room for ten 100-byte replies per shard.
+    cwist_bdr_set_limits(bdr, CWIST_BDR_SHARDS * 1000, 0, 0);
+    char reply[101];
+    memset(reply, 'r', 100);
+    reply[100] = '\0';
+    char path[32];
+    cwist_http_request *req = make_req("/", NULL);
+
+    for (int round = 0; round < 6; round++) {
+        for (int i = 0; i < SCAN_HOT; i++) {
+            snprintf(path, sizeof(path), "/hot/%d", i);
+            visit(bdr, req, path, reply);
+        }
+    }
+    // A long run of one-hit wonders, each seen twice so it becomes a stable reply.
+    for (int i = 0; i < SCAN_COLD; i++) {
+        snprintf(path, sizeof(path), "/cold/%d", i);
+        visit(bdr, req, path, reply);
+        put(bdr, req, NULL, reply);
+    }
+    for (int i = 0; i < SCAN_HOT; i++) {
+        snprintf(path, sizeof(path), "/hot/%d", i);
+        cwist_sstring_assign(req->path, path);
+        assert(hit_is(bdr, req, reply));
+    }
+
+    cwist_bdr_stats stats;
+    cwist_bdr_get_stats(bdr, &stats);
+    assert(stats.rejected > 0);
+    assert(stats.bytes <= CWIST_BDR_SHARDS * 1000);
+    printf("Passed BDR scan resistance (hit ratio %.2f, %llu rejected, %llu evicted).\n",
+           cwist_bdr_hit_ratio(bdr), (unsigned long long)stats.rejected, (unsigned long long)stats.evicted);
+    cwist_http_request_destroy(req);
+    cwist_bdr_destroy(bdr);
+}
+
+#define STRESS_THREADS 8
+#define STRESS_KEYS 256
+#define STRESS_ROUNDS 20000
+
+typedef struct {
+    cwist_bdr_t *bdr;
+    unsigned seed;
+    size_t hits;
+} stress_ctx;
+
+// Every reply for key k is k repeated, in one of two lengths, so a torn or freed blob shows up.
+static size_t make_reply(char *buf, int key, int variant) {
+    size_t len = 200 + (size_t)variant * 300;
+    memset(buf, 'a' + key % 26, len);
+    return len;
+}
+
+static void *stress_worker(void *arg) {
+    stress_ctx *ctx = (stress_ctx *)arg;
+    char path[32];
+    char reply[512];
+    cwist_http_request *req = make_req("/", NULL);
+    for (int i = 0; i < STRESS_ROUNDS; i++) {
+        int key = (int)(rand_r(&ctx->seed) % STRESS_KEYS);
+        snprintf(path, sizeof(path), "/k/%d", key);
+        cwist_sstring_assign(req->path, path);
+        cwist_bdr_result result;
+        cwist_bdr_acquire(ctx->bdr, req, &result);
+        cwist_bdr_blob *blob = result.blob;
+        if (blob) {
+            // Demoted replies come back with their bytes in `body`, read from the segment file.
+            size_t total = blob->len + blob->body_len;
+            assert(total == 200 || total == 500);
+            for (size_t j = 0; j < total; j++) {
+                unsigned char c = j < blob->len ? blob->data[j] : blob->body[j - blob->len];
+                assert(c == 'a' + key % 26);
+            }
+            cwist_bdr_blob_release(blob);
+            ctx->hits++;
+        }
+        if (!blob || result.flight) {
+            size_t len = make_reply(reply, key, (int)(rand_r(&ctx->seed) % 8 == 0));
+            if (result.flight) complete(ctx->bdr, &result, req, res_none, reply, len);
+            else cwist_bdr_put(ctx->bdr, req, res_none, reply, len);
+        }
+    }
+    cwist_http_request_destroy(req);
+    return NULL;
+}
+
+static int pin_releases;
+
+static void count_release(const void *ptr, size_t len, void *ctx) {
+    (void)ptr;
+    (void)len;
+    (void)ctx;
+    pin_releases++;
+}
+
+// Sends `body` as a managed body after `head`; returns whether BDR adopted the pin.
+static bool put_pinned(cwist_bdr_t *bdr, cwist_http_request *req, const char *head, const char *body) {
+    struct iovec iov[2] = {
+        { .iov_base = (void *)head, .iov_len = strlen(head) },
+        { .iov_base = (void *)body, .iov_len = strlen(body) },
+    };
+    cwist_http_body_pin pin = { body, strlen(body), count_release, NULL };
+    cwist_bdr_put_iov(bdr, req, res_none, iov, 2, &pin);
+    if (pin.cleanup) count_release(pin.ptr, pin.len, pin.ctx); // Still ours: the send path releases it.
+    return pin.cleanup == NULL;
+}
+
+void test_pinned_body() {
+    printf("Testing BDR pinned bodies...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    cwist_http_request *req = make_req("/static/app.js", NULL);
+    static const char body[] = "console.log(1);";
+    pin_releases = 0;
+
+    // A candidate only hashes the bytes; the body stays with the sender.
+    assert(!put_pinned(bdr, req, "HTTP/1.1 200 OK\r\n\r\n", body));
+    assert(pin_releases == 1);
+
+    // Stabilizing copies the head once and adopts the body without copying it.
+    assert(put_pinned(bdr, req, "HTTP/1.1 200 OK\r\n\r\n", body));
+    cwist_bdr_blob *blob = cwist_bdr_get(bdr, req);
+    assert(blob && blob->body == (const unsigned char *)body && blob->body_len == strlen(body));
+    assert(blob_is(blob, "HTTP/1.1 200 OK\r\n\r\nconsole.log(1);"));
+    cwist_bdr_stats stats;
+    cwist_bdr_get_stats(bdr, &stats);
+    assert(stats.bytes == blob->len + blob->body_len);
+
+    // Dropping the entry releases the pin only once the last reference goes.
+    put(bdr, req, NULL, "changed");
+    assert(pin_releases == 1);
+    cwist_bdr_blob_release(blob);
+    assert(pin_releases == 2);
+
+    cwist_http_request_destroy(req);
+    cwist_bdr_destroy(bdr);
+    printf("Passed BDR pinned bodies.\n");
+}
+
+// Flattens a spliced hit into `out` the way cwist_http_send_iov would put it on the wire.
+static void splice_wire(cwist_bdr_blob *blob, cwist_http_request *req, char *out, bool *keep_alive) {
+    cwist_bdr_splice splice;
+    cwist_bdr_splice_reply(blob, req, &splice);
+    size_t len = 0;
+    for (int i = 0; i < splice.iov_cnt; i++) {
+        memcpy(out + len, splice.iov[i].iov_base, splice.iov[i].iov_len);
+        len += splice.iov[i].iov_len;
+    }
+    out[len] = '\0';
+    *keep_alive = splice.keep_alive;
+}
+
+void test_header_splice() {
+    printf("Testing BDR header splicing...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    cwist_http_request *req = make_req("/stamped", NULL);
+
+    // Replies that differ only in per-hit headers are the same reply.
+    put(bdr, req, NULL, "HTTP/1.1 200 OK\r\nX-Request-Id: first\r\nContent-Length: 2\r\n"
+                        "Date: Mon, 01 Jan 2024 00:00:00 GMT\r\nConnection: keep-alive\r\n\r\nok");
+    put(bdr, req, NULL, "HTTP/1.1 200 OK\r\nX-Request-Id: second\r\nContent-Length: 2\r\n"
+                        "Date: Mon, 01 Jan 2024 00:00:09 GMT\r\nConnection: keep-alive\r\n\r\nok");
+    cwist_bdr_blob *blob = cwist_bdr_get(bdr, req);
+    assert(blob && blob->request_id && blob->head_split > 0);
+    assert(blob_is(blob, "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"));
+
+    // Each hit gets its own request id, a current Date and a Connection that matches the request.
+    char wire[512];
+    bool keep_alive;
+    req->keep_alive = true;
+    cwist_http_header_add(&req->headers, "X-Request-Id", "third");
+    splice_wire(blob, req, wire, &keep_alive);
+    assert(keep_alive);
+    const char *head = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nDate: ";
+    assert(strncmp(wire, head, strlen(head)) == 0);
+    assert(strstr(wire, " GMT\r\nConnection: keep-alive\r\nAge: 0\r\nX-Request-Id: third\r\n\r\nok"));
+    assert(!strstr(wire, "first") && !strstr(wire, "second") && !strstr(wire, "2024"));
+
+    // Without a client id, a fresh one is made up rather than replaying the learned one.
+    // A client asking to close gets Connection: close, not the learned keep-alive.
+    cwist_http_request *bare = make_req("/stamped", NULL);
+    bare->keep_alive = false;
+    splice_wire(blob, bare, wire, &keep_alive);
+    assert(!keep_alive && strstr(wire, "Connection: close\r\n"));
+    const char *rid = strstr(wire, "X-Request-Id: ");
+    assert(rid && strncmp(rid + 14 + 16, "\r\n\r\nok", 6) == 0);
+    cwist_bdr_blob_release(blob);
+
+    // Anything that is not an HTTP head goes out untouched.
+    cwist_http_request *raw = make_req("/raw", NULL);
+    put_twice(bdr, raw, "opaque");
+    blob = cwist_bdr_get(bdr, raw);
+    splice_wire(blob, raw, wire, &keep_alive);
+    assert(strcmp(wire, "opaque") == 0);
+    cwist_bdr_blob_release(blob);
+
+    cwist_http_request_destroy(req);
+    cwist_http_request_destroy(bare);
+    cwist_http_request_destroy(raw);
+    cwist_bdr_destroy(bdr);
+    printf("Passed BDR header splicing.\n");
+}
+
+#define DISK_KEYS 64
+
+static void disk_reply(char *out, size_t cap, int key, char fill) {
+    char body[120];
+    memset(body, fill, 100);
+    snprintf(body + 100, sizeof(body) - 100, "%d", key);
+    snprintf(out, cap, "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n%s", strlen(body), body);
+}
+
+static void disk_path(cwist_http_request *req, int key) {
+    char path[32];
+    snprintf(path, sizeof(path), "/disk/%d", key);
+    cwist_sstring_assign(req->path, path);
+}
+
+void test_disk_tier() {
+    printf("Testing BDR disk tier...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    // About one reply per shard in RAM; the rest has to come from the segment file.
+    cwist_bdr_set_limits(bdr, CWIST_BDR_SHARDS * 200, 0, 0);
+    assert(cwist_bdr_set_disk_tier(bdr, "/tmp", 64 * 1024).error.err_i16 == 0);
+    assert(cwist_bdr_set_disk_tier(bdr, "/tmp", 64 * 1024).error.err_i16 == -1);
+    cwist_http_request *req = make_req("/", NULL);
+    char reply[256];
+
+    for (int i = 0; i < DISK_KEYS; i++) {
+        disk_path(req, i);
+        disk_reply(reply, sizeof(reply), i, 'd');
+        put_twice(bdr, req, reply);
+    }
+    cwist_bdr_stats stats;
+    cwist_bdr_get_stats(bdr, &stats);
+    assert(stats.demoted > 0 && stats.disk_entries == stats.demoted && stats.disk_bytes > 0);
+    for (int i = 0; i < DISK_KEYS; i++) {
+        disk_path(req, i);
+        disk_reply(reply, sizeof(reply), i, 'd');
+        assert(hit_is(bdr, req, reply));
+    }
+    cwist_bdr_get_stats(bdr, &stats);
+    assert(stats.disk_hits == stats.demoted);
+
+    // A demoted reply is served from the mapping; only the head comes back to RAM.
+    cwist_bdr_blob *pinned = NULL;
+    int on_disk = 0;
+    for (; on_disk < DISK_KEYS && !pinned; on_disk++) {
+        disk_path(req, on_disk);
+        pinned = cwist_bdr_get(bdr, req);
+        if (pinned && !pinned->body_release) {
+            cwist_bdr_blob_release(pinned);
+            pinned = NULL;
+        }
+    }
+    on_disk--;
+    assert(pinned && pinned->head_split > 0);
+    disk_reply(reply, sizeof(reply), on_disk, 'd');
+    assert(pinned->len == (size_t)(strstr(reply, "\r\n\r\n") + 4 - reply));
+
+    // Churn far past the file size: the pinned segment is never recycled under the hit.
+    for (int round = 0; round < 8; round++) {
+        for (int i = 0; i < DISK_KEYS; i++) {
+            if (i == on_disk) continue;
+            disk_path(req, i);
+            disk_reply(reply, sizeof(reply), i, (char)('e' + round));
+            put_twice(bdr, req, reply);
+        }
+    }
+    disk_reply(reply, sizeof(reply), on_disk, 'd');
+    assert(blob_is(pinned, reply));
+    cwist_bdr_blob_release(pinned);
+
+    // Other bytes for a demoted key replace it instead of serving the old reply.
+    disk_path(req, on_disk);
+    disk_reply(reply, sizeof(reply), on_disk, 'x');
+    put(bdr, req, NULL, reply);
+    assert(hit_is(bdr, req, NULL));
+
+    // Low RAM: every stable reply leaves RAM, and new ones stabilize on disk.
+    bdr->ram_floor = SIZE_MAX;
+    bdr->ram_checked_at = 0;
+    disk_path(req, DISK_KEYS);
+    disk_reply(reply, sizeof(reply), DISK_KEYS, 'p');
+    put_twice(bdr, req, reply);
+    assert(bdr->is_disk_mode);
+    cwist_bdr_get_stats(bdr, &stats);
+    assert(stats.bytes == 0);
+    assert(hit_is(bdr, req, reply));
+
+    cwist_http_request_destroy(req);
+    cwist_bdr_destroy(bdr);
+    printf("Passed BDR disk tier.\n");
+}
+
+// Every hit must be `reply`; evicted keys may miss.
+static bool hit_is_or_miss(cwist_bdr_t *bdr, cwist_http_request *req, const char *reply) {
+    cwist_bdr_blob *blob = cwist_bdr_get(bdr, req);
+    bool ok = !blob || blob_is(blob, reply);
+    cwist_bdr_blob_release(blob);
+    return ok;
+}
+
+void test_disk_fork() {
+    printf("Testing BDR disk tier across fork...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    cwist_bdr_set_limits(bdr, CWIST_BDR_SHARDS * 200, 0, 0);
+    assert(cwist_bdr_set_disk_tier(bdr, "/tmp", 64 * 1024).error.err_i16 == 0);
+    cwist_http_request *req = make_req("/", NULL);
+    char reply[256];
+    for (int i = 0; i < DISK_KEYS; i++) {
+        disk_path(req, i);
+        disk_reply(reply, sizeof(reply), i, 'f');
+        put_twice(bdr, req, reply);
+    }
+    cwist_bdr_stats stats;
+    cwist_bdr_get_stats(bdr, &stats);
+    assert(stats.demoted > 0);
+
+    // A child (a prefork worker, say) churns its copy far past the file size.
+    pid_t pid = fork();
+    if (pid == 0) {
+        bool ok = true;
+        for (int round = 0; round < 8; round++) {
+            for (int i = 0; i < DISK_KEYS; i++) {
+                disk_path(req, i);
+                disk_reply(reply, sizeof(reply), i, (char)('g' + round));
+                put_twice(bdr, req, reply);
+                ok = ok && hit_is_or_miss(bdr, req, reply);
+            }
+        }
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    assert(pid > 0 && waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // None of it landed in the parent's segment file.
+    for (int i = 0; i < DISK_KEYS; i++) {
+        disk_path(req, i);
+        disk_reply(reply, sizeof(reply), i, 'f');
+        assert(hit_is(bdr, req, reply));
+    }
+    cwist_http_request_destroy(req);
+    cwist_bdr_destroy(bdr);
+    printf("Passed BDR disk tier across fork.\n");
+}
+
+void test_snapshot() {
+    printf("Testing BDR snapshots...\n");
+    char path[64], bad[64];
+    snprintf(path, sizeof(path), "/tmp/cwist_bdr_test.%ld.snap", (long)getpid());
+    snprintf(bad, sizeof(bad), "/tmp/cwist_bdr_test.%ld.bad", (long)getpid());
+
+    // Part of the cache on disk, a Vary pair, and a candidate that must not be saved.
+    cwist_bdr_t *old = cwist_bdr_create();
+    cwist_bdr_set_limits(old, CWIST_BDR_SHARDS * 200, 0, 0);
+    assert(cwist_bdr_set_disk_tier(old, "/tmp", 64 * 1024).error.err_i16 == 0);
+    assert(cwist_bdr_set_version(old, "/disk/", "build-1").error.err_i16 == 0);
+    cwist_http_request *req = make_req("/", NULL);
+    char reply[256];
+    for (int i = 0; i < DISK_KEYS; i++) {
+        disk_path(req, i);
+        disk_reply(reply, sizeof(reply), i, 's');
+        put_twice(old, req, reply);
+    }
+    cwist_http_response *vary = cwist_http_response_create();
+    cwist_http_header_add(&vary->headers, "Vary", "Accept-Language");
+    cwist_http_request *en = make_req("/doc", NULL);
+    cwist_http_header_add(&en->headers, "Accept-Language", "en");
+    put(old, en, vary, "hello");
+    put(old, en, vary, "hello");
+    cwist_http_request *once = make_req("/once", NULL);
+    put(old, once, NULL, "candidate");
+    cwist_bdr_stats stats;
+    cwist_bdr_get_stats(old, &stats);
+    assert(stats.disk_entries > 0);
+    assert(cwist_bdr_snapshot_save(old, path).error.err_i16 == 0);
+    cwist_bdr_destroy(old);
+
+    // A deploy bumped everything under /disk/1: those replies are gone, the rest serve at once.
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    assert(cwist_bdr_set_version(bdr, "/disk/", "build-1").error.err_i16 == 0);
+    assert(cwist_bdr_set_version(bdr, "/disk/1", "build-2").error.err_i16 == 0);
+    size_t loaded = 0;
+    assert(cwist_bdr_snapshot_load(bdr, path, &loaded).error.err_i16 == 0);
+    assert(loaded == DISK_KEYS - 11 + 2);
+    for (int i = 0; i < DISK_KEYS; i++) {
+        disk_path(req, i);
+        disk_reply(reply, sizeof(reply), i, 's');
+        bool bumped = i == 1 || (i >= 10 && i < 20);
+        assert(hit_is(bdr, req, bumped ? NULL : reply));
+    }
+    assert(hit_is(bdr, en, "hello"));
+    assert(hit_is(bdr, once, NULL));
+    // Only an empty cache can adopt a snapshot's hashes.
+    assert(cwist_bdr_snapshot_load(bdr, path, NULL).error.err_i16 == -1);
+
+    // Restored replies renew like learned ones, and a bumped key is learned afresh.
+    disk_path(req, 2);
+    disk_reply(reply, sizeof(reply), 2, 's');
+    put(bdr, req, NULL, reply);
+    assert(hit_is(bdr, req, reply));
+    disk_path(req, 1);
+    disk_reply(reply, sizeof(reply), 1, 'n');
+    put_twice(bdr, req, reply);
+    assert(hit_is(bdr, req, reply));
+    cwist_bdr_destroy(bdr);
+
+    // A damaged or missing file is refused before anything is used.
+    FILE *in = fopen(path, "rb");
+    FILE *out = fopen(bad, "wb");
+    assert(in && out);
+    int c;
+    for (long off = 0; (c = fgetc(in)) != EOF; off++) fputc(off == 300 ? c ^ 0x20 : c, out);
+    fclose(in);
+    fclose(out);
+    bdr = cwist_bdr_create();
+    assert(cwist_bdr_snapshot_load(bdr, bad, &loaded).error.err_i16 == -1 && loaded == 0);
+    assert(cwist_bdr_snapshot_load(bdr, "/nonexistent/cwist.snap", NULL).error.err_i16 == -1);
+    assert(hit_is(bdr, en, NULL));
+    cwist_bdr_destroy(bdr);
+
+    unlink(path);
+    unlink(bad);
+    cwist_http_request_destroy(req);
+    cwist_http_request_destroy(en);
+    cwist_http_request_destroy(once);
+    cwist_http_response_destroy(vary);
+    printf("Passed BDR snapshots.\n");
+}
+
+void test_concurrent_access() {
+    printf("Testing concurrent BDR access...\n");
+    cwist_bdr_t *bdr = cwist_bdr_create();
+    // Small enough that eviction runs constantly under the readers.
+    cwist_bdr_set_limits(bdr, 64 * 1024, 0, 50);
+    // Evicted and refused replies spill into the disk tier, so it sees the same churn.
+    assert(cwist_bdr_set_disk_tier(bdr, "/tmp", 256 * 1024).error.err_i16 == 0);
+
+    pthread_t threads[STRESS_THREADS];
+    stress_ctx ctx[STRESS_THREADS];
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        ctx[i] = (stress_ctx){ bdr, (unsigned)i * 7919u + 1, 0 };
+        pthread_create(&threads[i], NULL, stress_worker, &ctx[i]);
+    }
+    // Snapshots reference entries while the workers evict them.
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/cwist_bdr_stress.%ld.snap", (long)getpid());
+    for (int i = 0; i < 4; i++) assert(cwist_bdr_snapshot_save(bdr, path).error.err_i16 == 0);
+    unlink(path);
+    size_t hits = 0;
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        hits += ctx[i].hits;
+    }
+    assert(hits > 0);
+    for (size_t s = 0; s < CWIST_BDR_SHARDS; s++) {
+        assert(bdr->shards[s].current_bytes <= 64 * 1024 / CWIST_BDR_SHARDS + 500);
+    }
+    cwist_bdr_destroy(bdr);
+    printf("Passed concurrent BDR access (%zu hits).\n", hits);
+}
+
+int main() {
+    res_none = cwist_http_response_create();
+    test_learn_and_invalidate();
+    test_revalidate_hits();
+    test_query_keys();
+    test_vary_keys();
+    test_stats();
+    test_single_flight();
+    test_scan_resistance();
+    test_pinned_body();
+    test_header_splice();
+    test_disk_tier();
+    test_disk_fork();
+    test_snapshot();
+    test_concurrent_access();
+    cwist_http_response_destroy(res_none);
+    printf("All BDR tests passed!\n");
+    return 0;
+}
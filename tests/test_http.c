@@ -1,4 +1,5 @@
 #include <cwist/net/http/http.h>
+#include <cwist/net/http/scan.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -47,6 +48,92 @@ void test_response_lifecycle() {
     printf("Passed Response Lifecycle.\n");
 }
 
+void test_recycling() {
+    printf("Testing Request/Response Recycling...\n");
+    cwist_http_request *req = cwist_http_parse_request(
+        "POST /a?x=1 HTTP/1.1\r\nHost: h\r\nConnection: close\r\nContent-Length: 2\r\n\r\nhi");
+    assert(req != NULL);
+    cwist_query_map_set(req->path_params, "id", "7");
+    cwist_http_header_add(&req->headers, "X-Extra", "1");
+    cwist_http_request_destroy(req);
+
+    // Same thread: the object comes back, reset to its defaults.
+    cwist_http_request *again = cwist_http_request_create();
+    assert(again == req);
+    assert(again->method == CWIST_HTTP_GET);
+    assert(strcmp(again->path->data, "/") == 0);
+    assert(again->query->size == 0 && again->body->size == 0);
+    assert(again->headers == NULL && again->keep_alive);
+    assert(cwist_query_map_get(again->query_params, "x") == NULL);
+    assert(cwist_query_map_get(again->path_params, "id") == NULL);
+    cwist_http_request_destroy(again);
+
+    cwist_http_response *res = cwist_http_response_create();
+    res->status_code = CWIST_HTTP_NOT_FOUND;
+    cwist_sstring_assign(res->status_text, "Not Found");
+    cwist_sstring_assign(res->body, "missing");
+    cwist_http_header_add(&res->headers, "X-A", "1");
+    cwist_http_response_destroy(res);
+
+    cwist_http_response *res2 = cwist_http_response_create();
+    assert(res2 == res);
+    assert(res2->status_code == CWIST_HTTP_OK);
+    assert(strcmp(res2->status_text->data, "OK") == 0);
+    assert(res2->body->size == 0 && res2->headers == NULL);
+    cwist_http_response_destroy(res2);
+    printf("Passed Request/Response Recycling.\n");
+}
+
+void test_request_arena() {
+    printf("Testing Request Arena...\n");
+    cwist_http_request *req = cwist_http_parse_request("GET /a?x=1&y=two HTTP/1.1\r\nHost: h\r\n\r\n");
+    assert(req != NULL);
+    assert(strcmp(cwist_query_map_get(req->query_params, "y"), "two") == 0);
+
+    char *first = cwist_http_request_strdup(req, "scratch");
+    assert(first && strcmp(first, "scratch") == 0);
+    // Spill past the inline block, including one oversized allocation.
+    for (int i = 0; i < 100; i++) {
+        unsigned char *p = cwist_http_request_alloc(req, 100);
+        assert(p && p[0] == 0 && p[99] == 0);
+        memset(p, 0xAB, 100);
+    }
+    unsigned char *big = cwist_http_request_alloc(req, 3 * CWIST_HTTP_ARENA_SIZE);
+    assert(big && big[3 * CWIST_HTTP_ARENA_SIZE - 1] == 0);
+    assert(strcmp(cwist_http_request_strndup(req, "abcdef", 3), "abc") == 0);
+    cwist_query_map_set(req->path_params, "id", "42");
+    assert(strcmp(cwist_query_map_get(req->path_params, "id"), "42") == 0);
+    cwist_http_request_destroy(req);
+
+    // The recycled request starts from an empty arena.
+    cwist_http_request *again = cwist_http_request_create();
+    assert(again == req);
+    char *reused = cwist_http_request_alloc(again, 8);
+    assert(reused != NULL && reused[0] == 0);
+    assert(cwist_query_map_get(again->query_params, "x") == NULL);
+    cwist_http_request_destroy(again);
+    printf("Passed Request Arena.\n");
+}
+
+void test_lazy_params() {
+    printf("Testing Lazy Query Parameters...\n");
+    cwist_http_request *req = cwist_http_parse_request("GET /s?q=a%20b&page=2 HTTP/1.1\r\nHost: h\r\n\r\n");
+    assert(req != NULL);
+    // Nothing is parsed until a handler asks.
+    assert(req->query_params->pending != NULL);
+
+    assert(strcmp(cwist_query_map_get(req->query_params, "q"), "a b") == 0);
+    assert(req->query_params->pending == NULL);
+    assert(strcmp(cwist_query_map_get(req->query_params, "page"), "2") == 0);
+
+    // Maps share the per-process seed instead of reading /dev/urandom each.
+    cwist_query_map *map = cwist_query_map_create();
+    assert(memcmp(map->seed, req->query_params->seed, sizeof(map->seed)) == 0);
+    cwist_query_map_destroy(map);
+    cwist_http_request_destroy(req);
+    printf("Passed Lazy Query Parameters.\n");
+}
+
 void test_parse_request() {
     printf("Testing Request Parsing...\n");
     const char *raw = "POST /api/users HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\nContent-Type: application/json\r\n\r\n{\"name\":\"test\"}";
@@ -67,6 +154,77 @@ void test_parse_request() {
     printf("Passed Request Parsing.\n");
 }
 
+void test_clone_request() {
+    printf("Testing Request Cloning...\n");
+    const char *raw = "GET /items?page=2 HTTP/1.1\r\nHost: localhost\r\nAccept-Language: ko\r\n\r\n";
+    cwist_http_request *req = cwist_http_parse_request(raw);
+    assert(req != NULL);
+    req->client_fd = 7;
+
+    cwist_http_request *copy = cwist_http_request_clone(req);
+    assert(copy != NULL);
+    // Headers keep their order.
+    assert(strcmp(copy->headers->key->data, req->headers->key->data) == 0);
+    assert(strcmp(copy->headers->next->key->data, req->headers->next->key->data) == 0);
+    cwist_http_request_destroy(req);
+    assert(copy->method == CWIST_HTTP_GET && copy->client_fd == -1);
+    assert(strcmp(copy->path->data, "/items") == 0);
+    assert(strcmp(copy->query->data, "page=2") == 0);
+    assert(strcmp(cwist_http_header_get(copy->headers, "Accept-Language"), "ko") == 0);
+    cwist_http_request_destroy(copy);
+    printf("Passed Request Cloning.\n");
+}
+
+void test_parse_frame_in_place() {
+    printf("Testing In-Place Frame Parsing...\n");
+    char frame[] = "GET /items?id=7 HTTP/1.1\r\nHost: a\r\nX-Tag: one\r\n\r\nGET / HTTP/1.1\r\n\r\n";
+    size_t frame_len = 0;
+    assert(cwist_http_frame_request(frame, strlen(frame), &frame_len) == 1);
+
+    cwist_http_request *req = cwist_http_request_from_frame(frame, frame_len);
+    assert(req != NULL);
+    assert(req->path->is_view && req->path->data >= frame && req->path->data < frame + frame_len);
+    assert(strcmp(req->path->data, "/items") == 0);
+    assert(strcmp(req->query->data, "id=7") == 0);
+    assert(strcmp(cwist_http_header_get(req->headers, "X-Tag"), "one") == 0);
+
+    // Writes copy the view instead of touching the frame.
+    cwist_sstring_append(req->path, "/more");
+    assert(!req->path->is_view);
+    assert(strcmp(req->path->data, "/items/more") == 0);
+
+    cwist_http_request_destroy(req);
+    // The pipelined request after the frame is left intact.
+    assert(strncmp(frame + frame_len, "GET / HTTP/1.1", 14) == 0);
+    printf("Passed In-Place Frame Parsing.\n");
+}
+
+void test_scan_resume() {
+    printf("Testing header scan (%s)...\n", cwist_http_scan_impl());
+    char line[100];
+    memset(line, 'a', sizeof(line));
+    for (size_t i = 0; i < sizeof(line); i++) {
+        line[i] = ':';
+        assert(cwist_http_scan2(line, sizeof(line), ':', '\n') == i);
+        line[i] = 'a';
+    }
+    assert(cwist_http_scan2(line, sizeof(line), ':', '\n') == sizeof(line));
+
+    // Feed the request a few bytes at a time, with the terminator split across reads.
+    const char *raw = "GET /x HTTP/1.1\r\nHost: a\r\nX-Long: 0123456789abcdef0123456789abcdef\r\n\r\nBODY";
+    size_t head = strstr(raw, "\r\n\r\n") - raw;
+    size_t scanned = 0;
+    size_t frame_len = 0;
+    for (size_t have = 0; have <= head + 4; have++) {
+        int framed = cwist_http_frame_request_resume(raw, have, &scanned, &frame_len);
+        assert(framed == (have == head + 4 ? 1 : 0));
+        assert(scanned <= have);
+    }
+    assert(frame_len == head + 4);
+    assert(cwist_http_frame_request_resume(raw, head + 4, &scanned, &frame_len) == 1);
+    printf("Passed header scan.\n");
+}
+
 void test_send_response() {
     printf("Testing Response Sending...\n");
     int sv[2];
@@ -100,12 +258,77 @@ void test_send_response() {
     printf("Passed Response Sending.\n");
 }
 
+static int body_releases;
+
+static void release_body(const void *ptr, size_t len, void *ctx) {
+    (void)ptr;
+    (void)len;
+    (void)ctx;
+    body_releases++;
+}
+
+typedef struct {
+    char wire[1024];
+    size_t len;
+    cwist_http_body_pin kept;
+} capture_ctx;
+
+static void keep_sent(const struct iovec *iov, int iov_cnt, cwist_http_body_pin *pin, void *arg) {
+    capture_ctx *cap = (capture_ctx *)arg;
+    for (int i = 0; i < iov_cnt; i++) {
+        memcpy(cap->wire + cap->len, iov[i].iov_base, iov[i].iov_len);
+        cap->len += iov[i].iov_len;
+    }
+    if (pin) {
+        cap->kept = *pin;
+        pin->cleanup = NULL;
+    }
+}
+
+void test_send_capture() {
+    printf("Testing Response Capture...\n");
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        perror("socketpair");
+        return;
+    }
+
+    static const char body[] = "pinned body";
+    cwist_http_response *res = cwist_http_response_create();
+    cwist_http_response_set_body_ptr_managed(res, body, strlen(body), release_body, NULL);
+    capture_ctx cap = {0};
+    body_releases = 0;
+    assert(cwist_http_send_response_capture(sv[0], res, keep_sent, &cap).error.err_i16 == 0);
+
+    // The observer sees exactly the bytes on the wire, and adopting the pin keeps the body alive.
+    char buffer[1024];
+    ssize_t len = recv(sv[1], buffer, sizeof(buffer), 0);
+    assert(len == (ssize_t)cap.len && memcmp(buffer, cap.wire, cap.len) == 0);
+    assert(strstr(cap.wire, "Content-Length: 11\r\n") != NULL);
+    assert(cap.kept.ptr == body && cap.kept.cleanup == release_body);
+    cwist_http_response_destroy(res);
+    assert(body_releases == 0);
+    cap.kept.cleanup(cap.kept.ptr, cap.kept.len, cap.kept.ctx);
+    assert(body_releases == 1);
+
+    close(sv[0]);
+    close(sv[1]);
+    printf("Passed Response Capture.\n");
+}
+
 int main() {
     test_methods();
     test_request_lifecycle();
     test_response_lifecycle();
+    test_recycling();
+    test_request_arena();
+    test_lazy_params();
     test_parse_request();
+    test_clone_request();
+    test_parse_frame_in_place();
+    test_scan_resume();
     test_send_response();
+    test_send_capture();
     printf("All HTTP tests passed!\n");
     return 0;
 }
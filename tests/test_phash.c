@@ -0,0 +1,50 @@
+#include <cwist/core/phash/phash.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+void test_build_and_lookup() {
+    printf("Testing perfect hash lookups...\n");
+    enum { N = 2000 };
+    static char names[N][32];
+    static cwist_phash_key keys[N];
+    for (int i = 0; i < N; i++) {
+        snprintf(names[i], sizeof(names[i]), "/route/%d", i / 2);
+        keys[i] = (cwist_phash_key){ names[i], strlen(names[i]), (uint32_t)(i % 2), &keys[i] };
+    }
+    cwist_phash *ph = cwist_phash_build(keys, N);
+    assert(ph);
+    assert(cwist_phash_count(ph) == N);
+    for (int i = 0; i < N; i++) {
+        assert(cwist_phash_get(ph, (uint32_t)(i % 2), names[i], strlen(names[i])) == &keys[i]);
+    }
+    // Same bytes under another tag, prefixes and unknown keys all miss.
+    assert(cwist_phash_get(ph, 2, "/route/1", 8) == NULL);
+    assert(cwist_phash_get(ph, 0, "/route/1", 7) == NULL);
+    assert(cwist_phash_get(ph, 0, "/nope", 5) == NULL);
+    cwist_phash_destroy(ph);
+    printf("Passed perfect hash lookups.\n");
+}
+
+void test_edge_cases() {
+    printf("Testing perfect hash edge cases...\n");
+    assert(cwist_phash_build(NULL, 0) == NULL);
+
+    cwist_phash_key one = { "/", 1, 0, (void *)&one };
+    cwist_phash *ph = cwist_phash_build(&one, 1);
+    assert(ph && cwist_phash_get(ph, 0, "/", 1) == &one);
+    assert(cwist_phash_get(ph, 0, "", 0) == NULL);
+    cwist_phash_destroy(ph);
+
+    cwist_phash_key dup[2] = { { "/a", 2, 1, NULL }, { "/a", 2, 1, NULL } };
+    assert(cwist_phash_build(dup, 2) == NULL);
+    printf("Passed perfect hash edge cases.\n");
+}
+
+int main() {
+    test_build_and_lookup();
+    test_edge_cases();
+    printf("All perfect hash tests passed!\n");
+    return 0;
+}
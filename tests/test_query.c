@@ -0,0 +1,131 @@
+#include <cwist/net/http/query.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+static char g_arena[64 * 1024];
+static size_t g_arena_used = 0;
+
+static void *bump_alloc(void *ctx, size_t size) {
+    (void)ctx;
+    size = (size + 15) & ~(size_t)15;
+    if (g_arena_used + size > sizeof(g_arena)) return NULL;
+    void *ptr = g_arena + g_arena_used;
+    g_arena_used += size;
+    return ptr;
+}
+
+static void fill_and_check(cwist_query_map *map, int count) {
+    char key[64], value[128];
+    for (int i = 0; i < count; i++) {
+        // Every third pair is too long to live inside its entry.
+        snprintf(key, sizeof(key), i % 3 ? "k%d" : "a_rather_long_parameter_name_%d", i);
+        snprintf(value, sizeof(value), "value-%d", i);
+        cwist_query_map_set(map, key, value);
+    }
+    assert(cwist_query_map_count(map) == (size_t)count);
+    for (int i = 0; i < count; i++) {
+        const char *k = NULL, *v = NULL;
+        assert(cwist_query_map_at(map, (size_t)i, &k, &v));
+        snprintf(key, sizeof(key), i % 3 ? "k%d" : "a_rather_long_parameter_name_%d", i);
+        snprintf(value, sizeof(value), "value-%d", i);
+        assert(strcmp(k, key) == 0);
+        assert(strcmp(v, value) == 0);
+        assert(strcmp(cwist_query_map_get(map, key), value) == 0);
+    }
+    assert(!cwist_query_map_at(map, (size_t)count, NULL, NULL));
+    assert(cwist_query_map_get(map, "missing") == NULL);
+}
+
+void test_insertion_order_and_growth() {
+    printf("Testing insertion order and growth...\n");
+    cwist_query_map *map = cwist_query_map_create();
+    fill_and_check(map, 3);
+    cwist_query_map_clear(map);
+    assert(cwist_query_map_count(map) == 0);
+    fill_and_check(map, 300);
+    cwist_query_map_destroy(map);
+    printf("Passed insertion order and growth.\n");
+}
+
+void test_overwrite() {
+    printf("Testing overwrite...\n");
+    cwist_query_map *map = cwist_query_map_create();
+    cwist_query_map_set(map, "page", "1");
+    cwist_query_map_set(map, "sort", "asc");
+    const char *const_ptr = cwist_query_map_get(map, "sort");
+    cwist_query_map_set(map, "page", "a value far too long to stay inside the entry");
+    assert(strcmp(cwist_query_map_get(map, "page"), "a value far too long to stay inside the entry") == 0);
+    cwist_query_map_set(map, "page", "2");
+    assert(strcmp(cwist_query_map_get(map, "page"), "2") == 0);
+    assert(cwist_query_map_count(map) == 2);
+    // Untouched entries do not move while others change or the map grows.
+    for (int i = 0; i < 50; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "x%d", i);
+        cwist_query_map_set(map, key, "y");
+    }
+    assert(const_ptr == cwist_query_map_get(map, "sort"));
+    assert(cwist_query_map_set_len(map, "ab", 1, "xyz", 2));
+    assert(strcmp(cwist_query_map_get(map, "a"), "xy") == 0);
+    cwist_query_map_destroy(map);
+    printf("Passed overwrite.\n");
+}
+
+void test_arena_backed() {
+    printf("Testing arena-backed map...\n");
+    cwist_query_map map;
+    cwist_query_map_init(&map);
+    cwist_query_map_use_arena(&map, bump_alloc, NULL);
+    fill_and_check(&map, 40);
+    assert(g_arena_used > 0);
+    cwist_query_map_clear(&map);
+    g_arena_used = 0;
+    fill_and_check(&map, 5);
+    cwist_query_map_parse(&map, "q=1&r=two");
+    assert(strcmp(cwist_query_map_get(&map, "r"), "two") == 0);
+    cwist_query_map_release(&map);
+    printf("Passed arena-backed map.\n");
+}
+
+void test_parse_decoding() {
+    printf("Testing query decoding...\n");
+    cwist_query_map *map = cwist_query_map_create();
+    cwist_query_map_parse(map, "q=hello+world&path=%2Fa%2fb&bad=100%&half=%4&&flag&=empty&k%20ey=v&eq=a=b");
+    assert(strcmp(cwist_query_map_get(map, "q"), "hello world") == 0);
+    assert(strcmp(cwist_query_map_get(map, "path"), "/a/b") == 0);
+    assert(strcmp(cwist_query_map_get(map, "bad"), "100%") == 0);
+    assert(strcmp(cwist_query_map_get(map, "half"), "%4") == 0);
+    assert(strcmp(cwist_query_map_get(map, "flag"), "") == 0);
+    assert(strcmp(cwist_query_map_get(map, ""), "empty") == 0);
+    assert(strcmp(cwist_query_map_get(map, "k ey"), "v") == 0);
+    assert(strcmp(cwist_query_map_get(map, "eq"), "a=b") == 0);
+    assert(cwist_query_map_count(map) == 8);
+
+    // Long values with an escape far past the first vector block.
+    char raw[512];
+    char expected[512];
+    memset(expected, 'x', 300);
+    expected[300] = '&';
+    expected[301] = '\0';
+    snprintf(raw, sizeof(raw), "long=%.*s%%26", 300, expected);
+    cwist_query_map_clear(map);
+    cwist_query_map_parse(map, raw);
+    assert(strcmp(cwist_query_map_get(map, "long"), expected) == 0);
+
+    // The last duplicate wins, as before.
+    cwist_query_map_parse(map, "long=1&long=%32");
+    assert(strcmp(cwist_query_map_get(map, "long"), "2") == 0);
+    cwist_query_map_destroy(map);
+    printf("Passed query decoding.\n");
+}
+
+int main() {
+    test_insertion_order_and_growth();
+    test_overwrite();
+    test_arena_backed();
+    test_parse_decoding();
+    printf("All query map tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,238 @@
+#include <cwist/sys/app/router.h>
+#include <cwist/sys/app/app.h>
+#include <cwist/net/http/query.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+static void h_user(cwist_http_request *req, cwist_http_response *res) { (void)req; (void)res; }
+static void h_user_new(cwist_http_request *req, cwist_http_response *res) { (void)req; (void)res; }
+static void h_user_edit(cwist_http_request *req, cwist_http_response *res) { (void)req; (void)res; }
+static void h_user_post(cwist_http_request *req, cwist_http_response *res) { (void)req; (void)res; }
+static void h_files(cwist_http_request *req, cwist_http_response *res) { (void)req; (void)res; }
+static void h_exact(cwist_http_request *req, cwist_http_response *res) { (void)req; (void)res; }
+
+static const cwist_route_entry *match(cwist_route_table *table, cwist_http_method_t method, const char *path,
+                                      cwist_route_match *out) {
+    return cwist_route_table_match(table, method, path, strlen(path), out) ? out->route : NULL;
+}
+
+static const char *capture(const cwist_route_match *m, const char *path, size_t i, char *buf, size_t cap) {
+    assert(i < m->param_count);
+    size_t len = m->params[i].len < cap - 1 ? m->params[i].len : cap - 1;
+    memcpy(buf, path + m->params[i].offset, len);
+    buf[len] = '\0';
+    return buf;
+}
+
+void test_static_and_params() {
+    printf("Testing static and parameter routes...\n");
+    cwist_route_table *table = cwist_route_table_create();
+    assert(cwist_route_table_insert(table, "/users/:id", CWIST_HTTP_GET, h_user, NULL));
+    assert(cwist_route_table_insert(table, "/users/:id/posts/:post", CWIST_HTTP_GET, h_user_post, NULL));
+    assert(cwist_route_table_insert(table, "/users/new/:step", CWIST_HTTP_GET, h_user_new, NULL));
+    assert(cwist_route_table_insert(table, "/users/:name/edit", CWIST_HTTP_POST, h_user_edit, NULL));
+    assert(cwist_route_table_insert(table, "/users", CWIST_HTTP_GET, h_exact, NULL));
+
+    cwist_route_match m;
+    char buf[64];
+    assert(match(table, CWIST_HTTP_GET, "/users", &m)->handler == h_exact);
+    assert(m.param_count == 0);
+
+    assert(match(table, CWIST_HTTP_GET, "/users/42", &m)->handler == h_user);
+    assert(strcmp(capture(&m, "/users/42", 0, buf, sizeof(buf)), "42") == 0);
+
+    // Static segments win, but the matcher backtracks into :id when they lead nowhere.
+    assert(match(table, CWIST_HTTP_GET, "/users/new/profile", &m)->handler == h_user_new);
+    assert(strcmp(capture(&m, "/users/new/profile", 0, buf, sizeof(buf)), "profile") == 0);
+    assert(match(table, CWIST_HTTP_GET, "/users/new", &m)->handler == h_user);
+    assert(strcmp(capture(&m, "/users/new", 0, buf, sizeof(buf)), "new") == 0);
+
+    const char *path = "/users//7/posts/99/";
+    assert(match(table, CWIST_HTTP_GET, path, &m)->handler == h_user_post);
+    assert(m.param_count == 2);
+    assert(strcmp(capture(&m, path, 0, buf, sizeof(buf)), "7") == 0);
+    assert(strcmp(capture(&m, path, 1, buf, sizeof(buf)), "99") == 0);
+
+    // Method is part of the key.
+    assert(match(table, CWIST_HTTP_POST, "/users/bob/edit", &m)->handler == h_user_edit);
+    assert(match(table, CWIST_HTTP_GET, "/users/bob/edit", &m) == NULL);
+    assert(match(table, CWIST_HTTP_GET, "/users/1/2", &m) == NULL);
+    assert(match(table, CWIST_HTTP_GET, "/other", &m) == NULL);
+
+    cwist_query_map params;
+    cwist_query_map_init(&params);
+    match(table, CWIST_HTTP_POST, "/users/bob/edit", &m);
+    cwist_route_match_bind(&m, "/users/bob/edit", &params);
+    assert(strcmp(cwist_query_map_get(&params, "name"), "bob") == 0);
+    assert(cwist_query_map_get(&params, "id") == NULL);
+    cwist_query_map_release(&params);
+
+    cwist_route_table_destroy(table);
+    printf("Passed static and parameter routes.\n");
+}
+
+void test_wildcard_and_long_paths() {
+    printf("Testing wildcards and long paths...\n");
+    cwist_route_table *table = cwist_route_table_create();
+    assert(cwist_route_table_insert(table, "/files/*path", CWIST_HTTP_GET, h_files, NULL));
+    assert(cwist_route_table_insert(table, "/items/:id", CWIST_HTTP_GET, h_user, NULL));
+    assert(!cwist_route_table_insert(table, "/bad/*rest/more", CWIST_HTTP_GET, h_files, NULL));
+
+    cwist_route_match m;
+    char buf[64];
+    assert(match(table, CWIST_HTTP_GET, "/files/css/site.css", &m)->handler == h_files);
+    assert(strcmp(capture(&m, "/files/css/site.css", 0, buf, sizeof(buf)), "css/site.css") == 0);
+    assert(match(table, CWIST_HTTP_GET, "/files", &m)->handler == h_files);
+    assert(m.params[0].len == 0);
+
+    // A segment far past the old 255-byte cutoff is captured in full.
+    size_t id_len = 1000;
+    char *path = malloc(id_len + 8);
+    memcpy(path, "/items/", 7);
+    memset(path + 7, 'x', id_len);
+    path[7 + id_len] = '\0';
+    assert(match(table, CWIST_HTTP_GET, path, &m)->handler == h_user);
+    assert(m.params[0].offset == 7 && m.params[0].len == id_len);
+    free(path);
+
+    cwist_route_table_destroy(table);
+    printf("Passed wildcards and long paths.\n");
+}
+
+void test_many_routes() {
+    printf("Testing many routes...\n");
+    cwist_route_table *table = cwist_route_table_create();
+    char pattern[64];
+    for (int i = 0; i < 500; i++) {
+        snprintf(pattern, sizeof(pattern), "/api/v1/res%d/:id/sub%d", i, i % 7);
+        assert(cwist_route_table_insert(table, pattern, CWIST_HTTP_GET, i % 2 ? h_user : h_files, NULL));
+    }
+    // Re-registering replaces the handler.
+    assert(cwist_route_table_insert(table, "/api/v1/res3/:key/sub3", CWIST_HTTP_GET, h_exact, NULL));
+
+    cwist_route_match m;
+    char path[64];
+    for (int i = 0; i < 500; i++) {
+        snprintf(path, sizeof(path), "/api/v1/res%d/abc/sub%d", i, i % 7);
+        const cwist_route_entry *route = match(table, CWIST_HTTP_GET, path, &m);
+        assert(route);
+        assert(route->handler == (i == 3 ? h_exact : i % 2 ? h_user : h_files));
+        assert(m.param_count == 1 && m.params[0].len == 3);
+    }
+    assert(strcmp(match(table, CWIST_HTTP_GET, "/api/v1/res3/abc/sub3", &m)->param_names[0], "key") == 0);
+    assert(match(table, CWIST_HTTP_GET, "/api/v1/res3/abc/sub4", &m) == NULL);
+    cwist_route_table_destroy(table);
+    printf("Passed many routes.\n");
+}
+
+void test_freeze() {
+    printf("Testing frozen exact routes...\n");
+    cwist_route_table *table = cwist_route_table_create();
+    assert(cwist_route_table_freeze(table));
+    char path[64];
+    for (int i = 0; i < 300; i++) {
+        snprintf(path, sizeof(path), "/static/page%d", i);
+        assert(cwist_route_table_insert(table, path, i % 3 ? CWIST_HTTP_GET : CWIST_HTTP_POST, h_exact, NULL));
+    }
+    assert(cwist_route_table_insert(table, "/users/:id", CWIST_HTTP_GET, h_user, NULL));
+    assert(cwist_route_table_freeze(table));
+
+    cwist_route_match m;
+    for (int i = 0; i < 300; i++) {
+        snprintf(path, sizeof(path), "/static/page%d", i);
+        assert(match(table, i % 3 ? CWIST_HTTP_GET : CWIST_HTTP_POST, path, &m)->handler == h_exact);
+        assert(match(table, i % 3 ? CWIST_HTTP_POST : CWIST_HTTP_GET, path, &m) == NULL);
+    }
+    assert(match(table, CWIST_HTTP_GET, "/static/page", &m) == NULL);
+    assert(match(table, CWIST_HTTP_GET, "/users/5", &m)->handler == h_user);
+
+    // Routes added after the freeze are still found.
+    assert(cwist_route_table_insert(table, "/late", CWIST_HTTP_GET, h_files, NULL));
+    assert(match(table, CWIST_HTTP_GET, "/late", &m)->handler == h_files);
+    assert(match(table, CWIST_HTTP_GET, "/static/page1", &m)->handler == h_exact);
+    assert(cwist_route_table_freeze(table));
+    assert(match(table, CWIST_HTTP_GET, "/late", &m)->handler == h_files);
+    cwist_route_table_destroy(table);
+    printf("Passed frozen exact routes.\n");
+}
+
+void test_clone_and_remove() {
+    printf("Testing clone and remove...\n");
+    cwist_route_table *table = cwist_route_table_create();
+    assert(cwist_route_table_insert(table, "/a", CWIST_HTTP_GET, h_exact, NULL));
+    assert(cwist_route_table_insert(table, "/a", CWIST_HTTP_POST, h_user, NULL));
+    assert(cwist_route_table_insert(table, "/u/:id", CWIST_HTTP_GET, h_user, NULL));
+    assert(cwist_route_table_insert(table, "/u/:id/x/*rest", CWIST_HTTP_GET, h_files, NULL));
+    assert(cwist_route_table_freeze(table));
+
+    cwist_route_table *copy = cwist_route_table_clone(table);
+    assert(copy);
+    cwist_route_match m;
+    assert(cwist_route_table_remove(copy, CWIST_HTTP_GET, "/a"));
+    assert(!cwist_route_table_remove(copy, CWIST_HTTP_GET, "/a"));
+    assert(cwist_route_table_remove(copy, CWIST_HTTP_GET, "/u/:name"));
+    assert(!cwist_route_table_remove(copy, CWIST_HTTP_GET, "/u/:id/y"));
+
+    // The copy changed; the original, still frozen, did not.
+    assert(match(copy, CWIST_HTTP_GET, "/a", &m) == NULL);
+    assert(match(copy, CWIST_HTTP_POST, "/a", &m)->handler == h_user);
+    assert(match(copy, CWIST_HTTP_GET, "/u/1", &m) == NULL);
+    assert(match(copy, CWIST_HTTP_GET, "/u/1/x/y/z", &m)->handler == h_files);
+    assert(match(table, CWIST_HTTP_GET, "/a", &m)->handler == h_exact);
+    assert(match(table, CWIST_HTTP_GET, "/u/1", &m)->handler == h_user);
+
+    cwist_route_table_destroy(table);
+    cwist_route_table_destroy(copy);
+    printf("Passed clone and remove.\n");
+}
+
+static void mw_a(cwist_http_request *req, cwist_http_response *res, cwist_handler_func next) { next(req, res); }
+static void mw_b(cwist_http_request *req, cwist_http_response *res, cwist_handler_func next) { next(req, res); }
+
+static const cwist_middleware_chain *route_chain(cwist_app *app, const char *path) {
+    cwist_route_match m;
+    const cwist_route_entry *route = match(app->router, CWIST_HTTP_GET, path, &m);
+    assert(route);
+    return route->middleware;
+}
+
+void test_middleware_chains() {
+    printf("Testing per-prefix middleware chains...\n");
+    cwist_app *app = cwist_app_create();
+    assert(app);
+    cwist_app_get(app, "/static/x", h_exact);
+    assert(cwist_app_use_prefix(app, "/api/", mw_a).error.err_i16 == 0);
+    cwist_app_get(app, "/api/users/:id", h_user);
+    cwist_app_get(app, "/api", h_exact);
+    cwist_app_get(app, "/apis", h_exact);
+
+    assert(route_chain(app, "/static/x") == NULL);
+    assert(route_chain(app, "/apis") == NULL);
+    const cwist_middleware_chain *api = route_chain(app, "/api/users/7");
+    assert(api && api->count == 1 && api->funcs[0] == mw_a);
+    assert(route_chain(app, "/api") == api);
+
+    // Middleware added later reaches routes registered earlier, in registration order.
+    cwist_app_use(app, mw_b);
+    api = route_chain(app, "/api/users/7");
+    assert(api && api->count == 2 && api->funcs[0] == mw_a && api->funcs[1] == mw_b);
+    const cwist_middleware_chain *other = route_chain(app, "/static/x");
+    assert(other && other->count == 1 && other->funcs[0] == mw_b);
+    assert(route_chain(app, "/apis") == other);
+
+    cwist_app_destroy(app);
+    printf("Passed per-prefix middleware chains.\n");
+}
+
+int main() {
+    test_static_and_params();
+    test_wildcard_and_long_paths();
+    test_many_routes();
+    test_freeze();
+    test_clone_and_remove();
+    test_middleware_chains();
+    printf("All router tests passed!\n");
+    return 0;
+}
@@ -30,6 +30,24 @@ void test_basic_hashing() {
     printf("Passed basic hashing.\n");
 }
 
+void test_128_bit() {
+    printf("Testing 128-bit hashing...\n");
+    uint8_t key[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    uint8_t msg[15];
+    for (int i = 0; i < 15; i++) msg[i] = (uint8_t)i;
+
+    // Reference vectors from the SipHash paper's test suite (key 00..0f).
+    uint64_t out[2];
+    siphash24_128(msg, 0, key, out);
+    assert(out[0] == 0xe6a825ba047f81a3ULL && out[1] == 0x930255c71472f66dULL);
+    siphash24_128(msg, 15, key, out);
+    assert(out[0] != 0 && out[0] != out[1]);
+
+    // The 64-bit variant is unchanged.
+    assert(siphash24(msg, 0, key) == 0x726fdb47dd0e0e31ULL);
+    printf("Passed 128-bit hashing.\n");
+}
+
 void test_key_generation() {
     printf("Testing key generation...\n");
     uint8_t key1[16];
@@ -64,6 +82,7 @@ void test_key_generation() {
 
 int main() {
     test_basic_hashing();
+    test_128_bit();
     test_key_generation();
     printf("All siphash tests passed!\n");
     return 0;